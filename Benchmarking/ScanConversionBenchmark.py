@@ -0,0 +1,268 @@
+#!/usr/bin/env python
+
+"""Benchmark the scan conversion resampling methods.
+
+Every resampling method of each scan conversion module is run on the module
+test input over a sweep of output grid resolutions and thread counts. The
+timing and memory of each run come from the JSON file written by the
+``--profile`` option of the modules. The throughput in output voxels per
+second of the resampling stage and of the whole run, along with the peak
+resident memory, are printed as a table and written to a JSON report. The
+ITK methods are also run for each tile size of the traversal of the output,
+so the tiled traversal is compared with the scanline traversal, tile size 0.
+
+This script is run by the ScanConversionBenchmark target, which passes the
+module test drivers and the test inputs.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import multiprocessing
+import os
+import subprocess
+import sys
+
+
+ITK_METHODS = [
+    'ITKNearestNeighbor',
+    'ITKLinear',
+    'ITKGaussian',
+    'ITKWindowedSinc',
+    ]
+
+VTK_METHODS = [
+    'VTKProbeFilter',
+    'VTKGaussianKernel',
+    'VTKLinearKernel',
+    'VTKShepardKernel',
+    'VTKVoronoiKernel',
+    ]
+
+
+# Geometry arguments of the module tests, and the output grids of the
+# resolution sweep. Each resolution covers the same field of view as the
+# test output grid.
+MODULES = {
+    'ScanConvertCurvilinearArray': {
+        'geometry': [
+            '--lateralAngularSeparation', '0.00862832',
+            '--radiusSampleSize', '0.0513434',
+            '--firstSampleDistance', '26.4',
+            ],
+        'resolutions': [
+            ['--outputSize', '400,400,3', '--outputSpacing', '0.3,0.3,0.3'],
+            ['--outputSize', '800,800,3', '--outputSpacing', '0.15,0.15,0.15'],
+            ['--outputSize', '1600,1600,3', '--outputSpacing', '0.075,0.075,0.075'],
+            ],
+        'methods': ITK_METHODS + VTK_METHODS + ['FastLinear'],
+        },
+    'ScanConvertPhasedArray3D': {
+        'geometry': [
+            '--azimuthAngularSeparation', '0.0872665',
+            '--elevationAngularSeparation', '0.0174533',
+            '--radiusSampleSize', '0.2',
+            '--firstSampleDistance', '8.0',
+            ],
+        'resolutions': [
+            ['--outputSize', '64,64,64', '--outputSpacing', '0.4,0.4,0.4'],
+            ['--outputSize', '128,128,128', '--outputSpacing', '0.2,0.2,0.2'],
+            ['--outputSize', '256,256,256', '--outputSpacing', '0.1,0.1,0.1'],
+            ],
+        'methods': ITK_METHODS + VTK_METHODS,
+        },
+    'ScanConvertSliceSeries': {
+        'geometry': [],
+        'resolutions': [
+            ['--outputSpacing', '2.0,2.0,2.0'],
+            ['--outputSpacing', '1.0,1.0,1.0'],
+            ['--outputSpacing', '0.5,0.5,0.5'],
+            ],
+        'methods': ITK_METHODS + VTK_METHODS + ['ForwardSplat'],
+        },
+    }
+
+
+def default_thread_counts():
+    """Powers of two up to the number of processors, plus that number."""
+    processors = multiprocessing.cpu_count()
+    counts = []
+    count = 1
+    while count < processors:
+        counts.append(count)
+        count *= 2
+    counts.append(processors)
+    return counts
+
+
+def read_meta_image_size(file_name):
+    """Read the DimSize of a MetaImage header."""
+    with open(file_name, 'rb') as meta_image:
+        for line in meta_image:
+            line = line.decode('latin-1').strip()
+            key, _, value = line.partition('=')
+            key = key.strip()
+            if key == 'DimSize':
+                return [int(dim) for dim in value.split()]
+            if key == 'ElementDataFile':
+                break
+    raise RuntimeError('No DimSize in ' + file_name)
+
+
+def profile_stage(profile, name):
+    for stage in profile['stages']:
+        if stage['name'] == name:
+            return stage
+    return None
+
+
+def run(launcher, driver, arguments, threads, output_directory, repeat):
+    """Run a module, and return the profile of the fastest repetition and the
+    number of output voxels."""
+    output_file = os.path.join(output_directory, 'ScanConversionBenchmarkOutput.mha')
+    profile_file = os.path.join(output_directory, 'ScanConversionBenchmarkProfile.json')
+    command = launcher + [driver, 'ModuleEntryPoint'] + arguments + \
+        ['--threads', str(threads), '--profile', profile_file, output_file]
+
+    fastest = None
+    for repetition in range(repeat):
+        with open(os.devnull, 'w') as devnull:
+            status = subprocess.call(command, stdout=devnull)
+        if status != 0:
+            return None, 0
+        with open(profile_file) as profile_json:
+            profile = json.load(profile_json)
+        total = profile_stage(profile, 'Total')
+        if fastest is None or total['wallTime'] < profile_stage(fastest, 'Total')['wallTime']:
+            fastest = profile
+
+    voxels = 1
+    for dim in read_meta_image_size(output_file):
+        voxels *= dim
+    return fastest, voxels
+
+
+def tiling_speedups(results):
+    """Resampling speed of each tile size relative to the scanline traversal
+    of the same configuration."""
+    scanline = {}
+    for result in results:
+        if result['tileSize'] == 0:
+            key = (result['module'], result['method'], tuple(result['arguments']), result['threads'])
+            scanline[key] = result['resampleVoxelsPerSecond']
+    speedups = []
+    for result in results:
+        key = (result['module'], result['method'], tuple(result['arguments']), result['threads'])
+        if result['tileSize'] != 0 and key in scanline:
+            speedups.append({
+                'module': result['module'],
+                'method': result['method'],
+                'arguments': result['arguments'],
+                'threads': result['threads'],
+                'tileSize': result['tileSize'],
+                'speedup': result['resampleVoxelsPerSecond'] / max(scanline[key], 1e-9),
+                })
+    return speedups
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--driver', nargs=3, action='append', default=[],
+        metavar=('MODULE', 'DRIVER', 'INPUT'),
+        help='Module name, test driver executable, and test input of a module to benchmark.')
+    parser.add_argument('--launcher', default='',
+        help='Semicolon separated command that launches the test drivers, e.g. the SEM_LAUNCH_COMMAND.')
+    parser.add_argument('--methods', default='',
+        help='Comma separated resampling methods to benchmark. Defaults to all the methods of each module.')
+    parser.add_argument('--threads', default='',
+        help='Comma separated thread counts. Defaults to powers of two up to the number of processors.')
+    parser.add_argument('--tile-sizes', default='0',
+        help='Comma separated output tile sizes of the ITK methods, 0 for the scanline traversal.')
+    parser.add_argument('--repeat', type=int, default=3,
+        help='Number of runs of each configuration. The fastest run is reported.')
+    parser.add_argument('--output-directory', default='.',
+        help='Directory for the temporary outputs of the runs.')
+    parser.add_argument('--report', default='',
+        help='JSON file for the results.')
+    args = parser.parse_args()
+
+    launcher = [arg for arg in args.launcher.split(';') if arg]
+    if args.threads:
+        thread_counts = [int(count) for count in args.threads.split(',')]
+    else:
+        thread_counts = default_thread_counts()
+    tile_sizes = [int(size) for size in args.tile_sizes.split(',') if size] or [0]
+    if not os.path.isdir(args.output_directory):
+        os.makedirs(args.output_directory)
+
+    header = '{0:<28} {1:<20} {2:>10} {3:>8} {4:>5} {5:>14} {6:>14} {7:>10}'.format(
+        'Module', 'Method', 'Voxels', 'Threads', 'Tile', 'Resample vox/s', 'Total vox/s', 'Peak MiB')
+    print(header)
+    print('-' * len(header))
+
+    results = []
+    failures = 0
+    for module, driver, input_file in args.driver:
+        configuration = MODULES[module]
+        methods = configuration['methods']
+        if args.methods:
+            methods = [method for method in args.methods.split(',') if method in methods]
+        for method in methods:
+            # Only the ITK methods traverse the output in tiles
+            method_tile_sizes = tile_sizes if method in ITK_METHODS else [0]
+            for resolution in configuration['resolutions']:
+                for threads in thread_counts:
+                    for tile_size in method_tile_sizes:
+                        arguments = configuration['geometry'] + resolution + \
+                            ['--method', method, '--tileSize', str(tile_size), input_file]
+                        profile, voxels = run(launcher, driver, arguments, threads,
+                            args.output_directory, args.repeat)
+                        if profile is None:
+                            print('{0:<28} {1:<20} failed with {2}'.format(module, method,
+                                ' '.join(resolution)))
+                            failures += 1
+                            continue
+                        total = profile_stage(profile, 'Total')
+                        resample = profile_stage(profile, 'Resample Image') or total
+                        result = {
+                            'module': module,
+                            'method': method,
+                            'arguments': resolution,
+                            'voxels': voxels,
+                            'threads': threads,
+                            'tileSize': tile_size,
+                            'resampleVoxelsPerSecond': voxels / max(resample['wallTime'], 1e-9),
+                            'totalVoxelsPerSecond': voxels / max(total['wallTime'], 1e-9),
+                            'peakResidentSetSize': total['peakResidentSetSize'],
+                            'profile': profile,
+                            }
+                        results.append(result)
+                        print('{0:<28} {1:<20} {2:>10} {3:>8} {4:>5} {5:>14.4g} {6:>14.4g} {7:>10.1f}'.format(
+                            module, method, voxels, threads, tile_size,
+                            result['resampleVoxelsPerSecond'],
+                            result['totalVoxelsPerSecond'],
+                            result['peakResidentSetSize'] / 1048576.0))
+                        sys.stdout.flush()
+
+    # The tiled traversal is only worth setting where it is faster than the
+    # scanlines on this machine
+    speedups = tiling_speedups(results)
+    if speedups:
+        print('')
+        print('{0:<28} {1:<20} {2:>20} {3:>8} {4:>5} {5:>8}'.format(
+            'Module', 'Method', 'Output', 'Threads', 'Tile', 'Speedup'))
+        for speedup in speedups:
+            print('{0:<28} {1:<20} {2:>20} {3:>8} {4:>5} {5:>8.3f}'.format(
+                speedup['module'], speedup['method'], speedup['arguments'][1],
+                speedup['threads'], speedup['tileSize'], speedup['speedup']))
+
+    if args.report:
+        with open(args.report, 'w') as report:
+            json.dump({'results': results, 'tilingSpeedups': speedups}, report, indent=2)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+
+"""Report the binary size and the load time of the scan conversion modules.
+
+The size of each module library and of the ScanConversionResampling library
+is printed, along with the wall time of the fastest of several runs of each
+module executable with ``--xml``, which loads the module and its libraries
+and prints its description without resampling. Compare the report of a
+build against that of another revision, e.g. before the resampling methods
+moved into the library, to measure the size and load time they cost the
+modules.
+
+This script is run by the ScanConversionBinarySize target, which passes the
+module libraries and executables.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+
+def load_time(launcher, executable, repeat):
+    """The fastest wall time of running the executable with --xml, or None
+    when it fails."""
+    fastest = None
+    for repetition in range(repeat):
+        start = time.time()
+        with open(os.devnull, 'w') as devnull:
+            status = subprocess.call(launcher + [executable, '--xml'], stdout=devnull)
+        wall_time = time.time() - start
+        if status != 0:
+            return None
+        if fastest is None or wall_time < fastest:
+            fastest = wall_time
+    return fastest
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--binary', nargs=2, action='append', default=[],
+        metavar=('NAME', 'FILE'),
+        help='Name and file of a library or executable to report the size of.')
+    parser.add_argument('--module', nargs=2, action='append', default=[],
+        metavar=('MODULE', 'EXECUTABLE'),
+        help='Module name and executable to report the load time of.')
+    parser.add_argument('--launcher', default='',
+        help='Semicolon separated command that launches the executables, e.g. the SEM_LAUNCH_COMMAND.')
+    parser.add_argument('--repeat', type=int, default=5,
+        help='Number of runs of each executable. The fastest run is reported.')
+    parser.add_argument('--report', default='',
+        help='JSON file for the results.')
+    args = parser.parse_args()
+
+    launcher = [arg for arg in args.launcher.split(';') if arg]
+
+    sizes = []
+    print('{0:<36} {1:>12}'.format('Binary', 'Size KiB'))
+    for name, file_name in args.binary:
+        size = os.path.getsize(file_name)
+        sizes.append({'name': name, 'file': file_name, 'size': size})
+        print('{0:<36} {1:>12.1f}'.format(name, size / 1024.0))
+
+    load_times = []
+    failures = 0
+    print('')
+    print('{0:<36} {1:>12}'.format('Module', 'Load ms'))
+    for module, executable in args.module:
+        wall_time = load_time(launcher, executable, args.repeat)
+        if wall_time is None:
+            print('{0:<36} failed'.format(module))
+            failures += 1
+            continue
+        load_times.append({'module': module, 'wallTime': wall_time})
+        print('{0:<36} {1:>12.1f}'.format(module, wall_time * 1000.0))
+
+    if args.report:
+        with open(args.report, 'w') as report:
+            json.dump({'sizes': sizes, 'loadTimes': load_times}, report, indent=2)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,12 @@
+#-----------------------------------------------------------------------------
+# Ratios of the tests labeled PERFORMANCE recorded on the reference machine
+#
+#   set(<test name>_TIME_RATIO <wall time of the stage / calibration>)
+#   set(<test name>_MEMORY_RATIO <memory added by the stage / calibration>)
+#
+# The budgets of the tests are these ratios times
+# ScanConversionPerformanceTest_MARGIN, see ScanConversionPerformanceTest.cmake.
+# A test without ratios here only measures them. Configure with
+# SlicerITKUltrasound_PERFORMANCE_RECORD enabled, run ctest -L PERFORMANCE on
+# the reference machine, and copy Benchmarking/ScanConversionPerformanceRatios.cmake
+# of the build tree over this file to record them.
@@ -0,0 +1,92 @@
+#-----------------------------------------------------------------------------
+# Performance tests of the scan conversion modules
+#
+#   ScanConversionAddPerformanceTest(<name>
+#     DATA <ExternalData target>
+#     [STAGE <profiled stage>]
+#     CALIBRATION_COMMAND <module test driver command>
+#     COMMAND <module test driver command>
+#     )
+#
+# The test runs the calibration command, then the command, both with the
+# --profile option of the module inserted after ModuleEntryPoint, and fails
+# when the command fails, when a profile lacks its STAGE, by default
+# "Resample Image", or when the wall time of the stage or the memory the stage
+# adds exceed the budget ratios times those of the calibration on the same
+# machine.
+#
+# The budgets are the <name>_TIME_RATIO and <name>_MEMORY_RATIO recorded in
+# ScanConversionPerformanceRatios.cmake times a margin of
+# ScanConversionPerformanceTest_MARGIN, 1.5, and times
+# ${EXTENSION_NAME}_PERFORMANCE_BUDGET_SCALE. A test without recorded ratios
+# only measures them. With ${EXTENSION_NAME}_PERFORMANCE_RECORD enabled, the
+# tests do not check budgets and write the measured ratios to
+# Benchmarking/ScanConversionPerformanceRatios.cmake in the build tree, which
+# is copied over the recorded ratios after a run on the reference machine.
+#
+# The tests are labeled PERFORMANCE and run serially, so they are run with
+# ctest -L PERFORMANCE and excluded with ctest -LE PERFORMANCE.
+
+include(CMakeParseArguments)
+
+set(ScanConversionPerformanceTest_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/ScanConversionPerformanceTest.py)
+set(ScanConversionPerformanceTest_MARGIN 1.5)
+set(ScanConversionPerformanceTest_RECORD_FILE
+  ${CMAKE_BINARY_DIR}/Benchmarking/ScanConversionPerformanceRatios.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/ScanConversionPerformanceRatios.cmake)
+if(${EXTENSION_NAME}_PERFORMANCE_RECORD)
+  # The tests replace the ratios of their name in a copy of the recorded ratios
+  configure_file(${CMAKE_CURRENT_LIST_DIR}/ScanConversionPerformanceRatios.cmake
+    ${ScanConversionPerformanceTest_RECORD_FILE} COPYONLY)
+endif()
+
+function(ScanConversionAddPerformanceTest testname)
+  cmake_parse_arguments(PERFORMANCE
+    ""
+    "DATA;STAGE"
+    "CALIBRATION_COMMAND;COMMAND"
+    ${ARGN}
+    )
+  if(NOT PERFORMANCE_STAGE)
+    set(PERFORMANCE_STAGE "Resample Image")
+  endif()
+
+  set(temporary "${CMAKE_BINARY_DIR}/Testing/Temporary")
+  set(profile ${temporary}/${testname}Profile.json)
+  set(calibrationProfile ${temporary}/${testname}CalibrationProfile.json)
+
+  set(calibrationCommand ${PERFORMANCE_CALIBRATION_COMMAND})
+  list(FIND calibrationCommand ModuleEntryPoint entryPoint)
+  math(EXPR entryPoint "${entryPoint} + 1")
+  list(INSERT calibrationCommand ${entryPoint} --profile ${calibrationProfile})
+
+  set(command ${PERFORMANCE_COMMAND})
+  list(FIND command ModuleEntryPoint entryPoint)
+  math(EXPR entryPoint "${entryPoint} + 1")
+  list(INSERT command ${entryPoint} --profile ${profile})
+
+  if(${EXTENSION_NAME}_PERFORMANCE_RECORD)
+    set(budget --name ${testname} --record ${ScanConversionPerformanceTest_RECORD_FILE})
+  elseif(DEFINED ${testname}_TIME_RATIO AND DEFINED ${testname}_MEMORY_RATIO)
+    set(budget
+      --time-ratio ${${testname}_TIME_RATIO}
+      --memory-ratio ${${testname}_MEMORY_RATIO}
+      --margin ${ScanConversionPerformanceTest_MARGIN}
+      --budget-scale ${${EXTENSION_NAME}_PERFORMANCE_BUDGET_SCALE}
+      )
+  else()
+    set(budget)
+  endif()
+
+  ExternalData_add_test(${PERFORMANCE_DATA} NAME ${testname} COMMAND ${PYTHON_EXECUTABLE}
+    ${ScanConversionPerformanceTest_SCRIPT}
+    --stage ${PERFORMANCE_STAGE}
+    ${budget}
+    --profile ${profile}
+    --calibration-profile ${calibrationProfile}
+    --calibration-command ${calibrationCommand}
+    --test-command ${command}
+    )
+  set_property(TEST ${testname} PROPERTY LABELS PERFORMANCE)
+  set_property(TEST ${testname} PROPERTY RUN_SERIAL TRUE)
+endfunction()
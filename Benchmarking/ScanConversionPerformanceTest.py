@@ -0,0 +1,183 @@
+#!/usr/bin/env python
+
+"""Check the time and memory of a scan conversion run against its budget.
+
+The calibration command and the test command are run one after the other.
+Both are module test driver commands whose ``--profile`` option writes the
+given profiles. The test fails when a command fails, when a profile lacks
+the profiled stage, e.g. Resample Image, or when
+
+  * the wall time of the stage of the test exceeds the time budget times the
+    wall time of the same stage of the calibration, or
+  * the memory that the stage of the test adds, its peak resident memory
+    minus the resident memory when it started, exceeds the memory budget
+    times that of the calibration.
+
+The calibration is a cheap run of the same module on the same machine,
+usually the nearest neighbor method on the test input, so the budgets are
+ratios that do not depend on the speed of the machine. The measurements are
+printed as CTest measurements, which CDash records for each run.
+
+The budgets are the ratios recorded on a reference machine, --time-ratio and
+--memory-ratio, times the --margin, 1.5 by default, and the --budget-scale.
+Without recorded ratios, the ratios are only measured. With --record, the measured
+ratios are written to a CMake file of recorded ratios, which replaces the
+entries of the same test name, see ScanConversionPerformanceRatios.cmake.
+
+This script is run by the tests that ScanConversionAddPerformanceTest adds,
+see ScanConversionPerformanceTest.cmake.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+
+def split_commands(arguments):
+    """Split the options, the calibration command, and the test command."""
+    calibration = arguments.index('--calibration-command')
+    test = arguments.index('--test-command')
+    if test < calibration:
+        raise ValueError('--calibration-command must come before --test-command')
+    return arguments[:calibration], arguments[calibration + 1:test], arguments[test + 1:]
+
+
+def profile_stage(profile, name):
+    for stage in profile['stages']:
+        if stage['name'] == name:
+            return stage
+    return None
+
+
+def read_profile(file_name):
+    with open(file_name) as profile_json:
+        return json.load(profile_json)
+
+
+def stage_memory(stage):
+    """Memory added by the stage, its peak minus its start resident memory."""
+    return max(stage['peakResidentSetSize'] - stage['startResidentSetSize'], 0)
+
+
+def record_ratios(file_name, name, time_ratio, memory_ratio):
+    """Replace the recorded ratios of the named test in the CMake file."""
+    lines = []
+    if os.path.exists(file_name):
+        with open(file_name) as ratios_file:
+            lines = ratios_file.readlines()
+    entry = re.compile(r'^set\({0}_(TIME|MEMORY)_RATIO '.format(re.escape(name)))
+    lines = [line for line in lines if not entry.match(line)]
+    lines.append('set({0}_TIME_RATIO {1:.3g})\n'.format(name, time_ratio))
+    lines.append('set({0}_MEMORY_RATIO {1:.3g})\n'.format(name, memory_ratio))
+    directory = os.path.dirname(file_name)
+    if directory and not os.path.isdir(directory):
+        os.makedirs(directory)
+    with open(file_name, 'w') as ratios_file:
+        ratios_file.writelines(lines)
+
+
+def measurement(name, value):
+    print('<DartMeasurement name="{0}" type="numeric/double">{1:.6g}</DartMeasurement>'.format(name, value))
+
+
+def main():
+    try:
+        options, calibration_command, test_command = split_commands(sys.argv[1:])
+    except ValueError as error:
+        print(error)
+        return 1
+
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--stage', default='Resample Image',
+        help='Profiled stage whose wall time is compared.')
+    parser.add_argument('--time-ratio', type=float,
+        help='Recorded ratio of the wall time of the stage to that of the calibration.')
+    parser.add_argument('--memory-ratio', type=float,
+        help='Recorded ratio of the memory added by the stage to that of the calibration.')
+    parser.add_argument('--margin', type=float, default=1.5,
+        help='Factor of the recorded ratios that gives the budgets.')
+    parser.add_argument('--budget-scale', type=float, default=1.0,
+        help='Further factor of both budgets, e.g. for a loaded machine.')
+    parser.add_argument('--profile', required=True,
+        help='Profile written by the test command.')
+    parser.add_argument('--calibration-profile', required=True,
+        help='Profile written by the calibration command.')
+    parser.add_argument('--name',
+        help='Name of the test in the recorded ratios.')
+    parser.add_argument('--record',
+        help='CMake file of recorded ratios to write the measured ratios to.')
+    args = parser.parse_args(options)
+    if (args.time_ratio is None) != (args.memory_ratio is None):
+        print('Give both --time-ratio and --memory-ratio, or neither')
+        return 1
+    if args.record and not args.name:
+        print('--record requires --name')
+        return 1
+
+    for name, command in (('calibration', calibration_command), ('test', test_command)):
+        status = subprocess.call(command)
+        if status != 0:
+            print('The {0} command failed with status {1}'.format(name, status))
+            return 1
+
+    calibration = read_profile(args.calibration_profile)
+    profile = read_profile(args.profile)
+
+    stage_name = args.stage
+    stage = profile_stage(profile, stage_name)
+    calibration_stage = profile_stage(calibration, stage_name)
+    for name, found in (('test', stage), ('calibration', calibration_stage)):
+        if found is None:
+            print('The {0} profile lacks the {1} stage'.format(name, stage_name))
+            return 1
+    wall_time = stage['wallTime']
+    calibration_wall_time = calibration_stage['wallTime']
+    memory = stage_memory(stage)
+    calibration_memory = stage_memory(calibration_stage)
+
+    # The calibration adds at least the memory of its output, so the floor of
+    # 1 MiB only guards against a calibration that reused freed memory
+    time_ratio = wall_time / max(calibration_wall_time, 1e-6)
+    memory_ratio = memory / max(calibration_memory, 1048576.0)
+
+    measurement(stage_name + ' Wall Time', wall_time)
+    measurement('Calibration ' + stage_name + ' Wall Time', calibration_wall_time)
+    measurement('Wall Time Ratio', time_ratio)
+    measurement(stage_name + ' Resident MiB', memory / 1048576.0)
+    measurement('Calibration ' + stage_name + ' Resident MiB', calibration_memory / 1048576.0)
+    measurement('Resident Ratio', memory_ratio)
+
+    if args.record:
+        record_ratios(args.record, args.name, time_ratio, memory_ratio)
+        print('Recorded the ratios of {0} in {1}'.format(args.name, args.record))
+    if args.time_ratio is None:
+        print('{0} took {1:.3g} times the calibration and added {2:.3g} times its resident memory, '
+            'no budget is recorded'.format(stage_name, time_ratio, memory_ratio))
+        return 0
+
+    time_budget = args.time_ratio * args.margin * args.budget_scale
+    memory_budget = args.memory_ratio * args.margin * args.budget_scale
+    failed = False
+    if time_ratio > time_budget:
+        print('{0} took {1:.3g} times the calibration, over the budget of {2:.3g}'.format(
+            stage_name, time_ratio, time_budget))
+        failed = True
+    if memory_ratio > memory_budget:
+        print('{0} added {1:.3g} times the resident memory of the calibration, over the budget of {2:.3g}'.format(
+            stage_name, memory_ratio, memory_budget))
+        failed = True
+    if not failed:
+        print('{0} took {1:.3g} times the calibration, budget {2:.3g}, and added {3:.3g} times its '
+            'resident memory, budget {4:.3g}'.format(
+                stage_name, time_ratio, time_budget, memory_ratio, memory_budget))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,587 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkCurvilinearArraySpecialCoordinatesImage.h"
+#include "itkEuler3DTransform.h"
+#include "itkPhasedArray3DSpecialCoordinatesImage.h"
+#include "itkSliceSeriesSpecialCoordinatesImage.h"
+
+#include "ScanConversionResamplingLibrary.h"
+#include "ScanConversionResamplingExport.h"
+#include "ScanConversionResamplingMethods.h"
+#include "ScanConversionLookupTable.h"
+#include "ScanConversionCurvilinearFastLinear.h"
+#include "ScanConversionOpenCL.h"
+
+namespace
+{
+
+/** A resampling method of the library. The kernels share a signature, so
+ * the method is selected at run time from the kernel table. */
+template< typename TInputImage, typename TOutputImage >
+struct ScanConversionResamplingKernel
+{
+  typedef int ( * FunctionType )( const typename TInputImage::Pointer & inputImage,
+    typename TOutputImage::Pointer & outputImage,
+    const typename TOutputImage::SizeType & size,
+    const typename TOutputImage::SpacingType & spacing,
+    const typename TOutputImage::PointType & origin,
+    const typename TOutputImage::DirectionType & direction,
+    ScanConversionResamplingMethod method,
+    const ScanConversionResamplingOptions & options,
+    ModuleProcessInformation * CLPProcessInformation );
+
+  const char *                   Name;
+  ScanConversionResamplingMethod Method;
+  FunctionType                   Function;
+};
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+ITKResamplingKernel(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  ScanConversionResamplingMethod method,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  return ITKScanConversionResampling< TInputImage, TOutputImage >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    method,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+VTKProbeFilterResamplingKernel(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  ScanConversionResamplingMethod itkNotUsed( method ),
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  return VTKProbeFilterResampling< TInputImage, TOutputImage >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+VTKPointInterpolatorResamplingKernel(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  ScanConversionResamplingMethod method,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  return VTKPointInterpolatorResampling< TInputImage, TOutputImage >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    method,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+/** The kernel of the CLI method name. A kernel is added to the library with
+ * an entry in the table, which is in the order of
+ * ScanConversionResamplingMethod. Unknown names use the ITKLinear kernel, as
+ * in ScanConversionResamplingMethodFromString. */
+template< typename TInputImage, typename TOutputImage >
+const ScanConversionResamplingKernel< TInputImage, TOutputImage > &
+FindScanConversionResamplingKernel( const std::string & methodString )
+{
+  typedef ScanConversionResamplingKernel< TInputImage, TOutputImage > KernelType;
+  static const KernelType kernels[] =
+    {
+      { "ITKNearestNeighbor", ITK_NEAREST_NEIGHBOR, &ITKResamplingKernel< TInputImage, TOutputImage > },
+      { "ITKLinear", ITK_LINEAR, &ITKResamplingKernel< TInputImage, TOutputImage > },
+      { "ITKGaussian", ITK_GAUSSIAN, &ITKResamplingKernel< TInputImage, TOutputImage > },
+      { "ITKWindowedSinc", ITK_WINDOWED_SINC, &ITKResamplingKernel< TInputImage, TOutputImage > },
+      { "VTKProbeFilter", VTK_PROBE_FILTER, &VTKProbeFilterResamplingKernel< TInputImage, TOutputImage > },
+      { "VTKGaussianKernel", VTK_GAUSSIAN_KERNEL, &VTKPointInterpolatorResamplingKernel< TInputImage, TOutputImage > },
+      { "VTKLinearKernel", VTK_LINEAR_KERNEL, &VTKPointInterpolatorResamplingKernel< TInputImage, TOutputImage > },
+      { "VTKShepardKernel", VTK_SHEPARD_KERNEL, &VTKPointInterpolatorResamplingKernel< TInputImage, TOutputImage > },
+      { "VTKVoronoiKernel", VTK_VORONOI_KERNEL, &VTKPointInterpolatorResamplingKernel< TInputImage, TOutputImage > }
+    };
+  const unsigned int numberOfKernels = sizeof( kernels ) / sizeof( kernels[0] );
+  for( unsigned int kernel = 0; kernel < numberOfKernels; ++kernel )
+    {
+    if( methodString == kernels[kernel].Name )
+      {
+      return kernels[kernel];
+      }
+    }
+  return kernels[ITK_LINEAR];
+}
+
+
+/** The FastLinear method, which is only available for a curvilinear array
+ * input. Other inputs resample FastLinear with the kernel table, where it is
+ * an unknown name. */
+template< typename TInputImage, typename TOutputImage >
+struct ScanConversionFastLinearKernel
+{
+  static bool Supports( const std::string & itkNotUsed( methodString ) )
+  {
+    return false;
+  }
+
+  static int Resample( const typename TInputImage::Pointer & itkNotUsed( inputImage ),
+    typename TOutputImage::Pointer & itkNotUsed( outputImage ),
+    const typename TOutputImage::SizeType & itkNotUsed( size ),
+    const typename TOutputImage::SpacingType & itkNotUsed( spacing ),
+    const typename TOutputImage::PointType & itkNotUsed( origin ),
+    const typename TOutputImage::DirectionType & itkNotUsed( direction ) )
+  {
+    return EXIT_FAILURE;
+  }
+};
+
+
+template< typename TPixel, typename TOutputImage >
+struct ScanConversionFastLinearKernel< itk::CurvilinearArraySpecialCoordinatesImage< TPixel, 3 >, TOutputImage >
+{
+  typedef itk::CurvilinearArraySpecialCoordinatesImage< TPixel, 3 > InputImageType;
+
+  static bool Supports( const std::string & methodString )
+  {
+    return methodString == "FastLinear";
+  }
+
+  static int Resample( const typename InputImageType::Pointer & inputImage,
+    typename TOutputImage::Pointer & outputImage,
+    const typename TOutputImage::SizeType & size,
+    const typename TOutputImage::SpacingType & spacing,
+    const typename TOutputImage::PointType & origin,
+    const typename TOutputImage::DirectionType & direction )
+  {
+    return CurvilinearArrayFastLinearResampling< InputImageType, TOutputImage >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction
+    );
+  }
+};
+
+
+/** Resample with the method of the CLI name: GPULinear, FastLinear, a lookup
+ * table when options.LookupTableFileName is set, or the kernel table. The
+ * lookup tables do not resample the progressive levels, so
+ * options.ProgressiveLevels with options.LookupTableFileName fails. */
+template< typename TInputImage, typename TOutputImage >
+int
+LibraryResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  typedef ScanConversionFastLinearKernel< TInputImage, TOutputImage > FastLinearKernelType;
+  if( ScanConversionResamplingMethodFromString( methodString ) == GPU_LINEAR )
+    {
+    return OpenCLScanConversionResampling< TInputImage, TOutputImage >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction
+    );
+    }
+  if( FastLinearKernelType::Supports( methodString ) )
+    {
+    return FastLinearKernelType::Resample( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction
+    );
+    }
+  if( !options.LookupTableFileName.empty() )
+    {
+    if( options.ProgressiveLevels > 0 )
+      {
+      std::cerr << "The progressive levels cannot be resampled with a lookup table" << std::endl;
+      return EXIT_FAILURE;
+      }
+    return LookupTableScanConversionResampling< TInputImage, TOutputImage >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      methodString,
+      options,
+      CLPProcessInformation
+    );
+    }
+
+  if( options.ProgressiveLevels > 0 )
+    {
+    return ProgressiveScanConversionResampling< TInputImage, TOutputImage >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      methodString,
+      options,
+      CLPProcessInformation
+    );
+    }
+
+  typedef ScanConversionResamplingKernel< TInputImage, TOutputImage > KernelType;
+  const KernelType & kernel = FindScanConversionResamplingKernel< TInputImage, TOutputImage >( methodString );
+  return kernel.Function( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    kernel.Method,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+/** Profile the stages of the library for the lifetime of the scope when
+ * profile is not null, and move them to profile at the end. */
+class ScanConversionResamplingLibraryProfileScope
+{
+public:
+  explicit ScanConversionResamplingLibraryProfileScope( ScanConversionResamplingLibraryProfile * profile ):
+    m_Profile( profile )
+  {
+    ScanConversionProfiler::GetInstance()->SetEnabled( m_Profile != ITK_NULLPTR );
+  }
+
+  ~ScanConversionResamplingLibraryProfileScope()
+  {
+    ScanConversionProfiler * profiler = ScanConversionProfiler::GetInstance();
+    if( m_Profile != ITK_NULLPTR )
+      {
+      const ScanConversionProfiler::StageContainerType & stages = profiler->GetStages();
+      for( ScanConversionProfiler::StageContainerType::const_iterator stage = stages.begin();
+        stage != stages.end();
+        ++stage )
+        {
+        ScanConversionResamplingLibraryStage libraryStage;
+        libraryStage.Name = stage->Name;
+        libraryStage.Count = stage->Count;
+        libraryStage.WallTime = stage->WallTime;
+        libraryStage.CPUTime = stage->CPUTime;
+        libraryStage.StartResidentSetSize = stage->StartResidentSetSize;
+        libraryStage.PeakResidentSetSize = stage->PeakResidentSetSize;
+        m_Profile->push_back( libraryStage );
+        }
+      }
+    profiler->ClearStages();
+    profiler->SetEnabled( false );
+  }
+
+private:
+  ScanConversionResamplingLibraryProfileScope( const ScanConversionResamplingLibraryProfileScope & );
+  void operator=( const ScanConversionResamplingLibraryProfileScope & );
+
+  ScanConversionResamplingLibraryProfile * m_Profile;
+};
+
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+ScanConversionResamplingLibrary< TInputImage, TOutputImage >
+::Resample( const typename InputImageType::Pointer & inputImage,
+  typename OutputImageType::Pointer & outputImage,
+  const typename OutputImageType::SizeType & size,
+  const typename OutputImageType::SpacingType & spacing,
+  const typename OutputImageType::PointType & origin,
+  const typename OutputImageType::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation,
+  ScanConversionResamplingLibraryProfile * profile )
+{
+  ScanConversionResamplingLibraryProfileScope profileScope( profile );
+
+  return LibraryResampling< InputImageType, OutputImageType >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+ScanConversionResamplingLibrary< TInputImage, TOutputImage >
+::StreamingResample( const typename InputImageType::Pointer & inputImage,
+  const std::string & outputFileName,
+  const typename OutputImageType::SizeType & size,
+  const typename OutputImageType::SpacingType & spacing,
+  const typename OutputImageType::PointType & origin,
+  const typename OutputImageType::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation,
+  ScanConversionResamplingLibraryProfile * profile )
+{
+  ScanConversionResamplingLibraryProfileScope profileScope( profile );
+
+  return StreamingScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+    outputFileName,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    options,
+    CLPProcessInformation
+  );
+}
+
+
+/** The state of the frame resampler for the geometry of the first frame. */
+template< typename TInputImage, typename TOutputImage >
+struct ScanConversionResamplingLibraryFrameResampler< TInputImage, TOutputImage >::Implementation
+{
+  typedef ScanConversionFastLinearKernel< TInputImage, TOutputImage >  FastLinearKernelType;
+  typedef ScanConversionLookupTable< TInputImage, TOutputImage >       LookupTableType;
+  typedef VTKScanConversionResampler< TInputImage, TOutputImage >      VTKResamplerType;
+  typedef OpenCLScanConversionResampler< TInputImage, TOutputImage >   GPUResamplerType;
+
+  enum ResamplerType
+    {
+    FAST_LINEAR_RESAMPLER,
+    GPU_RESAMPLER,
+    LOOKUP_TABLE_RESAMPLER,
+    VTK_RESAMPLER,
+    LIBRARY_RESAMPLER
+    };
+
+  Implementation():
+    Resampler( LIBRARY_RESAMPLER ),
+    CLPProcessInformation( ITK_NULLPTR )
+  {}
+
+  ResamplerType                           Resampler;
+  typename TOutputImage::SizeType         Size;
+  typename TOutputImage::SpacingType      Spacing;
+  typename TOutputImage::PointType        Origin;
+  typename TOutputImage::DirectionType    Direction;
+  std::string                             MethodString;
+  ScanConversionResamplingOptions         Options;
+  ModuleProcessInformation *              CLPProcessInformation;
+  LookupTableType                         LookupTable;
+  VTKResamplerType                        VTKResampler;
+  GPUResamplerType                        GPUResampler;
+};
+
+
+template< typename TInputImage, typename TOutputImage >
+ScanConversionResamplingLibraryFrameResampler< TInputImage, TOutputImage >
+::ScanConversionResamplingLibraryFrameResampler():
+  m_Implementation( new Implementation )
+{
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+ScanConversionResamplingLibraryFrameResampler< TInputImage, TOutputImage >
+::~ScanConversionResamplingLibraryFrameResampler()
+{
+  delete m_Implementation;
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+ScanConversionResamplingLibraryFrameResampler< TInputImage, TOutputImage >
+::Initialize( const typename InputImageType::Pointer & inputImage,
+  const typename OutputImageType::SizeType & size,
+  const typename OutputImageType::SpacingType & spacing,
+  const typename OutputImageType::PointType & origin,
+  const typename OutputImageType::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation,
+  ScanConversionResamplingLibraryProfile * profile )
+{
+  ScanConversionResamplingLibraryProfileScope profileScope( profile );
+
+  Implementation & state = *m_Implementation;
+  state.Size = size;
+  state.Spacing = spacing;
+  state.Origin = origin;
+  state.Direction = direction;
+  state.MethodString = methodString;
+  state.Options = options;
+  state.CLPProcessInformation = CLPProcessInformation;
+
+  const ScanConversionResamplingMethod method = ScanConversionResamplingMethodFromString( methodString );
+  if( Implementation::FastLinearKernelType::Supports( methodString ) )
+    {
+    state.Resampler = Implementation::FAST_LINEAR_RESAMPLER;
+    return EXIT_SUCCESS;
+    }
+  else if( method == GPU_LINEAR )
+    {
+    state.Resampler = Implementation::GPU_RESAMPLER;
+    return state.GPUResampler.Initialize( inputImage.GetPointer(), size, spacing, origin, direction );
+    }
+  else if( Implementation::LookupTableType::SupportsMethod( method ) )
+    {
+    state.Resampler = Implementation::LOOKUP_TABLE_RESAMPLER;
+    state.LookupTable.SetReplaceNonFinite( options.ReplaceNonFinite );
+    return state.LookupTable.ReadOrBuild( inputImage.GetPointer(),
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      options.LookupTableGeometryParameters,
+      options.LookupTableFileName );
+    }
+  else if( Implementation::VTKResamplerType::SupportsMethod( method ) )
+    {
+    state.Resampler = Implementation::VTK_RESAMPLER;
+    state.VTKResampler.SetKernelFootprint( options.KernelFootprint, options.KernelNumberOfPoints );
+    state.VTKResampler.SetReplaceNonFinite( options.ReplaceNonFinite );
+    return state.VTKResampler.Initialize( inputImage.GetPointer(),
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      CLPProcessInformation );
+    }
+  state.Resampler = Implementation::LIBRARY_RESAMPLER;
+  state.Options.LookupTableFileName.clear();
+  return EXIT_SUCCESS;
+}
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+ScanConversionResamplingLibraryFrameResampler< TInputImage, TOutputImage >
+::Resample( const typename InputImageType::Pointer & inputImage,
+  typename OutputImageType::Pointer & outputImage,
+  ScanConversionResamplingLibraryProfile * profile )
+{
+  ScanConversionResamplingLibraryProfileScope profileScope( profile );
+
+  Implementation & state = *m_Implementation;
+  switch( state.Resampler )
+    {
+  case Implementation::FAST_LINEAR_RESAMPLER:
+    return Implementation::FastLinearKernelType::Resample( inputImage,
+      outputImage,
+      state.Size,
+      state.Spacing,
+      state.Origin,
+      state.Direction
+    );
+  case Implementation::GPU_RESAMPLER:
+    return state.GPUResampler.Resample( inputImage.GetPointer(), outputImage );
+  case Implementation::LOOKUP_TABLE_RESAMPLER:
+    return state.LookupTable.Apply( inputImage.GetPointer(), outputImage );
+  case Implementation::VTK_RESAMPLER:
+    return state.VTKResampler.Resample( inputImage.GetPointer(), outputImage );
+  default:
+    return LibraryResampling< InputImageType, OutputImageType >( inputImage,
+      outputImage,
+      state.Size,
+      state.Spacing,
+      state.Origin,
+      state.Direction,
+      state.MethodString,
+      state.Options,
+      state.CLPProcessInformation
+    );
+    }
+}
+
+
+#define ScanConversionResamplingLibraryInstantiateMacro( PixelType ) \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibrary< \
+    itk::CurvilinearArraySpecialCoordinatesImage< PixelType, 3 >, itk::Image< PixelType, 3 > >; \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibrary< \
+    itk::PhasedArray3DSpecialCoordinatesImage< PixelType >, itk::Image< PixelType, 3 > >; \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibraryFrameResampler< \
+    itk::CurvilinearArraySpecialCoordinatesImage< PixelType, 3 >, itk::Image< PixelType, 3 > >; \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibraryFrameResampler< \
+    itk::PhasedArray3DSpecialCoordinatesImage< PixelType >, itk::Image< PixelType, 3 > >; \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibrary< \
+    itk::SliceSeriesSpecialCoordinatesImage< itk::Image< PixelType, 2 >, itk::Euler3DTransform< double >, PixelType, 3 >, \
+    itk::Image< PixelType, 3 > >; \
+  template class ScanConversionResampling_EXPORT ScanConversionResamplingLibraryFrameResampler< \
+    itk::SliceSeriesSpecialCoordinatesImage< itk::Image< PixelType, 2 >, itk::Euler3DTransform< double >, PixelType, 3 >, \
+    itk::Image< PixelType, 3 > >
+
+// The pixel types of the main() of the modules
+ScanConversionResamplingLibraryInstantiateMacro( unsigned char );
+ScanConversionResamplingLibraryInstantiateMacro( unsigned short );
+ScanConversionResamplingLibraryInstantiateMacro( short );
+ScanConversionResamplingLibraryInstantiateMacro( float );
+ScanConversionResamplingLibraryInstantiateMacro( double );
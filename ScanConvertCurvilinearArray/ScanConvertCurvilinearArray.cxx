@@ -18,14 +18,23 @@
 
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
 #include "itkCurvilinearArraySpecialCoordinatesImage.h"
 #include "itkResampleImageFilter.h"
 #include "itkCastImageFilter.h"
+#include "itkExtractImageFilter.h"
 
 #include "itkPluginUtilities.h"
 
 #include "ScanConvertCurvilinearArrayCLP.h"
-#include "ScanConversionResamplingMethods.h"
+#include "ScanConversionResamplingLibrary.h"
+#include "ScanConversionGeometry.h"
+#include "ScanConversionFramePipeline.h"
+#include "ScanConversionProfiler.h"
+#include "ScanConversionThreading.h"
+#include "ScanConversionImageWriter.h"
+#include "ScanConversionServer.h"
+#include "ScanConversionSharedMemory.h"
 
 // Use an anonymous namespace to keep class types and function names
 // from colliding when module is used as shared object module.  Every
@@ -35,10 +44,425 @@
 namespace
 {
 
+template< typename TInputImage, typename TOutputImage >
+void
+ComputeOutputGrid( const TInputImage * inputImage,
+  const std::vector< int > & outputSize,
+  const std::vector< double > & outputSpacing,
+  double lateralAngularSeparation,
+  double firstSampleDistance,
+  typename TOutputImage::SizeType & size,
+  typename TOutputImage::SpacingType & spacing,
+  typename TOutputImage::PointType & origin,
+  typename TOutputImage::DirectionType & direction )
+{
+  size[0] = outputSize[0];
+  size[1] = outputSize[1];
+  size[2] = outputSize[2];
+
+  spacing[0] = outputSpacing[0];
+  spacing[1] = outputSpacing[1];
+  spacing[2] = outputSpacing[2];
+
+  origin[0] = outputSize[0] * outputSpacing[0] / -2.0;
+  origin[1] = firstSampleDistance * std::cos( (inputImage->GetLargestPossibleRegion().GetSize()[1] - 1) / 2.0 * lateralAngularSeparation );
+  origin[2] = inputImage->GetOrigin()[2];
+
+  direction.SetIdentity();
+}
+
+
+unsigned int
+GetNumberOfInputDimensions( const std::string & fileName )
+{
+  if( IsScanConversionSharedMemoryName( fileName ) )
+    {
+    return 3;
+    }
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO( fileName.c_str(), itk::ImageIOFactory::ReadMode );
+  if( imageIO.IsNull() )
+    {
+    itkGenericExceptionMacro( "Could not create an ImageIO to read: " << fileName );
+    }
+  imageIO->SetFileName( fileName );
+  imageIO->ReadImageInformation();
+  return imageIO->GetNumberOfDimensions();
+}
+
+
+/** Reads, scan converts, and writes the frames of a batch with the
+ * ScanConversionFramePipeline. Frames come from a list of volumes or from the
+ * last dimension of a 4D time series. All frames share the geometry of the
+ * first frame, so the output grid and the state of the frame resampler of
+ * the library, e.g. the lookup table, are only computed once. */
+template< typename TPixel >
+class CurvilinearArrayFrameProcessor
+{
+public:
+  typedef TPixel PixelType;
+  itkStaticConstMacro( Dimension, unsigned int, 3 );
+
+  typedef itk::CurvilinearArraySpecialCoordinatesImage< PixelType, Dimension > InputImageType;
+  typedef itk::Image< PixelType, Dimension >                                   OutputImageType;
+  typedef itk::Image< PixelType, Dimension + 1 >                               TimeSeriesImageType;
+
+  typedef itk::ImageFileReader< TimeSeriesImageType >   TimeSeriesReaderType;
+  typedef LibraryScanConversionFrameResampler< InputImageType, OutputImageType > FrameResamplerType;
+
+  CurvilinearArrayFrameProcessor( double lateralAngularSeparation,
+    double radiusSampleSize,
+    double firstSampleDistance,
+    const std::vector< int > & outputSize,
+    const std::vector< double > & outputSpacing,
+    const std::string & method,
+    bool sectorMask,
+    unsigned int windowedSincRadius,
+    const std::string & kernelFootprint,
+    unsigned int kernelPoints,
+    unsigned int tileSize,
+    const std::string & lookupTableFileName,
+    const std::string & outputPattern,
+    int compressionLevel,
+    ModuleProcessInformation * CLPProcessInformation ):
+    m_LateralAngularSeparation( lateralAngularSeparation ),
+    m_RadiusSampleSize( radiusSampleSize ),
+    m_FirstSampleDistance( firstSampleDistance ),
+    m_OutputSize( outputSize ),
+    m_OutputSpacing( outputSpacing ),
+    m_Method( method ),
+    m_SectorMask( sectorMask ),
+    m_WindowedSincRadius( windowedSincRadius ),
+    m_KernelFootprint( ScanConversionKernelFootprintFromString( kernelFootprint ) ),
+    m_KernelPoints( kernelPoints ),
+    m_TileSize( tileSize ),
+    m_LookupTableFileName( lookupTableFileName ),
+    m_OutputPattern( outputPattern ),
+    m_CompressionLevel( compressionLevel ),
+    m_CLPProcessInformation( CLPProcessInformation ),
+    m_GridInitialized( false )
+  {
+  }
+
+  /** Frames are read from the given volumes. */
+  unsigned int SetInputFileNames( const std::vector< std::string > & fileNames )
+  {
+    m_InputFileNames = fileNames;
+    return static_cast< unsigned int >( m_InputFileNames.size() );
+  }
+
+  /** Frames are read from the last dimension of a 4D volume. */
+  unsigned int SetTimeSeriesFileName( const std::string & fileName )
+  {
+    m_TimeSeriesReader = TimeSeriesReaderType::New();
+    m_TimeSeriesReader->SetFileName( fileName );
+    m_TimeSeriesReader->UpdateOutputInformation();
+    return static_cast< unsigned int >( m_TimeSeriesReader->GetOutput()->GetLargestPossibleRegion().GetSize()[Dimension] );
+  }
+
+  int ReadFrame( unsigned int frame )
+  {
+    ScanConversionProfileScope profileRead( "Read Frame" );
+    typename InputImageType::Pointer inputImage;
+    if( m_TimeSeriesReader.IsNotNull() )
+      {
+      typedef itk::ExtractImageFilter< TimeSeriesImageType, OutputImageType > ExtractorType;
+      typename ExtractorType::Pointer extractor = ExtractorType::New();
+      extractor->SetInput( m_TimeSeriesReader->GetOutput() );
+      typename TimeSeriesImageType::RegionType extractionRegion = m_TimeSeriesReader->GetOutput()->GetLargestPossibleRegion();
+      extractionRegion.SetIndex( Dimension, extractionRegion.GetIndex( Dimension ) + frame );
+      extractionRegion.SetSize( Dimension, 0 );
+      extractor->SetExtractionRegion( extractionRegion );
+      extractor->SetDirectionCollapseToSubmatrix();
+      extractor->Update();
+      typename OutputImageType::Pointer frameImage = extractor->GetOutput();
+
+      // Share the extracted buffer instead of copying it
+      inputImage = InputImageType::New();
+      inputImage->SetRegions( frameImage->GetLargestPossibleRegion() );
+      inputImage->SetOrigin( frameImage->GetOrigin() );
+      inputImage->SetSpacing( frameImage->GetSpacing() );
+      inputImage->SetPixelContainer( frameImage->GetPixelContainer() );
+      }
+    else if( IsScanConversionSharedMemoryName( m_InputFileNames[frame] ) )
+      {
+      if( ReadCurvilinearArraySharedMemoryFrame( m_InputFileNames[frame], inputImage ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      m_InputImages[frame % 2] = inputImage;
+      return EXIT_SUCCESS;
+      }
+    else
+      {
+      typedef itk::ImageFileReader< InputImageType > ReaderType;
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( m_InputFileNames[frame] );
+      reader->Update();
+      inputImage = reader->GetOutput();
+      inputImage->DisconnectPipeline();
+      }
+    inputImage->SetLateralAngularSeparation( m_LateralAngularSeparation );
+    inputImage->SetRadiusSampleSize( m_RadiusSampleSize );
+    inputImage->SetFirstSampleDistance( m_FirstSampleDistance );
+    m_InputImages[frame % 2] = inputImage;
+    return EXIT_SUCCESS;
+  }
+
+  int ResampleFrame( unsigned int frame )
+  {
+    const InputImageType * inputImage = m_InputImages[frame % 2].GetPointer();
+    std::vector< double > geometryParameters;
+    geometryParameters.push_back( inputImage->GetLateralAngularSeparation() );
+    geometryParameters.push_back( inputImage->GetRadiusSampleSize() );
+    geometryParameters.push_back( inputImage->GetFirstSampleDistance() );
+    if( !m_GridInitialized )
+      {
+      ComputeOutputGrid< InputImageType, OutputImageType >( inputImage,
+        m_OutputSize,
+        m_OutputSpacing,
+        inputImage->GetLateralAngularSeparation(),
+        inputImage->GetFirstSampleDistance(),
+        m_Size,
+        m_Spacing,
+        m_Origin,
+        m_Direction );
+      m_InputSize = inputImage->GetLargestPossibleRegion().GetSize();
+      m_InputGeometryParameters = geometryParameters;
+      m_ResamplingOptions.SectorMask = m_SectorMask;
+      m_ResamplingOptions.WindowedSincRadius = m_WindowedSincRadius;
+      m_ResamplingOptions.KernelFootprint = m_KernelFootprint;
+      m_ResamplingOptions.KernelNumberOfPoints = m_KernelPoints;
+      m_ResamplingOptions.TileSize = m_TileSize;
+      m_ResamplingOptions.Sector = MakeCurvilinearArraySector( inputImage );
+      m_ResamplingOptions.LookupTableFileName = m_LookupTableFileName;
+      m_ResamplingOptions.LookupTableGeometryParameters = geometryParameters;
+      m_GridInitialized = true;
+      if( m_FrameResampler.Initialize( m_InputImages[frame % 2],
+          m_Size,
+          m_Spacing,
+          m_Origin,
+          m_Direction,
+          m_Method,
+          m_ResamplingOptions,
+          m_CLPProcessInformation ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    if( inputImage->GetLargestPossibleRegion().GetSize() != m_InputSize )
+      {
+      std::cerr << "The size of frame " << frame << " differs from the size of the first frame" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( geometryParameters != m_InputGeometryParameters )
+      {
+      std::cerr << "The probe geometry of frame " << frame << " differs from the geometry of the first frame" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    typename OutputImageType::Pointer outputImage;
+    int status = m_FrameResampler.Resample( m_InputImages[frame % 2], outputImage );
+    if( status == EXIT_SUCCESS
+      && m_TimeSeriesReader.IsNull()
+      && CheckScanConversionSharedMemoryFrame< InputImageType >( inputImage, m_InputFileNames[frame] ) != EXIT_SUCCESS )
+      {
+      status = EXIT_FAILURE;
+      }
+    m_OutputImages[frame % 2] = outputImage;
+    m_InputImages[frame % 2] = ITK_NULLPTR;
+    return status;
+  }
+
+  int WriteFrame( unsigned int frame )
+  {
+    ScanConversionProfileScope profileWrite( "Write Frame" );
+    const int status = WriteScanConversionImage< OutputImageType >( m_OutputImages[frame % 2],
+      ScanConversionFrameFileName( m_OutputPattern, frame ),
+      m_CompressionLevel,
+      "Write Frame",
+      ITK_NULLPTR );
+    m_OutputImages[frame % 2] = ITK_NULLPTR;
+    return status;
+  }
+
+  /** Scan convert one frame file to an output file. The output grid and the
+   * resampler state of the first frame are kept for the next frames, which
+   * must have the same size. */
+  int operator()( const std::string & inputFileName, const std::string & outputFileName )
+  {
+    m_TimeSeriesReader = ITK_NULLPTR;
+    m_InputFileNames.assign( 1, inputFileName );
+    if( this->ReadFrame( 0 ) != EXIT_SUCCESS || this->ResampleFrame( 0 ) != EXIT_SUCCESS )
+      {
+      m_InputImages[0] = ITK_NULLPTR;
+      m_OutputImages[0] = ITK_NULLPTR;
+      return EXIT_FAILURE;
+      }
+    ScanConversionProfileScope profileWrite( "Write Frame" );
+    const int status = WriteScanConversionImage< OutputImageType >( m_OutputImages[0],
+      outputFileName,
+      m_CompressionLevel,
+      "Write Frame",
+      ITK_NULLPTR );
+    m_OutputImages[0] = ITK_NULLPTR;
+    return status;
+  }
+
+private:
+  /** Wrap a shared memory frame without a copy. The header of the frame
+   * provides the probe geometry, or the command line when it has none. */
+  int ReadCurvilinearArraySharedMemoryFrame( const std::string & inputName, typename InputImageType::Pointer & inputImage ) const
+  {
+    std::vector< double > geometryParameters;
+    if( ReadScanConversionSharedMemoryFrame< InputImageType >( inputName, inputImage, geometryParameters ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( geometryParameters.empty() )
+      {
+      geometryParameters.push_back( m_LateralAngularSeparation );
+      geometryParameters.push_back( m_RadiusSampleSize );
+      geometryParameters.push_back( m_FirstSampleDistance );
+      }
+    else if( geometryParameters.size() != 3 )
+      {
+      std::cerr << "A curvilinear array shared memory frame has 3 geometry parameters, not "
+        << geometryParameters.size() << std::endl;
+      return EXIT_FAILURE;
+      }
+    inputImage->SetLateralAngularSeparation( geometryParameters[0] );
+    inputImage->SetRadiusSampleSize( geometryParameters[1] );
+    inputImage->SetFirstSampleDistance( geometryParameters[2] );
+    return EXIT_SUCCESS;
+  }
+
+  const double              m_LateralAngularSeparation;
+  const double              m_RadiusSampleSize;
+  const double              m_FirstSampleDistance;
+  const std::vector< int >  m_OutputSize;
+  const std::vector< double > m_OutputSpacing;
+  const std::string         m_Method;
+  const bool                m_SectorMask;
+  const unsigned int        m_WindowedSincRadius;
+  const ScanConversionResamplingOptions::KernelFootprintType m_KernelFootprint;
+  const unsigned int        m_KernelPoints;
+  const unsigned int        m_TileSize;
+  const std::string         m_LookupTableFileName;
+  const std::string         m_OutputPattern;
+  const int                 m_CompressionLevel;
+  ModuleProcessInformation * m_CLPProcessInformation;
+
+  std::vector< std::string >              m_InputFileNames;
+  typename TimeSeriesReaderType::Pointer  m_TimeSeriesReader;
+
+  typename InputImageType::Pointer  m_InputImages[2];
+  typename OutputImageType::Pointer m_OutputImages[2];
+
+  FrameResamplerType                           m_FrameResampler;
+  bool                                         m_GridInitialized;
+  typename InputImageType::SizeType            m_InputSize;
+  std::vector< double >                        m_InputGeometryParameters;
+  typename OutputImageType::SizeType           m_Size;
+  typename OutputImageType::SpacingType        m_Spacing;
+  typename OutputImageType::PointType          m_Origin;
+  typename OutputImageType::DirectionType      m_Direction;
+  ScanConversionResamplingOptions              m_ResamplingOptions;
+};
+
+
+template< typename TPixel >
+int DoBatch( int argc, char * argv[], unsigned int numberOfInputDimensions )
+{
+  PARSE_ARGS;
+
+  std::string outputPattern = batchOutputPattern;
+  if( outputPattern.empty() )
+    {
+    outputPattern = ScanConversionDefaultFramePattern( outputVolume );
+    }
+
+  typedef CurvilinearArrayFrameProcessor< TPixel > ProcessorType;
+  ProcessorType processor( lateralAngularSeparation,
+    radiusSampleSize,
+    firstSampleDistance,
+    outputSize,
+    outputSpacing,
+    method,
+    sectorMask,
+    windowedSincRadius,
+    kernelFootprint,
+    kernelPoints,
+    tileSize,
+    lookupTable,
+    outputPattern,
+    compressionLevel,
+    CLPProcessInformation );
+
+  unsigned int numberOfFrames = 0;
+  if( numberOfInputDimensions == 4 )
+    {
+    numberOfFrames = processor.SetTimeSeriesFileName( inputVolume );
+    }
+  else
+    {
+    std::vector< std::string > inputFileNames;
+    inputFileNames.push_back( inputVolume );
+    inputFileNames.insert( inputFileNames.end(), batchInputVolumes.begin(), batchInputVolumes.end() );
+    numberOfFrames = processor.SetInputFileNames( inputFileNames );
+    }
+
+  return ScanConversionFramePipeline( processor, numberOfFrames );
+}
+
+
+/** Scan convert the requests of a server, or the shared memory frame of the
+ * input volume, with a processor that keeps its state across frames. */
+template< typename TPixel >
+int DoFrames( int argc, char * argv[] )
+{
+  PARSE_ARGS;
+
+  typedef CurvilinearArrayFrameProcessor< TPixel > ProcessorType;
+  ProcessorType processor( lateralAngularSeparation,
+    radiusSampleSize,
+    firstSampleDistance,
+    outputSize,
+    outputSpacing,
+    method,
+    sectorMask,
+    windowedSincRadius,
+    kernelFootprint,
+    kernelPoints,
+    tileSize,
+    lookupTable,
+    std::string(),
+    compressionLevel,
+    CLPProcessInformation );
+
+  if( serverPort > 0 )
+    {
+    return ScanConversionServe( serverPort, serverTokenFile, processor );
+    }
+  return processor( inputVolume, outputVolume );
+}
+
+
 template< typename TPixel >
 int DoIt( int argc, char * argv[] )
 {
   PARSE_ARGS;
+  ScanConversionProfileSession profileSession( profile );
+
+  if( serverPort > 0 || IsScanConversionSharedMemoryName( inputVolume ) )
+    {
+    return DoFrames< TPixel >( argc, argv );
+    }
+
+  const unsigned int numberOfInputDimensions = GetNumberOfInputDimensions( inputVolume );
+  if( numberOfInputDimensions == 4 || !batchInputVolumes.empty() )
+    {
+    return DoBatch< TPixel >( argc, argv, numberOfInputDimensions );
+    }
 
   const unsigned int Dimension = 3;
 
@@ -49,6 +473,7 @@ int DoIt( int argc, char * argv[] )
   typedef itk::ImageFileReader< InputImageType > ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
   reader->SetFileName( inputVolume );
+  ScanConversionFilterWatcher watchReader(reader, "Read Input", CLPProcessInformation);
   reader->Update();
 
   typename InputImageType::Pointer inputImage = reader->GetOutput();
@@ -58,43 +483,55 @@ int DoIt( int argc, char * argv[] )
   inputImage->SetFirstSampleDistance( firstSampleDistance );
 
   typename OutputImageType::SizeType size;
-  size[0] = outputSize[0];
-  size[1] = outputSize[1];
-  size[2] = outputSize[2];
-
   typename OutputImageType::SpacingType spacing;
-  spacing[0] = outputSpacing[0];
-  spacing[1] = outputSpacing[1];
-  spacing[2] = outputSpacing[2];
-
   typename OutputImageType::PointType origin;
-  origin[0] = outputSize[0] * outputSpacing[0] / -2.0;
-  origin[1] = firstSampleDistance * std::cos( (inputImage->GetLargestPossibleRegion().GetSize()[1] - 1) / 2.0 * lateralAngularSeparation );
-  origin[2] = inputImage->GetOrigin()[2];
-
   typename OutputImageType::DirectionType direction;
-  direction.SetIdentity();
-
-  typename OutputImageType::Pointer outputImage;
-
-  ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
-    outputImage,
+  ComputeOutputGrid< InputImageType, OutputImageType >( inputImage.GetPointer(),
+    outputSize,
+    outputSpacing,
+    lateralAngularSeparation,
+    firstSampleDistance,
     size,
     spacing,
     origin,
-    direction,
-    method,
-    CLPProcessInformation
-  );
+    direction );
 
-  typedef itk::ImageFileWriter< OutputImageType > WriterType;
-  typename WriterType::Pointer writer = WriterType::New();
-  writer->SetFileName( outputVolume );
-  writer->SetInput( outputImage );
-  writer->SetUseCompression( true );
-  writer->Update();
+  // FastLinear, GPULinear, and the lookup table are resampled by the
+  // library too
+  ScanConversionResamplingOptions resamplingOptions;
+  resamplingOptions.SectorMask = sectorMask;
+  resamplingOptions.Sector = MakeCurvilinearArraySector( inputImage.GetPointer() );
+  resamplingOptions.WindowedSincRadius = windowedSincRadius;
+  resamplingOptions.KernelFootprint = ScanConversionKernelFootprintFromString( kernelFootprint );
+  resamplingOptions.KernelNumberOfPoints = kernelPoints;
+  resamplingOptions.TileSize = tileSize;
+  resamplingOptions.CompressionLevel = compressionLevel;
+  resamplingOptions.ProgressiveLevels = progressiveLevels;
+  resamplingOptions.ProgressiveFileName = outputVolume;
+  resamplingOptions.ProgressiveDirectory = progressiveDirectory;
+  resamplingOptions.LookupTableFileName = lookupTable;
+  resamplingOptions.LookupTableGeometryParameters.push_back( lateralAngularSeparation );
+  resamplingOptions.LookupTableGeometryParameters.push_back( radiusSampleSize );
+  resamplingOptions.LookupTableGeometryParameters.push_back( firstSampleDistance );
+  typename OutputImageType::Pointer outputImage;
+  if( LibraryScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      resamplingOptions,
+      CLPProcessInformation ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
 
-  return EXIT_SUCCESS;
+  return WriteScanConversionImage< OutputImageType >( outputImage,
+    outputVolume,
+    compressionLevel,
+    "Write Output",
+    CLPProcessInformation );
 }
 
 } // end of anonymous namespace
@@ -103,12 +540,17 @@ int main( int argc, char * argv[] )
 {
   PARSE_ARGS;
 
-  itk::ImageIOBase::IOPixelType     inputPixelType;
+  ScanConversionThreadingScope threadingScope;
+  if( threadingScope.Configure( threads, cpuAffinity ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+
   itk::ImageIOBase::IOComponentType inputComponentType;
 
   try
     {
-    itk::GetImageType(inputVolume, inputPixelType, inputComponentType);
+    GetScanConversionInputComponentType( inputVolume, inputComponentType );
 
     switch( inputComponentType )
       {
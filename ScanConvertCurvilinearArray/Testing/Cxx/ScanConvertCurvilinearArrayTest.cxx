@@ -8,6 +8,8 @@
 
 #include "itkTestMain.h"
 
+#include "ScanConversionTesting.h"
+
 // STD includes
 #include <iostream>
 
@@ -22,4 +24,5 @@ extern "C" MODULE_IMPORT int ModuleEntryPoint(int, char* []);
 void RegisterTests()
 {
   StringToTestFunctionMap["ModuleEntryPoint"] = ModuleEntryPoint;
+  RegisterScanConversionTests();
 }
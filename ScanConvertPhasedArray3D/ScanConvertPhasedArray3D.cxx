@@ -23,10 +23,15 @@
 #include "itkCastImageFilter.h"
 
 #include "itkPluginUtilities.h"
-#include "itkPluginFilterWatcher.h"
 
 #include "ScanConvertPhasedArray3DCLP.h"
-#include "ScanConversionResamplingMethods.h"
+#include "ScanConversionResamplingLibrary.h"
+#include "ScanConversionGeometry.h"
+#include "ScanConversionProfiler.h"
+#include "ScanConversionThreading.h"
+#include "ScanConversionImageWriter.h"
+#include "ScanConversionServer.h"
+#include "ScanConversionSharedMemory.h"
 
 // Use an anonymous namespace to keep class types and function names
 // from colliding when module is used as shared object module.  Every
@@ -36,8 +41,278 @@
 namespace
 {
 
+/** Output grid of the module, or of the slab outputSlab of it along its last
+ * axis. Fails when outputSlab is not a valid slab. */
+template< typename TOutputImage >
+int
+ComputeOutputGrid( const std::vector< int > & outputSize,
+  const std::vector< double > & outputSpacing,
+  const std::vector< int > & outputSlab,
+  typename TOutputImage::SizeType & size,
+  typename TOutputImage::SpacingType & spacing,
+  typename TOutputImage::PointType & origin,
+  typename TOutputImage::DirectionType & direction )
+{
+  const unsigned int Dimension = TOutputImage::ImageDimension;
+
+  size[0] = outputSize[0];
+  size[1] = outputSize[1];
+  size[2] = outputSize[2];
+
+  spacing[0] = outputSpacing[0];
+  spacing[1] = outputSpacing[1];
+  spacing[2] = outputSpacing[2];
+
+  direction.SetIdentity();
+
+  for( unsigned int ii = 0; ii < Dimension - 1; ++ii )
+    {
+    origin[ii] = -1 * spacing[ii] * size[ii]  / 2;
+    }
+  origin[2] = 0.0;
+
+  // Only resample a slab of the output along its last axis, at its position
+  // in the whole output, e.g. for a worker of a distributed conversion
+  if( outputSlab.size() != 2
+    || outputSlab[1] < 1
+    || outputSlab[0] < 0
+    || outputSlab[0] >= outputSlab[1]
+    || static_cast< itk::SizeValueType >( outputSlab[1] ) > size[2] )
+    {
+    std::cerr << "The Output Slab must be a slab index and a number of slabs no larger than the output size" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const itk::SizeValueType slabStart = size[2] * outputSlab[0] / outputSlab[1];
+  const itk::SizeValueType slabEnd = size[2] * ( outputSlab[0] + 1 ) / outputSlab[1];
+  origin[2] += spacing[2] * slabStart;
+  size[2] = slabEnd - slabStart;
+  return EXIT_SUCCESS;
+}
+
+
+/** Wrap a shared memory frame without a copy. The geometry of the frame
+ * comes from its header, or is empty when the header has none. */
+template< typename TInputImage >
+int
+ReadPhasedArray3DSharedMemoryFrame( const std::string & inputFileName,
+  typename TInputImage::Pointer & inputImage,
+  std::vector< double > & geometryParameters )
+{
+  ScanConversionProfileScope profileRead( "Read Input" );
+  if( ReadScanConversionSharedMemoryFrame< TInputImage >( inputFileName, inputImage, geometryParameters ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  if( !geometryParameters.empty() && geometryParameters.size() != 4 )
+    {
+    std::cerr << "A phased array shared memory frame has 4 geometry parameters, not "
+      << geometryParameters.size() << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+
+/** Scan converts the requests of a server with a frame resampler of the
+ * library that is kept across the requests, as the
+ * CurvilinearArrayFrameProcessor of ScanConvertCurvilinearArray. The output
+ * grid and the state of the frame resampler, e.g. the lookup table, the
+ * locator of the VTK kernels, or the OpenCL context of GPULinear, are only
+ * computed again for a frame whose size, origin, spacing, or probe geometry
+ * differ from the frame of the previous request. */
 template< typename TPixel >
-int DoIt( int argc, char * argv[] )
+class PhasedArray3DFrameProcessor
+{
+public:
+  typedef TPixel PixelType;
+  itkStaticConstMacro( Dimension, unsigned int, 3 );
+
+  typedef itk::PhasedArray3DSpecialCoordinatesImage< PixelType > InputImageType;
+  typedef itk::Image< PixelType, Dimension >                     OutputImageType;
+
+  typedef LibraryScanConversionFrameResampler< InputImageType, OutputImageType > FrameResamplerType;
+
+  PhasedArray3DFrameProcessor( double azimuthAngularSeparation,
+    double elevationAngularSeparation,
+    double radiusSampleSize,
+    double firstSampleDistance,
+    const std::vector< int > & outputSize,
+    const std::vector< double > & outputSpacing,
+    const std::vector< int > & outputSlab,
+    const std::string & method,
+    bool sectorMask,
+    unsigned int windowedSincRadius,
+    const std::string & kernelFootprint,
+    unsigned int kernelPoints,
+    unsigned int tileSize,
+    const std::string & lookupTableFileName,
+    int compressionLevel,
+    ModuleProcessInformation * CLPProcessInformation ):
+    m_OutputSize( outputSize ),
+    m_OutputSpacing( outputSpacing ),
+    m_OutputSlab( outputSlab ),
+    m_Method( method ),
+    m_SectorMask( sectorMask ),
+    m_WindowedSincRadius( windowedSincRadius ),
+    m_KernelFootprint( ScanConversionKernelFootprintFromString( kernelFootprint ) ),
+    m_KernelPoints( kernelPoints ),
+    m_TileSize( tileSize ),
+    m_LookupTableFileName( lookupTableFileName ),
+    m_CompressionLevel( compressionLevel ),
+    m_CLPProcessInformation( CLPProcessInformation ),
+    m_FrameResampler( ITK_NULLPTR )
+  {
+    m_CommandLineGeometryParameters.push_back( azimuthAngularSeparation );
+    m_CommandLineGeometryParameters.push_back( elevationAngularSeparation );
+    m_CommandLineGeometryParameters.push_back( radiusSampleSize );
+    m_CommandLineGeometryParameters.push_back( firstSampleDistance );
+  }
+
+  ~PhasedArray3DFrameProcessor()
+  {
+    delete m_FrameResampler;
+  }
+
+  /** Scan convert one frame file, or shared memory frame, to an output file. */
+  int operator()( const std::string & inputFileName, const std::string & outputFileName )
+  {
+    typename InputImageType::Pointer inputImage;
+    std::vector< double > geometryParameters;
+    if( IsScanConversionSharedMemoryName( inputFileName ) )
+      {
+      if( ReadPhasedArray3DSharedMemoryFrame< InputImageType >( inputFileName, inputImage, geometryParameters ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    else
+      {
+      ScanConversionProfileScope profileRead( "Read Frame" );
+      typedef itk::ImageFileReader< InputImageType > ReaderType;
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( inputFileName );
+      reader->Update();
+      inputImage = reader->GetOutput();
+      inputImage->DisconnectPipeline();
+      }
+    if( geometryParameters.empty() )
+      {
+      geometryParameters = m_CommandLineGeometryParameters;
+      }
+    inputImage->SetAzimuthAngularSeparation( geometryParameters[0] );
+    inputImage->SetElevationAngularSeparation( geometryParameters[1] );
+    inputImage->SetRadiusSampleSize( geometryParameters[2] );
+    inputImage->SetFirstSampleDistance( geometryParameters[3] );
+
+    if( m_FrameResampler == ITK_NULLPTR
+      || inputImage->GetLargestPossibleRegion().GetSize() != m_InputSize
+      || inputImage->GetOrigin() != m_InputOrigin
+      || inputImage->GetSpacing() != m_InputSpacing
+      || geometryParameters != m_GeometryParameters )
+      {
+      if( this->Initialize( inputImage, geometryParameters ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      }
+
+    typename OutputImageType::Pointer outputImage;
+    if( m_FrameResampler->Resample( inputImage, outputImage ) != EXIT_SUCCESS
+      || CheckScanConversionSharedMemoryFrame< InputImageType >( inputImage, inputFileName ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+
+    ScanConversionProfileScope profileWrite( "Write Frame" );
+    return WriteScanConversionImage< OutputImageType >( outputImage,
+      outputFileName,
+      m_CompressionLevel,
+      "Write Frame",
+      ITK_NULLPTR );
+  }
+
+private:
+  PhasedArray3DFrameProcessor( const PhasedArray3DFrameProcessor & );
+  void operator=( const PhasedArray3DFrameProcessor & );
+
+  /** Compute the output grid and the state of the frame resampler for the
+   * geometry of inputImage. */
+  int Initialize( const typename InputImageType::Pointer & inputImage,
+    const std::vector< double > & geometryParameters )
+  {
+    delete m_FrameResampler;
+    m_FrameResampler = ITK_NULLPTR;
+
+    typename OutputImageType::SizeType size;
+    typename OutputImageType::SpacingType spacing;
+    typename OutputImageType::PointType origin;
+    typename OutputImageType::DirectionType direction;
+    if( ComputeOutputGrid< OutputImageType >( m_OutputSize, m_OutputSpacing, m_OutputSlab, size, spacing, origin, direction ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+
+    ScanConversionResamplingOptions resamplingOptions;
+    resamplingOptions.SectorMask = m_SectorMask;
+    resamplingOptions.Sector = MakePhasedArray3DSector( inputImage.GetPointer() );
+    resamplingOptions.WindowedSincRadius = m_WindowedSincRadius;
+    resamplingOptions.KernelFootprint = m_KernelFootprint;
+    resamplingOptions.KernelNumberOfPoints = m_KernelPoints;
+    resamplingOptions.TileSize = m_TileSize;
+    resamplingOptions.CompressionLevel = m_CompressionLevel;
+    resamplingOptions.LookupTableFileName = m_LookupTableFileName;
+    resamplingOptions.LookupTableGeometryParameters = geometryParameters;
+
+    FrameResamplerType * frameResampler = new FrameResamplerType;
+    if( frameResampler->Initialize( inputImage,
+        size,
+        spacing,
+        origin,
+        direction,
+        m_Method,
+        resamplingOptions,
+        m_CLPProcessInformation ) != EXIT_SUCCESS )
+      {
+      delete frameResampler;
+      return EXIT_FAILURE;
+      }
+    m_FrameResampler = frameResampler;
+    m_InputSize = inputImage->GetLargestPossibleRegion().GetSize();
+    m_InputOrigin = inputImage->GetOrigin();
+    m_InputSpacing = inputImage->GetSpacing();
+    m_GeometryParameters = geometryParameters;
+    return EXIT_SUCCESS;
+  }
+
+  std::vector< double >       m_CommandLineGeometryParameters;
+  const std::vector< int >    m_OutputSize;
+  const std::vector< double > m_OutputSpacing;
+  const std::vector< int >    m_OutputSlab;
+  const std::string           m_Method;
+  const bool                  m_SectorMask;
+  const unsigned int          m_WindowedSincRadius;
+  const ScanConversionResamplingOptions::KernelFootprintType m_KernelFootprint;
+  const unsigned int          m_KernelPoints;
+  const unsigned int          m_TileSize;
+  const std::string           m_LookupTableFileName;
+  const int                   m_CompressionLevel;
+  ModuleProcessInformation *  m_CLPProcessInformation;
+
+  FrameResamplerType *                   m_FrameResampler;
+  typename InputImageType::SizeType      m_InputSize;
+  typename InputImageType::PointType     m_InputOrigin;
+  typename InputImageType::SpacingType   m_InputSpacing;
+  std::vector< double >                  m_GeometryParameters;
+};
+
+
+/** Scan convert inputFileName to outputFileName with the other parameters
+ * of the command line. */
+template< typename TPixel >
+int ScanConvert( int argc,
+  char * argv[],
+  const std::string & inputFileName,
+  const std::string & outputFileName )
 {
   PARSE_ARGS;
 
@@ -47,58 +322,159 @@ int DoIt( int argc, char * argv[] )
   typedef itk::PhasedArray3DSpecialCoordinatesImage< PixelType > InputImageType;
   typedef itk::Image< PixelType, Dimension >                     OutputImageType;
 
+  // When streaming, the reader stays connected so that each piece of the
+  // output only reads the input region it samples. Shared memory frames are
+  // used in place.
+  const bool sharedMemory = IsScanConversionSharedMemoryName( inputFileName );
+  const bool streaming = streamDivisions > 1 && lookupTable.empty() && ScanConversionResamplingMethodFromString( method ) != GPU_LINEAR && !sharedMemory;
+
   typedef itk::ImageFileReader< InputImageType > ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
-  reader->SetFileName( inputVolume );
-  reader->Update();
-
-  typename InputImageType::Pointer inputImage = reader->GetOutput();
-  inputImage->DisconnectPipeline();
-  inputImage->SetAzimuthAngularSeparation( azimuthAngularSeparation );
-  inputImage->SetElevationAngularSeparation( elevationAngularSeparation );
-  inputImage->SetRadiusSampleSize( radiusSampleSize );
-  inputImage->SetFirstSampleDistance( firstSampleDistance );
+  ScanConversionFilterWatcher watchReader(reader, "Read Input", CLPProcessInformation);
+  typename InputImageType::Pointer inputImage;
+  std::vector< double > geometryParameters;
+  if( sharedMemory )
+    {
+    if( ReadPhasedArray3DSharedMemoryFrame< InputImageType >( inputFileName, inputImage, geometryParameters ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  else
+    {
+    reader->SetFileName( inputFileName );
+    inputImage = reader->GetOutput();
+    if( streaming )
+      {
+      reader->UpdateOutputInformation();
+      }
+    else
+      {
+      reader->Update();
+      inputImage->DisconnectPipeline();
+      }
+    }
+  // The geometry of a shared memory frame comes from its header
+  if( geometryParameters.empty() )
+    {
+    geometryParameters.push_back( azimuthAngularSeparation );
+    geometryParameters.push_back( elevationAngularSeparation );
+    geometryParameters.push_back( radiusSampleSize );
+    geometryParameters.push_back( firstSampleDistance );
+    }
+  inputImage->SetAzimuthAngularSeparation( geometryParameters[0] );
+  inputImage->SetElevationAngularSeparation( geometryParameters[1] );
+  inputImage->SetRadiusSampleSize( geometryParameters[2] );
+  inputImage->SetFirstSampleDistance( geometryParameters[3] );
 
   typename OutputImageType::SizeType size;
-  size[0] = outputSize[0];
-  size[1] = outputSize[1];
-  size[2] = outputSize[2];
-
   typename OutputImageType::SpacingType spacing;
-  spacing[0] = outputSpacing[0];
-  spacing[1] = outputSpacing[1];
-  spacing[2] = outputSpacing[2];
-
+  typename OutputImageType::PointType origin;
   typename OutputImageType::DirectionType direction;
-  direction.SetIdentity();
+  if( ComputeOutputGrid< OutputImageType >( outputSize, outputSpacing, outputSlab, size, spacing, origin, direction ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
 
-  typename OutputImageType::PointType origin;
-  for( unsigned int ii = 0; ii < Dimension - 1; ++ii )
+  if( streaming )
     {
-    origin[ii] = -1 * spacing[ii] * size[ii]  / 2;
+    ScanConversionResamplingOptions resamplingOptions;
+    resamplingOptions.SectorMask = sectorMask;
+    resamplingOptions.Sector = MakePhasedArray3DSector( inputImage.GetPointer() );
+    resamplingOptions.WindowedSincRadius = windowedSincRadius;
+    resamplingOptions.KernelFootprint = ScanConversionKernelFootprintFromString( kernelFootprint );
+    resamplingOptions.KernelNumberOfPoints = kernelPoints;
+    resamplingOptions.TileSize = tileSize;
+    resamplingOptions.CompressionLevel = compressionLevel;
+    resamplingOptions.StreamDivisions = streamDivisions;
+    return LibraryStreamingScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputFileName,
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      resamplingOptions,
+      CLPProcessInformation
+    );
     }
-  origin[2] = 0.0;
 
+  // GPULinear and the lookup table are resampled by the library too
+  ScanConversionResamplingOptions resamplingOptions;
+  resamplingOptions.SectorMask = sectorMask;
+  resamplingOptions.Sector = MakePhasedArray3DSector( inputImage.GetPointer() );
+  resamplingOptions.WindowedSincRadius = windowedSincRadius;
+  resamplingOptions.KernelFootprint = ScanConversionKernelFootprintFromString( kernelFootprint );
+  resamplingOptions.KernelNumberOfPoints = kernelPoints;
+  resamplingOptions.TileSize = tileSize;
+  resamplingOptions.CompressionLevel = compressionLevel;
+  resamplingOptions.ProgressiveLevels = progressiveLevels;
+  resamplingOptions.ProgressiveFileName = outputFileName;
+  resamplingOptions.ProgressiveDirectory = progressiveDirectory;
+  resamplingOptions.LookupTableFileName = lookupTable;
+  resamplingOptions.LookupTableGeometryParameters = geometryParameters;
   typename OutputImageType::Pointer outputImage;
+  if( LibraryScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      resamplingOptions,
+      CLPProcessInformation ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
 
-  ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
-    outputImage,
-    size,
-    spacing,
-    origin,
-    direction,
-    method,
-    CLPProcessInformation
-  );
-
-  typedef itk::ImageFileWriter< OutputImageType > WriterType;
-  typename WriterType::Pointer writer = WriterType::New();
-  writer->SetFileName( outputVolume );
-  writer->SetInput( outputImage );
-  writer->SetUseCompression( true );
-  writer->Update();
+  if( CheckScanConversionSharedMemoryFrame< InputImageType >( inputImage, inputFileName ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
 
-  return EXIT_SUCCESS;
+  return WriteScanConversionImage< OutputImageType >( outputImage,
+    outputFileName,
+    compressionLevel,
+    "Write Output",
+    CLPProcessInformation );
+}
+
+
+template< typename TPixel >
+int DoIt( int argc, char * argv[] )
+{
+  PARSE_ARGS;
+  ScanConversionProfileSession profileSession( profile );
+
+  if( serverPort > 0 )
+    {
+    if( streamDivisions > 1 || progressiveLevels > 0 )
+      {
+      std::cerr << "The server resamples whole frames, so the Stream Divisions "
+        "and Progressive Levels are not available with the Server Port" << std::endl;
+      return EXIT_FAILURE;
+      }
+    typedef PhasedArray3DFrameProcessor< TPixel > ProcessorType;
+    ProcessorType processor( azimuthAngularSeparation,
+      elevationAngularSeparation,
+      radiusSampleSize,
+      firstSampleDistance,
+      outputSize,
+      outputSpacing,
+      outputSlab,
+      method,
+      sectorMask,
+      windowedSincRadius,
+      kernelFootprint,
+      kernelPoints,
+      tileSize,
+      lookupTable,
+      compressionLevel,
+      CLPProcessInformation );
+    return ScanConversionServe( serverPort, serverTokenFile, processor );
+    }
+
+  return ScanConvert< TPixel >( argc, argv, inputVolume, outputVolume );
 }
 
 } // end of anonymous namespace
@@ -107,12 +483,17 @@ int main( int argc, char * argv[] )
 {
   PARSE_ARGS;
 
-  itk::ImageIOBase::IOPixelType     inputPixelType;
+  ScanConversionThreadingScope threadingScope;
+  if( threadingScope.Configure( threads, cpuAffinity ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+
   itk::ImageIOBase::IOComponentType inputComponentType;
 
   try
     {
-    itk::GetImageType(inputVolume, inputPixelType, inputComponentType);
+    GetScanConversionInputComponentType( inputVolume, inputComponentType );
 
     switch( inputComponentType )
       {
@@ -22,14 +22,26 @@
 #include "itkResampleImageFilter.h"
 #include "itkCastImageFilter.h"
 #include "itkUltrasoundImageFileReader.h"
-#include "itkHDF5UltrasoundImageIOFactory.h"
+#include "itkHDF5UltrasoundImageIO.h"
+#include "itkImageIOFactory.h"
 #include "itkReplaceNonFiniteImageFilter.h"
 #include "itkFloatingPointExceptions.h"
+#include "itksys/SystemTools.hxx"
+
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+#include "vnl/algo/vnl_determinant.h"
 
 #include "itkPluginUtilities.h"
 
 #include "ScanConvertSliceSeriesCLP.h"
-#include "ScanConversionResamplingMethods.h"
+#include "ScanConversionResamplingLibrary.h"
+#include "ScanConversionGeometry.h"
+#include "ScanConversionProfiler.h"
+#include "ScanConversionThreading.h"
+#include "ScanConversionImageWriter.h"
+#include "ScanConversionServer.h"
+#include "ScanConversionNonFiniteImageIO.h"
+#include "ScanConversionSliceSplatAccumulator.h"
 
 
 // Use an anonymous namespace to keep class types and function names
@@ -40,161 +52,730 @@
 namespace
 {
 
-template< typename TPixel >
-int DoIt( int argc, char * argv[] )
+/** Physical points of the four corners of every slice. Each slice is a
+ * planar grid, so the corners span all the input samples. */
+template< typename TInputImage >
+void
+ComputeSliceCorners( const TInputImage * inputImage,
+  std::vector< typename TInputImage::PointType > & corners )
 {
-  PARSE_ARGS;
+  typedef TInputImage InputImageType;
 
-  const unsigned int Dimension = 3;
-  const unsigned int SliceDimension = Dimension - 1;
+  const typename InputImageType::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const typename InputImageType::IndexType & inputStart = inputRegion.GetIndex();
+  const typename InputImageType::SizeType & inputSize = inputRegion.GetSize();
 
-  typedef TPixel                                                                                         PixelType;
-  typedef double                                                                                         ParametersValueType;
-  typedef itk::Image< PixelType, SliceDimension >                                                        SliceImageType;
-  typedef itk::Euler3DTransform< ParametersValueType >                                                   TransformType;
-  typedef itk::SliceSeriesSpecialCoordinatesImage< SliceImageType, TransformType, PixelType, Dimension > InputImageType;
-  typedef itk::Image< PixelType, Dimension >                                                             OutputImageType;
+  corners.resize( 4 * inputSize[2] );
+  typename InputImageType::IndexType inputIndex;
+  for( itk::SizeValueType slice = 0; slice < inputSize[2]; ++slice )
+    {
+    inputIndex[2] = inputStart[2] + slice;
+    for( unsigned int corner = 0; corner < 4; ++corner )
+      {
+      inputIndex[0] = inputStart[0] + ( ( corner & 1 ) ? inputSize[0] - 1 : 0 );
+      inputIndex[1] = inputStart[1] + ( ( corner & 2 ) ? inputSize[1] - 1 : 0 );
+      inputImage->TransformIndexToPhysicalPoint( inputIndex, corners[4 * slice + corner] );
+      }
+    }
+}
 
-  typedef itk::UltrasoundImageFileReader< InputImageType > ReaderType;
-  typename ReaderType::Pointer reader = ReaderType::New();
-  reader->SetFileName( inputVolume );
 
-  typedef itk::ReplaceNonFiniteImageFilter< InputImageType > ReplaceNonFiniteFilterType;
-  typename ReplaceNonFiniteFilterType::Pointer replaceNonFiniteFilter = ReplaceNonFiniteFilterType::New();
-  replaceNonFiniteFilter->SetInput( reader->GetOutput() );
-  replaceNonFiniteFilter->InPlaceOn();
-  itk::PluginFilterWatcher watchReplaceNonFinite(replaceNonFiniteFilter, "Replace NonFinite", CLPProcessInformation);
-  replaceNonFiniteFilter->UpdateLargestPossibleRegion();
+/** Physical bounds of each slice from the corners of the slices. */
+template< typename TPoint >
+void
+ComputeSliceBounds( const std::vector< TPoint > & corners,
+  std::vector< ScanConversionSliceBounds > & sliceBounds )
+{
+  const std::size_t numberOfSlices = corners.size() / 4;
+  sliceBounds.resize( numberOfSlices );
+  for( std::size_t slice = 0; slice < numberOfSlices; ++slice )
+    {
+    ScanConversionSliceBounds & bounds = sliceBounds[slice];
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      bounds.Lower[ii] = corners[4 * slice][ii];
+      bounds.Upper[ii] = corners[4 * slice][ii];
+      for( unsigned int corner = 1; corner < 4; ++corner )
+        {
+        bounds.Lower[ii] = std::min( bounds.Lower[ii], static_cast< double >( corners[4 * slice + corner][ii] ) );
+        bounds.Upper[ii] = std::max( bounds.Upper[ii], static_cast< double >( corners[4 * slice + corner][ii] ) );
+        }
+      }
+    }
+}
 
-  typename InputImageType::Pointer inputImage = replaceNonFiniteFilter->GetOutput();
 
-  // Find the bounding box of the input
-  typedef typename OutputImageType::PointType OutputPointType;
-  OutputPointType lowerBound( itk::NumericTraits< typename OutputPointType::CoordRepType >::max() );
-  OutputPointType upperBound( itk::NumericTraits< typename OutputPointType::CoordRepType >::NonpositiveMin() );
+/** Output direction aligned with the principal axes of the slice corners, so
+ * the output grid is oriented along the sweep instead of the scanner axes. The
+ * axes are ordered by decreasing extent and form a right-handed frame. */
+template< typename TOutputImage >
+void
+ComputeSweepDirection( const std::vector< typename TOutputImage::PointType > & corners,
+  typename TOutputImage::DirectionType & direction )
+{
+  const unsigned int Dimension = TOutputImage::ImageDimension;
 
-  typename InputImageType::SizeType inputSize = inputImage->GetLargestPossibleRegion().GetSize();
-  typename InputImageType::IndexType inputIndex;
-  typename InputImageType::PointType point;
-  // Only sample with some of the slices so we get a sufficient sampling of
-  // the bounds
-  const itk::IndexValueType sliceStride = 4;
-  for( itk::IndexValueType sliceIndex = 0; sliceIndex < static_cast< itk::IndexValueType >( inputSize[2] ); sliceIndex += sliceStride  )
+  vnl_vector< double > mean( Dimension, 0.0 );
+  for( std::size_t cornerIndex = 0; cornerIndex < corners.size(); ++cornerIndex )
     {
-    inputIndex[0] = 0;
-    inputIndex[1] = 0;
-    inputIndex[2] = sliceIndex;
-
-    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
     for( unsigned int ii = 0; ii < Dimension; ++ii )
       {
-      lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-      upperBound[ii] = std::max( upperBound[ii], point[ii] );
+      mean[ii] += corners[cornerIndex][ii];
       }
+    }
+  mean /= static_cast< double >( corners.size() );
 
-    inputIndex[0] = inputSize[0] - 1;
-    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+  vnl_matrix< double > covariance( Dimension, Dimension, 0.0 );
+  for( std::size_t cornerIndex = 0; cornerIndex < corners.size(); ++cornerIndex )
+    {
     for( unsigned int ii = 0; ii < Dimension; ++ii )
       {
-      lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-      upperBound[ii] = std::max( upperBound[ii], point[ii] );
+      for( unsigned int jj = 0; jj < Dimension; ++jj )
+        {
+        covariance( ii, jj ) += ( corners[cornerIndex][ii] - mean[ii] ) * ( corners[cornerIndex][jj] - mean[jj] );
+        }
       }
+    }
 
-    inputIndex[0] = 0;
-    inputIndex[1] = inputSize[1] - 1;
-    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+  // Eigenvalues are in increasing order
+  vnl_symmetric_eigensystem< double > eigensystem( covariance );
+  for( unsigned int column = 0; column < Dimension; ++column )
+    {
     for( unsigned int ii = 0; ii < Dimension; ++ii )
       {
-      lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-      upperBound[ii] = std::max( upperBound[ii], point[ii] );
+      direction[ii][column] = eigensystem.V( ii, Dimension - 1 - column );
       }
-
-    inputIndex[0] = inputSize[0] - 1;
-    inputIndex[1] = inputSize[1] - 1;
-    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+    }
+  if( vnl_determinant( direction.GetVnlMatrix() ) < 0.0 )
+    {
     for( unsigned int ii = 0; ii < Dimension; ++ii )
       {
-      lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-      upperBound[ii] = std::max( upperBound[ii], point[ii] );
+      direction[ii][Dimension - 1] = -direction[ii][Dimension - 1];
       }
+    }
+}
+
+
+/** Output grid that covers the slice corners with the given spacing. With
+ * cropToSweep, the grid is aligned with the principal axes of the sweep, and
+ * otherwise with the scanner axes. */
+template< typename TOutputImage, typename TPoint >
+void
+ComputeSweepGrid( const std::vector< TPoint > & corners,
+  const std::vector< double > & outputSpacing,
+  bool cropToSweep,
+  typename TOutputImage::SizeType & size,
+  typename TOutputImage::SpacingType & spacing,
+  typename TOutputImage::PointType & origin,
+  typename TOutputImage::DirectionType & direction )
+{
+  const unsigned int Dimension = TOutputImage::ImageDimension;
 
+  if( cropToSweep )
+    {
+    ComputeSweepDirection< TOutputImage >( corners, direction );
+    }
+  else
+    {
+    direction.SetIdentity();
     }
 
-  const itk::IndexValueType sliceIndex = inputSize[2] - 1;
-  inputIndex[2] = sliceIndex;
+  // Find the bounding box of the input in the output grid axes
+  typedef typename TOutputImage::PointType OutputPointType;
+  OutputPointType lowerBound( itk::NumericTraits< typename OutputPointType::CoordRepType >::max() );
+  OutputPointType upperBound( itk::NumericTraits< typename OutputPointType::CoordRepType >::NonpositiveMin() );
+  for( std::size_t cornerIndex = 0; cornerIndex < corners.size(); ++cornerIndex )
+    {
+    for( unsigned int ii = 0; ii < Dimension; ++ii )
+      {
+      typename OutputPointType::CoordRepType coordinate = 0.0;
+      for( unsigned int jj = 0; jj < Dimension; ++jj )
+        {
+        coordinate += direction[jj][ii] * corners[cornerIndex][jj];
+        }
+      lowerBound[ii] = std::min( lowerBound[ii], coordinate );
+      upperBound[ii] = std::max( upperBound[ii], coordinate );
+      }
+    }
 
-  inputIndex[0] = 0;
-  inputIndex[1] = 0;
-  inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
   for( unsigned int ii = 0; ii < Dimension; ++ii )
     {
-    lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-    upperBound[ii] = std::max( upperBound[ii], point[ii] );
+    spacing[ii] = outputSpacing[ii];
     }
 
-  inputIndex[0] = inputSize[0] - 1;
-  inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
   for( unsigned int ii = 0; ii < Dimension; ++ii )
     {
-    lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-    upperBound[ii] = std::max( upperBound[ii], point[ii] );
+    size[ii] = ( upperBound[ii] - lowerBound[ii] ) / outputSpacing[ii] + 1;
     }
 
-  inputIndex[0] = 0;
-  inputIndex[1] = inputSize[1] - 1;
-  inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
-  for( unsigned int ii = 0; ii < Dimension; ++ii )
+  origin = direction * lowerBound;
+}
+
+
+/** Splat the slices that were added to the series since the last run into
+ * the accumulator stored in stateFileName, and write the output. The first
+ * run, without a state file, sets the grid from the slices available, and
+ * later runs extend it by whole voxels to include the new slices. */
+template< typename TInputImage, typename TOutputImage >
+int
+IncrementalScanConversion( itk::ImageSource< TInputImage > * inputSource,
+  const std::vector< double > & outputSpacing,
+  bool cropToSweep,
+  const std::string & stateFileName,
+  unsigned int holeFillingRadius,
+  const std::string & outputFileName,
+  int compressionLevel,
+  ModuleProcessInformation * CLPProcessInformation )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+  typedef ScanConversionSliceSplatAccumulator< InputImageType, OutputImageType > AccumulatorType;
+  const unsigned int SliceAxis = InputImageType::ImageDimension - 1;
+
+  AccumulatorType accumulator;
+  accumulator.SetHoleFillingRadius( holeFillingRadius );
+  if( itksys::SystemTools::FileExists( stateFileName.c_str(), true )
+    && !accumulator.Read( stateFileName ) )
     {
-    lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-    upperBound[ii] = std::max( upperBound[ii], point[ii] );
+    std::cerr << "Could not read the incremental scan conversion state: " << stateFileName << std::endl;
+    return EXIT_FAILURE;
     }
 
-  inputIndex[0] = inputSize[0] - 1;
-  inputIndex[1] = inputSize[1] - 1;
-  inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
-  for( unsigned int ii = 0; ii < Dimension; ++ii )
+  inputSource->UpdateOutputInformation();
+  InputImageType * inputImage = inputSource->GetOutput();
+  const typename InputImageType::RegionType & largestRegion = inputImage->GetLargestPossibleRegion();
+  const itk::IndexValueType firstSlice = largestRegion.GetIndex( SliceAxis ) + static_cast< itk::IndexValueType >( accumulator.GetNumberOfSlices() );
+  const itk::IndexValueType endSlice = largestRegion.GetIndex( SliceAxis ) + static_cast< itk::IndexValueType >( largestRegion.GetSize( SliceAxis ) );
+  if( firstSlice > endSlice )
     {
-    lowerBound[ii] = std::min( lowerBound[ii], point[ii] );
-    upperBound[ii] = std::max( upperBound[ii], point[ii] );
+    std::cerr << "The input has fewer slices than were accumulated in " << stateFileName << std::endl;
+    return EXIT_FAILURE;
     }
 
+  if( firstSlice < endSlice )
+    {
+    // Only read the new slices
+    typename InputImageType::RegionType newRegion = largestRegion;
+    newRegion.SetIndex( SliceAxis, firstSlice );
+    newRegion.SetSize( SliceAxis, endSlice - firstSlice );
+    inputImage->SetRequestedRegion( newRegion );
+    inputSource->Update();
+
+    std::vector< typename InputImageType::PointType > allCorners;
+    ComputeSliceCorners< InputImageType >( inputImage, allCorners );
+    const std::vector< typename InputImageType::PointType > corners( allCorners.begin() + 4 * ( firstSlice - largestRegion.GetIndex( SliceAxis ) ),
+      allCorners.end() );
+    if( accumulator.GetHasGrid() )
+      {
+      accumulator.ExpandToInclude( corners );
+      }
+    else
+      {
+      typename OutputImageType::SizeType size;
+      typename OutputImageType::SpacingType spacing;
+      typename OutputImageType::PointType origin;
+      typename OutputImageType::DirectionType direction;
+      ComputeSweepGrid< OutputImageType >( corners, outputSpacing, cropToSweep, size, spacing, origin, direction );
+      accumulator.SetGrid( size, spacing, origin, direction );
+      }
+    if( accumulator.AddSlices( inputImage, firstSlice, endSlice ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( !accumulator.Write( stateFileName ) )
+      {
+      std::cerr << "Could not write the incremental scan conversion state: " << stateFileName << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  else if( !accumulator.GetHasGrid() )
+    {
+    std::cerr << "The input has no slices to scan convert" << std::endl;
+    return EXIT_FAILURE;
+    }
 
-  typename OutputImageType::SpacingType spacing;
-  for( unsigned int ii = 0; ii < Dimension; ++ii )
+  typename OutputImageType::Pointer outputImage;
+  if( accumulator.GetOutput( outputImage ) != EXIT_SUCCESS )
     {
-    spacing[ii] = outputSpacing[ii];
+    return EXIT_FAILURE;
     }
 
-  typename OutputImageType::SizeType size;
-  for( unsigned int ii = 0; ii < Dimension; ++ii )
+  return WriteScanConversionImage< OutputImageType >( outputImage,
+    outputFileName,
+    compressionLevel,
+    "Write Output",
+    CLPProcessInformation );
+}
+
+
+/** Splat the slices onto the output grid in a single pass over the input,
+ * reading the slices in numberOfPieces contiguous pieces when the pipeline
+ * has not been updated yet. */
+template< typename TInputImage, typename TOutputImage >
+int
+ForwardSplatScanConversion( itk::ImageSource< TInputImage > * inputSource,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  unsigned int numberOfPieces,
+  unsigned int holeFillingRadius )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+  typedef ScanConversionSliceSplatAccumulator< InputImageType, OutputImageType > AccumulatorType;
+  const unsigned int SliceAxis = InputImageType::ImageDimension - 1;
+
+  ScanConversionProfileScope profileResampling( "Resample Image" );
+  AccumulatorType accumulator;
+  accumulator.SetGrid( size, spacing, origin, direction );
+  accumulator.SetHoleFillingRadius( holeFillingRadius );
+
+  InputImageType * inputImage = inputSource->GetOutput();
+  const typename InputImageType::RegionType largestRegion = inputImage->GetLargestPossibleRegion();
+  const itk::IndexValueType startSlice = largestRegion.GetIndex( SliceAxis );
+  const itk::SizeValueType numberOfSlices = largestRegion.GetSize( SliceAxis );
+  numberOfPieces = std::max( 1u, std::min( numberOfPieces, static_cast< unsigned int >( numberOfSlices ) ) );
+  for( unsigned int piece = 0; piece < numberOfPieces; ++piece )
     {
-    size[ii] = ( upperBound[ii] - lowerBound[ii] ) / outputSpacing[ii] + 1;
+    const itk::IndexValueType firstSlice = startSlice + numberOfSlices * piece / numberOfPieces;
+    const itk::IndexValueType endSlice = startSlice + numberOfSlices * ( piece + 1 ) / numberOfPieces;
+    typename InputImageType::RegionType pieceRegion = largestRegion;
+    pieceRegion.SetIndex( SliceAxis, firstSlice );
+    pieceRegion.SetSize( SliceAxis, endSlice - firstSlice );
+    inputImage->SetRequestedRegion( pieceRegion );
+    inputSource->Update();
+    if( accumulator.AddSlices( inputImage, firstSlice, endSlice ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
     }
 
+  return accumulator.GetOutput( outputImage );
+}
+
+
+/** Whether the samples of inputFileName are replaced when they are
+ * resampled. Integer samples are always finite, so they are used as read, in
+ * their own pixel type. HDF5 inputs are read with a
+ * ScanConversionNonFiniteImageIO, which replaces the non-finite samples of
+ * each region as it is read instead of in another pass over the input. */
+template< typename TPixel >
+bool
+ReplaceNonFiniteOnResampling( const std::string & inputFileName )
+{
+  if( itk::NumericTraits< TPixel >::is_integer )
+    {
+    return false;
+    }
+  itk::ImageIOBase::Pointer inputImageIO = itk::ImageIOFactory::CreateImageIO( inputFileName.c_str(), itk::ImageIOFactory::ReadMode );
+  return inputImageIO.IsNull()
+    || std::string( inputImageIO->GetNameOfClass() ) != "ScanConversionNonFiniteImageIO";
+}
+
+
+/** The corners of the slices, the geometry that the state of a frame
+ * resampler depends on, as the parameters of its lookup table key. */
+template< typename TPoint >
+std::vector< double >
+SliceCornerParameters( const std::vector< TPoint > & corners )
+{
+  std::vector< double > parameters;
+  parameters.reserve( 3 * corners.size() );
+  for( std::size_t cornerIndex = 0; cornerIndex < corners.size(); ++cornerIndex )
+    {
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      parameters.push_back( corners[cornerIndex][ii] );
+      }
+    }
+  return parameters;
+}
+
+
+/** Scan converts the requests of a server with a frame resampler of the
+ * library that is kept across the requests. The output grid and the state
+ * of the frame resampler, e.g. the lookup table or the locator of the VTK
+ * kernels, are only computed again for a slice series whose slices differ
+ * from the slices of the previous request. ForwardSplat splats each request
+ * as without a server. */
+template< typename TPixel >
+class SliceSeriesFrameProcessor
+{
+public:
+  typedef TPixel PixelType;
+  itkStaticConstMacro( Dimension, unsigned int, 3 );
+
+  typedef itk::Image< PixelType, Dimension - 1 >                                                          SliceImageType;
+  typedef itk::Euler3DTransform< double >                                                                 TransformType;
+  typedef itk::SliceSeriesSpecialCoordinatesImage< SliceImageType, TransformType, PixelType, Dimension > InputImageType;
+  typedef itk::Image< PixelType, Dimension >                                                              OutputImageType;
+  typedef typename InputImageType::PointType                                                              InputPointType;
+
+  typedef LibraryScanConversionFrameResampler< InputImageType, OutputImageType > FrameResamplerType;
+
+  SliceSeriesFrameProcessor( const std::vector< double > & outputSpacing,
+    bool cropToSweep,
+    const std::string & method,
+    unsigned int windowedSincRadius,
+    const std::string & kernelFootprint,
+    unsigned int kernelPoints,
+    unsigned int tileSize,
+    bool imageSliceMapping,
+    unsigned int holeFillingRadius,
+    int compressionLevel,
+    ModuleProcessInformation * CLPProcessInformation ):
+    m_OutputSpacing( outputSpacing ),
+    m_CropToSweep( cropToSweep ),
+    m_Method( method ),
+    m_ForwardSplat( ScanConversionResamplingMethodFromString( method ) == FORWARD_SPLAT ),
+    m_WindowedSincRadius( windowedSincRadius ),
+    m_KernelFootprint( ScanConversionKernelFootprintFromString( kernelFootprint ) ),
+    m_KernelPoints( kernelPoints ),
+    m_TileSize( tileSize ),
+    m_ImageSliceMapping( imageSliceMapping ),
+    m_HoleFillingRadius( holeFillingRadius ),
+    m_CompressionLevel( compressionLevel ),
+    m_CLPProcessInformation( CLPProcessInformation ),
+    m_FrameResampler( ITK_NULLPTR ),
+    m_ReplaceNonFinite( false )
+  {
+  }
+
+  ~SliceSeriesFrameProcessor()
+  {
+    delete m_FrameResampler;
+  }
+
+  /** Scan convert one slice series file to an output file. */
+  int operator()( const std::string & inputFileName, const std::string & outputFileName )
+  {
+    typedef itk::UltrasoundImageFileReader< InputImageType > ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( inputFileName );
+    const bool replaceNonFinite = ReplaceNonFiniteOnResampling< PixelType >( inputFileName );
+
+    typename OutputImageType::Pointer outputImage;
+    if( m_ForwardSplat )
+      {
+      typedef itk::ReplaceNonFiniteImageFilter< InputImageType > ReplaceNonFiniteFilterType;
+      typename ReplaceNonFiniteFilterType::Pointer replaceNonFiniteFilter = ReplaceNonFiniteFilterType::New();
+      replaceNonFiniteFilter->SetInput( reader->GetOutput() );
+      replaceNonFiniteFilter->InPlaceOn();
+      itk::ImageSource< InputImageType > * inputSource = reader;
+      if( replaceNonFinite )
+        {
+        inputSource = replaceNonFiniteFilter;
+        }
+      inputSource->UpdateOutputInformation();
+
+      std::vector< InputPointType > corners;
+      ComputeSliceCorners< InputImageType >( inputSource->GetOutput(), corners );
+      typename OutputImageType::SizeType size;
+      typename OutputImageType::SpacingType spacing;
+      typename OutputImageType::PointType origin;
+      typename OutputImageType::DirectionType direction;
+      ComputeSweepGrid< OutputImageType >( corners, m_OutputSpacing, m_CropToSweep, size, spacing, origin, direction );
+      if( ForwardSplatScanConversion< InputImageType, OutputImageType >( inputSource,
+          outputImage,
+          size,
+          spacing,
+          origin,
+          direction,
+          1,
+          m_HoleFillingRadius ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    else
+      {
+      {
+      ScanConversionProfileScope profileRead( "Read Frame" );
+      reader->Update();
+      }
+      typename InputImageType::Pointer inputImage = reader->GetOutput();
+      inputImage->DisconnectPipeline();
+
+      std::vector< InputPointType > corners;
+      ComputeSliceCorners< InputImageType >( inputImage.GetPointer(), corners );
+      const std::vector< double > geometryParameters = SliceCornerParameters( corners );
+      if( m_FrameResampler == ITK_NULLPTR
+        || inputImage->GetLargestPossibleRegion().GetSize() != m_InputSize
+        || geometryParameters != m_GeometryParameters
+        || replaceNonFinite != m_ReplaceNonFinite )
+        {
+        if( this->Initialize( inputImage, corners, geometryParameters, replaceNonFinite ) != EXIT_SUCCESS )
+          {
+          return EXIT_FAILURE;
+          }
+        }
+      if( m_FrameResampler->Resample( inputImage, outputImage ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      }
+
+    ScanConversionProfileScope profileWrite( "Write Frame" );
+    return WriteScanConversionImage< OutputImageType >( outputImage,
+      outputFileName,
+      m_CompressionLevel,
+      "Write Frame",
+      ITK_NULLPTR );
+  }
+
+private:
+  SliceSeriesFrameProcessor( const SliceSeriesFrameProcessor & );
+  void operator=( const SliceSeriesFrameProcessor & );
+
+  /** Compute the output grid and the state of the frame resampler for the
+   * slices of inputImage. */
+  int Initialize( const typename InputImageType::Pointer & inputImage,
+    const std::vector< InputPointType > & corners,
+    const std::vector< double > & geometryParameters,
+    bool replaceNonFinite )
+  {
+    delete m_FrameResampler;
+    m_FrameResampler = ITK_NULLPTR;
+
+    typename OutputImageType::SizeType size;
+    typename OutputImageType::SpacingType spacing;
+    typename OutputImageType::PointType origin;
+    typename OutputImageType::DirectionType direction;
+    ComputeSweepGrid< OutputImageType >( corners, m_OutputSpacing, m_CropToSweep, size, spacing, origin, direction );
+
+    ScanConversionResamplingOptions resamplingOptions;
+    resamplingOptions.WindowedSincRadius = m_WindowedSincRadius;
+    resamplingOptions.KernelFootprint = m_KernelFootprint;
+    resamplingOptions.KernelNumberOfPoints = m_KernelPoints;
+    resamplingOptions.TileSize = m_TileSize;
+    resamplingOptions.CompressionLevel = m_CompressionLevel;
+    resamplingOptions.SliceSeriesLocator = !m_ImageSliceMapping;
+    resamplingOptions.ReplaceNonFinite = replaceNonFinite;
+    resamplingOptions.LookupTableGeometryParameters = geometryParameters;
+
+    FrameResamplerType * frameResampler = new FrameResamplerType;
+    if( frameResampler->Initialize( inputImage,
+        size,
+        spacing,
+        origin,
+        direction,
+        m_Method,
+        resamplingOptions,
+        m_CLPProcessInformation ) != EXIT_SUCCESS )
+      {
+      delete frameResampler;
+      return EXIT_FAILURE;
+      }
+    m_FrameResampler = frameResampler;
+    m_InputSize = inputImage->GetLargestPossibleRegion().GetSize();
+    m_GeometryParameters = geometryParameters;
+    m_ReplaceNonFinite = replaceNonFinite;
+    return EXIT_SUCCESS;
+  }
+
+  const std::vector< double > m_OutputSpacing;
+  const bool                  m_CropToSweep;
+  const std::string           m_Method;
+  const bool                  m_ForwardSplat;
+  const unsigned int          m_WindowedSincRadius;
+  const ScanConversionResamplingOptions::KernelFootprintType m_KernelFootprint;
+  const unsigned int          m_KernelPoints;
+  const unsigned int          m_TileSize;
+  const bool                  m_ImageSliceMapping;
+  const unsigned int          m_HoleFillingRadius;
+  const int                   m_CompressionLevel;
+  ModuleProcessInformation *  m_CLPProcessInformation;
+
+  FrameResamplerType *                 m_FrameResampler;
+  typename InputImageType::SizeType    m_InputSize;
+  std::vector< double >                m_GeometryParameters;
+  bool                                 m_ReplaceNonFinite;
+};
+
+
+/** Scan convert inputFileName to outputFileName with the other parameters
+ * of the command line. */
+template< typename TPixel >
+int ScanConvert( int argc,
+  char * argv[],
+  const std::string & inputFileName,
+  const std::string & outputFileName )
+{
+  PARSE_ARGS;
+
+  const unsigned int Dimension = 3;
+  const unsigned int SliceDimension = Dimension - 1;
+
+  typedef TPixel                                                                                         PixelType;
+  typedef double                                                                                         ParametersValueType;
+  typedef itk::Image< PixelType, SliceDimension >                                                        SliceImageType;
+  typedef itk::Euler3DTransform< ParametersValueType >                                                   TransformType;
+  typedef itk::SliceSeriesSpecialCoordinatesImage< SliceImageType, TransformType, PixelType, Dimension > InputImageType;
+  typedef itk::Image< PixelType, Dimension >                                                             OutputImageType;
+
+  typedef itk::UltrasoundImageFileReader< InputImageType > ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( inputFileName );
+  ScanConversionFilterWatcher watchReader(reader, "Read Input", CLPProcessInformation);
+
+  // The resampling methods replace the non-finite samples as they
+  // interpolate them, and only the forward splat and the incremental scan
+  // conversion, which accumulate the samples, read them from an
+  // itk::ReplaceNonFiniteImageFilter.
+  const bool replaceNonFinite = ReplaceNonFiniteOnResampling< PixelType >( inputFileName );
+  typedef itk::ReplaceNonFiniteImageFilter< InputImageType > ReplaceNonFiniteFilterType;
+  typename ReplaceNonFiniteFilterType::Pointer replaceNonFiniteFilter = ReplaceNonFiniteFilterType::New();
+  replaceNonFiniteFilter->SetInput( reader->GetOutput() );
+  replaceNonFiniteFilter->InPlaceOn();
+  ScanConversionFilterWatcher watchReplaceNonFinite(replaceNonFiniteFilter, "Replace NonFinite", CLPProcessInformation);
+  itk::ImageSource< InputImageType > * inputSource = reader;
+  const bool forwardSplat = ScanConversionResamplingMethodFromString( method ) == FORWARD_SPLAT;
+  if( replaceNonFinite && ( forwardSplat || !incrementalState.empty() ) )
+    {
+    inputSource = replaceNonFiniteFilter;
+    }
+  if( !incrementalState.empty() )
+    {
+    return IncrementalScanConversion< InputImageType, OutputImageType >( inputSource,
+      outputSpacing,
+      cropToSweep,
+      incrementalState,
+      holeFillingRadius,
+      outputFileName,
+      compressionLevel,
+      CLPProcessInformation );
+    }
+
+  // When streaming, the pipeline is only updated by the writer so that each
+  // piece of the output only reads the slices it samples, and ForwardSplat
+  // reads the slices one piece at a time
+  const bool streaming = streamDivisions > 1;
+  if( streaming )
+    {
+    inputSource->UpdateOutputInformation();
+    }
+  else
+    {
+    inputSource->UpdateLargestPossibleRegion();
+    }
+
+  typename InputImageType::Pointer inputImage = inputSource->GetOutput();
+
+  std::vector< typename InputImageType::PointType > corners;
+  ComputeSliceCorners< InputImageType >( inputImage, corners );
+
+  typename OutputImageType::SizeType size;
+  typename OutputImageType::SpacingType spacing;
+  typename OutputImageType::PointType origin;
   typename OutputImageType::DirectionType direction;
-  direction.SetIdentity();
+  ComputeSweepGrid< OutputImageType >( corners, outputSpacing, cropToSweep, size, spacing, origin, direction );
 
   typename OutputImageType::Pointer outputImage;
 
-  ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
-    outputImage,
-    size,
-    spacing,
-    lowerBound,
-    direction,
-    method,
-    CLPProcessInformation
-  );
-
-  typedef itk::ImageFileWriter< OutputImageType > WriterType;
-  typename WriterType::Pointer writer = WriterType::New();
-  writer->SetFileName( outputVolume );
-  writer->SetInput( outputImage );
-  writer->SetUseCompression( true );
-  itk::PluginFilterWatcher watchWriter(writer, "Write Output", CLPProcessInformation);
-  writer->Update();
+  if( forwardSplat )
+    {
+    if( ForwardSplatScanConversion< InputImageType, OutputImageType >( inputSource,
+        outputImage,
+        size,
+        spacing,
+        origin,
+        direction,
+        streamDivisions,
+        holeFillingRadius ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  else if( streaming )
+    {
+    ScanConversionResamplingOptions resamplingOptions;
+    resamplingOptions.StreamDivisions = streamDivisions;
+    resamplingOptions.WindowedSincRadius = windowedSincRadius;
+    resamplingOptions.KernelFootprint = ScanConversionKernelFootprintFromString( kernelFootprint );
+    resamplingOptions.KernelNumberOfPoints = kernelPoints;
+    resamplingOptions.TileSize = tileSize;
+    resamplingOptions.CompressionLevel = compressionLevel;
+    resamplingOptions.SliceSeriesLocator = !imageSliceMapping;
+    resamplingOptions.ReplaceNonFinite = replaceNonFinite;
+    ComputeSliceBounds( corners, resamplingOptions.SliceBounds );
+    return LibraryStreamingScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputFileName,
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      resamplingOptions,
+      CLPProcessInformation
+    );
+    }
+  else
+    {
+    ScanConversionResamplingOptions resamplingOptions;
+    resamplingOptions.WindowedSincRadius = windowedSincRadius;
+    resamplingOptions.KernelFootprint = ScanConversionKernelFootprintFromString( kernelFootprint );
+    resamplingOptions.KernelNumberOfPoints = kernelPoints;
+    resamplingOptions.TileSize = tileSize;
+    resamplingOptions.CompressionLevel = compressionLevel;
+    resamplingOptions.SliceSeriesLocator = !imageSliceMapping;
+    resamplingOptions.ReplaceNonFinite = replaceNonFinite;
+    resamplingOptions.ProgressiveLevels = progressiveLevels;
+    resamplingOptions.ProgressiveFileName = outputFileName;
+    resamplingOptions.ProgressiveDirectory = progressiveDirectory;
+    if( LibraryScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+        outputImage,
+        size,
+        spacing,
+        origin,
+        direction,
+        method,
+        resamplingOptions,
+        CLPProcessInformation ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  return WriteScanConversionImage< OutputImageType >( outputImage,
+    outputFileName,
+    compressionLevel,
+    "Write Output",
+    CLPProcessInformation );
+}
 
-  return EXIT_SUCCESS;
+
+template< typename TPixel >
+int DoIt( int argc, char * argv[] )
+{
+  PARSE_ARGS;
+  ScanConversionProfileSession profileSession( profile );
+
+  if( serverPort > 0 )
+    {
+    if( !incrementalState.empty() || streamDivisions > 1 || progressiveLevels > 0 )
+      {
+      std::cerr << "The server resamples whole frames, so the Incremental State, Stream Divisions, "
+        "and Progressive Levels are not available with the Server Port" << std::endl;
+      return EXIT_FAILURE;
+      }
+    typedef SliceSeriesFrameProcessor< TPixel > ProcessorType;
+    ProcessorType processor( outputSpacing,
+      cropToSweep,
+      method,
+      windowedSincRadius,
+      kernelFootprint,
+      kernelPoints,
+      tileSize,
+      imageSliceMapping,
+      holeFillingRadius,
+      compressionLevel,
+      CLPProcessInformation );
+    return ScanConversionServe( serverPort, serverTokenFile, processor );
+    }
+
+  return ScanConvert< TPixel >( argc, argv, inputVolume, outputVolume );
 }
 
 } // end of anonymous namespace
@@ -203,6 +784,12 @@ int main( int argc, char * argv[] )
 {
   PARSE_ARGS;
 
+  ScanConversionThreadingScope threadingScope;
+  if( threadingScope.Configure( threads, cpuAffinity ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+
   itk::ImageIOBase::IOPixelType     inputPixelType;
   itk::ImageIOBase::IOComponentType inputComponentType;
   itk::FloatingPointExceptions::Enable();
@@ -211,27 +798,27 @@ int main( int argc, char * argv[] )
   try
     {
     // TODO: use the CMake configured factory registration
-    itk::HDF5UltrasoundImageIOFactory::RegisterOneFactory();
+    ScanConversionNonFiniteImageIOFactory< itk::HDF5UltrasoundImageIO >::RegisterOneFactory();
 
     itk::GetImageType(inputVolume, inputPixelType, inputComponentType);
 
     switch( inputComponentType )
       {
-      //case itk::ImageIOBase::UCHAR:
-        //return DoIt< unsigned char >( argc, argv );
-        //break;
-      //case itk::ImageIOBase::USHORT:
-        //return DoIt< unsigned short >( argc, argv );
-        //break;
-      //case itk::ImageIOBase::SHORT:
-        //return DoIt< short >( argc, argv );
-        //break;
+      case itk::ImageIOBase::UCHAR:
+        return DoIt< unsigned char >( argc, argv );
+        break;
+      case itk::ImageIOBase::USHORT:
+        return DoIt< unsigned short >( argc, argv );
+        break;
+      case itk::ImageIOBase::SHORT:
+        return DoIt< short >( argc, argv );
+        break;
       case itk::ImageIOBase::FLOAT:
         return DoIt< float >( argc, argv );
         break;
-      //case itk::ImageIOBase::DOUBLE:
-        //return DoIt< double >( argc, argv );
-        //break;
+      case itk::ImageIOBase::DOUBLE:
+        return DoIt< double >( argc, argv );
+        break;
       default:
         std::cerr << "Unknown input image pixel component type: "
           << itk::ImageIOBase::GetComponentTypeAsString( inputComponentType )
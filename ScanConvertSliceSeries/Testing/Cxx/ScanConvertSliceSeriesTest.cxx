@@ -8,8 +8,33 @@
 
 #include "itkTestMain.h"
 
+#include "ScanConversionTesting.h"
+
+#include "itkEuler3DTransform.h"
+#include "itkHDF5UltrasoundImageIO.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIORegion.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkObjectFactoryBase.h"
+#include "itkReplaceNonFiniteImageFilter.h"
+#include "itkSliceSeriesSpecialCoordinatesImage.h"
+#include "itkUltrasoundImageFileReader.h"
+#include "itk_hdf5.h"
+#include "itksys/SystemTools.hxx"
+#include "vnl/vnl_math.h"
+
+#include "ScanConversionNonFiniteImageIO.h"
+#include "ScanConversionResamplingMethods.h"
+#include "ScanConversionSliceSeriesLocator.h"
+#include "ScanConversionSliceSplatAccumulator.h"
+
 // STD includes
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 #ifdef WIN32
 # define MODULE_IMPORT __declspec(dllimport)
@@ -19,7 +44,1034 @@
 
 extern "C" MODULE_IMPORT int ModuleEntryPoint(int, char* []);
 
+namespace
+{
+
+typedef itk::Image< float, 2 >                                                              SliceImageType;
+typedef itk::Euler3DTransform< double >                                                     SliceTransformType;
+typedef itk::SliceSeriesSpecialCoordinatesImage< SliceImageType, SliceTransformType, float, 3 > SliceSeriesImageType;
+typedef itk::Image< float, 3 >                                                              SplatOutputImageType;
+typedef ScanConversionSliceSplatAccumulator< SliceSeriesImageType, SplatOutputImageType >   SplatAccumulatorType;
+typedef ScanConversionSliceSeriesLocator< SliceSeriesImageType >                            SliceSeriesLocatorType;
+
+/** Physical points of the corners of the slices in [firstSlice, endSlice). */
+void
+SliceCorners( const SliceSeriesImageType * inputImage,
+  itk::IndexValueType firstSlice,
+  itk::IndexValueType endSlice,
+  std::vector< SliceSeriesImageType::PointType > & corners )
+{
+  const SliceSeriesImageType::RegionType & region = inputImage->GetLargestPossibleRegion();
+  corners.clear();
+  SliceSeriesImageType::IndexType index;
+  for( index[2] = firstSlice; index[2] < endSlice; ++index[2] )
+    {
+    for( unsigned int corner = 0; corner < 4; ++corner )
+      {
+      index[0] = region.GetIndex( 0 ) + ( ( corner & 1 ) ? region.GetSize( 0 ) - 1 : 0 );
+      index[1] = region.GetIndex( 1 ) + ( ( corner & 2 ) ? region.GetSize( 1 ) - 1 : 0 );
+      SliceSeriesImageType::PointType point;
+      inputImage->TransformIndexToPhysicalPoint( index, point );
+      corners.push_back( point );
+      }
+    }
+}
+
+
+int
+WriteSplatOutput( const SplatAccumulatorType & accumulator, const char * fileName )
+{
+  SplatOutputImageType::Pointer output;
+  if( accumulator.GetOutput( output ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  typedef itk::ImageFileWriter< SplatOutputImageType > WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( fileName );
+  writer->SetInput( output );
+  writer->Update();
+  return EXIT_SUCCESS;
+}
+
+
+/** Accumulate the slices of a slice series in three parts of about a
+ * third of the slices, writing and reading the state between them as the
+ * Incremental State does, e.g.
+ *
+ *   ScanConvertSliceSeriesIncrementalTest <input> <state> <output> <reference>
+ *
+ * The output is compared with the reference, the splat of all the slices at
+ * once onto the grid of the output.
+ */
+int
+ScanConvertSliceSeriesIncrementalTest( int argc, char * argv[] )
+{
+  if( argc < 5 )
+    {
+    std::cerr << "Usage: " << argv[0] << " input state output reference" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  typedef itk::UltrasoundImageFileReader< SliceSeriesImageType > ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[1] );
+  reader->SetImageIO( itk::HDF5UltrasoundImageIO::New() );
+  reader->Update();
+  const SliceSeriesImageType * inputImage = reader->GetOutput();
+  const itk::IndexValueType startSlice = inputImage->GetLargestPossibleRegion().GetIndex( 2 );
+  const itk::IndexValueType endSlice = startSlice + static_cast< itk::IndexValueType >( inputImage->GetLargestPossibleRegion().GetSize( 2 ) );
+  const itk::IndexValueType numberOfSlices = endSlice - startSlice;
+  const itk::IndexValueType partEnds[3] = { startSlice + numberOfSlices / 3, startSlice + 2 * numberOfSlices / 3, endSlice };
+  if( numberOfSlices < 3 )
+    {
+    std::cerr << "The input has fewer than three slices" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // The first part sets the grid, with unit spacing along the scanner axes
+  std::vector< SliceSeriesImageType::PointType > corners;
+  SliceCorners( inputImage, startSlice, partEnds[0], corners );
+  SplatOutputImageType::PointType origin( itk::NumericTraits< double >::max() );
+  SplatOutputImageType::PointType upper( itk::NumericTraits< double >::NonpositiveMin() );
+  for( std::size_t corner = 0; corner < corners.size(); ++corner )
+    {
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      origin[dim] = std::min( origin[dim], corners[corner][dim] );
+      upper[dim] = std::max( upper[dim], corners[corner][dim] );
+      }
+    }
+  SplatOutputImageType::SizeType size;
+  SplatOutputImageType::SpacingType spacing( 1.0 );
+  SplatOutputImageType::DirectionType direction;
+  direction.SetIdentity();
+  for( unsigned int dim = 0; dim < 3; ++dim )
+    {
+    size[dim] = static_cast< itk::SizeValueType >( upper[dim] - origin[dim] ) + 1;
+    }
+
+  itk::IndexValueType partStart = startSlice;
+  for( unsigned int part = 0; part < 3; ++part )
+    {
+    SplatAccumulatorType accumulator;
+    if( part == 0 )
+      {
+      accumulator.SetGrid( size, spacing, origin, direction );
+      }
+    else
+      {
+      if( !accumulator.Read( argv[2] )
+        || accumulator.GetNumberOfSlices() != static_cast< itk::SizeValueType >( partStart - startSlice ) )
+        {
+        std::cerr << "Could not read the state of part " << part << " from " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+        }
+      SliceCorners( inputImage, partStart, partEnds[part], corners );
+      accumulator.ExpandToInclude( corners );
+      }
+    if( accumulator.AddSlices( inputImage, partStart, partEnds[part] ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( part < 2 )
+      {
+      if( !accumulator.Write( argv[2] ) )
+        {
+        std::cerr << "Could not write the state of part " << part << " to " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    else
+      {
+      if( WriteSplatOutput( accumulator, argv[3] ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      accumulator.GetGrid( size, spacing, origin, direction );
+      }
+    partStart = partEnds[part];
+    }
+
+  SplatAccumulatorType reference;
+  reference.SetGrid( size, spacing, origin, direction );
+  if( reference.AddSlices( inputImage, startSlice, endSlice ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return WriteSplatOutput( reference, argv[4] );
+}
+
+
+
+/** The largest floating point dataset of the root group of an HDF5 file. */
+struct LargestFloatDataset
+{
+  LargestFloatDataset():
+    NumberOfValues( 0 )
+  {
+  }
+
+  std::string Name;
+  hssize_t    NumberOfValues;
+};
+
+
+herr_t
+FindLargestFloatDataset( hid_t group, const char * name, const H5L_info_t *, void * data )
+{
+  LargestFloatDataset * largest = static_cast< LargestFloatDataset * >( data );
+  H5O_info_t objectInfo;
+  if( H5Oget_info_by_name( group, name, &objectInfo, H5P_DEFAULT ) < 0 || objectInfo.type != H5O_TYPE_DATASET )
+    {
+    return 0;
+    }
+  const hid_t dataset = H5Dopen2( group, name, H5P_DEFAULT );
+  if( dataset < 0 )
+    {
+    return 0;
+    }
+  const hid_t dataType = H5Dget_type( dataset );
+  const hid_t dataSpace = H5Dget_space( dataset );
+  const hssize_t numberOfValues = H5Sget_simple_extent_npoints( dataSpace );
+  if( H5Tget_class( dataType ) == H5T_FLOAT && numberOfValues > largest->NumberOfValues )
+    {
+    largest->Name = name;
+    largest->NumberOfValues = numberOfValues;
+    }
+  H5Sclose( dataSpace );
+  H5Tclose( dataType );
+  H5Dclose( dataset );
+  return 0;
+}
+
+
+/** Copy an HDF5 file and set every stride-th sample of its largest floating
+ * point dataset, the image, to NaN, +Inf, and -Inf in turn. */
+int
+WriteNonFiniteHDF5Copy( const char * inputFileName, const char * outputFileName, bool zeroed )
+{
+  if( !itksys::SystemTools::CopyFileAlways( inputFileName, outputFileName ) )
+    {
+    std::cerr << "Could not copy " << inputFileName << " to " << outputFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  const hid_t file = H5Fopen( outputFileName, H5F_ACC_RDWR, H5P_DEFAULT );
+  if( file < 0 )
+    {
+    std::cerr << "Could not open " << outputFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  LargestFloatDataset largest;
+  H5Literate( file, H5_INDEX_NAME, H5_ITER_NATIVE, ITK_NULLPTR, FindLargestFloatDataset, &largest );
+  int status = EXIT_FAILURE;
+  if( largest.NumberOfValues == 0 )
+    {
+    std::cerr << "There is no floating point dataset in " << inputFileName << std::endl;
+    }
+  else
+    {
+    const hid_t dataset = H5Dopen2( file, largest.Name.c_str(), H5P_DEFAULT );
+    std::vector< double > values( static_cast< std::size_t >( largest.NumberOfValues ) );
+    if( H5Dread( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] ) >= 0 )
+      {
+      const double nonFinite[3] = { std::numeric_limits< double >::quiet_NaN(),
+        std::numeric_limits< double >::infinity(),
+        -std::numeric_limits< double >::infinity() };
+      const std::size_t stride = 97;
+      for( std::size_t ii = 0; ii < values.size(); ii += stride )
+        {
+        values[ii] = zeroed ? 0.0 : nonFinite[( ii / stride ) % 3];
+        }
+      if( H5Dwrite( dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0] ) >= 0 )
+        {
+        status = EXIT_SUCCESS;
+        }
+      }
+    H5Dclose( dataset );
+    if( status != EXIT_SUCCESS )
+      {
+      std::cerr << "Could not rewrite the " << largest.Name << " dataset of " << outputFileName << std::endl;
+      }
+    }
+  H5Fclose( file );
+  return status;
+}
+
+
+/** Write two copies of an HDF5 slice series, one with non-finite samples
+ * and one with zeros at the same samples instead, the output of an
+ * itk::ReplaceNonFiniteImageFilter, e.g.
+ *
+ *   ScanConvertSliceSeriesWriteNonFiniteInput <input> <non-finite> <zeroed>
+ *
+ * so the conversions of the two are compared.
+ */
+int
+ScanConvertSliceSeriesWriteNonFiniteInput( int argc, char * argv[] )
+{
+  if( argc < 4 )
+    {
+    std::cerr << "Usage: " << argv[0] << " input nonFiniteOutput zeroedOutput" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( WriteNonFiniteHDF5Copy( argv[1], argv[2], false ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return WriteNonFiniteHDF5Copy( argv[1], argv[3], true );
+}
+
+
+/** \class RegionRecordingHDF5ImageIO
+ *
+ * \brief The ScanConversionNonFiniteImageIO of the module that records the
+ * IO region of each read.
+ *
+ * It keeps the class name of its superclass, so the module still relies on
+ * it to replace the non-finite samples as it reads them.
+ */
+class RegionRecordingHDF5ImageIO: public ScanConversionNonFiniteImageIO< itk::HDF5UltrasoundImageIO >
+{
+public:
+  typedef RegionRecordingHDF5ImageIO                                     Self;
+  typedef ScanConversionNonFiniteImageIO< itk::HDF5UltrasoundImageIO > Superclass;
+  typedef itk::SmartPointer< Self >                                      Pointer;
+  typedef itk::SmartPointer< const Self >                                ConstPointer;
+  typedef std::vector< itk::ImageIORegion >                              RegionContainerType;
+
+  itkNewMacro( Self );
+
+  /** The IO regions read by all the instances, in the order of the reads. */
+  static RegionContainerType & GetReadRegions()
+    {
+    static RegionContainerType readRegions;
+    return readRegions;
+    }
+
+  virtual void Read( void * buffer ) ITK_OVERRIDE
+    {
+    GetReadRegions().push_back( this->GetIORegion() );
+    Superclass::Read( buffer );
+    }
+
+protected:
+  RegionRecordingHDF5ImageIO() {}
+  ~RegionRecordingHDF5ImageIO() {}
+
+private:
+  RegionRecordingHDF5ImageIO( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+};
+
+
+/** Creates a RegionRecordingHDF5ImageIO for the image readers, ahead of the
+ * factory that the module registers. */
+class RegionRecordingHDF5ImageIOFactory: public itk::ObjectFactoryBase
+{
+public:
+  typedef RegionRecordingHDF5ImageIOFactory Self;
+  typedef itk::ObjectFactoryBase            Superclass;
+  typedef itk::SmartPointer< Self >         Pointer;
+  typedef itk::SmartPointer< const Self >   ConstPointer;
+
+  itkFactorylessNewMacro( Self );
+  itkTypeMacro( RegionRecordingHDF5ImageIOFactory, ObjectFactoryBase );
+
+  virtual const char * GetITKSourceVersion() const ITK_OVERRIDE
+    {
+    return ITK_SOURCE_VERSION;
+    }
+
+  virtual const char * GetDescription() const ITK_OVERRIDE
+    {
+    return "ImageIO that records the regions it reads";
+    }
+
+protected:
+  RegionRecordingHDF5ImageIOFactory()
+  {
+    this->RegisterOverride( "itkImageIOBase",
+      "ScanConversionNonFiniteImageIO",
+      "ImageIO that records the regions it reads",
+      1,
+      itk::CreateObjectFunction< RegionRecordingHDF5ImageIO >::New() );
+  }
+  ~RegionRecordingHDF5ImageIOFactory() {}
+
+private:
+  RegionRecordingHDF5ImageIOFactory( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+};
+
+
+/** Convert an HDF5 slice series with the Stream Divisions and check that
+ * each piece of the output only reads the slab of slices it samples, e.g.
+ *
+ *   ScanConvertSliceSeriesStreamedReadTest <input> <output> <stream divisions>
+ *
+ * Every IO region read from the input must have fewer slices than the
+ * input, and there must be a read for more than one piece.
+ */
+int
+ScanConvertSliceSeriesStreamedReadTest( int argc, char * argv[] )
+{
+  if( argc < 4 )
+    {
+    std::cerr << "Usage: " << argv[0] << " input output streamDivisions" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::HDF5UltrasoundImageIO::Pointer informationIO = itk::HDF5UltrasoundImageIO::New();
+  informationIO->SetFileName( argv[1] );
+  informationIO->ReadImageInformation();
+  const itk::SizeValueType numberOfSlices = informationIO->GetDimensions( 2 );
+
+  itk::ObjectFactoryBase::RegisterFactory( RegionRecordingHDF5ImageIOFactory::New(),
+    itk::ObjectFactoryBase::INSERT_AT_FRONT );
+  RegionRecordingHDF5ImageIO::GetReadRegions().clear();
+
+  char outputSpacingFlag[] = "--outputSpacing";
+  char outputSpacing[] = "1.0,1.0,1.0";
+  char streamDivisionsFlag[] = "--streamDivisions";
+  char * moduleArgv[] = { argv[0],
+    outputSpacingFlag,
+    outputSpacing,
+    streamDivisionsFlag,
+    argv[3],
+    argv[1],
+    argv[2] };
+  if( ModuleEntryPoint( static_cast< int >( sizeof( moduleArgv ) / sizeof( moduleArgv[0] ) ), moduleArgv ) != EXIT_SUCCESS )
+    {
+    std::cerr << "The streamed conversion failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const RegionRecordingHDF5ImageIO::RegionContainerType & readRegions = RegionRecordingHDF5ImageIO::GetReadRegions();
+  std::cout << "The input of " << numberOfSlices << " slices was read in " << readRegions.size() << " regions:";
+  int status = EXIT_SUCCESS;
+  for( std::size_t region = 0; region < readRegions.size(); ++region )
+    {
+    const itk::SizeValueType regionSlices = readRegions[region].GetSize( 2 );
+    std::cout << " " << regionSlices;
+    if( regionSlices >= numberOfSlices )
+      {
+      status = EXIT_FAILURE;
+      }
+    }
+  std::cout << std::endl;
+  if( status != EXIT_SUCCESS )
+    {
+    std::cerr << "A piece of the output read all the slices of the input" << std::endl;
+    }
+  if( readRegions.size() < 2 )
+    {
+    std::cerr << "The input was not read one piece of the output at a time" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
+
+
+/** Read an HDF5 slice series with the HDF5UltrasoundImageIO itself, which
+ * keeps its non-finite samples, optionally replaced with zero by an
+ * itk::ReplaceNonFiniteImageFilter. */
+SliceSeriesImageType::Pointer
+ReadNonFiniteSliceSeries( const char * fileName, bool replaceNonFinite )
+{
+  typedef itk::UltrasoundImageFileReader< SliceSeriesImageType > ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( fileName );
+  reader->SetImageIO( itk::HDF5UltrasoundImageIO::New() );
+  if( !replaceNonFinite )
+    {
+    reader->Update();
+    return reader->GetOutput();
+    }
+  typedef itk::ReplaceNonFiniteImageFilter< SliceSeriesImageType > ReplaceNonFiniteFilterType;
+  ReplaceNonFiniteFilterType::Pointer replaceNonFiniteFilter = ReplaceNonFiniteFilterType::New();
+  replaceNonFiniteFilter->SetInput( reader->GetOutput() );
+  replaceNonFiniteFilter->InPlaceOn();
+  replaceNonFiniteFilter->Update();
+  return replaceNonFiniteFilter->GetOutput();
+}
+
+
+/** The grid of the given spacing along the physical axes over the bounding
+ * box of the slices of a slice series. */
+void
+SweepBoundingGrid( const SliceSeriesImageType * inputImage,
+  SplatOutputImageType::SizeType & size,
+  const SplatOutputImageType::SpacingType & spacing,
+  SplatOutputImageType::PointType & origin,
+  SplatOutputImageType::DirectionType & direction )
+{
+  const SliceSeriesImageType::RegionType & region = inputImage->GetLargestPossibleRegion();
+  std::vector< SliceSeriesImageType::PointType > corners;
+  SliceCorners( inputImage, region.GetIndex( 2 ), region.GetIndex( 2 ) + static_cast< itk::IndexValueType >( region.GetSize( 2 ) ), corners );
+  origin.Fill( itk::NumericTraits< double >::max() );
+  SplatOutputImageType::PointType upper( itk::NumericTraits< double >::NonpositiveMin() );
+  for( std::size_t corner = 0; corner < corners.size(); ++corner )
+    {
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      origin[dim] = std::min( origin[dim], corners[corner][dim] );
+      upper[dim] = std::max( upper[dim], corners[corner][dim] );
+      }
+    }
+  direction.SetIdentity();
+  for( unsigned int dim = 0; dim < 3; ++dim )
+    {
+    size[dim] = static_cast< itk::SizeValueType >( ( upper[dim] - origin[dim] ) / spacing[dim] ) + 1;
+    }
+}
+
+
+/** Resample a slice series with non-finite samples with every ITK and VTK
+ * method, once replacing the samples as they are interpolated, with
+ * ScanConversionResamplingOptions::ReplaceNonFinite, and once from the
+ * output of an itk::ReplaceNonFiniteImageFilter, and compare the two, e.g.
+ *
+ *   ScanConvertSliceSeriesNonFiniteMethodsTest <non-finite input>
+ *
+ * The output grid has a spacing of 2 along the physical axes.
+ */
+int
+ScanConvertSliceSeriesNonFiniteMethodsTest( int argc, char * argv[] )
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " nonFiniteInput" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  SliceSeriesImageType::Pointer nonFiniteImage = ReadNonFiniteSliceSeries( argv[1], false );
+  SliceSeriesImageType::Pointer replacedImage = ReadNonFiniteSliceSeries( argv[1], true );
+
+  SplatOutputImageType::SizeType size;
+  SplatOutputImageType::SpacingType spacing( 2.0 );
+  SplatOutputImageType::PointType origin;
+  SplatOutputImageType::DirectionType direction;
+  SweepBoundingGrid( nonFiniteImage, size, spacing, origin, direction );
+
+  const char * methods[] = {
+    "ITKNearestNeighbor",
+    "ITKLinear",
+    "ITKGaussian",
+    "ITKWindowedSinc",
+    "VTKProbeFilter",
+    "VTKGaussianKernel",
+    "VTKLinearKernel",
+    "VTKShepardKernel",
+    "VTKVoronoiKernel"
+  };
+  const double tolerance = 1.0e-4;
+  int status = EXIT_SUCCESS;
+  for( unsigned int methodIndex = 0; methodIndex < sizeof( methods ) / sizeof( methods[0] ); ++methodIndex )
+    {
+    ScanConversionResamplingOptions options;
+    options.SliceSeriesLocator = true;
+    options.ReplaceNonFinite = true;
+    SplatOutputImageType::Pointer output;
+    if( ScanConversionResampling< SliceSeriesImageType, SplatOutputImageType >( nonFiniteImage,
+        output, size, spacing, origin, direction, methods[methodIndex], options, ITK_NULLPTR ) != EXIT_SUCCESS )
+      {
+      std::cerr << methods[methodIndex] << " failed on the non-finite input" << std::endl;
+      return EXIT_FAILURE;
+      }
+    options.ReplaceNonFinite = false;
+    SplatOutputImageType::Pointer reference;
+    if( ScanConversionResampling< SliceSeriesImageType, SplatOutputImageType >( replacedImage,
+        reference, size, spacing, origin, direction, methods[methodIndex], options, ITK_NULLPTR ) != EXIT_SUCCESS )
+      {
+      std::cerr << methods[methodIndex] << " failed on the replaced input" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    itk::ImageRegionConstIterator< SplatOutputImageType > outputIt( output, output->GetLargestPossibleRegion() );
+    itk::ImageRegionConstIterator< SplatOutputImageType > referenceIt( reference, reference->GetLargestPossibleRegion() );
+    itk::SizeValueType differences = 0;
+    for( ; !outputIt.IsAtEnd(); ++outputIt, ++referenceIt )
+      {
+      const double value = outputIt.Get();
+      if( !vnl_math_isfinite( value ) || std::abs( value - referenceIt.Get() ) > tolerance )
+        {
+        ++differences;
+        }
+      }
+    if( differences > 0 )
+      {
+      std::cerr << methods[methodIndex] << " differs from the replaced input at " << differences
+        << " of the " << output->GetLargestPossibleRegion().GetNumberOfPixels() << " voxels" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    else
+      {
+      std::cout << methods[methodIndex] << " matches the replaced input" << std::endl;
+      }
+    }
+  return status;
+}
+
+
+/** Interpolate the output grid with the VTK kernel of a resampling method
+ * from the numberOfPoints closest input samples, found by the kernel itself.
+ * With the adaptive footprint, the samples farther than the larger of the
+ * radius and the local sample spacing of the closest sample, the largest
+ * distance from it to its neighbors on the input grid, are dropped. */
+void
+KernelFootprintReference( vtkStructuredGrid * structuredGrid,
+  const float * inputBuffer,
+  ScanConversionResamplingMethod method,
+  double radius,
+  unsigned int numberOfPoints,
+  bool adaptive,
+  const SplatOutputImageType * grid,
+  std::vector< double > & values )
+{
+  vtkNew< vtkStaticPointLocator > locator;
+  locator->SetDataSet( structuredGrid );
+  locator->BuildLocator();
+  vtkSmartPointer< vtkGeneralizedKernel > kernel;
+  kernel.TakeReference( vtkGeneralizedKernel::SafeDownCast( CreateVTKInterpolationKernel( method, radius ) ) );
+  kernel->SetKernelFootprintToNClosest();
+  kernel->SetNumberOfPoints( static_cast< int >( numberOfPoints ) );
+  kernel->Initialize( locator.GetPointer(), structuredGrid, structuredGrid->GetPointData() );
+
+  int dimensions[3];
+  structuredGrid->GetDimensions( dimensions );
+  const vtkIdType strides[3] = { 1, dimensions[0], static_cast< vtkIdType >( dimensions[0] ) * dimensions[1] };
+
+  vtkNew< vtkIdList > pointIds;
+  vtkNew< vtkDoubleArray > weights;
+  const SplatOutputImageType::RegionType & region = grid->GetLargestPossibleRegion();
+  values.assign( region.GetNumberOfPixels(), 0.0 );
+  itk::ImageRegionConstIteratorWithIndex< SplatOutputImageType > gridIt( grid, region );
+  for( std::size_t voxel = 0; !gridIt.IsAtEnd(); ++gridIt, ++voxel )
+    {
+    SplatOutputImageType::PointType gridPoint;
+    grid->TransformIndexToPhysicalPoint( gridIt.GetIndex(), gridPoint );
+    double point[3] = { gridPoint[0], gridPoint[1], gridPoint[2] };
+    if( kernel->ComputeBasis( point, pointIds.GetPointer() ) == 0 )
+      {
+      continue;
+      }
+    if( adaptive )
+      {
+      // The local sample spacing of the closest sample
+      const vtkIdType closestId = pointIds->GetId( 0 );
+      const int indices[3] = {
+        static_cast< int >( closestId % strides[1] ),
+        static_cast< int >( ( closestId / strides[1] ) % dimensions[1] ),
+        static_cast< int >( closestId / strides[2] ) };
+      double closestPoint[3];
+      double neighborPoint[3];
+      structuredGrid->GetPoint( closestId, closestPoint );
+      double maximumDistance2 = radius * radius;
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        for( int step = -1; step <= 1; step += 2 )
+          {
+          if( indices[dim] + step >= 0 && indices[dim] + step < dimensions[dim] )
+            {
+            structuredGrid->GetPoint( closestId + step * strides[dim], neighborPoint );
+            maximumDistance2 = std::max( maximumDistance2, vtkMath::Distance2BetweenPoints( closestPoint, neighborPoint ) );
+            }
+          }
+        }
+      vtkIdType numberOfIds = 0;
+      while( numberOfIds < pointIds->GetNumberOfIds() )
+        {
+        structuredGrid->GetPoint( pointIds->GetId( numberOfIds ), neighborPoint );
+        if( vtkMath::Distance2BetweenPoints( point, neighborPoint ) > maximumDistance2 )
+          {
+          break;
+          }
+        ++numberOfIds;
+        }
+      pointIds->SetNumberOfIds( numberOfIds );
+      if( numberOfIds == 0 )
+        {
+        continue;
+        }
+      }
+    const vtkIdType numberOfWeights = kernel->ComputeWeights( point, pointIds.GetPointer(), weights.GetPointer() );
+    for( vtkIdType weightIndex = 0; weightIndex < numberOfWeights; ++weightIndex )
+      {
+      values[voxel] += weights->GetValue( weightIndex ) * inputBuffer[pointIds->GetId( weightIndex )];
+      }
+    }
+}
+
+
+/** Compare the NClosest and the Adaptive kernel footprints of the VTK
+ * Gaussian, Linear, and Shepard kernels with the footprints computed by the
+ * kernels themselves, e.g.
+ *
+ *   ScanConvertSliceSeriesKernelFootprintTest <input>
+ *
+ * The output grid has a spacing of 2 along the physical axes.
+ */
+int
+ScanConvertSliceSeriesKernelFootprintTest( int argc, char * argv[] )
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " input" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  typedef itk::UltrasoundImageFileReader< SliceSeriesImageType > ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[1] );
+  reader->SetImageIO( itk::HDF5UltrasoundImageIO::New() );
+  reader->Update();
+  SliceSeriesImageType::Pointer inputImage = reader->GetOutput();
+
+  SplatOutputImageType::SizeType size;
+  SplatOutputImageType::SpacingType spacing( 2.0 );
+  SplatOutputImageType::PointType origin;
+  SplatOutputImageType::DirectionType direction;
+  SweepBoundingGrid( inputImage, size, spacing, origin, direction );
+  SplatOutputImageType::Pointer grid = SplatOutputImageType::New();
+  grid->SetRegions( size );
+  grid->SetSpacing( spacing );
+  grid->SetOrigin( origin );
+  grid->SetDirection( direction );
+
+  typedef itk::SpecialCoordinatesImageToVTKStructuredGridFilter< SliceSeriesImageType > ConversionFilterType;
+  ConversionFilterType::Pointer conversionFilter = ConversionFilterType::New();
+  conversionFilter->SetInput( inputImage );
+  conversionFilter->Update();
+  vtkSmartPointer< vtkStructuredGrid > structuredGrid = vtkSmartPointer< vtkStructuredGrid >::New();
+  structuredGrid->ShallowCopy( conversionFilter->GetOutput() );
+  structuredGrid->GetPointData()->Initialize();
+
+  // The radius of the kernels of the resampler, 2.1 times the largest output
+  // spacing
+  const double radius = 2.1 * spacing[0];
+  const unsigned int numberOfPoints = 8;
+  const char * methods[] = { "VTKGaussianKernel", "VTKLinearKernel", "VTKShepardKernel" };
+  const ScanConversionResamplingOptions::KernelFootprintType footprints[] = {
+    ScanConversionResamplingOptions::N_CLOSEST_FOOTPRINT,
+    ScanConversionResamplingOptions::ADAPTIVE_FOOTPRINT };
+  const char * footprintNames[] = { "NClosest", "Adaptive" };
+  int status = EXIT_SUCCESS;
+  for( unsigned int methodIndex = 0; methodIndex < 3; ++methodIndex )
+    {
+    for( unsigned int footprintIndex = 0; footprintIndex < 2; ++footprintIndex )
+      {
+      ScanConversionResamplingOptions options;
+      options.KernelFootprint = footprints[footprintIndex];
+      options.KernelNumberOfPoints = numberOfPoints;
+      SplatOutputImageType::Pointer output;
+      if( ScanConversionResampling< SliceSeriesImageType, SplatOutputImageType >( inputImage,
+          output, size, spacing, origin, direction, methods[methodIndex], options, ITK_NULLPTR ) != EXIT_SUCCESS )
+        {
+        std::cerr << methods[methodIndex] << " failed with the " << footprintNames[footprintIndex] << " footprint" << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      std::vector< double > reference;
+      KernelFootprintReference( structuredGrid, inputImage->GetBufferPointer(),
+        ScanConversionResamplingMethodFromString( methods[methodIndex] ), radius, numberOfPoints,
+        footprints[footprintIndex] == ScanConversionResamplingOptions::ADAPTIVE_FOOTPRINT, grid, reference );
+
+      // The weights of the neighbor lists are stored in single precision
+      itk::ImageRegionConstIterator< SplatOutputImageType > outputIt( output, output->GetLargestPossibleRegion() );
+      itk::SizeValueType differences = 0;
+      for( std::size_t voxel = 0; !outputIt.IsAtEnd(); ++outputIt, ++voxel )
+        {
+        if( std::abs( outputIt.Get() - reference[voxel] ) > 1.0e-3 * std::max( 1.0, std::abs( reference[voxel] ) ) )
+          {
+          ++differences;
+          }
+        }
+      if( differences > 0 )
+        {
+        std::cerr << methods[methodIndex] << " with the " << footprintNames[footprintIndex]
+          << " footprint differs from the kernel at " << differences << " voxels" << std::endl;
+        status = EXIT_FAILURE;
+        }
+      }
+    }
+  return status;
+}
+
+
+/** A sweep of 40 by 30 sample slices, translated along the normal of the
+ * slices for a parallel sweep, or rotated about an axis beside the slices
+ * for a fan sweep. */
+template< typename TPixel >
+typename itk::SliceSeriesSpecialCoordinatesImage< itk::Image< TPixel, 2 >, SliceTransformType, TPixel, 3 >::Pointer
+LocatorTestSweep( bool fan )
+{
+  typedef itk::Image< TPixel, 2 >                                                               SweepSliceImageType;
+  typedef itk::SliceSeriesSpecialCoordinatesImage< SweepSliceImageType, SliceTransformType, TPixel, 3 > SweepImageType;
+
+  typename SweepSliceImageType::Pointer sliceImage = SweepSliceImageType::New();
+  typename SweepSliceImageType::SizeType sliceSize;
+  sliceSize[0] = 40;
+  sliceSize[1] = 30;
+  typename SweepSliceImageType::RegionType sliceRegion( sliceSize );
+  sliceImage->SetRegions( sliceRegion );
+  typename SweepSliceImageType::SpacingType sliceSpacing;
+  sliceSpacing[0] = 0.5;
+  sliceSpacing[1] = 0.3;
+  sliceImage->SetSpacing( sliceSpacing );
+  typename SweepSliceImageType::PointType sliceOrigin;
+  sliceOrigin[0] = -10.0;
+  sliceOrigin[1] = 2.0;
+  sliceImage->SetOrigin( sliceOrigin );
+
+  const itk::SizeValueType numberOfSlices = 24;
+  typename SweepImageType::Pointer image = SweepImageType::New();
+  image->SetSliceImage( sliceImage );
+  typename SweepImageType::SizeType size;
+  size[0] = sliceSize[0];
+  size[1] = sliceSize[1];
+  size[2] = numberOfSlices;
+  typename SweepImageType::RegionType region( size );
+  image->SetRegions( region );
+  for( itk::SizeValueType slice = 0; slice < numberOfSlices; ++slice )
+    {
+    SliceTransformType::Pointer transform = SliceTransformType::New();
+    const double offset = static_cast< double >( slice ) - 0.5 * ( numberOfSlices - 1.0 );
+    if( fan )
+      {
+      // The slices share the rotation axis, below their first row
+      SliceTransformType::InputPointType center;
+      center[0] = 0.0;
+      center[1] = 0.0;
+      center[2] = 0.0;
+      transform->SetCenter( center );
+      transform->SetRotation( 0.03 * offset, 0.0, 0.0 );
+      }
+    else
+      {
+      SliceTransformType::OutputVectorType translation;
+      translation[0] = 0.0;
+      translation[1] = 0.0;
+      translation[2] = 0.4 * offset;
+      transform->SetTranslation( translation );
+      }
+    image->SetSliceTransform( static_cast< itk::IndexValueType >( slice ), transform );
+    }
+  return image;
+}
+
+
+/** Compare the continuous indices of the ScanConversionSliceSeriesLocator
+ * with the mapping of the image for random points inside the sweep. */
+int
+CompareLocatorWithImageMapping( bool fan )
+{
+  const char * sweep = fan ? "fan" : "parallel";
+  SliceSeriesImageType::Pointer image = LocatorTestSweep< float >( fan );
+  SliceSeriesLocatorType locator;
+  if( !locator.Initialize( image ) )
+    {
+    std::cerr << "The locator of the " << sweep << " sweep is not valid" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const SliceSeriesImageType::RegionType & region = image->GetLargestPossibleRegion();
+  std::vector< SliceSeriesImageType::PointType > corners;
+  SliceCorners( image, region.GetIndex( 2 ), region.GetIndex( 2 ) + static_cast< itk::IndexValueType >( region.GetSize( 2 ) ), corners );
+  SliceSeriesImageType::PointType lower( itk::NumericTraits< double >::max() );
+  SliceSeriesImageType::PointType upper( itk::NumericTraits< double >::NonpositiveMin() );
+  for( std::size_t corner = 0; corner < corners.size(); ++corner )
+    {
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      lower[dim] = std::min( lower[dim], corners[corner][dim] );
+      upper[dim] = std::max( upper[dim], corners[corner][dim] );
+      }
+    }
+
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->Initialize( 8342 );
+  const unsigned int numberOfPoints = 10000;
+  const double tolerance = 1.0e-4;
+  unsigned int inside = 0;
+  for( unsigned int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex )
+    {
+    SliceSeriesImageType::PointType point;
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      point[dim] = lower[dim] + generator->GetUniformVariate( 0.0, 1.0 ) * ( upper[dim] - lower[dim] );
+      }
+    itk::ContinuousIndex< double, 3 > imageIndex;
+    if( !image->TransformPhysicalPointToContinuousIndex( point, imageIndex ) )
+      {
+      continue;
+      }
+    ++inside;
+    itk::ContinuousIndex< double, 3 > locatorIndex;
+    locator.TransformPhysicalPointToContinuousIndex( point, locatorIndex );
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      if( std::abs( locatorIndex[dim] - imageIndex[dim] ) > tolerance )
+        {
+        std::cerr << "The locator of the " << sweep << " sweep maps " << point
+          << " to " << locatorIndex << " instead of " << imageIndex << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    }
+  // The sweep fills a good part of its bounding box
+  if( inside < numberOfPoints / 10 )
+    {
+    std::cerr << "Only " << inside << " of the " << numberOfPoints << " points are inside the "
+      << sweep << " sweep" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << inside << " points inside the " << sweep << " sweep match the image mapping" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+
+/** Check the ScanConversionSliceSeriesLocator against the mapping of the
+ * slice series image over random points of a parallel and a fan sweep, e.g.
+ *
+ *   ScanConvertSliceSeriesLocatorTest
+ */
+int
+ScanConvertSliceSeriesLocatorTest( int, char * [] )
+{
+  if( CompareLocatorWithImageMapping( false ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return CompareLocatorWithImageMapping( true );
+}
+
+
+/** Fill a test sweep with a ramp of integer samples from zero, which
+ * reaches the top of the 8-bit range halfway across each slice. */
+template< typename TImage >
+void
+FillUCharTestSweep( TImage * image )
+{
+  image->Allocate();
+  itk::ImageRegionIteratorWithIndex< TImage > imageIt( image, image->GetLargestPossibleRegion() );
+  for( ; !imageIt.IsAtEnd(); ++imageIt )
+    {
+    const typename TImage::IndexType & index = imageIt.GetIndex();
+    const itk::IndexValueType value = 13 * index[0] + 3 * index[1] + 2 * index[2];
+    imageIt.Set( static_cast< typename TImage::PixelType >( std::min( value, static_cast< itk::IndexValueType >( 255 ) ) ) );
+    }
+}
+
+
+/** Scan convert an 8-bit slice series in its own pixel type with the ITK and
+ * VTK methods, e.g.
+ *
+ *   ScanConvertSliceSeriesUCharTest
+ *
+ * The weighted sums of the VTK kernels saturate at the 8-bit range instead
+ * of wrapping around, and every output is the float output of the same
+ * samples, truncated, within one gray level.
+ */
+int
+ScanConvertSliceSeriesUCharTest( int, char * [] )
+{
+  typedef itk::SliceSeriesSpecialCoordinatesImage< itk::Image< unsigned char, 2 >, SliceTransformType, unsigned char, 3 >
+    UCharSliceSeriesImageType;
+  typedef itk::Image< unsigned char, 3 > UCharOutputImageType;
+
+  // The sums that round past the range of the pixel type saturate
+  const double unsignedCharValues[] = { -300.0, -0.5, 0.0, 127.7, 255.0, 255.9, 256.5, 1000.0 };
+  const unsigned char unsignedCharExpected[] = { 0, 0, 0, 127, 255, 255, 255, 255 };
+  for( unsigned int ii = 0; ii < sizeof( unsignedCharValues ) / sizeof( unsignedCharValues[0] ); ++ii )
+    {
+    const unsigned char saturated = SaturateVTKKernelValue< unsigned char >( unsignedCharValues[ii] );
+    if( saturated != unsignedCharExpected[ii] )
+      {
+      std::cerr << "The weighted sum " << unsignedCharValues[ii] << " saturates to "
+        << static_cast< int >( saturated ) << " instead of " << static_cast< int >( unsignedCharExpected[ii] ) << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  if( SaturateVTKKernelValue< short >( 40000.0 ) != 32767 || SaturateVTKKernelValue< short >( -40000.0 ) != -32768 )
+    {
+    std::cerr << "The weighted sums past the range of short do not saturate" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  UCharSliceSeriesImageType::Pointer ucharImage = LocatorTestSweep< unsigned char >( true );
+  FillUCharTestSweep( ucharImage.GetPointer() );
+  SliceSeriesImageType::Pointer floatImage = LocatorTestSweep< float >( true );
+  FillUCharTestSweep( floatImage.GetPointer() );
+
+  SplatOutputImageType::SizeType size;
+  SplatOutputImageType::SpacingType spacing( 0.5 );
+  SplatOutputImageType::PointType origin;
+  SplatOutputImageType::DirectionType direction;
+  SweepBoundingGrid( floatImage, size, spacing, origin, direction );
+
+  const char * methods[] = { "ITKLinear", "ITKWindowedSinc", "VTKProbeFilter", "VTKGaussianKernel",
+    "VTKLinearKernel", "VTKShepardKernel", "VTKVoronoiKernel" };
+  const unsigned int numberOfMethods = sizeof( methods ) / sizeof( methods[0] );
+  int status = EXIT_SUCCESS;
+  for( unsigned int methodIndex = 0; methodIndex < numberOfMethods; ++methodIndex )
+    {
+    ScanConversionResamplingOptions options;
+    UCharOutputImageType::Pointer ucharOutput;
+    SplatOutputImageType::Pointer floatOutput;
+    if( ScanConversionResampling< UCharSliceSeriesImageType, UCharOutputImageType >( ucharImage,
+        ucharOutput, size, spacing, origin, direction, methods[methodIndex], options, ITK_NULLPTR ) != EXIT_SUCCESS
+      || ScanConversionResampling< SliceSeriesImageType, SplatOutputImageType >( floatImage,
+        floatOutput, size, spacing, origin, direction, methods[methodIndex], options, ITK_NULLPTR ) != EXIT_SUCCESS )
+      {
+      std::cerr << methods[methodIndex] << " failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    itk::ImageRegionConstIterator< UCharOutputImageType > ucharIt( ucharOutput, ucharOutput->GetLargestPossibleRegion() );
+    itk::ImageRegionConstIterator< SplatOutputImageType > floatIt( floatOutput, floatOutput->GetLargestPossibleRegion() );
+    itk::SizeValueType differences = 0;
+    itk::SizeValueType saturated = 0;
+    for( ; !ucharIt.IsAtEnd(); ++ucharIt, ++floatIt )
+      {
+      const double expected = SaturateVTKKernelValue< unsigned char >( floatIt.Get() );
+      if( std::abs( static_cast< double >( ucharIt.Get() ) - expected ) > 1.0 )
+        {
+        ++differences;
+        }
+      if( ucharIt.Get() == 255 )
+        {
+        ++saturated;
+        }
+      }
+    if( differences > 0 )
+      {
+      std::cerr << "The 8-bit output of " << methods[methodIndex] << " differs from the float output at "
+        << differences << " voxels" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    // The top of the range is reached, so the saturation is exercised
+    if( saturated == 0 )
+      {
+      std::cerr << "No 8-bit output voxel of " << methods[methodIndex] << " is at the top of the range" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+  return status;
+}
+
+}
+
 void RegisterTests()
 {
   StringToTestFunctionMap["ModuleEntryPoint"] = ModuleEntryPoint;
+  RegisterScanConversionTests();
+  StringToTestFunctionMap["ScanConvertSliceSeriesIncrementalTest"] = ScanConvertSliceSeriesIncrementalTest;
+  StringToTestFunctionMap["ScanConvertSliceSeriesLocatorTest"] = ScanConvertSliceSeriesLocatorTest;
+  StringToTestFunctionMap["ScanConvertSliceSeriesWriteNonFiniteInput"] = ScanConvertSliceSeriesWriteNonFiniteInput;
+  StringToTestFunctionMap["ScanConvertSliceSeriesNonFiniteMethodsTest"] = ScanConvertSliceSeriesNonFiniteMethodsTest;
+  StringToTestFunctionMap["ScanConvertSliceSeriesStreamedReadTest"] = ScanConvertSliceSeriesStreamedReadTest;
+  StringToTestFunctionMap["ScanConvertSliceSeriesKernelFootprintTest"] = ScanConvertSliceSeriesKernelFootprintTest;
+  StringToTestFunctionMap["ScanConvertSliceSeriesUCharTest"] = ScanConvertSliceSeriesUCharTest;
 }
@@ -0,0 +1,272 @@
+#!/usr/bin/env python
+
+"""Scan convert a dataset of phased array volumes over distributed workers.
+
+The dataset is partitioned into work items, one per input volume and output
+slab. With ``--slabs N``, each output is split into N slabs along its last
+axis with the ``--outputSlab`` option of ScanConvertPhasedArray3D, so a
+volume too large for one node is converted by several workers. The items are
+sorted by slab, then by volume, and each worker converts a contiguous block
+of them, so the work of the workers differs by at most one item and each
+worker uses the geometry of few slabs.
+
+The workers share one precomputed geometry table per slab, the
+``--lookupTable`` of the module, since each slab is a different output grid.
+The first run that needs a table builds it and renames it into place once it
+is written, and the other runs read it.
+
+The outputs form a chunked store in the output directory: slab K of the
+output of a volume named frame is written to frame/slabK.mha, with the origin
+of the slab in the whole output, or to frame.mha when there is one slab. The
+frame is the path of the volume relative to the deepest directory that
+contains all the inputs, without its extensions, so a/vol0001.mha and
+b/vol0001.mha are the frames a/vol0001 and b/vol0001. Inputs with the same
+frame, e.g. vol0001.mha and vol0001.nrrd, are an error.
+Worker 0 writes a store.json that lists the chunks of each volume. A chunk
+is written under a temporary name and renamed once the module succeeds, so
+the extension must be a single file format such as .mha or .nrrd. Existing
+chunks are skipped, so an interrupted job is resumed by running it again.
+
+The rank of the worker and the number of workers are given with ``--rank``
+and ``--workers``, or read from the environment of the MPI launchers and of
+SLURM, so ``mpirun -n 16`` or a SLURM job with 16 tasks starts 16 workers
+without a Python MPI module. The arguments after ``--`` are passed to every
+run of the module, e.g. the geometry, the output grid, and the method.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import threading
+import time
+
+
+# Rank and number of workers set by the launchers, in order of precedence
+WORKER_ENVIRONMENT = [
+    ('OMPI_COMM_WORLD_RANK', 'OMPI_COMM_WORLD_SIZE'),
+    ('PMI_RANK', 'PMI_SIZE'),
+    ('SLURM_ARRAY_TASK_ID', 'SLURM_ARRAY_TASK_COUNT'),
+    ('SLURM_PROCID', 'SLURM_NTASKS'),
+    ]
+
+
+def worker_environment():
+    """Rank and number of workers from the environment of the launcher."""
+    for rank_variable, size_variable in WORKER_ENVIRONMENT:
+        if rank_variable in os.environ and size_variable in os.environ:
+            rank = int(os.environ[rank_variable])
+            if rank_variable == 'SLURM_ARRAY_TASK_ID':
+                rank -= int(os.environ.get('SLURM_ARRAY_TASK_MIN', '0'))
+            return rank, int(os.environ[size_variable])
+    return 0, 1
+
+
+def input_root(inputs):
+    """Deepest directory that contains all the inputs."""
+    directories = [os.path.dirname(os.path.abspath(input_file)).split(os.sep) for input_file in inputs]
+    root = os.path.commonprefix(directories)
+    return os.sep.join(root) or os.sep
+
+
+def frame_name(input_file, root):
+    """Path of an input volume relative to the root without its extensions."""
+    name = os.path.relpath(os.path.abspath(input_file), root)
+    if name.endswith('.gz'):
+        name = name[:-len('.gz')]
+    return os.path.splitext(name)[0]
+
+
+def frame_collisions(inputs, root):
+    """Inputs whose frame is the frame of an earlier input."""
+    frames = {}
+    collisions = []
+    for input_file in inputs:
+        name = os.path.normcase(frame_name(input_file, root))
+        if name in frames:
+            collisions.append((frames[name], input_file))
+        else:
+            frames[name] = input_file
+    return collisions
+
+
+def chunk_file_name(input_file, root, slab, slabs, extension):
+    """Output of a slab of an input volume, relative to the store."""
+    name = frame_name(input_file, root)
+    if slabs == 1:
+        return name + extension
+    return os.path.join(name, 'slab{0}{1}'.format(slab, extension))
+
+
+def lookup_table_file_name(lookup_table, slab, slabs):
+    """Geometry table of a slab."""
+    if not lookup_table or slabs == 1:
+        return lookup_table
+    root, extension = os.path.splitext(lookup_table)
+    return '{0}_slab{1}{2}'.format(root, slab, extension)
+
+
+def work_items(inputs, slabs):
+    """Items of the dataset, by slab then by volume."""
+    return [(input_file, slab) for slab in range(slabs) for input_file in inputs]
+
+
+def worker_items(items, rank, workers):
+    """Contiguous block of the items of a worker."""
+    begin = len(items) * rank // workers
+    end = len(items) * (rank + 1) // workers
+    return items[begin:end]
+
+
+def make_directory(directory):
+    """Create a directory that other workers may create at the same time."""
+    try:
+        os.makedirs(directory)
+    except OSError:
+        if not os.path.isdir(directory):
+            raise
+
+
+def write_store(file_name, inputs, root, slabs, extension):
+    """Write the list of the chunks of each volume of the store."""
+    frames = []
+    for input_file in inputs:
+        frames.append({
+            'input': input_file,
+            'chunks': [chunk_file_name(input_file, root, slab, slabs, extension) for slab in range(slabs)],
+            })
+    store = {
+        'slabs': slabs,
+        'slabAxis': 2,
+        'frames': frames,
+        }
+    with open(file_name, 'w') as store_json:
+        json.dump(store, store_json, indent=2)
+
+
+def convert(command, item, output_file, lookup_table, slabs):
+    """Run the module on an item. Returns the exit status."""
+    input_file, slab = item
+    root, extension = os.path.splitext(output_file)
+    partial_file = root + '.partial' + extension
+    arguments = command + ['--outputSlab', '{0},{1}'.format(slab, slabs)]
+    if lookup_table:
+        arguments += ['--lookupTable', lookup_table_file_name(lookup_table, slab, slabs)]
+    arguments += [input_file, partial_file]
+    with open(os.devnull, 'w') as devnull:
+        status = subprocess.call(arguments, stdout=devnull)
+    if status == 0 and os.path.exists(partial_file):
+        if os.path.exists(output_file):
+            os.remove(output_file)
+        os.rename(partial_file, output_file)
+        return 0
+    if os.path.exists(partial_file):
+        os.remove(partial_file)
+    return status if status != 0 else 1
+
+
+def main():
+    if '--' in sys.argv:
+        separator = sys.argv.index('--')
+        driver_arguments = sys.argv[1:separator]
+        module_arguments = sys.argv[separator + 1:]
+    else:
+        driver_arguments = sys.argv[1:]
+        module_arguments = []
+
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        fromfile_prefix_chars='@')
+    parser.add_argument('inputs', nargs='+',
+        help='Input volumes. @file reads the inputs from file, one per line.')
+    parser.add_argument('--module', required=True,
+        help='ScanConvertPhasedArray3D executable.')
+    parser.add_argument('--launcher', default='',
+        help='Semicolon separated command that launches the module, e.g. the SEM_LAUNCH_COMMAND.')
+    parser.add_argument('--output-directory', required=True,
+        help='Directory of the chunked output store.')
+    parser.add_argument('--output-extension', default='.mha',
+        help='Extension of the chunks.')
+    parser.add_argument('--slabs', type=int, default=1,
+        help='Number of slabs of each output along its last axis.')
+    parser.add_argument('--lookup-table', default='',
+        help='Geometry table shared by the workers. The table of slab K of N is named with a _slabK suffix.')
+    parser.add_argument('--rank', type=int, default=None,
+        help='Rank of this worker. Defaults to the rank of the MPI or SLURM launcher.')
+    parser.add_argument('--workers', type=int, default=None,
+        help='Number of workers. Defaults to the number of tasks of the MPI or SLURM launcher.')
+    parser.add_argument('--jobs', type=int, default=1,
+        help='Number of items the worker converts at the same time.')
+    parser.add_argument('--overwrite', action='store_true',
+        help='Convert the items whose chunk already exists.')
+    args = parser.parse_args(driver_arguments)
+
+    rank, workers = worker_environment()
+    if args.rank is not None:
+        rank = args.rank
+    if args.workers is not None:
+        workers = args.workers
+    if workers < 1 or rank < 0 or rank >= workers:
+        parser.error('the rank must be in [0, workers)')
+    if args.slabs < 1:
+        parser.error('the number of slabs must be positive')
+    root = input_root(args.inputs)
+    collisions = frame_collisions(args.inputs, root)
+    if collisions:
+        parser.error('the inputs {0} and {1} would be written to the same chunks'.format(*collisions[0]))
+
+    make_directory(args.output_directory)
+    if rank == 0:
+        write_store(os.path.join(args.output_directory, 'store.json'),
+            args.inputs, root, args.slabs, args.output_extension)
+
+    launcher = [arg for arg in args.launcher.split(';') if arg]
+    command = launcher + [args.module] + module_arguments
+    items = worker_items(work_items(args.inputs, args.slabs), rank, workers)
+
+    pending = []
+    for item in items:
+        output_file = os.path.join(args.output_directory,
+            chunk_file_name(item[0], root, item[1], args.slabs, args.output_extension))
+        if args.overwrite or not os.path.exists(output_file):
+            pending.append((item, output_file))
+
+    lock = threading.Lock()
+    failures = []
+    start = time.time()
+
+    def run_items():
+        while True:
+            with lock:
+                if not pending:
+                    return
+                item, output_file = pending.pop(0)
+            make_directory(os.path.dirname(output_file))
+            status = convert(command, item, output_file, args.lookup_table, args.slabs)
+            with lock:
+                if status != 0:
+                    failures.append(item)
+                    print('Worker {0}: failed to convert slab {1} of {2}'.format(rank, item[1], item[0]))
+                else:
+                    print('Worker {0}: converted slab {1} of {2}'.format(rank, item[1], item[0]))
+                sys.stdout.flush()
+
+    number_of_items = len(pending)
+    threads = [threading.Thread(target=run_items) for job in range(max(args.jobs, 1))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    elapsed = time.time() - start
+    print('Worker {0} of {1}: converted {2} of {3} items in {4:.1f} s, {5:.3g} items/s, {6} failed'.format(
+        rank, workers, number_of_items - len(failures), len(items), elapsed,
+        (number_of_items - len(failures)) / max(elapsed, 1e-9), len(failures)))
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,288 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionCurvilinearFastLinear_h
+#define ScanConversionCurvilinearFastLinear_h
+
+#include "itkImage.h"
+#include "itkMath.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+
+#include "ScanConversionGeometry.h"
+#include "ScanConversionProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+/** Shared state of the threads of CurvilinearArrayFastLinearResampling. */
+template< typename TInputImage, typename TOutputImage >
+struct CurvilinearArrayFastLinearData
+{
+  const TInputImage * InputImage;
+  TOutputImage *      OutputImage;
+  double              Apex[2];
+};
+
+
+/** Bilinear interpolation in the plane of the fan and linear interpolation
+ * along the elevation, one output row at a time.
+ *
+ * The polar mapping of a row is computed in separate loops over contiguous
+ * arrays without branches, so the compiler can vectorize the square roots,
+ * arc tangents, and index arithmetic. The result matches ITKLinear: samples
+ * outside the input buffer, as defined by itk::ImageFunction::IsInsideBuffer,
+ * get the default value of zero, and neighbors beyond the boundary take the
+ * value of the boundary sample. */
+template< typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+CurvilinearArrayFastLinearThread( void * arg )
+{
+  typedef TInputImage                          InputImageType;
+  typedef TOutputImage                         OutputImageType;
+  typedef typename InputImageType::PixelType   InputPixelType;
+  typedef typename OutputImageType::PixelType  OutputPixelType;
+  typedef CurvilinearArrayFastLinearData< InputImageType, OutputImageType > DataType;
+
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+  const DataType * data = static_cast< const DataType * >( threadInfo->UserData );
+  const InputImageType * inputImage = data->InputImage;
+  OutputImageType * outputImage = data->OutputImage;
+
+  const typename InputImageType::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const typename InputImageType::SizeType & inputSize = inputRegion.GetSize();
+  const InputPixelType * inputBuffer = inputImage->GetBufferPointer();
+  const itk::OffsetValueType radiusStride = 1;
+  const itk::OffsetValueType lateralStride = inputSize[0];
+  const itk::OffsetValueType elevationStride = inputSize[0] * inputSize[1];
+
+  const double radiusScale = 1.0 / inputImage->GetRadiusSampleSize();
+  const double radiusOffset = -inputImage->GetFirstSampleDistance() * radiusScale;
+  const double lateralScale = 1.0 / inputImage->GetLateralAngularSeparation();
+  const double lateralOffset = ( inputSize[1] - 1 ) / 2.0;
+
+  const typename OutputImageType::RegionType & outputRegion = outputImage->GetLargestPossibleRegion();
+  const typename OutputImageType::SizeType & outputSize = outputRegion.GetSize();
+  const typename OutputImageType::SpacingType & outputSpacing = outputImage->GetSpacing();
+  const typename OutputImageType::PointType & outputOrigin = outputImage->GetOrigin();
+  OutputPixelType * outputBuffer = outputImage->GetBufferPointer();
+
+  const double minOutputValue = itk::NumericTraits< OutputPixelType >::NonpositiveMin();
+  const double maxOutputValue = itk::NumericTraits< OutputPixelType >::max();
+
+  const itk::SizeValueType rowLength = outputSize[0];
+  const itk::SizeValueType numberOfRows = outputSize[1] * outputSize[2];
+  const itk::SizeValueType firstRow = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  const itk::SizeValueType endRow = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+
+  // Lateral coordinate relative to the apex, shared by all rows
+  std::vector< double > lateral( rowLength );
+  for( itk::SizeValueType ii = 0; ii < rowLength; ++ii )
+    {
+    lateral[ii] = outputOrigin[0] + ii * outputSpacing[0] - data->Apex[0];
+    }
+  std::vector< double > radiusIndex( rowLength );
+  std::vector< double > lateralIndex( rowLength );
+
+  typename OutputImageType::IndexType rowIndex;
+  rowIndex[0] = outputRegion.GetIndex( 0 );
+  typename OutputImageType::PointType rowPoint;
+  itk::ContinuousIndex< double, 3 > rowInputIndex;
+  for( itk::SizeValueType row = firstRow; row < endRow; ++row )
+    {
+    rowIndex[1] = outputRegion.GetIndex( 1 ) + row % outputSize[1];
+    rowIndex[2] = outputRegion.GetIndex( 2 ) + row / outputSize[1];
+    OutputPixelType * outputRow = outputBuffer + row * rowLength;
+
+    // The elevation index is constant along the row
+    outputImage->TransformIndexToPhysicalPoint( rowIndex, rowPoint );
+    inputImage->TransformPhysicalPointToContinuousIndex( rowPoint, rowInputIndex );
+    const double elevation = rowInputIndex[2] - inputRegion.GetIndex( 2 );
+    if( !( elevation >= -0.5 && elevation < inputSize[2] - 0.5 ) )
+      {
+      for( itk::SizeValueType ii = 0; ii < rowLength; ++ii )
+        {
+        outputRow[ii] = itk::NumericTraits< OutputPixelType >::ZeroValue();
+        }
+      continue;
+      }
+    itk::OffsetValueType elevationBase = itk::Math::Floor< itk::OffsetValueType >( elevation );
+    double elevationFraction = elevation - elevationBase;
+    if( inputSize[2] == 1 || elevationBase < 0 )
+      {
+      elevationBase = 0;
+      elevationFraction = 0.0;
+      }
+    else if( elevationBase >= static_cast< itk::OffsetValueType >( inputSize[2] ) - 1 )
+      {
+      elevationBase = inputSize[2] - 2;
+      elevationFraction = 1.0;
+      }
+    const itk::OffsetValueType elevationNext = inputSize[2] == 1 ? 0 : elevationStride;
+
+    // Polar mapping of the row
+    const double depth = rowPoint[1] - data->Apex[1];
+    const double depthSquared = depth * depth;
+    const double inverseDepth = 1.0 / depth;
+    for( itk::SizeValueType ii = 0; ii < rowLength; ++ii )
+      {
+      radiusIndex[ii] = std::sqrt( lateral[ii] * lateral[ii] + depthSquared ) * radiusScale + radiusOffset;
+      }
+    for( itk::SizeValueType ii = 0; ii < rowLength; ++ii )
+      {
+      lateralIndex[ii] = std::atan( lateral[ii] * inverseDepth ) * lateralScale + lateralOffset;
+      }
+
+    // Gather and interpolate
+    for( itk::SizeValueType ii = 0; ii < rowLength; ++ii )
+      {
+      const double radius = radiusIndex[ii];
+      const double angle = lateralIndex[ii];
+      if( !( radius >= -0.5 && radius < inputSize[0] - 0.5 && angle >= -0.5 && angle < inputSize[1] - 0.5 ) )
+        {
+        outputRow[ii] = itk::NumericTraits< OutputPixelType >::ZeroValue();
+        continue;
+        }
+
+      itk::OffsetValueType radiusBase = itk::Math::Floor< itk::OffsetValueType >( radius );
+      double radiusFraction = radius - radiusBase;
+      if( inputSize[0] == 1 || radiusBase < 0 )
+        {
+        radiusBase = 0;
+        radiusFraction = 0.0;
+        }
+      else if( radiusBase >= static_cast< itk::OffsetValueType >( inputSize[0] ) - 1 )
+        {
+        radiusBase = inputSize[0] - 2;
+        radiusFraction = 1.0;
+        }
+      itk::OffsetValueType lateralBase = itk::Math::Floor< itk::OffsetValueType >( angle );
+      double lateralFraction = angle - lateralBase;
+      if( inputSize[1] == 1 || lateralBase < 0 )
+        {
+        lateralBase = 0;
+        lateralFraction = 0.0;
+        }
+      else if( lateralBase >= static_cast< itk::OffsetValueType >( inputSize[1] ) - 1 )
+        {
+        lateralBase = inputSize[1] - 2;
+        lateralFraction = 1.0;
+        }
+      const itk::OffsetValueType radiusNext = inputSize[0] == 1 ? 0 : radiusStride;
+      const itk::OffsetValueType lateralNext = inputSize[1] == 1 ? 0 : lateralStride;
+
+      const InputPixelType * sample = inputBuffer + radiusBase * radiusStride + lateralBase * lateralStride + elevationBase * elevationStride;
+      const double v000 = sample[0];
+      const double v100 = sample[radiusNext];
+      const double v010 = sample[lateralNext];
+      const double v110 = sample[lateralNext + radiusNext];
+      const double v001 = sample[elevationNext];
+      const double v101 = sample[elevationNext + radiusNext];
+      const double v011 = sample[elevationNext + lateralNext];
+      const double v111 = sample[elevationNext + lateralNext + radiusNext];
+
+      const double v00 = v000 + ( v100 - v000 ) * radiusFraction;
+      const double v10 = v010 + ( v110 - v010 ) * radiusFraction;
+      const double v01 = v001 + ( v101 - v001 ) * radiusFraction;
+      const double v11 = v011 + ( v111 - v011 ) * radiusFraction;
+      const double v0 = v00 + ( v10 - v00 ) * lateralFraction;
+      const double v1 = v01 + ( v11 - v01 ) * lateralFraction;
+      const double value = v0 + ( v1 - v0 ) * elevationFraction;
+
+      if( value < minOutputValue )
+        {
+        outputRow[ii] = static_cast< OutputPixelType >( minOutputValue );
+        }
+      else if( value > maxOutputValue )
+        {
+        outputRow[ii] = static_cast< OutputPixelType >( maxOutputValue );
+        }
+      else
+        {
+        outputRow[ii] = static_cast< OutputPixelType >( value );
+        }
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Scan convert an itk::CurvilinearArraySpecialCoordinatesImage with linear
+ * interpolation without going through itk::ResampleImageFilter. The output
+ * rows are distributed over the threads of an itk::MultiThreader. The output
+ * direction must be the identity. */
+template< typename TInputImage, typename TOutputImage >
+int
+CurvilinearArrayFastLinearResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction
+  )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+
+  typename OutputImageType::DirectionType identity;
+  identity.SetIdentity();
+  if( direction != identity )
+    {
+    std::cerr << "FastLinear resampling requires an identity output direction" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ScanConversionProfileScope profileResampling( "Resample Image" );
+  typename OutputImageType::Pointer output = OutputImageType::New();
+  output->SetRegions( size );
+  output->SetSpacing( spacing );
+  output->SetOrigin( origin );
+  output->SetDirection( direction );
+  output->Allocate();
+
+  const ScanConversionSector sector = MakeCurvilinearArraySector( inputImage.GetPointer() );
+
+  typedef CurvilinearArrayFastLinearData< InputImageType, OutputImageType > DataType;
+  DataType data;
+  data.InputImage = inputImage.GetPointer();
+  data.OutputImage = output.GetPointer();
+  data.Apex[0] = sector.Apex[0];
+  data.Apex[1] = sector.Apex[1];
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const itk::SizeValueType numberOfRows = size[1] * size[2];
+  if( numberOfRows < static_cast< itk::SizeValueType >( threader->GetNumberOfThreads() ) )
+    {
+    threader->SetNumberOfThreads( std::max( itk::SizeValueType( 1 ), numberOfRows ) );
+    }
+  threader->SetSingleMethod( CurvilinearArrayFastLinearThread< InputImageType, OutputImageType >, &data );
+  threader->SingleMethodExecute();
+
+  outputImage = output;
+  return EXIT_SUCCESS;
+}
+
+}
+
+#endif
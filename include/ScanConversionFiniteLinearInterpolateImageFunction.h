@@ -0,0 +1,151 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef ScanConversionFiniteLinearInterpolateImageFunction_h
+#define ScanConversionFiniteLinearInterpolateImageFunction_h
+
+#include "itkInterpolateImageFunction.h"
+#include "itkMath.h"
+
+#include "ScanConversionFiniteSample.h"
+
+#include <algorithm>
+
+namespace
+{
+
+/** \class ScanConversionFiniteLinearInterpolateImageFunction
+ *
+ * \brief Linear interpolation that replaces the non-finite samples of the
+ * support with zero as it reads them.
+ *
+ * The output is the output of the itk::LinearInterpolateImageFunction of the
+ * input after an itk::ReplaceNonFiniteImageFilter, and the samples beyond
+ * the buffer are the nearest samples in the buffer. The weighted sum is
+ * evaluated as one pass along each axis.
+ */
+template< typename TInputImage, typename TCoordRep = double >
+class ScanConversionFiniteLinearInterpolateImageFunction:
+  public itk::InterpolateImageFunction< TInputImage, TCoordRep >
+{
+public:
+  typedef ScanConversionFiniteLinearInterpolateImageFunction        Self;
+  typedef itk::InterpolateImageFunction< TInputImage, TCoordRep >   Superclass;
+  typedef itk::SmartPointer< Self >                                 Pointer;
+  typedef itk::SmartPointer< const Self >                           ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionFiniteLinearInterpolateImageFunction, InterpolateImageFunction );
+
+  itkStaticConstMacro( ImageDimension, unsigned int, TInputImage::ImageDimension );
+
+  typedef typename Superclass::InputImageType      InputImageType;
+  typedef typename Superclass::OutputType          OutputType;
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+  typedef typename Superclass::RealType            RealType;
+  typedef typename InputImageType::PixelType       InputPixelType;
+
+  virtual void SetInputImage( const InputImageType * image ) ITK_OVERRIDE
+    {
+    Superclass::SetInputImage( image );
+    if( image == ITK_NULLPTR )
+      {
+      return;
+      }
+    const typename InputImageType::RegionType & bufferedRegion = image->GetBufferedRegion();
+    const typename InputImageType::OffsetValueType * offsetTable = image->GetOffsetTable();
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_BufferStart[dim] = bufferedRegion.GetIndex( dim );
+      m_BufferSize[dim] = static_cast< itk::OffsetValueType >( bufferedRegion.GetSize( dim ) );
+      m_Strides[dim] = offsetTable[dim];
+      }
+    }
+
+  virtual OutputType EvaluateAtContinuousIndex( const ContinuousIndexType & cindex ) const ITK_OVERRIDE
+    {
+    RealType weights[ImageDimension][2];
+    itk::OffsetValueType offsets[ImageDimension][2];
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      const itk::IndexValueType baseIndex = itk::Math::Floor< itk::IndexValueType >( cindex[dim] );
+      const RealType distance = cindex[dim] - static_cast< RealType >( baseIndex );
+      const itk::OffsetValueType lower = baseIndex - m_BufferStart[dim];
+      for( unsigned int ii = 0; ii < 2; ++ii )
+        {
+        const itk::OffsetValueType offset = std::min( std::max( lower + static_cast< itk::OffsetValueType >( ii ),
+            static_cast< itk::OffsetValueType >( 0 ) ),
+          m_BufferSize[dim] - 1 );
+        offsets[dim][ii] = offset * m_Strides[dim];
+        }
+      weights[dim][0] = 1.0 - distance;
+      weights[dim][1] = distance;
+      }
+
+    const InputPixelType * buffer = this->GetInputImage()->GetBufferPointer();
+    return static_cast< OutputType >( this->SumAlongAxis( ImageDimension - 1, buffer, weights, offsets ) );
+    }
+
+protected:
+  ScanConversionFiniteLinearInterpolateImageFunction()
+  {
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_BufferStart[dim] = 0;
+      m_BufferSize[dim] = 0;
+      m_Strides[dim] = 0;
+      }
+  }
+  ~ScanConversionFiniteLinearInterpolateImageFunction() {}
+
+private:
+  ScanConversionFiniteLinearInterpolateImageFunction( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  /** Weighted sum of the finite samples of the support along the axes up to
+   * axis, starting at sample. */
+  RealType SumAlongAxis( unsigned int axis,
+    const InputPixelType * sample,
+    const RealType weights[ImageDimension][2],
+    const itk::OffsetValueType offsets[ImageDimension][2] ) const
+    {
+    RealType sum = 0.0;
+    if( axis == 0 )
+      {
+      for( unsigned int ii = 0; ii < 2; ++ii )
+        {
+        sum += weights[0][ii] * static_cast< RealType >( ScanConversionFiniteSample( sample[offsets[0][ii]] ) );
+        }
+      return sum;
+      }
+    for( unsigned int ii = 0; ii < 2; ++ii )
+      {
+      sum += weights[axis][ii] * this->SumAlongAxis( axis - 1, sample + offsets[axis][ii], weights, offsets );
+      }
+    return sum;
+    }
+
+  itk::IndexValueType   m_BufferStart[ImageDimension];
+  itk::OffsetValueType  m_BufferSize[ImageDimension];
+  itk::OffsetValueType  m_Strides[ImageDimension];
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef ScanConversionFiniteNearestNeighborInterpolateImageFunction_h
+#define ScanConversionFiniteNearestNeighborInterpolateImageFunction_h
+
+#include "itkNearestNeighborInterpolateImageFunction.h"
+
+#include "ScanConversionFiniteSample.h"
+
+namespace
+{
+
+/** \class ScanConversionFiniteNearestNeighborInterpolateImageFunction
+ *
+ * \brief Nearest neighbor interpolation that replaces a non-finite nearest
+ * sample with zero.
+ *
+ * The output is the output of the itk::NearestNeighborInterpolateImageFunction
+ * of the input after an itk::ReplaceNonFiniteImageFilter.
+ */
+template< typename TInputImage, typename TCoordRep = double >
+class ScanConversionFiniteNearestNeighborInterpolateImageFunction:
+  public itk::NearestNeighborInterpolateImageFunction< TInputImage, TCoordRep >
+{
+public:
+  typedef ScanConversionFiniteNearestNeighborInterpolateImageFunction            Self;
+  typedef itk::NearestNeighborInterpolateImageFunction< TInputImage, TCoordRep > Superclass;
+  typedef itk::SmartPointer< Self >                                              Pointer;
+  typedef itk::SmartPointer< const Self >                                        ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionFiniteNearestNeighborInterpolateImageFunction, NearestNeighborInterpolateImageFunction );
+
+  typedef typename Superclass::OutputType          OutputType;
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+
+  virtual OutputType EvaluateAtContinuousIndex( const ContinuousIndexType & cindex ) const ITK_OVERRIDE
+    {
+    return ScanConversionFiniteSample( Superclass::EvaluateAtContinuousIndex( cindex ) );
+    }
+
+protected:
+  ScanConversionFiniteNearestNeighborInterpolateImageFunction() {}
+  ~ScanConversionFiniteNearestNeighborInterpolateImageFunction() {}
+
+private:
+  ScanConversionFiniteNearestNeighborInterpolateImageFunction( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+};
+
+}
+
+#endif
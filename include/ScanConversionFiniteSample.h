@@ -0,0 +1,57 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef ScanConversionFiniteSample_h
+#define ScanConversionFiniteSample_h
+
+#include "vnl/vnl_math.h"
+
+namespace
+{
+
+/** The sample, or zero when it is not finite, as the
+ * itk::ReplaceNonFiniteImageFilter replaces it. The interpolators replace the
+ * non-finite samples as they read them, so the input does not need another
+ * pass to replace them first. Integer samples are always finite. */
+template< typename TValue >
+inline TValue
+ScanConversionFiniteSample( TValue value )
+{
+  return value;
+}
+
+
+template<>
+inline float
+ScanConversionFiniteSample( float value )
+{
+  return vnl_math::isfinite( value ) ? value : 0.0f;
+}
+
+
+template<>
+inline double
+ScanConversionFiniteSample( double value )
+{
+  return vnl_math::isfinite( value ) ? value : 0.0;
+}
+
+}
+
+#endif
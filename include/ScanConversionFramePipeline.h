@@ -0,0 +1,183 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionFramePipeline_h
+#define ScanConversionFramePipeline_h
+
+#include "itkMultiThreader.h"
+#include "itkNumericSeriesFileNames.h"
+#include "itksys/SystemTools.hxx"
+
+#include <string>
+
+namespace
+{
+
+/** File name of a frame given a printf-style pattern, e.g. frame_%04d.mha. */
+inline std::string
+ScanConversionFrameFileName( const std::string & pattern, unsigned int frame )
+{
+  itk::NumericSeriesFileNames::Pointer fileNames = itk::NumericSeriesFileNames::New();
+  fileNames->SetSeriesFormat( pattern );
+  fileNames->SetStartIndex( frame );
+  fileNames->SetEndIndex( frame );
+  return fileNames->GetFileNames()[0];
+}
+
+
+/** Default frame file name pattern derived from an output file name, e.g.
+ * Output_%04d.mha for Output.mha. */
+inline std::string
+ScanConversionDefaultFramePattern( const std::string & fileName )
+{
+  const std::string path = itksys::SystemTools::GetFilenamePath( fileName );
+  std::string pattern;
+  if( !path.empty() )
+    {
+    pattern = path + "/";
+    }
+  pattern += itksys::SystemTools::GetFilenameWithoutLastExtension( fileName );
+  pattern += "_%04d";
+  pattern += itksys::SystemTools::GetFilenameLastExtension( fileName );
+  return pattern;
+}
+
+
+template< typename TFrameProcessor >
+struct ScanConversionFrameTask
+{
+  TFrameProcessor * Processor;
+  unsigned int      Frame;
+  int               Status;
+};
+
+
+template< typename TFrameProcessor >
+ITK_THREAD_RETURN_TYPE
+ScanConversionReadFrameThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct        ThreadInfoType;
+  typedef ScanConversionFrameTask< TFrameProcessor > TaskType;
+  TaskType * task = static_cast< TaskType * >( static_cast< ThreadInfoType * >( arg )->UserData );
+  try
+    {
+    task->Status = task->Processor->ReadFrame( task->Frame );
+    }
+  catch( itk::ExceptionObject & excep )
+    {
+    std::cerr << "Error reading frame " << task->Frame << ": " << excep << std::endl;
+    task->Status = EXIT_FAILURE;
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+template< typename TFrameProcessor >
+ITK_THREAD_RETURN_TYPE
+ScanConversionWriteFrameThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct        ThreadInfoType;
+  typedef ScanConversionFrameTask< TFrameProcessor > TaskType;
+  TaskType * task = static_cast< TaskType * >( static_cast< ThreadInfoType * >( arg )->UserData );
+  try
+    {
+    task->Status = task->Processor->WriteFrame( task->Frame );
+    }
+  catch( itk::ExceptionObject & excep )
+    {
+    std::cerr << "Error writing frame " << task->Frame << ": " << excep << std::endl;
+    task->Status = EXIT_FAILURE;
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Scan convert a series of frames with reading, resampling, and writing
+ * pipelined across frames: while frame N is resampled on the calling thread,
+ * frame N+1 is read and frame N-1 is written on spawned threads.
+ *
+ * The processor provides
+ *
+ *   int ReadFrame( unsigned int frame );
+ *   int ResampleFrame( unsigned int frame );
+ *   int WriteFrame( unsigned int frame );
+ *
+ * which return EXIT_SUCCESS or EXIT_FAILURE. Up to three frames are in
+ * flight, so the processor must keep the input and output of each frame in
+ * separate slots, e.g. indexed by frame % 2. */
+template< typename TFrameProcessor >
+int
+ScanConversionFramePipeline( TFrameProcessor & processor, unsigned int numberOfFrames )
+{
+  typedef ScanConversionFrameTask< TFrameProcessor > TaskType;
+
+  if( numberOfFrames == 0 )
+    {
+    return EXIT_SUCCESS;
+    }
+  if( processor.ReadFrame( 0 ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  for( unsigned int frame = 0; frame < numberOfFrames; ++frame )
+    {
+    TaskType readTask = { &processor, frame + 1, EXIT_SUCCESS };
+    int readThread = -1;
+    if( frame + 1 < numberOfFrames )
+      {
+      readThread = threader->SpawnThread( ScanConversionReadFrameThread< TFrameProcessor >, &readTask );
+      }
+    TaskType writeTask = { &processor, frame - 1, EXIT_SUCCESS };
+    int writeThread = -1;
+    if( frame > 0 )
+      {
+      writeThread = threader->SpawnThread( ScanConversionWriteFrameThread< TFrameProcessor >, &writeTask );
+      }
+
+    int resampleStatus = EXIT_FAILURE;
+    try
+      {
+      resampleStatus = processor.ResampleFrame( frame );
+      }
+    catch( itk::ExceptionObject & excep )
+      {
+      std::cerr << "Error resampling frame " << frame << ": " << excep << std::endl;
+      }
+
+    if( readThread >= 0 )
+      {
+      threader->TerminateThread( readThread );
+      }
+    if( writeThread >= 0 )
+      {
+      threader->TerminateThread( writeThread );
+      }
+    if( resampleStatus != EXIT_SUCCESS || readTask.Status != EXIT_SUCCESS || writeTask.Status != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  return processor.WriteFrame( numberOfFrames - 1 );
+}
+
+}
+
+#endif
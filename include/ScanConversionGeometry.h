@@ -0,0 +1,248 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionGeometry_h
+#define ScanConversionGeometry_h
+
+#include "itkContinuousIndex.h"
+#include "itkMath.h"
+#include "itkNumericTraits.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The sector and the slice bounds are part of the
+// ScanConversionResamplingOptions that the modules pass to the prebuilt
+// resampling library, so they are not in the anonymous namespace.
+
+/** Region of physical space sampled by a curvilinear array or a phased array
+ * 3D probe.
+ *
+ * For a curvilinear array, the fan lies in the plane of the first two axes
+ * with the depth along the second axis, and it is extruded along the third
+ * axis. For a phased array 3D probe, the depth is along the third axis with
+ * the azimuth in the first axis and the elevation in the second axis.
+ *
+ * The angles and radii include the half sample margin that is still inside
+ * the buffer of the interpolators. A default constructed sector has an
+ * UNSPECIFIED_GEOMETRY. */
+struct ScanConversionSector
+{
+  enum GeometryType
+    {
+    UNSPECIFIED_GEOMETRY,
+    CURVILINEAR_ARRAY,
+    PHASED_ARRAY_3D
+    };
+
+  ScanConversionSector():
+    Geometry( UNSPECIFIED_GEOMETRY ),
+    MinRadius( 0.0 ),
+    MaxRadius( 0.0 ),
+    LateralHalfAngle( 0.0 ),
+    ElevationHalfAngle( 0.0 )
+  {
+    Apex[0] = 0.0;
+    Apex[1] = 0.0;
+    Apex[2] = 0.0;
+  }
+
+  GeometryType Geometry;
+  double       Apex[3];
+  double       MinRadius;
+  double       MaxRadius;
+  double       LateralHalfAngle;
+  double       ElevationHalfAngle;
+};
+
+
+/** Physical bounding box of an input slice of a slice series. */
+struct ScanConversionSliceBounds
+{
+  double Lower[3];
+  double Upper[3];
+};
+
+
+namespace
+{
+
+/** Sector sampled by an itk::CurvilinearArraySpecialCoordinatesImage. */
+template< typename TInputImage >
+ScanConversionSector
+MakeCurvilinearArraySector( const TInputImage * inputImage )
+{
+  const typename TInputImage::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const double radiusSampleSize = inputImage->GetRadiusSampleSize();
+  const double firstSampleDistance = inputImage->GetFirstSampleDistance();
+
+  ScanConversionSector sector;
+  sector.Geometry = ScanConversionSector::CURVILINEAR_ARRAY;
+
+  itk::ContinuousIndex< double, 3 > apexIndex;
+  apexIndex[0] = inputRegion.GetIndex( 0 ) - firstSampleDistance / radiusSampleSize;
+  apexIndex[1] = inputRegion.GetIndex( 1 ) + ( inputRegion.GetSize( 1 ) - 1 ) / 2.0;
+  apexIndex[2] = inputRegion.GetIndex( 2 );
+  typename TInputImage::PointType apex;
+  inputImage->TransformContinuousIndexToPhysicalPoint( apexIndex, apex );
+  for( unsigned int ii = 0; ii < 3; ++ii )
+    {
+    sector.Apex[ii] = apex[ii];
+    }
+
+  sector.MinRadius = std::max( 0.0, firstSampleDistance - 0.5 * radiusSampleSize );
+  sector.MaxRadius = firstSampleDistance + ( inputRegion.GetSize( 0 ) - 0.5 ) * radiusSampleSize;
+  sector.LateralHalfAngle = inputRegion.GetSize( 1 ) / 2.0 * inputImage->GetLateralAngularSeparation();
+  sector.ElevationHalfAngle = 0.0;
+
+  return sector;
+}
+
+
+/** Sector sampled by an itk::PhasedArray3DSpecialCoordinatesImage. */
+template< typename TInputImage >
+ScanConversionSector
+MakePhasedArray3DSector( const TInputImage * inputImage )
+{
+  const typename TInputImage::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const double radiusSampleSize = inputImage->GetRadiusSampleSize();
+  const double firstSampleDistance = inputImage->GetFirstSampleDistance();
+
+  ScanConversionSector sector;
+  sector.Geometry = ScanConversionSector::PHASED_ARRAY_3D;
+
+  itk::ContinuousIndex< double, 3 > apexIndex;
+  apexIndex[0] = inputRegion.GetIndex( 0 ) + ( inputRegion.GetSize( 0 ) - 1 ) / 2.0;
+  apexIndex[1] = inputRegion.GetIndex( 1 ) + ( inputRegion.GetSize( 1 ) - 1 ) / 2.0;
+  apexIndex[2] = inputRegion.GetIndex( 2 ) - firstSampleDistance / radiusSampleSize;
+  typename TInputImage::PointType apex;
+  inputImage->TransformContinuousIndexToPhysicalPoint( apexIndex, apex );
+  for( unsigned int ii = 0; ii < 3; ++ii )
+    {
+    sector.Apex[ii] = apex[ii];
+    }
+
+  sector.MinRadius = std::max( 0.0, firstSampleDistance - 0.5 * radiusSampleSize );
+  sector.MaxRadius = firstSampleDistance + ( inputRegion.GetSize( 2 ) - 0.5 ) * radiusSampleSize;
+  sector.LateralHalfAngle = inputRegion.GetSize( 0 ) / 2.0 * inputImage->GetAzimuthAngularSeparation();
+  sector.ElevationHalfAngle = inputRegion.GetSize( 1 ) / 2.0 * inputImage->GetElevationAngularSeparation();
+
+  return sector;
+}
+
+
+/** Index of the input axis sampled along the radius of the sector, or -1 for
+ * an unspecified geometry. */
+inline int
+ScanConversionSectorRadiusAxis( const ScanConversionSector & sector )
+{
+  switch( sector.Geometry )
+    {
+  case ScanConversionSector::CURVILINEAR_ARRAY:
+    return 0;
+  case ScanConversionSector::PHASED_ARRAY_3D:
+    return 2;
+  default:
+    return -1;
+    }
+}
+
+
+/** Intervals of the first axis coordinate inside the sector along the line
+ * through the given coordinates of the second and third axes.
+ *
+ * The line crosses the sector in at most two intervals, which are separated
+ * when the line passes through the region closer to the apex than the first
+ * sample. The intervals are written to spans[span][0] and spans[span][1], and
+ * the number of intervals is returned. */
+inline unsigned int
+ScanConversionSectorLineSpans( const ScanConversionSector & sector,
+  double y,
+  double z,
+  double spans[2][2] )
+{
+  const double halfPi = itk::Math::pi / 2.0;
+  if( sector.Geometry == ScanConversionSector::UNSPECIFIED_GEOMETRY )
+    {
+    return 0;
+    }
+
+  double depth;
+  double depthSquared;
+  bool bounded;
+  double lateralExtent = itk::NumericTraits< double >::max();
+  if( sector.Geometry == ScanConversionSector::CURVILINEAR_ARRAY )
+    {
+    depth = y - sector.Apex[1];
+    depthSquared = depth * depth;
+    bounded = sector.LateralHalfAngle < halfPi;
+    if( bounded )
+      {
+      lateralExtent = depth * std::tan( sector.LateralHalfAngle );
+      }
+    }
+  else
+    {
+    depth = z - sector.Apex[2];
+    const double elevation = y - sector.Apex[1];
+    depthSquared = depth * depth + elevation * elevation;
+    bounded = sector.LateralHalfAngle < halfPi && sector.ElevationHalfAngle < halfPi;
+    if( bounded )
+      {
+      if( std::abs( elevation ) > depth * std::tan( sector.ElevationHalfAngle ) )
+        {
+        return 0;
+        }
+      lateralExtent = depth * std::tan( sector.LateralHalfAngle );
+      }
+    }
+  if( bounded && depth <= 0.0 )
+    {
+    return 0;
+    }
+
+  const double outerSquared = sector.MaxRadius * sector.MaxRadius - depthSquared;
+  if( outerSquared < 0.0 )
+    {
+    return 0;
+    }
+  const double outer = std::min( lateralExtent, std::sqrt( outerSquared ) );
+  const double innerSquared = sector.MinRadius * sector.MinRadius - depthSquared;
+  const double inner = innerSquared > 0.0 ? std::sqrt( innerSquared ) : 0.0;
+  if( inner > outer )
+    {
+    return 0;
+    }
+
+  const double center = sector.Apex[0];
+  if( inner == 0.0 )
+    {
+    spans[0][0] = center - outer;
+    spans[0][1] = center + outer;
+    return 1;
+    }
+  spans[0][0] = center - outer;
+  spans[0][1] = center - inner;
+  spans[1][0] = center + inner;
+  spans[1][1] = center + outer;
+  return 2;
+}
+
+}
+
+#endif
@@ -0,0 +1,397 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionImageWriter_h
+#define ScanConversionImageWriter_h
+
+#include "itkByteSwapper.h"
+#include "itkImageFileWriter.h"
+#include "itkMultiThreader.h"
+#include "itk_zlib.h"
+#include "itksys/SystemTools.hxx"
+
+#include "ScanConversionProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** MetaImage ElementType of a pixel type, or ITK_NULLPTR when the pixel
+ * type is not written by WriteScanConversionMetaImage. */
+template< typename TPixel >
+struct ScanConversionMetaImageElementType
+{
+  static const char * Get() { return ITK_NULLPTR; }
+};
+
+template<>
+struct ScanConversionMetaImageElementType< unsigned char >
+{
+  static const char * Get() { return "MET_UCHAR"; }
+};
+
+template<>
+struct ScanConversionMetaImageElementType< unsigned short >
+{
+  static const char * Get() { return "MET_USHORT"; }
+};
+
+template<>
+struct ScanConversionMetaImageElementType< short >
+{
+  static const char * Get() { return "MET_SHORT"; }
+};
+
+template<>
+struct ScanConversionMetaImageElementType< float >
+{
+  static const char * Get() { return "MET_FLOAT"; }
+};
+
+template<>
+struct ScanConversionMetaImageElementType< double >
+{
+  static const char * Get() { return "MET_DOUBLE"; }
+};
+
+
+/** Shared state of the threads of ScanConversionParallelDeflate. */
+struct ScanConversionDeflateData
+{
+  const unsigned char *                      Buffer;
+  std::size_t                                BufferSize;
+  std::size_t                                ChunkSize;
+  int                                        CompressionLevel;
+  std::vector< std::vector< unsigned char > > Chunks;
+  std::vector< uLong >                       Adlers;
+  std::vector< int >                         Status;
+};
+
+
+/** Deflate every NumberOfThreads-th chunk, starting at the chunk of the
+ * thread, as raw deflate data. Each chunk is primed with the window that
+ * precedes it, and every chunk but the last ends on a byte boundary with a
+ * sync flush, so the chunks concatenate into a single deflate stream. */
+inline ITK_THREAD_RETURN_TYPE
+ScanConversionDeflateThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+  ScanConversionDeflateData * data = static_cast< ScanConversionDeflateData * >( threadInfo->UserData );
+
+  const std::size_t WindowSize = 32768;
+  const std::size_t numberOfChunks = data->Chunks.size();
+  for( std::size_t chunk = threadInfo->ThreadID; chunk < numberOfChunks; chunk += threadInfo->NumberOfThreads )
+    {
+    const std::size_t begin = chunk * data->ChunkSize;
+    const std::size_t length = std::min( data->ChunkSize, data->BufferSize - begin );
+    const bool last = chunk + 1 == numberOfChunks;
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if( deflateInit2( &stream, data->CompressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+      {
+      data->Status[chunk] = EXIT_FAILURE;
+      continue;
+      }
+    if( begin > 0 )
+      {
+      const std::size_t dictionarySize = std::min( WindowSize, begin );
+      deflateSetDictionary( &stream, data->Buffer + begin - dictionarySize, static_cast< uInt >( dictionarySize ) );
+      }
+
+    std::vector< unsigned char > & output = data->Chunks[chunk];
+    output.resize( deflateBound( &stream, static_cast< uLong >( length ) ) + 16 );
+    stream.next_in = const_cast< Bytef * >( data->Buffer + begin );
+    stream.avail_in = static_cast< uInt >( length );
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    int status = Z_OK;
+    std::size_t written = 0;
+    do
+      {
+      if( written == output.size() )
+        {
+        output.resize( 2 * output.size() );
+        }
+      stream.next_out = &output[written];
+      stream.avail_out = static_cast< uInt >( output.size() - written );
+      status = deflate( &stream, flush );
+      written = output.size() - stream.avail_out;
+      }
+    while( status == Z_OK && ( stream.avail_out == 0 || ( last && status != Z_STREAM_END ) ) );
+    deflateEnd( &stream );
+    output.resize( written );
+
+    const bool finished = last ? status == Z_STREAM_END : ( status == Z_OK || status == Z_BUF_ERROR );
+    data->Status[chunk] = finished ? EXIT_SUCCESS : EXIT_FAILURE;
+    data->Adlers[chunk] = adler32( adler32( 0L, Z_NULL, 0 ), data->Buffer + begin, static_cast< uInt >( length ) );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Compress a buffer into a zlib stream, in chunks of chunkSize bytes over
+ * the threads of an itk::MultiThreader, and write it to the stream. Returns
+ * the number of compressed bytes, or zero on failure. */
+inline std::size_t
+ScanConversionParallelDeflate( const unsigned char * buffer,
+  std::size_t bufferSize,
+  int compressionLevel,
+  std::ostream & outputStream )
+{
+  const std::size_t ChunkSize = 1 << 22;
+
+  ScanConversionDeflateData data;
+  data.Buffer = buffer;
+  data.BufferSize = bufferSize;
+  data.ChunkSize = ChunkSize;
+  data.CompressionLevel = compressionLevel;
+  const std::size_t numberOfChunks = std::max< std::size_t >( ( bufferSize + ChunkSize - 1 ) / ChunkSize, 1 );
+  data.Chunks.resize( numberOfChunks );
+  data.Adlers.resize( numberOfChunks );
+  data.Status.resize( numberOfChunks, EXIT_FAILURE );
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  if( numberOfChunks < static_cast< std::size_t >( threader->GetNumberOfThreads() ) )
+    {
+    threader->SetNumberOfThreads( static_cast< itk::ThreadIdType >( numberOfChunks ) );
+    }
+  threader->SetSingleMethod( ScanConversionDeflateThread, &data );
+  threader->SingleMethodExecute();
+
+  // zlib header with the compression level flags of deflateInit
+  unsigned char header[2] = { 0x78, 0x9c };
+  if( compressionLevel == 1 )
+    {
+    header[1] = 0x01;
+    }
+  else if( compressionLevel >= 2 && compressionLevel <= 5 )
+    {
+    header[1] = 0x5e;
+    }
+  else if( compressionLevel >= 7 )
+    {
+    header[1] = 0xda;
+    }
+  outputStream.write( reinterpret_cast< const char * >( header ), sizeof( header ) );
+
+  std::size_t compressedSize = sizeof( header );
+  uLong adler = adler32( 0L, Z_NULL, 0 );
+  for( std::size_t chunk = 0; chunk < numberOfChunks; ++chunk )
+    {
+    if( data.Status[chunk] != EXIT_SUCCESS )
+      {
+      return 0;
+      }
+    const std::size_t length = std::min( ChunkSize, bufferSize - std::min( bufferSize, chunk * ChunkSize ) );
+    adler = adler32_combine( adler, data.Adlers[chunk], static_cast< z_off_t >( length ) );
+    if( !data.Chunks[chunk].empty() )
+      {
+      outputStream.write( reinterpret_cast< const char * >( &(data.Chunks[chunk][0]) ), data.Chunks[chunk].size() );
+      }
+    compressedSize += data.Chunks[chunk].size();
+    std::vector< unsigned char >().swap( data.Chunks[chunk] );
+    }
+
+  const unsigned char trailer[4] = {
+    static_cast< unsigned char >( ( adler >> 24 ) & 0xff ),
+    static_cast< unsigned char >( ( adler >> 16 ) & 0xff ),
+    static_cast< unsigned char >( ( adler >> 8 ) & 0xff ),
+    static_cast< unsigned char >( adler & 0xff ) };
+  outputStream.write( reinterpret_cast< const char * >( trailer ), sizeof( trailer ) );
+  compressedSize += sizeof( trailer );
+
+  return outputStream ? compressedSize : 0;
+}
+
+
+/** Write a compressed MetaImage, .mha with the data after the header or
+ * .mhd with the data in a .zraw file next to it. The pixel data is
+ * compressed with ScanConversionParallelDeflate, and the header carries the
+ * same fields as the itk::MetaImageIO. A null image, e.g. the output of a
+ * failed resampling, fails. */
+template< typename TImage >
+int
+WriteScanConversionMetaImage( const TImage * image,
+  const std::string & fileName,
+  int compressionLevel )
+{
+  typedef TImage                       ImageType;
+  typedef typename ImageType::PixelType PixelType;
+  const unsigned int Dimension = ImageType::ImageDimension;
+
+  if( image == ITK_NULLPTR )
+    {
+    std::cerr << "There is no image to write to " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const std::string extension = itksys::SystemTools::LowerCase( itksys::SystemTools::GetFilenameLastExtension( fileName ) );
+  const bool local = extension == ".mha";
+  const std::string dataFileName = itksys::SystemTools::GetFilenamePath( fileName ).empty() ?
+    itksys::SystemTools::GetFilenameWithoutLastExtension( fileName ) + ".zraw" :
+    itksys::SystemTools::GetFilenamePath( fileName ) + "/" + itksys::SystemTools::GetFilenameWithoutLastExtension( fileName ) + ".zraw";
+
+  std::ofstream dataStream;
+  if( !local )
+    {
+    dataStream.open( dataFileName.c_str(), std::ios::out | std::ios::binary );
+    if( !dataStream )
+      {
+      std::cerr << "Could not write the MetaImage data file: " << dataFileName << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // The header starts with the compressed size, so the data of a .mha is
+  // compressed to memory first
+  std::ostringstream localData;
+  std::ostream & compressedStream = local ? static_cast< std::ostream & >( localData ) : dataStream;
+  const unsigned char * buffer = reinterpret_cast< const unsigned char * >( image->GetBufferPointer() );
+  const std::size_t bufferSize = image->GetBufferedRegion().GetNumberOfPixels() * sizeof( PixelType );
+  const std::size_t compressedSize = ScanConversionParallelDeflate( buffer, bufferSize, compressionLevel, compressedStream );
+  if( compressedSize == 0 )
+    {
+    std::cerr << "Could not compress the output: " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::ofstream headerStream( fileName.c_str(), std::ios::out | std::ios::binary );
+  if( !headerStream )
+    {
+    std::cerr << "Could not write the output: " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  const typename ImageType::SpacingType & spacing = image->GetSpacing();
+  const typename ImageType::DirectionType & direction = image->GetDirection();
+  typename ImageType::PointType origin;
+  image->TransformIndexToPhysicalPoint( image->GetBufferedRegion().GetIndex(), origin );
+  const typename ImageType::SizeType & size = image->GetBufferedRegion().GetSize();
+
+  headerStream << std::setprecision( 17 );
+  headerStream << "ObjectType = Image\n";
+  headerStream << "NDims = " << Dimension << "\n";
+  headerStream << "BinaryData = True\n";
+  headerStream << "BinaryDataByteOrderMSB = " << ( itk::ByteSwapper< int >::SystemIsBigEndian() ? "True" : "False" ) << "\n";
+  headerStream << "CompressedData = True\n";
+  headerStream << "CompressedDataSize = " << compressedSize << "\n";
+  headerStream << "TransformMatrix =";
+  for( unsigned int axis = 0; axis < Dimension; ++axis )
+    {
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      headerStream << " " << direction[dim][axis];
+      }
+    }
+  headerStream << "\n";
+  headerStream << "Offset =";
+  for( unsigned int dim = 0; dim < Dimension; ++dim )
+    {
+    headerStream << " " << origin[dim];
+    }
+  headerStream << "\n";
+  headerStream << "ElementSpacing =";
+  for( unsigned int dim = 0; dim < Dimension; ++dim )
+    {
+    headerStream << " " << spacing[dim];
+    }
+  headerStream << "\n";
+  headerStream << "DimSize =";
+  for( unsigned int dim = 0; dim < Dimension; ++dim )
+    {
+    headerStream << " " << size[dim];
+    }
+  headerStream << "\n";
+  headerStream << "ElementType = " << ScanConversionMetaImageElementType< PixelType >::Get() << "\n";
+  if( local )
+    {
+    headerStream << "ElementDataFile = LOCAL\n";
+    const std::string data = localData.str();
+    headerStream.write( data.data(), data.size() );
+    }
+  else
+    {
+    headerStream << "ElementDataFile = " << itksys::SystemTools::GetFilenameName( dataFileName ) << "\n";
+    }
+
+  if( !headerStream || ( !local && !dataStream ) )
+    {
+    std::cerr << "Could not write the output: " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+
+/** Write a scan converted image. A compressionLevel of zero writes the
+ * output without compression, and 1 to 9 are the zlib compression levels,
+ * from fastest to smallest. MetaImage outputs are compressed over all the
+ * threads with WriteScanConversionMetaImage. Other formats are written by
+ * the itk::ImageFileWriter, compressed with the default level of their
+ * ImageIO when compressionLevel is not zero. The writer is watched as
+ * comment when CLPProcessInformation is given. */
+template< typename TImage >
+int
+WriteScanConversionImage( const TImage * image,
+  const std::string & fileName,
+  int compressionLevel,
+  const char * comment,
+  ModuleProcessInformation * CLPProcessInformation )
+{
+  typedef TImage ImageType;
+
+  const std::string extension = itksys::SystemTools::LowerCase( itksys::SystemTools::GetFilenameLastExtension( fileName ) );
+  if( compressionLevel > 0
+    && ( extension == ".mha" || extension == ".mhd" )
+    && ScanConversionMetaImageElementType< typename ImageType::PixelType >::Get() != ITK_NULLPTR )
+    {
+    if( CLPProcessInformation == ITK_NULLPTR )
+      {
+      return WriteScanConversionMetaImage< ImageType >( image, fileName, std::min( compressionLevel, 9 ) );
+      }
+    ScanConversionProfileScope profileWrite( comment );
+    return WriteScanConversionMetaImage< ImageType >( image, fileName, std::min( compressionLevel, 9 ) );
+    }
+
+  typedef itk::ImageFileWriter< ImageType > WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( fileName );
+  writer->SetInput( image );
+  writer->SetUseCompression( compressionLevel > 0 );
+  if( CLPProcessInformation == ITK_NULLPTR )
+    {
+    writer->Update();
+    return EXIT_SUCCESS;
+    }
+  ScanConversionFilterWatcher watchWriter(writer, comment, CLPProcessInformation);
+  writer->Update();
+  return EXIT_SUCCESS;
+}
+
+}
+
+#endif
@@ -0,0 +1,744 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionLookupTable_h
+#define ScanConversionLookupTable_h
+
+#include "itkContinuousIndex.h"
+#include "itkIntTypes.h"
+#include "itkMath.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+#include "itksys/SystemTools.hxx"
+
+#include "ScanConversionFiniteSample.h"
+#include "ScanConversionResamplingMethods.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+inline int
+ScanConversionProcessId()
+{
+#ifdef _WIN32
+  return _getpid();
+#else
+  return static_cast< int >( getpid() );
+#endif
+}
+
+
+/** Name of the host, or an empty string. */
+inline std::string
+ScanConversionHostName()
+{
+#ifdef _WIN32
+  const char * hostName = itksys::SystemTools::GetEnv( "COMPUTERNAME" );
+  return hostName != ITK_NULLPTR ? hostName : "";
+#else
+  char hostName[256];
+  if( gethostname( hostName, sizeof( hostName ) ) != 0 )
+    {
+    return "";
+    }
+  hostName[sizeof( hostName ) - 1] = '\0';
+  return hostName;
+#endif
+}
+
+
+/** Temporary file name next to fileName that is unique for the processes of
+ * all the hosts that share its directory, e.g. over a network file system
+ * where the process ids of different hosts collide. */
+inline std::string
+ScanConversionTemporaryFileName( const std::string & fileName )
+{
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetSeed();
+  std::ostringstream temporaryFileName;
+  temporaryFileName << fileName << ".partial." << ScanConversionHostName()
+    << "." << ScanConversionProcessId()
+    << "." << std::hex << generator->GetIntegerVariate();
+  return temporaryFileName.str();
+}
+
+
+/** \class ScanConversionLookupTable
+ *
+ * \brief Precomputed mapping from the voxels of a rectilinear output grid to
+ * the samples of a special coordinates input image.
+ *
+ * Every output voxel stores the buffer offset of its first input sample and
+ * the fractional distance to the next sample along each axis. Voxels outside
+ * the input buffer store a negative offset. Applying the table to a frame
+ * that shares the geometry is a gather and a weighted sum, so the physical
+ * point to index mapping of the special coordinates image is only evaluated
+ * once.
+ *
+ * Boundary handling and the output pixel casting follow the
+ * itk::ResampleImageFilter with the itk::NearestNeighborInterpolateImageFunction
+ * or itk::LinearInterpolateImageFunction, which are the supported methods.
+ *
+ * The geometry key records the input and output grids, the method, and the
+ * special coordinates parameters given by the caller. A table is only read
+ * from disk when its key matches. Files are written in the native byte order,
+ * to a temporary file that is renamed once it is complete, so the processes
+ * that share a table file, e.g. the workers of a distributed conversion,
+ * either read a complete table or build it.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ScanConversionLookupTable
+{
+public:
+  typedef TInputImage                           InputImageType;
+  typedef TOutputImage                          OutputImageType;
+  typedef typename OutputImageType::PixelType   OutputPixelType;
+  typedef typename OutputImageType::SizeType    SizeType;
+  typedef typename OutputImageType::SpacingType SpacingType;
+  typedef typename OutputImageType::PointType   PointType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  itkStaticConstMacro( ImageDimension, unsigned int, OutputImageType::ImageDimension );
+
+  typedef std::vector< double >                 GeometryKeyType;
+  typedef itk::int64_t                          OffsetValueType;
+  typedef float                                 FractionValueType;
+
+  ScanConversionLookupTable():
+    m_Method( ITK_LINEAR ),
+    m_ReplaceNonFinite( false ),
+    m_NumberOfVoxels( 0 )
+  {
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_Strides[dim] = 0;
+      }
+  }
+
+  /** Replace the non-finite input samples with zero as they are gathered by
+   * Apply, as ScanConversionResamplingOptions::ReplaceNonFinite does for
+   * the other methods. It is not part of the key, since it does not change
+   * the table. */
+  void SetReplaceNonFinite( bool replaceNonFinite )
+  {
+    m_ReplaceNonFinite = replaceNonFinite;
+  }
+
+  /** Methods that can be represented by a lookup table. */
+  static bool SupportsMethod( ScanConversionResamplingMethod method )
+  {
+    return method == ITK_NEAREST_NEIGHBOR || method == ITK_LINEAR;
+  }
+
+  /** Create the key that identifies the input geometry, the output grid, and
+   * the method. geometryParameters are the special coordinates parameters,
+   * e.g. the angular separation and radius sample size, that are not stored
+   * in the itk::ImageBase information. */
+  static GeometryKeyType MakeGeometryKey( const InputImageType * inputImage,
+    const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction,
+    ScanConversionResamplingMethod method,
+    const GeometryKeyType & geometryParameters )
+  {
+    GeometryKeyType key;
+    key.push_back( static_cast< double >( method ) );
+    const typename InputImageType::RegionType & inputRegion = inputImage->GetBufferedRegion();
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      key.push_back( static_cast< double >( inputRegion.GetIndex()[dim] ) );
+      key.push_back( static_cast< double >( inputRegion.GetSize()[dim] ) );
+      key.push_back( inputImage->GetOrigin()[dim] );
+      key.push_back( inputImage->GetSpacing()[dim] );
+      }
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      key.push_back( static_cast< double >( size[dim] ) );
+      key.push_back( spacing[dim] );
+      key.push_back( origin[dim] );
+      for( unsigned int column = 0; column < ImageDimension; ++column )
+        {
+        key.push_back( direction[dim][column] );
+        }
+      }
+    key.insert( key.end(), geometryParameters.begin(), geometryParameters.end() );
+    return key;
+  }
+
+  /** Compute the table for the geometry of the inputImage sampled on the given
+   * output grid. */
+  int Build( const InputImageType * inputImage,
+    const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction,
+    ScanConversionResamplingMethod method,
+    const GeometryKeyType & geometryParameters )
+  {
+    if( !SupportsMethod( method ) )
+      {
+      std::cerr << "Unsupported lookup table resampling method: " << method << std::endl;
+      return EXIT_FAILURE;
+      }
+    m_Method = method;
+    m_GeometryKey = MakeGeometryKey( inputImage, size, spacing, origin, direction, method, geometryParameters );
+
+    const typename InputImageType::RegionType & inputRegion = inputImage->GetBufferedRegion();
+    const typename InputImageType::IndexType & inputStart = inputRegion.GetIndex();
+    const typename InputImageType::SizeType & inputSize = inputRegion.GetSize();
+    OffsetValueType stride = 1;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_Strides[dim] = inputSize[dim] > 1 ? stride : 0;
+      stride *= static_cast< OffsetValueType >( inputSize[dim] );
+      }
+
+    typename OutputImageType::Pointer grid = OutputImageType::New();
+    grid->SetRegions( size );
+    grid->SetSpacing( spacing );
+    grid->SetOrigin( origin );
+    grid->SetDirection( direction );
+
+    m_NumberOfVoxels = grid->GetLargestPossibleRegion().GetNumberOfPixels();
+    m_Offsets.resize( m_NumberOfVoxels );
+    m_Fractions.resize( m_NumberOfVoxels * ImageDimension );
+
+    typedef itk::ContinuousIndex< double, ImageDimension > ContinuousIndexType;
+    typename OutputImageType::IndexType outputIndex;
+    outputIndex.Fill( 0 );
+    PointType point;
+    ContinuousIndexType inputIndex;
+    for( itk::SizeValueType voxel = 0; voxel < m_NumberOfVoxels; ++voxel )
+      {
+      grid->TransformIndexToPhysicalPoint( outputIndex, point );
+      inputImage->TransformPhysicalPointToContinuousIndex( point, inputIndex );
+
+      OffsetValueType offset = 0;
+      FractionValueType * fractions = &(m_Fractions[voxel * ImageDimension]);
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        // Same bounds as itk::ImageFunction::IsInsideBuffer
+        const double local = inputIndex[dim] - static_cast< double >( inputStart[dim] );
+        if( !( local >= -0.5 && local < static_cast< double >( inputSize[dim] ) - 0.5 ) )
+          {
+          offset = -1;
+          break;
+          }
+        const OffsetValueType lastIndex = static_cast< OffsetValueType >( inputSize[dim] ) - 1;
+        OffsetValueType base;
+        double fraction = 0.0;
+        if( m_Method == ITK_NEAREST_NEIGHBOR )
+          {
+          base = itk::Math::RoundHalfIntegerUp< OffsetValueType >( local );
+          base = std::max( OffsetValueType( 0 ), std::min( lastIndex, base ) );
+          }
+        else
+          {
+          base = itk::Math::Floor< OffsetValueType >( local );
+          fraction = local - static_cast< double >( base );
+          // Neighbors outside the buffer take the value of the boundary
+          // sample, as in itk::LinearInterpolateImageFunction
+          if( lastIndex == 0 || base < 0 )
+            {
+            base = 0;
+            fraction = 0.0;
+            }
+          else if( base >= lastIndex )
+            {
+            base = lastIndex - 1;
+            fraction = 1.0;
+            }
+          }
+        offset += base * m_Strides[dim];
+        fractions[dim] = static_cast< FractionValueType >( fraction );
+        }
+      m_Offsets[voxel] = offset;
+
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        if( ++outputIndex[dim] < static_cast< itk::IndexValueType >( size[dim] ) )
+          {
+          break;
+          }
+        outputIndex[dim] = 0;
+        }
+      }
+
+    return EXIT_SUCCESS;
+  }
+
+  /** Read the table from fileName if it matches the geometry. Otherwise,
+   * build it and write it to fileName. An empty fileName only builds the
+   * table. */
+  int ReadOrBuild( const InputImageType * inputImage,
+    const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction,
+    ScanConversionResamplingMethod method,
+    const GeometryKeyType & geometryParameters,
+    const std::string & fileName )
+  {
+    ScanConversionProfileScope profileLookupTable( "Read or Build Lookup Table" );
+    if( !fileName.empty() )
+      {
+      const GeometryKeyType expectedKey = MakeGeometryKey( inputImage, size, spacing, origin, direction, method, geometryParameters );
+      if( this->Read( fileName, expectedKey ) )
+        {
+        return EXIT_SUCCESS;
+        }
+      }
+    if( this->Build( inputImage, size, spacing, origin, direction, method, geometryParameters ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( !fileName.empty() && !this->Write( fileName ) )
+      {
+      std::cerr << "Could not write the scan conversion lookup table: " << fileName << std::endl;
+      }
+    return EXIT_SUCCESS;
+  }
+
+  /** Resample the inputImage, which must have the geometry used to build the
+   * table, onto the output grid. An input whose buffered size differs from
+   * the size of the key fails, since the offsets of the table would index
+   * outside of its buffer. */
+  int Apply( const InputImageType * inputImage,
+    typename OutputImageType::Pointer & outputImage ) const
+  {
+    if( m_NumberOfVoxels == 0 )
+      {
+      std::cerr << "The scan conversion lookup table has not been built" << std::endl;
+      return EXIT_FAILURE;
+      }
+    const typename InputImageType::SizeType & inputSize = inputImage->GetBufferedRegion().GetSize();
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      // The key starts with the method, then the index, size, origin, and
+      // spacing of each input dimension, see MakeGeometryKey
+      if( static_cast< double >( inputSize[dim] ) != m_GeometryKey[2 + 4 * dim] )
+        {
+        std::cerr << "The input size " << inputSize
+          << " differs from the input size of the scan conversion lookup table" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    ScanConversionProfileScope profileResampling( "Resample Image" );
+
+    typename OutputImageType::Pointer output = OutputImageType::New();
+    SizeType size;
+    SpacingType spacing;
+    PointType origin;
+    DirectionType direction;
+    this->GetOutputGrid( size, spacing, origin, direction );
+    output->SetRegions( size );
+    output->SetSpacing( spacing );
+    output->SetOrigin( origin );
+    output->SetDirection( direction );
+    output->Allocate();
+
+    ApplyData data;
+    data.Table = this;
+    data.InputBuffer = inputImage->GetBufferPointer();
+    data.OutputBuffer = output->GetBufferPointer();
+    data.ReplaceNonFinite = m_ReplaceNonFinite && !itk::NumericTraits< InputPixelType >::is_integer;
+
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    if( m_NumberOfVoxels < static_cast< itk::SizeValueType >( threader->GetNumberOfThreads() ) )
+      {
+      threader->SetNumberOfThreads( static_cast< itk::ThreadIdType >( m_NumberOfVoxels ) );
+      }
+    threader->SetSingleMethod( ApplyThread, &data );
+    threader->SingleMethodExecute();
+
+    outputImage = output;
+    return EXIT_SUCCESS;
+  }
+
+  /** Read a table. Returns false if the file cannot be read, if its
+   * geometry key does not match the expectedKey, or if its length, strides,
+   * or offsets do not match the input and output grids of the key, e.g. a
+   * truncated or corrupted file. */
+  bool Read( const std::string & fileName, const GeometryKeyType & expectedKey )
+  {
+    std::ifstream stream( fileName.c_str(), std::ios::in | std::ios::binary );
+    if( !stream )
+      {
+      return false;
+      }
+    stream.seekg( 0, std::ios::end );
+    const std::streamoff fileLength = stream.tellg();
+    stream.seekg( 0, std::ios::beg );
+
+    char magic[sizeof( MagicString )];
+    stream.read( magic, sizeof( magic ) );
+    itk::uint32_t dimension = 0;
+    stream.read( reinterpret_cast< char * >( &dimension ), sizeof( dimension ) );
+    if( !stream || std::memcmp( magic, MagicString, sizeof( magic ) ) != 0 || dimension != ImageDimension )
+      {
+      return false;
+      }
+
+    itk::uint64_t keyLength = 0;
+    stream.read( reinterpret_cast< char * >( &keyLength ), sizeof( keyLength ) );
+    if( !stream || keyLength != expectedKey.size() )
+      {
+      return false;
+      }
+    GeometryKeyType key( keyLength );
+    stream.read( reinterpret_cast< char * >( &(key[0]) ), keyLength * sizeof( double ) );
+    if( !stream || key != expectedKey )
+      {
+      return false;
+      }
+
+    // The strides and the number of voxels follow from the key, in the
+    // layout of MakeGeometryKey
+    OffsetValueType expectedStrides[ImageDimension];
+    OffsetValueType numberOfInputSamples = 1;
+    itk::uint64_t expectedNumberOfVoxels = 1;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      const OffsetValueType inputSize = static_cast< OffsetValueType >( key[1 + 4 * dim + 1] );
+      expectedStrides[dim] = inputSize > 1 ? numberOfInputSamples : 0;
+      numberOfInputSamples *= inputSize;
+      expectedNumberOfVoxels *= static_cast< itk::uint64_t >( key[1 + 4 * ImageDimension + ( 3 + ImageDimension ) * dim] );
+      }
+
+    itk::uint64_t numberOfVoxels = 0;
+    OffsetValueType strides[ImageDimension];
+    stream.read( reinterpret_cast< char * >( &numberOfVoxels ), sizeof( numberOfVoxels ) );
+    stream.read( reinterpret_cast< char * >( strides ), sizeof( strides ) );
+    if( !stream
+      || numberOfVoxels != expectedNumberOfVoxels
+      || !std::equal( strides, strides + ImageDimension, expectedStrides ) )
+      {
+      return false;
+      }
+    const std::streamoff dataLength = static_cast< std::streamoff >( numberOfVoxels )
+      * static_cast< std::streamoff >( sizeof( OffsetValueType ) + ImageDimension * sizeof( FractionValueType ) );
+    if( fileLength - static_cast< std::streamoff >( stream.tellg() ) != dataLength )
+      {
+      return false;
+      }
+    std::copy( strides, strides + ImageDimension, m_Strides );
+    m_Offsets.resize( numberOfVoxels );
+    m_Fractions.resize( numberOfVoxels * ImageDimension );
+    stream.read( reinterpret_cast< char * >( &(m_Offsets[0]) ), numberOfVoxels * sizeof( OffsetValueType ) );
+    stream.read( reinterpret_cast< char * >( &(m_Fractions[0]) ), numberOfVoxels * ImageDimension * sizeof( FractionValueType ) );
+    if( !stream )
+      {
+      m_NumberOfVoxels = 0;
+      return false;
+      }
+    // Apply gathers the linear samples from the offset to the offset plus
+    // the strides
+    const ScanConversionResamplingMethod method = static_cast< ScanConversionResamplingMethod >( static_cast< int >( key[0] ) );
+    OffsetValueType lastNeighbor = 0;
+    for( unsigned int dim = 0; dim < ImageDimension && method != ITK_NEAREST_NEIGHBOR; ++dim )
+      {
+      lastNeighbor += m_Strides[dim];
+      }
+    for( itk::SizeValueType voxel = 0; voxel < numberOfVoxels; ++voxel )
+      {
+      if( m_Offsets[voxel] >= 0 && m_Offsets[voxel] + lastNeighbor >= numberOfInputSamples )
+        {
+        m_NumberOfVoxels = 0;
+        return false;
+        }
+      }
+
+    m_GeometryKey = key;
+    m_Method = method;
+    m_NumberOfVoxels = numberOfVoxels;
+    return true;
+  }
+
+  bool Write( const std::string & fileName ) const
+  {
+    const std::string temporaryFileName = ScanConversionTemporaryFileName( fileName );
+    if( !this->WriteStream( temporaryFileName ) )
+      {
+      std::remove( temporaryFileName.c_str() );
+      return false;
+      }
+    if( std::rename( temporaryFileName.c_str(), fileName.c_str() ) != 0 )
+      {
+      // Windows does not rename over an existing file
+      std::remove( fileName.c_str() );
+      if( std::rename( temporaryFileName.c_str(), fileName.c_str() ) != 0 )
+        {
+        std::remove( temporaryFileName.c_str() );
+        return false;
+        }
+      }
+    return true;
+  }
+
+  const GeometryKeyType & GetGeometryKey() const
+  {
+    return m_GeometryKey;
+  }
+
+  ScanConversionResamplingMethod GetMethod() const
+  {
+    return m_Method;
+  }
+
+private:
+  typedef typename InputImageType::PixelType InputPixelType;
+
+  struct ApplyData
+  {
+    const ScanConversionLookupTable * Table;
+    const InputPixelType *            InputBuffer;
+    OutputPixelType *                 OutputBuffer;
+    bool                              ReplaceNonFinite;
+  };
+
+  /** Resample a contiguous range of the output voxels, split across the
+   * threads by voxel index, as VTKScanConversionKernelThread splits the
+   * output rows. */
+  static ITK_THREAD_RETURN_TYPE ApplyThread( void * arg )
+  {
+    typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+    ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+    const ApplyData * data = static_cast< ApplyData * >( threadInfo->UserData );
+
+    // The product of the number of voxels and the thread id can exceed a
+    // 32 bit itk::SizeValueType
+    const itk::uint64_t numberOfVoxels = data->Table->m_NumberOfVoxels;
+    const itk::SizeValueType voxelBegin = static_cast< itk::SizeValueType >( numberOfVoxels * threadInfo->ThreadID / threadInfo->NumberOfThreads );
+    const itk::SizeValueType voxelEnd = static_cast< itk::SizeValueType >( numberOfVoxels * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads );
+    if( data->ReplaceNonFinite )
+      {
+      data->Table->template ApplyVoxels< true >( data->InputBuffer, data->OutputBuffer, voxelBegin, voxelEnd );
+      }
+    else
+      {
+      data->Table->template ApplyVoxels< false >( data->InputBuffer, data->OutputBuffer, voxelBegin, voxelEnd );
+      }
+
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  /** With ReplaceNonFinite, the samples are gathered with
+   * ScanConversionFiniteSample. It is a template parameter so that the test
+   * is not in the voxel loop. */
+  template< bool ReplaceNonFinite >
+  void ApplyVoxels( const InputPixelType * inputBuffer,
+    OutputPixelType * outputBuffer,
+    itk::SizeValueType voxelBegin,
+    itk::SizeValueType voxelEnd ) const
+  {
+    typedef typename itk::NumericTraits< InputPixelType >::RealType RealType;
+    const RealType minOutputValue = static_cast< RealType >( itk::NumericTraits< OutputPixelType >::NonpositiveMin() );
+    const RealType maxOutputValue = static_cast< RealType >( itk::NumericTraits< OutputPixelType >::max() );
+    const OutputPixelType defaultValue = itk::NumericTraits< OutputPixelType >::ZeroValue();
+
+    static const unsigned int NumberOfNeighbors = 1 << ImageDimension;
+    for( itk::SizeValueType voxel = voxelBegin; voxel < voxelEnd; ++voxel )
+      {
+      const OffsetValueType offset = m_Offsets[voxel];
+      if( offset < 0 )
+        {
+        outputBuffer[voxel] = defaultValue;
+        continue;
+        }
+
+      RealType value;
+      if( m_Method == ITK_NEAREST_NEIGHBOR )
+        {
+        value = static_cast< RealType >( ReplaceNonFinite ? ScanConversionFiniteSample( inputBuffer[offset] ) : inputBuffer[offset] );
+        }
+      else
+        {
+        // Gather the corners, then reduce them one axis at a time
+        RealType neighbors[NumberOfNeighbors];
+        for( unsigned int neighbor = 0; neighbor < NumberOfNeighbors; ++neighbor )
+          {
+          OffsetValueType neighborOffset = offset;
+          for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+            {
+            if( neighbor & ( 1 << dim ) )
+              {
+              neighborOffset += m_Strides[dim];
+              }
+            }
+          neighbors[neighbor] = static_cast< RealType >( ReplaceNonFinite ? ScanConversionFiniteSample( inputBuffer[neighborOffset] ) : inputBuffer[neighborOffset] );
+          }
+        const FractionValueType * fractions = &(m_Fractions[voxel * ImageDimension]);
+        unsigned int remaining = NumberOfNeighbors;
+        for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+          {
+          remaining /= 2;
+          for( unsigned int neighbor = 0; neighbor < remaining; ++neighbor )
+            {
+            const RealType lower = neighbors[2 * neighbor];
+            const RealType upper = neighbors[2 * neighbor + 1];
+            neighbors[neighbor] = lower + ( upper - lower ) * fractions[dim];
+            }
+          }
+        value = neighbors[0];
+        }
+
+      if( value < minOutputValue )
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( minOutputValue );
+        }
+      else if( value > maxOutputValue )
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( maxOutputValue );
+        }
+      else
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( value );
+        }
+      }
+  }
+
+  bool WriteStream( const std::string & fileName ) const
+  {
+    std::ofstream stream( fileName.c_str(), std::ios::out | std::ios::binary );
+    if( !stream )
+      {
+      return false;
+      }
+
+    stream.write( MagicString, sizeof( MagicString ) );
+    const itk::uint32_t dimension = ImageDimension;
+    stream.write( reinterpret_cast< const char * >( &dimension ), sizeof( dimension ) );
+    const itk::uint64_t keyLength = m_GeometryKey.size();
+    stream.write( reinterpret_cast< const char * >( &keyLength ), sizeof( keyLength ) );
+    stream.write( reinterpret_cast< const char * >( &(m_GeometryKey[0]) ), keyLength * sizeof( double ) );
+    const itk::uint64_t numberOfVoxels = m_NumberOfVoxels;
+    stream.write( reinterpret_cast< const char * >( &numberOfVoxels ), sizeof( numberOfVoxels ) );
+    stream.write( reinterpret_cast< const char * >( m_Strides ), sizeof( m_Strides ) );
+    stream.write( reinterpret_cast< const char * >( &(m_Offsets[0]) ), m_NumberOfVoxels * sizeof( OffsetValueType ) );
+    stream.write( reinterpret_cast< const char * >( &(m_Fractions[0]) ), m_NumberOfVoxels * ImageDimension * sizeof( FractionValueType ) );
+    return !stream.fail();
+  }
+
+  /** The output grid is recovered from the geometry key, which is laid out by
+   * MakeGeometryKey. */
+  void GetOutputGrid( SizeType & size, SpacingType & spacing, PointType & origin, DirectionType & direction ) const
+  {
+    unsigned int position = 1 + 4 * ImageDimension;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      size[dim] = static_cast< itk::SizeValueType >( m_GeometryKey[position++] );
+      spacing[dim] = m_GeometryKey[position++];
+      origin[dim] = m_GeometryKey[position++];
+      for( unsigned int column = 0; column < ImageDimension; ++column )
+        {
+        direction[dim][column] = m_GeometryKey[position++];
+        }
+      }
+  }
+
+  static const char MagicString[8];
+
+  ScanConversionResamplingMethod m_Method;
+  bool                           m_ReplaceNonFinite;
+  GeometryKeyType                m_GeometryKey;
+  itk::SizeValueType             m_NumberOfVoxels;
+  OffsetValueType                m_Strides[ImageDimension];
+  std::vector< OffsetValueType > m_Offsets;
+  std::vector< FractionValueType > m_Fractions;
+};
+
+template< typename TInputImage, typename TOutputImage >
+const char ScanConversionLookupTable< TInputImage, TOutputImage >::MagicString[8] = { 'S', 'C', 'L', 'U', 'T', '0', '0', '1' };
+
+
+/** Resample with a lookup table that is read from
+ * options.LookupTableFileName when it matches the geometry, or computed and
+ * written to options.LookupTableFileName otherwise. The key of the table
+ * records options.LookupTableGeometryParameters. Methods that cannot be
+ * tabulated fall back to ScanConversionResampling with the options. */
+template< typename TInputImage, typename TOutputImage >
+int
+LookupTableScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+  typedef ScanConversionLookupTable< InputImageType, OutputImageType > LookupTableType;
+
+  const ScanConversionResamplingMethod method = ScanConversionResamplingMethodFromString( methodString );
+  if( !LookupTableType::SupportsMethod( method ) )
+    {
+    std::cerr << "Lookup tables are not available for the " << methodString
+      << " method, resampling without a lookup table." << std::endl;
+    return ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      methodString,
+      options,
+      CLPProcessInformation
+    );
+    }
+
+  LookupTableType lookupTable;
+  lookupTable.SetReplaceNonFinite( options.ReplaceNonFinite );
+  if( lookupTable.ReadOrBuild( inputImage.GetPointer(),
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      options.LookupTableGeometryParameters,
+      options.LookupTableFileName ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return lookupTable.Apply( inputImage.GetPointer(), outputImage );
+}
+
+}
+
+#endif
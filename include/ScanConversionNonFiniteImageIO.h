@@ -0,0 +1,148 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionNonFiniteImageIO_h
+#define ScanConversionNonFiniteImageIO_h
+
+#include "itkCreateObjectFunction.h"
+#include "itkImageIOBase.h"
+#include "itkObjectFactoryBase.h"
+#include "itkVersion.h"
+#include "vnl/vnl_math.h"
+
+namespace
+{
+
+/** \class ScanConversionNonFiniteImageIO
+ *
+ * \brief An ImageIO that replaces the non-finite samples it reads with zero.
+ *
+ * The replacement is applied to the IO region that TImageIO has just read
+ * into the buffer, so when the reader streams, each requested region is
+ * sanitized in the same pass that reads it, and no separate pass of an
+ * itk::ReplaceNonFiniteImageFilter over the whole volume is needed. The IO
+ * does not read the file lazily or by HDF5 chunks: how much of the file a
+ * region reads is up to TImageIO. Only float and double components can be
+ * non-finite. Everything else, including the meta data and the streaming
+ * support, is TImageIO.
+ */
+template< typename TImageIO >
+class ScanConversionNonFiniteImageIO: public TImageIO
+{
+public:
+  typedef ScanConversionNonFiniteImageIO  Self;
+  typedef TImageIO                        Superclass;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionNonFiniteImageIO, TImageIO );
+
+  virtual void Read( void * buffer ) ITK_OVERRIDE
+    {
+    Superclass::Read( buffer );
+
+    const itk::SizeValueType numberOfValues = this->GetIORegion().GetNumberOfPixels() * this->GetNumberOfComponents();
+    switch( this->GetComponentType() )
+      {
+    case itk::ImageIOBase::FLOAT:
+      ReplaceNonFinite( static_cast< float * >( buffer ), numberOfValues );
+      break;
+    case itk::ImageIOBase::DOUBLE:
+      ReplaceNonFinite( static_cast< double * >( buffer ), numberOfValues );
+      break;
+    default:
+      break;
+      }
+    }
+
+protected:
+  ScanConversionNonFiniteImageIO() {}
+  ~ScanConversionNonFiniteImageIO() {}
+
+private:
+  ScanConversionNonFiniteImageIO( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  template< typename TValue >
+  static void ReplaceNonFinite( TValue * values, itk::SizeValueType numberOfValues )
+    {
+    for( itk::SizeValueType ii = 0; ii < numberOfValues; ++ii )
+      {
+      if( !vnl_math::isfinite( values[ii] ) )
+        {
+        values[ii] = 0;
+        }
+      }
+    }
+};
+
+
+/** \class ScanConversionNonFiniteImageIOFactory
+ *
+ * \brief Creates a ScanConversionNonFiniteImageIO of TImageIO for the image
+ * readers, in place of the factory of TImageIO.
+ */
+template< typename TImageIO >
+class ScanConversionNonFiniteImageIOFactory: public itk::ObjectFactoryBase
+{
+public:
+  typedef ScanConversionNonFiniteImageIOFactory Self;
+  typedef itk::ObjectFactoryBase                Superclass;
+  typedef itk::SmartPointer< Self >             Pointer;
+  typedef itk::SmartPointer< const Self >       ConstPointer;
+  typedef ScanConversionNonFiniteImageIO< TImageIO > ImageIOType;
+
+  itkFactorylessNewMacro( Self );
+  itkTypeMacro( ScanConversionNonFiniteImageIOFactory, ObjectFactoryBase );
+
+  virtual const char * GetITKSourceVersion() const ITK_OVERRIDE
+    {
+    return ITK_SOURCE_VERSION;
+    }
+
+  virtual const char * GetDescription() const ITK_OVERRIDE
+    {
+    return "ImageIO that replaces the non-finite samples it reads with zero";
+    }
+
+  static void RegisterOneFactory()
+    {
+    Pointer factory = Self::New();
+    itk::ObjectFactoryBase::RegisterFactoryInternal( factory );
+    }
+
+protected:
+  ScanConversionNonFiniteImageIOFactory()
+  {
+    this->RegisterOverride( "itkImageIOBase",
+      "ScanConversionNonFiniteImageIO",
+      "ImageIO that replaces the non-finite samples it reads with zero",
+      1,
+      itk::CreateObjectFunction< ImageIOType >::New() );
+  }
+  ~ScanConversionNonFiniteImageIOFactory() {}
+
+private:
+  ScanConversionNonFiniteImageIOFactory( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+};
+
+}
+
+#endif
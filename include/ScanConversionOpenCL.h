@@ -0,0 +1,730 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionOpenCL_h
+#define ScanConversionOpenCL_h
+
+#include "itkCurvilinearArraySpecialCoordinatesImage.h"
+#include "itkPhasedArray3DSpecialCoordinatesImage.h"
+#include "itkNumericTraits.h"
+
+#include "ScanConversionGeometry.h"
+#include "ScanConversionProfiler.h"
+
+#include <vector>
+
+#ifdef SlicerITKUltrasound_ENABLE_GPU
+// The resampler only uses the OpenCL 1.1 API, e.g. clCreateImage3D and
+// clCreateCommandQueue. Headers that predate CL_TARGET_OPENCL_VERSION
+// declare them deprecated unless the deprecated APIs are enabled.
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 110
+#endif
+#define CL_USE_DEPRECATED_OPENCL_1_1_APIS
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#if defined( __APPLE__ )
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+namespace
+{
+
+/** Mapping from the output grid to the continuous index of a polar special
+ * coordinates image, which is evaluated by the OpenCL kernel.
+ *
+ * For a curvilinear array, the radius and lateral angle are in the plane of
+ * the first two axes and the elevation index is linear in the third
+ * coordinate. For a phased array 3D probe, the azimuth and elevation angles
+ * are measured from the third axis, which is the depth. The first axis of the
+ * continuous index is the fastest varying axis of the input buffer. */
+struct ScanConversionOpenCLGeometry
+{
+  ScanConversionOpenCLGeometry():
+    Geometry( ScanConversionSector::UNSPECIFIED_GEOMETRY ),
+    RadiusScale( 0.0 ),
+    RadiusOffset( 0.0 ),
+    LateralScale( 0.0 ),
+    LateralOffset( 0.0 ),
+    ElevationScale( 0.0 ),
+    ElevationOffset( 0.0 )
+  {
+    Apex[0] = 0.0;
+    Apex[1] = 0.0;
+    Apex[2] = 0.0;
+    InputSize[0] = 0;
+    InputSize[1] = 0;
+    InputSize[2] = 0;
+  }
+
+  ScanConversionSector::GeometryType Geometry;
+  double       Apex[3];
+  double       RadiusScale;
+  double       RadiusOffset;
+  double       LateralScale;
+  double       LateralOffset;
+  double       ElevationScale;
+  double       ElevationOffset;
+  unsigned int InputSize[3];
+};
+
+
+/** Only the polar geometries can be scan converted on the GPU. */
+template< typename TInputImage >
+bool
+MakeScanConversionOpenCLGeometry( const TInputImage *, ScanConversionOpenCLGeometry & )
+{
+  return false;
+}
+
+
+template< typename TPixel >
+bool
+MakeScanConversionOpenCLGeometry( const itk::CurvilinearArraySpecialCoordinatesImage< TPixel, 3 > * inputImage,
+  ScanConversionOpenCLGeometry & geometry )
+{
+  typedef itk::CurvilinearArraySpecialCoordinatesImage< TPixel, 3 > InputImageType;
+  const typename InputImageType::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const ScanConversionSector sector = MakeCurvilinearArraySector( inputImage );
+
+  geometry.Geometry = ScanConversionSector::CURVILINEAR_ARRAY;
+  for( unsigned int ii = 0; ii < 3; ++ii )
+    {
+    geometry.Apex[ii] = sector.Apex[ii];
+    geometry.InputSize[ii] = inputRegion.GetSize( ii );
+    }
+  geometry.RadiusScale = 1.0 / inputImage->GetRadiusSampleSize();
+  geometry.RadiusOffset = -inputImage->GetFirstSampleDistance() * geometry.RadiusScale;
+  geometry.LateralScale = 1.0 / inputImage->GetLateralAngularSeparation();
+  geometry.LateralOffset = ( inputRegion.GetSize( 1 ) - 1 ) / 2.0;
+
+  // The elevation index only depends on the third coordinate, so it is
+  // calibrated from the image at two points on the center line of the fan
+  typename InputImageType::PointType point;
+  point[0] = sector.Apex[0];
+  point[1] = sector.Apex[1] + inputImage->GetFirstSampleDistance() + inputImage->GetRadiusSampleSize();
+  point[2] = 0.0;
+  itk::ContinuousIndex< double, 3 > index;
+  inputImage->TransformPhysicalPointToContinuousIndex( point, index );
+  const double elevationAtZero = index[2] - inputRegion.GetIndex( 2 );
+  point[2] = 1.0;
+  inputImage->TransformPhysicalPointToContinuousIndex( point, index );
+  geometry.ElevationScale = index[2] - inputRegion.GetIndex( 2 ) - elevationAtZero;
+  geometry.ElevationOffset = elevationAtZero;
+  return true;
+}
+
+
+template< typename TPixel >
+bool
+MakeScanConversionOpenCLGeometry( const itk::PhasedArray3DSpecialCoordinatesImage< TPixel > * inputImage,
+  ScanConversionOpenCLGeometry & geometry )
+{
+  typedef itk::PhasedArray3DSpecialCoordinatesImage< TPixel > InputImageType;
+  const typename InputImageType::RegionType & inputRegion = inputImage->GetLargestPossibleRegion();
+  const ScanConversionSector sector = MakePhasedArray3DSector( inputImage );
+
+  geometry.Geometry = ScanConversionSector::PHASED_ARRAY_3D;
+  for( unsigned int ii = 0; ii < 3; ++ii )
+    {
+    geometry.Apex[ii] = sector.Apex[ii];
+    geometry.InputSize[ii] = inputRegion.GetSize( ii );
+    }
+  geometry.RadiusScale = 1.0 / inputImage->GetRadiusSampleSize();
+  geometry.RadiusOffset = -inputImage->GetFirstSampleDistance() * geometry.RadiusScale;
+  geometry.LateralScale = 1.0 / inputImage->GetAzimuthAngularSeparation();
+  geometry.LateralOffset = ( inputRegion.GetSize( 0 ) - 1 ) / 2.0;
+  geometry.ElevationScale = 1.0 / inputImage->GetElevationAngularSeparation();
+  geometry.ElevationOffset = ( inputRegion.GetSize( 1 ) - 1 ) / 2.0;
+  return true;
+}
+
+
+#ifdef SlicerITKUltrasound_ENABLE_GPU
+
+/** OpenCL image channel type for an input pixel type. The normalized integer
+ * formats are filtered by the texture units, and the filtered value is
+ * scaled back to the pixel range. Other pixel types are uploaded as float. */
+template< typename TPixel >
+struct ScanConversionOpenCLPixelTraits
+{
+  typedef float ChannelType;
+  static cl_channel_type ChannelDataType() { return CL_FLOAT; }
+  static float ValueScale() { return 1.0f; }
+};
+
+template<>
+struct ScanConversionOpenCLPixelTraits< unsigned char >
+{
+  typedef unsigned char ChannelType;
+  static cl_channel_type ChannelDataType() { return CL_UNORM_INT8; }
+  static float ValueScale() { return 255.0f; }
+};
+
+template<>
+struct ScanConversionOpenCLPixelTraits< unsigned short >
+{
+  typedef unsigned short ChannelType;
+  static cl_channel_type ChannelDataType() { return CL_UNORM_INT16; }
+  static float ValueScale() { return 65535.0f; }
+};
+
+template<>
+struct ScanConversionOpenCLPixelTraits< short >
+{
+  typedef short ChannelType;
+  static cl_channel_type ChannelDataType() { return CL_SNORM_INT16; }
+  static float ValueScale() { return 32767.0f; }
+};
+
+
+/** Continuous index of every output voxel, a bounds check that follows
+ * itk::ImageFunction::IsInsideBuffer, and a hardware trilinear fetch. Texel
+ * centers are at half integer unnormalized coordinates. */
+const char * const ScanConversionOpenCLSource =
+  "__constant sampler_t linearSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;\n"
+  "\n"
+  "__kernel void ScanConvert( __read_only image3d_t samples,\n"
+  "  __global float * output,\n"
+  "  const int4 outputSize,\n"
+  "  const float4 origin,\n"
+  "  const float4 stepX,\n"
+  "  const float4 stepY,\n"
+  "  const float4 stepZ,\n"
+  "  const int geometry,\n"
+  "  const float4 indexScale,\n"
+  "  const float4 indexOffset,\n"
+  "  const int4 inputSize,\n"
+  "  const float valueScale )\n"
+  "{\n"
+  "  const int i = get_global_id( 0 );\n"
+  "  const int j = get_global_id( 1 );\n"
+  "  const int k = get_global_id( 2 );\n"
+  "  if( i >= outputSize.x || j >= outputSize.y || k >= outputSize.z )\n"
+  "    {\n"
+  "    return;\n"
+  "    }\n"
+  "  const float4 point = origin + i * stepX + j * stepY + k * stepZ;\n"
+  "  float4 index;\n"
+  "  if( geometry == 0 )\n"
+  "    {\n"
+  "    index.x = sqrt( point.x * point.x + point.y * point.y );\n"
+  "    index.y = atan( point.x / point.y );\n"
+  "    index.z = point.z;\n"
+  "    }\n"
+  "  else\n"
+  "    {\n"
+  "    index.x = atan( point.x / point.z );\n"
+  "    index.y = atan( point.y / point.z );\n"
+  "    index.z = sqrt( point.x * point.x + point.y * point.y + point.z * point.z );\n"
+  "    }\n"
+  "  index = index * indexScale + indexOffset;\n"
+  "  index.w = 0.0f;\n"
+  "  const size_t voxel = ( (size_t)k * outputSize.y + j ) * outputSize.x + i;\n"
+  "  if( !( index.x >= -0.5f && index.x < inputSize.x - 0.5f\n"
+  "      && index.y >= -0.5f && index.y < inputSize.y - 0.5f\n"
+  "      && index.z >= -0.5f && index.z < inputSize.z - 0.5f ) )\n"
+  "    {\n"
+  "    output[voxel] = 0.0f;\n"
+  "    return;\n"
+  "    }\n"
+  "  output[voxel] = valueScale * read_imagef( samples, linearSampler, index + (float4)( 0.5f, 0.5f, 0.5f, 0.0f ) ).x;\n"
+  "}\n";
+
+
+/** \class OpenCLScanConversionResampler
+ *
+ * \brief Scan convert curvilinear array and phased array 3D frames on the GPU.
+ *
+ * The samples of each frame are uploaded to a 3D OpenCL image, and every
+ * output voxel is computed by one work item with the polar or spherical
+ * mapping of the probe and a trilinear fetch by the texture units. The
+ * context, program, image, and output buffer are created by Initialize and
+ * reused for every frame with the same geometry.
+ *
+ * The texture units interpolate with reduced precision fractional weights
+ * and the mapping is evaluated in single precision, so the output differs
+ * slightly from ITKLinear. Samples outside the input buffer are zero, as in
+ * ITKLinear. */
+template< typename TInputImage, typename TOutputImage >
+class OpenCLScanConversionResampler
+{
+public:
+  typedef TInputImage                             InputImageType;
+  typedef TOutputImage                            OutputImageType;
+  typedef typename InputImageType::PixelType      InputPixelType;
+  typedef typename OutputImageType::PixelType     OutputPixelType;
+  typedef typename OutputImageType::SizeType      SizeType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  typedef ScanConversionOpenCLPixelTraits< InputPixelType > PixelTraitsType;
+  typedef typename PixelTraitsType::ChannelType             ChannelType;
+
+  OpenCLScanConversionResampler():
+    m_Context( ITK_NULLPTR ),
+    m_Queue( ITK_NULLPTR ),
+    m_Program( ITK_NULLPTR ),
+    m_Kernel( ITK_NULLPTR ),
+    m_Samples( ITK_NULLPTR ),
+    m_Output( ITK_NULLPTR )
+  {
+  }
+
+  ~OpenCLScanConversionResampler()
+  {
+    this->Release();
+  }
+
+  /** Create the OpenCL objects for the geometry of the inputImage sampled on
+   * the given output grid. */
+  int Initialize( const InputImageType * inputImage,
+    const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction )
+  {
+    this->Release();
+    if( !MakeScanConversionOpenCLGeometry( inputImage, m_Geometry ) )
+      {
+      std::cerr << "GPU scan conversion is only available for curvilinear array and phased array 3D images" << std::endl;
+      return EXIT_FAILURE;
+      }
+    m_Size = size;
+    m_Spacing = spacing;
+    m_Origin = origin;
+    m_Direction = direction;
+
+    cl_device_id device;
+    if( !SelectDevice( device ) )
+      {
+      std::cerr << "No OpenCL device with image support was found" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    cl_int error = CL_SUCCESS;
+    m_Context = clCreateContext( ITK_NULLPTR, 1, &device, ITK_NULLPTR, ITK_NULLPTR, &error );
+    if( !CheckError( error, "clCreateContext" ) )
+      {
+      return EXIT_FAILURE;
+      }
+    m_Queue = clCreateCommandQueue( m_Context, device, 0, &error );
+    if( !CheckError( error, "clCreateCommandQueue" ) )
+      {
+      return EXIT_FAILURE;
+      }
+
+    const char * source = ScanConversionOpenCLSource;
+    m_Program = clCreateProgramWithSource( m_Context, 1, &source, ITK_NULLPTR, &error );
+    if( !CheckError( error, "clCreateProgramWithSource" ) )
+      {
+      return EXIT_FAILURE;
+      }
+    error = clBuildProgram( m_Program, 1, &device, "-cl-mad-enable", ITK_NULLPTR, ITK_NULLPTR );
+    if( error != CL_SUCCESS )
+      {
+      size_t logSize = 0;
+      clGetProgramBuildInfo( m_Program, device, CL_PROGRAM_BUILD_LOG, 0, ITK_NULLPTR, &logSize );
+      std::vector< char > log( logSize + 1, '\0' );
+      clGetProgramBuildInfo( m_Program, device, CL_PROGRAM_BUILD_LOG, logSize, &log[0], ITK_NULLPTR );
+      std::cerr << "Could not build the OpenCL scan conversion kernel:\n" << &log[0] << std::endl;
+      return EXIT_FAILURE;
+      }
+    m_Kernel = clCreateKernel( m_Program, "ScanConvert", &error );
+    if( !CheckError( error, "clCreateKernel" ) )
+      {
+      return EXIT_FAILURE;
+      }
+
+    cl_image_format imageFormat;
+    imageFormat.image_channel_order = CL_R;
+    imageFormat.image_channel_data_type = PixelTraitsType::ChannelDataType();
+    m_Samples = clCreateImage3D( m_Context,
+      CL_MEM_READ_ONLY,
+      &imageFormat,
+      m_Geometry.InputSize[0],
+      m_Geometry.InputSize[1],
+      m_Geometry.InputSize[2],
+      0,
+      0,
+      ITK_NULLPTR,
+      &error );
+    if( !CheckError( error, "clCreateImage3D" ) )
+      {
+      return EXIT_FAILURE;
+      }
+    m_OutputValues.resize( size[0] * size[1] * size[2] );
+    m_Output = clCreateBuffer( m_Context, CL_MEM_WRITE_ONLY, m_OutputValues.size() * sizeof( float ), ITK_NULLPTR, &error );
+    if( !CheckError( error, "clCreateBuffer" ) )
+      {
+      return EXIT_FAILURE;
+      }
+
+    return this->SetKernelArguments();
+  }
+
+  /** Resample the inputImage, which must have the geometry given to
+   * Initialize. */
+  int Resample( const InputImageType * inputImage,
+    typename OutputImageType::Pointer & outputImage )
+  {
+    if( m_Kernel == ITK_NULLPTR )
+      {
+      std::cerr << "The GPU scan conversion resampler has not been initialized" << std::endl;
+      return EXIT_FAILURE;
+      }
+    const typename InputImageType::SizeType & inputSize = inputImage->GetBufferedRegion().GetSize();
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      if( inputSize[ii] != m_Geometry.InputSize[ii] )
+        {
+        std::cerr << "The input size differs from the size of the input used to initialize the GPU resampler" << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+
+    ScanConversionProfileScope profileResampling( "Resample Image" );
+    const ChannelType * samples = this->GetSamples( inputImage );
+    const size_t imageOrigin[3] = { 0, 0, 0 };
+    const size_t imageRegion[3] = { inputSize[0], inputSize[1], inputSize[2] };
+    cl_int error = clEnqueueWriteImage( m_Queue, m_Samples, CL_FALSE, imageOrigin, imageRegion, 0, 0, samples, 0, ITK_NULLPTR, ITK_NULLPTR );
+    if( !CheckError( error, "clEnqueueWriteImage" ) )
+      {
+      return EXIT_FAILURE;
+      }
+    const size_t globalWorkSize[3] = { m_Size[0], m_Size[1], m_Size[2] };
+    error = clEnqueueNDRangeKernel( m_Queue, m_Kernel, 3, ITK_NULLPTR, globalWorkSize, ITK_NULLPTR, 0, ITK_NULLPTR, ITK_NULLPTR );
+    if( !CheckError( error, "clEnqueueNDRangeKernel" ) )
+      {
+      return EXIT_FAILURE;
+      }
+    error = clEnqueueReadBuffer( m_Queue, m_Output, CL_TRUE, 0, m_OutputValues.size() * sizeof( float ), &m_OutputValues[0], 0, ITK_NULLPTR, ITK_NULLPTR );
+    if( !CheckError( error, "clEnqueueReadBuffer" ) )
+      {
+      return EXIT_FAILURE;
+      }
+
+    typename OutputImageType::Pointer output = OutputImageType::New();
+    output->SetRegions( m_Size );
+    output->SetSpacing( m_Spacing );
+    output->SetOrigin( m_Origin );
+    output->SetDirection( m_Direction );
+    output->Allocate();
+
+    const float minOutputValue = static_cast< float >( itk::NumericTraits< OutputPixelType >::NonpositiveMin() );
+    const float maxOutputValue = static_cast< float >( itk::NumericTraits< OutputPixelType >::max() );
+    OutputPixelType * outputBuffer = output->GetBufferPointer();
+    for( std::size_t voxel = 0; voxel < m_OutputValues.size(); ++voxel )
+      {
+      const float value = m_OutputValues[voxel];
+      if( value < minOutputValue )
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( minOutputValue );
+        }
+      else if( value > maxOutputValue )
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( maxOutputValue );
+        }
+      else
+        {
+        outputBuffer[voxel] = static_cast< OutputPixelType >( value );
+        }
+      }
+
+    outputImage = output;
+    return EXIT_SUCCESS;
+  }
+
+private:
+  OpenCLScanConversionResampler( const OpenCLScanConversionResampler & ); // purposely not implemented
+  void operator=( const OpenCLScanConversionResampler & ); // purposely not implemented
+
+  /** Select the first GPU with image support, or any device with image
+   * support when there is no such GPU. */
+  static bool SelectDevice( cl_device_id & device )
+  {
+    cl_uint numberOfPlatforms = 0;
+    if( clGetPlatformIDs( 0, ITK_NULLPTR, &numberOfPlatforms ) != CL_SUCCESS || numberOfPlatforms == 0 )
+      {
+      return false;
+      }
+    std::vector< cl_platform_id > platforms( numberOfPlatforms );
+    clGetPlatformIDs( numberOfPlatforms, &platforms[0], ITK_NULLPTR );
+    const cl_device_type deviceTypes[2] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL };
+    for( unsigned int typeIndex = 0; typeIndex < 2; ++typeIndex )
+      {
+      for( cl_uint platformIndex = 0; platformIndex < numberOfPlatforms; ++platformIndex )
+        {
+        cl_uint numberOfDevices = 0;
+        if( clGetDeviceIDs( platforms[platformIndex], deviceTypes[typeIndex], 0, ITK_NULLPTR, &numberOfDevices ) != CL_SUCCESS
+          || numberOfDevices == 0 )
+          {
+          continue;
+          }
+        std::vector< cl_device_id > devices( numberOfDevices );
+        clGetDeviceIDs( platforms[platformIndex], deviceTypes[typeIndex], numberOfDevices, &devices[0], ITK_NULLPTR );
+        for( cl_uint deviceIndex = 0; deviceIndex < numberOfDevices; ++deviceIndex )
+          {
+          cl_bool imageSupport = CL_FALSE;
+          clGetDeviceInfo( devices[deviceIndex], CL_DEVICE_IMAGE_SUPPORT, sizeof( imageSupport ), &imageSupport, ITK_NULLPTR );
+          if( imageSupport == CL_TRUE )
+            {
+            device = devices[deviceIndex];
+            return true;
+            }
+          }
+        }
+      }
+    return false;
+  }
+
+  static bool CheckError( cl_int error, const char * call )
+  {
+    if( error != CL_SUCCESS )
+      {
+      std::cerr << call << " failed with OpenCL error " << error << std::endl;
+      return false;
+      }
+    return true;
+  }
+
+  int SetKernelArguments()
+  {
+    // Physical coordinates relative to the apex of each output voxel are
+    // origin + i * stepX + j * stepY + k * stepZ
+    cl_int4 outputSize;
+    cl_float4 origin;
+    cl_float4 steps[3];
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      outputSize.s[ii] = static_cast< cl_int >( m_Size[ii] );
+      origin.s[ii] = static_cast< cl_float >( m_Origin[ii] - m_Geometry.Apex[ii] );
+      for( unsigned int jj = 0; jj < 3; ++jj )
+        {
+        steps[jj].s[ii] = static_cast< cl_float >( m_Direction[ii][jj] * m_Spacing[jj] );
+        }
+      }
+    outputSize.s[3] = 0;
+    origin.s[3] = 0.0f;
+    steps[0].s[3] = 0.0f;
+    steps[1].s[3] = 0.0f;
+    steps[2].s[3] = 0.0f;
+
+    const cl_int geometry = m_Geometry.Geometry == ScanConversionSector::CURVILINEAR_ARRAY ? 0 : 1;
+    cl_float4 indexScale;
+    cl_float4 indexOffset;
+    if( geometry == 0 )
+      {
+      indexScale.s[0] = static_cast< cl_float >( m_Geometry.RadiusScale );
+      indexScale.s[1] = static_cast< cl_float >( m_Geometry.LateralScale );
+      indexScale.s[2] = static_cast< cl_float >( m_Geometry.ElevationScale );
+      indexOffset.s[0] = static_cast< cl_float >( m_Geometry.RadiusOffset );
+      indexOffset.s[1] = static_cast< cl_float >( m_Geometry.LateralOffset );
+      // The elevation is calibrated in absolute coordinates
+      indexOffset.s[2] = static_cast< cl_float >( m_Geometry.ElevationOffset + m_Geometry.ElevationScale * m_Geometry.Apex[2] );
+      }
+    else
+      {
+      indexScale.s[0] = static_cast< cl_float >( m_Geometry.LateralScale );
+      indexScale.s[1] = static_cast< cl_float >( m_Geometry.ElevationScale );
+      indexScale.s[2] = static_cast< cl_float >( m_Geometry.RadiusScale );
+      indexOffset.s[0] = static_cast< cl_float >( m_Geometry.LateralOffset );
+      indexOffset.s[1] = static_cast< cl_float >( m_Geometry.ElevationOffset );
+      indexOffset.s[2] = static_cast< cl_float >( m_Geometry.RadiusOffset );
+      }
+    indexScale.s[3] = 0.0f;
+    indexOffset.s[3] = 0.0f;
+
+    cl_int4 inputSize;
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      inputSize.s[ii] = static_cast< cl_int >( m_Geometry.InputSize[ii] );
+      }
+    inputSize.s[3] = 0;
+    const cl_float valueScale = PixelTraitsType::ValueScale();
+
+    // The error codes are negative, so each call is checked on its own
+    // instead of combining the codes
+    const size_t argumentSizes[] = {
+      sizeof( cl_mem ),
+      sizeof( cl_mem ),
+      sizeof( cl_int4 ),
+      sizeof( cl_float4 ),
+      sizeof( cl_float4 ),
+      sizeof( cl_float4 ),
+      sizeof( cl_float4 ),
+      sizeof( cl_int ),
+      sizeof( cl_float4 ),
+      sizeof( cl_float4 ),
+      sizeof( cl_int4 ),
+      sizeof( cl_float ) };
+    const void * const argumentValues[] = {
+      &m_Samples,
+      &m_Output,
+      &outputSize,
+      &origin,
+      &steps[0],
+      &steps[1],
+      &steps[2],
+      &geometry,
+      &indexScale,
+      &indexOffset,
+      &inputSize,
+      &valueScale };
+    const cl_uint numberOfArguments = sizeof( argumentSizes ) / sizeof( argumentSizes[0] );
+    for( cl_uint argument = 0; argument < numberOfArguments; ++argument )
+      {
+      const cl_int error = clSetKernelArg( m_Kernel, argument, argumentSizes[argument], argumentValues[argument] );
+      if( error != CL_SUCCESS )
+        {
+        std::cerr << "clSetKernelArg of argument " << argument << " failed with OpenCL error " << error << std::endl;
+        return EXIT_FAILURE;
+        }
+      }
+    return EXIT_SUCCESS;
+  }
+
+  /** Samples in the channel type of the OpenCL image, converted into
+   * m_Samples when the pixel type has no matching channel type. */
+  const ChannelType * GetSamples( const InputImageType * inputImage )
+  {
+    const InputPixelType * inputBuffer = inputImage->GetBufferPointer();
+    if( sizeof( ChannelType ) == sizeof( InputPixelType )
+      && static_cast< ChannelType >( 0.5 ) == static_cast< InputPixelType >( 0.5 ) )
+      {
+      return reinterpret_cast< const ChannelType * >( inputBuffer );
+      }
+    const std::size_t numberOfSamples = inputImage->GetBufferedRegion().GetNumberOfPixels();
+    m_ConvertedSamples.resize( numberOfSamples );
+    for( std::size_t sample = 0; sample < numberOfSamples; ++sample )
+      {
+      m_ConvertedSamples[sample] = static_cast< ChannelType >( inputBuffer[sample] );
+      }
+    return &m_ConvertedSamples[0];
+  }
+
+  void Release()
+  {
+    if( m_Output != ITK_NULLPTR )
+      {
+      clReleaseMemObject( m_Output );
+      m_Output = ITK_NULLPTR;
+      }
+    if( m_Samples != ITK_NULLPTR )
+      {
+      clReleaseMemObject( m_Samples );
+      m_Samples = ITK_NULLPTR;
+      }
+    if( m_Kernel != ITK_NULLPTR )
+      {
+      clReleaseKernel( m_Kernel );
+      m_Kernel = ITK_NULLPTR;
+      }
+    if( m_Program != ITK_NULLPTR )
+      {
+      clReleaseProgram( m_Program );
+      m_Program = ITK_NULLPTR;
+      }
+    if( m_Queue != ITK_NULLPTR )
+      {
+      clReleaseCommandQueue( m_Queue );
+      m_Queue = ITK_NULLPTR;
+      }
+    if( m_Context != ITK_NULLPTR )
+      {
+      clReleaseContext( m_Context );
+      m_Context = ITK_NULLPTR;
+      }
+  }
+
+  ScanConversionOpenCLGeometry m_Geometry;
+  SizeType                     m_Size;
+  SpacingType                  m_Spacing;
+  PointType                    m_Origin;
+  DirectionType                m_Direction;
+
+  cl_context                   m_Context;
+  cl_command_queue             m_Queue;
+  cl_program                   m_Program;
+  cl_kernel                    m_Kernel;
+  cl_mem                       m_Samples;
+  cl_mem                       m_Output;
+  std::vector< ChannelType >   m_ConvertedSamples;
+  std::vector< float >         m_OutputValues;
+};
+
+#else
+
+/** Without SlicerITKUltrasound_ENABLE_GPU, the GPU resampler reports that it
+ * is not available. */
+template< typename TInputImage, typename TOutputImage >
+class OpenCLScanConversionResampler
+{
+public:
+  typedef TInputImage                             InputImageType;
+  typedef TOutputImage                            OutputImageType;
+  typedef typename OutputImageType::SizeType      SizeType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  int Initialize( const InputImageType *,
+    const SizeType &,
+    const SpacingType &,
+    const PointType &,
+    const DirectionType & )
+  {
+    std::cerr << "GPU scan conversion is not available: build with SlicerITKUltrasound_ENABLE_GPU" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int Resample( const InputImageType *,
+    typename OutputImageType::Pointer & )
+  {
+    return EXIT_FAILURE;
+  }
+};
+
+#endif
+
+
+/** Scan convert a single frame on the GPU. */
+template< typename TInputImage, typename TOutputImage >
+int
+OpenCLScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction
+  )
+{
+  OpenCLScanConversionResampler< TInputImage, TOutputImage > resampler;
+  if( resampler.Initialize( inputImage.GetPointer(), size, spacing, origin, direction ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return resampler.Resample( inputImage.GetPointer(), outputImage );
+}
+
+}
+
+#endif
@@ -0,0 +1,403 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionProfiler_h
+#define ScanConversionProfiler_h
+
+#include "itkIntTypes.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+#include "itkPluginFilterWatcher.h"
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#include <psapi.h>
+#if defined( _MSC_VER )
+#pragma comment( lib, "psapi.lib" )
+#endif
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined( __APPLE__ )
+#include <mach/mach.h>
+#endif
+#endif
+
+namespace
+{
+
+/** Process wide resource usage at one point in time. */
+struct ScanConversionProfileSample
+{
+  /** Wall clock time in seconds. */
+  double WallTime;
+  /** User and system CPU time of all the threads of the process in seconds. */
+  double CPUTime;
+  /** Resident set size of the process in bytes. */
+  double ResidentSetSize;
+  /** High water mark of the resident set size of the process in bytes. */
+  double PeakResidentSetSize;
+};
+
+
+inline ScanConversionProfileSample
+ScanConversionProfileSampleNow()
+{
+  ScanConversionProfileSample sample;
+  sample.WallTime = itksys::SystemTools::GetTime();
+#if defined( _WIN32 )
+  FILETIME creationTime;
+  FILETIME exitTime;
+  FILETIME kernelTime;
+  FILETIME userTime;
+  sample.CPUTime = 0.0;
+  if( GetProcessTimes( GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime ) )
+    {
+    ULARGE_INTEGER kernel;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    ULARGE_INTEGER user;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    sample.CPUTime = ( kernel.QuadPart + user.QuadPart ) * 1.0e-7;
+    }
+  PROCESS_MEMORY_COUNTERS memoryCounters;
+  sample.ResidentSetSize = 0.0;
+  sample.PeakResidentSetSize = 0.0;
+  if( GetProcessMemoryInfo( GetCurrentProcess(), &memoryCounters, sizeof( memoryCounters ) ) )
+    {
+    sample.ResidentSetSize = static_cast< double >( memoryCounters.WorkingSetSize );
+    sample.PeakResidentSetSize = static_cast< double >( memoryCounters.PeakWorkingSetSize );
+    }
+#else
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  sample.CPUTime = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+    + 1.0e-6 * ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec );
+#if defined( __APPLE__ )
+  // ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+  sample.PeakResidentSetSize = static_cast< double >( usage.ru_maxrss );
+#else
+  sample.PeakResidentSetSize = 1024.0 * usage.ru_maxrss;
+#endif
+  sample.ResidentSetSize = 0.0;
+#if defined( __APPLE__ )
+  mach_task_basic_info_data_t taskInfo;
+  mach_msg_type_number_t taskInfoCount = MACH_TASK_BASIC_INFO_COUNT;
+  if( task_info( mach_task_self(), MACH_TASK_BASIC_INFO,
+      reinterpret_cast< task_info_t >( &taskInfo ), &taskInfoCount ) == KERN_SUCCESS )
+    {
+    sample.ResidentSetSize = static_cast< double >( taskInfo.resident_size );
+    }
+#else
+  // The second field of statm is the number of resident pages
+  std::ifstream statm( "/proc/self/statm" );
+  double totalPages = 0.0;
+  double residentPages = 0.0;
+  if( statm >> totalPages >> residentPages )
+    {
+    sample.ResidentSetSize = residentPages * sysconf( _SC_PAGESIZE );
+    }
+#endif
+#endif
+  return sample;
+}
+
+
+/** Wall time, CPU time, and peak memory of the stages of a scan conversion.
+ *
+ * Stages are identified by name, and repeated stages, e.g. the pieces of a
+ * streamed resampling or the frames of a batch, are accumulated. Stages may
+ * nest or run concurrently, and the CPU time and peak resident set size are
+ * measured for the whole process, so the CPU time of a stage includes the
+ * work of concurrent stages, and its peak resident set size is the process
+ * high water mark when the stage ended. The start resident set size is the
+ * resident set size when the first run of the stage started, so the peak
+ * minus the start bounds the memory the stage added.
+ *
+ * The profiler is disabled unless a ScanConversionProfileSession is
+ * active. */
+class ScanConversionProfiler
+{
+public:
+  struct Stage
+  {
+    std::string  Name;
+    unsigned int Count;
+    double       WallTime;
+    double       CPUTime;
+    double       StartResidentSetSize;
+    double       PeakResidentSetSize;
+  };
+  typedef std::vector< Stage > StageContainerType;
+
+  static ScanConversionProfiler * GetInstance()
+  {
+    static ScanConversionProfiler profiler;
+    return &profiler;
+  }
+
+  void SetEnabled( bool enabled )
+  {
+    m_Enabled = enabled;
+  }
+
+  bool GetEnabled() const
+  {
+    return m_Enabled;
+  }
+
+  /** Accumulate a stage that ran from start to end. Thread safe. */
+  void AddStage( const std::string & name,
+    const ScanConversionProfileSample & start,
+    const ScanConversionProfileSample & end )
+  {
+    Stage stage;
+    stage.Name = name;
+    stage.Count = 1;
+    stage.WallTime = end.WallTime - start.WallTime;
+    stage.CPUTime = end.CPUTime - start.CPUTime;
+    stage.StartResidentSetSize = start.ResidentSetSize;
+    stage.PeakResidentSetSize = end.PeakResidentSetSize;
+    this->AddStage( stage );
+  }
+
+  /** Accumulate the totals of a stage, e.g. a stage of the resampling
+   * library, which has its own profiler. Thread safe. */
+  void AddStage( const Stage & stage )
+  {
+    if( !m_Enabled )
+      {
+      return;
+      }
+    itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( m_Mutex );
+    StageContainerType::size_type stageIndex = 0;
+    while( stageIndex < m_Stages.size() && m_Stages[stageIndex].Name != stage.Name )
+      {
+      ++stageIndex;
+      }
+    if( stageIndex == m_Stages.size() )
+      {
+      Stage newStage;
+      newStage.Name = stage.Name;
+      newStage.Count = 0;
+      newStage.WallTime = 0.0;
+      newStage.CPUTime = 0.0;
+      newStage.StartResidentSetSize = stage.StartResidentSetSize;
+      newStage.PeakResidentSetSize = 0.0;
+      m_Stages.push_back( newStage );
+      }
+    Stage & accumulated = m_Stages[stageIndex];
+    accumulated.Count += stage.Count;
+    accumulated.WallTime += stage.WallTime;
+    accumulated.CPUTime += stage.CPUTime;
+    accumulated.StartResidentSetSize = std::min( accumulated.StartResidentSetSize, stage.StartResidentSetSize );
+    accumulated.PeakResidentSetSize = std::max( accumulated.PeakResidentSetSize, stage.PeakResidentSetSize );
+  }
+
+  void ClearStages()
+  {
+    itk::MutexLockHolder< itk::SimpleFastMutexLock > holder( m_Mutex );
+    m_Stages.clear();
+  }
+
+  const StageContainerType & GetStages() const
+  {
+    return m_Stages;
+  }
+
+  /** Write the stages as JSON:
+   *
+   *   {
+   *     "numberOfThreads": 8,
+   *     "stages": [
+   *       { "name": "Read Input", "count": 1, "wallTime": 0.25,
+   *         "cpuTime": 0.24, "startResidentSetSize": 20971520,
+   *         "peakResidentSetSize": 104857600 },
+   *       ...
+   *     ]
+   *   }
+   *
+   * with the times in seconds and the sizes in bytes. */
+  bool WriteJSON( const std::string & fileName ) const
+  {
+    std::ofstream outputStream( fileName.c_str() );
+    if( !outputStream )
+      {
+      return false;
+      }
+    outputStream << std::setprecision( 9 );
+    outputStream << "{\n";
+    outputStream << "  \"numberOfThreads\": " << itk::MultiThreader::GetGlobalDefaultNumberOfThreads() << ",\n";
+    outputStream << "  \"stages\": [";
+    for( StageContainerType::size_type stageIndex = 0; stageIndex < m_Stages.size(); ++stageIndex )
+      {
+      const Stage & stage = m_Stages[stageIndex];
+      outputStream << ( stageIndex == 0 ? "\n" : ",\n" );
+      outputStream << "    { \"name\": \"" << EscapeJSON( stage.Name ) << "\""
+        << ", \"count\": " << stage.Count
+        << ", \"wallTime\": " << stage.WallTime
+        << ", \"cpuTime\": " << stage.CPUTime
+        << ", \"startResidentSetSize\": " << static_cast< itk::uint64_t >( stage.StartResidentSetSize )
+        << ", \"peakResidentSetSize\": " << static_cast< itk::uint64_t >( stage.PeakResidentSetSize ) << " }";
+      }
+    outputStream << "\n  ]\n";
+    outputStream << "}\n";
+    outputStream.close();
+    return !outputStream.fail();
+  }
+
+private:
+  ScanConversionProfiler():
+    m_Enabled( false )
+  {
+  }
+
+  static std::string EscapeJSON( const std::string & text )
+  {
+    std::string escaped;
+    for( std::string::size_type ii = 0; ii < text.size(); ++ii )
+      {
+      if( text[ii] == '"' || text[ii] == '\\' )
+        {
+        escaped += '\\';
+        }
+      escaped += text[ii];
+      }
+    return escaped;
+  }
+
+  bool                     m_Enabled;
+  StageContainerType       m_Stages;
+  itk::SimpleFastMutexLock m_Mutex;
+};
+
+
+/** Profile a stage that is not a filter for the lifetime of the scope. */
+class ScanConversionProfileScope
+{
+public:
+  explicit ScanConversionProfileScope( const std::string & name ):
+    m_Name( name ),
+    m_Enabled( ScanConversionProfiler::GetInstance()->GetEnabled() )
+  {
+    if( m_Enabled )
+      {
+      m_Start = ScanConversionProfileSampleNow();
+      }
+  }
+
+  ~ScanConversionProfileScope()
+  {
+    if( m_Enabled )
+      {
+      ScanConversionProfiler::GetInstance()->AddStage( m_Name, m_Start, ScanConversionProfileSampleNow() );
+      }
+  }
+
+private:
+  ScanConversionProfileScope( const ScanConversionProfileScope & );
+  void operator=( const ScanConversionProfileScope & );
+
+  const std::string           m_Name;
+  const bool                  m_Enabled;
+  ScanConversionProfileSample m_Start;
+};
+
+
+/** An itk::PluginFilterWatcher that also profiles the filter from its
+ * StartEvent to its EndEvent under the watcher comment. */
+class ScanConversionFilterWatcher: public itk::PluginFilterWatcher
+{
+public:
+  ScanConversionFilterWatcher( itk::ProcessObject * filter,
+    const char * comment,
+    ModuleProcessInformation * CLPProcessInformation ):
+    itk::PluginFilterWatcher( filter, comment, CLPProcessInformation )
+  {
+    m_Start = ScanConversionProfileSampleNow();
+  }
+
+protected:
+  virtual void StartFilter() ITK_OVERRIDE
+  {
+    if( ScanConversionProfiler::GetInstance()->GetEnabled() )
+      {
+      m_Start = ScanConversionProfileSampleNow();
+      }
+    itk::PluginFilterWatcher::StartFilter();
+  }
+
+  virtual void EndFilter() ITK_OVERRIDE
+  {
+    itk::PluginFilterWatcher::EndFilter();
+    ScanConversionProfiler::GetInstance()->AddStage( this->GetComment(), m_Start, ScanConversionProfileSampleNow() );
+  }
+
+private:
+  ScanConversionProfileSample m_Start;
+};
+
+
+/** Enable the profiler for the lifetime of the session when fileName is not
+ * empty, and write the stages plus a "Total" stage to fileName when the
+ * session ends. */
+class ScanConversionProfileSession
+{
+public:
+  explicit ScanConversionProfileSession( const std::string & fileName ):
+    m_FileName( fileName )
+  {
+    ScanConversionProfiler::GetInstance()->SetEnabled( !m_FileName.empty() );
+    m_Start = ScanConversionProfileSampleNow();
+  }
+
+  ~ScanConversionProfileSession()
+  {
+    ScanConversionProfiler * profiler = ScanConversionProfiler::GetInstance();
+    if( !profiler->GetEnabled() )
+      {
+      return;
+      }
+    profiler->AddStage( "Total", m_Start, ScanConversionProfileSampleNow() );
+    if( !profiler->WriteJSON( m_FileName ) )
+      {
+      std::cerr << "Could not write the profile to " << m_FileName << std::endl;
+      }
+    profiler->SetEnabled( false );
+  }
+
+private:
+  ScanConversionProfileSession( const ScanConversionProfileSession & );
+  void operator=( const ScanConversionProfileSession & );
+
+  const std::string           m_FileName;
+  ScanConversionProfileSample m_Start;
+};
+
+}
+
+#endif
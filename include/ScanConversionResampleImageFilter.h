@@ -0,0 +1,819 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionResampleImageFilter_h
+#define ScanConversionResampleImageFilter_h
+
+#include "itkResampleImageFilter.h"
+#include "itkImageScanlineIterator.h"
+#include "itkIntTypes.h"
+#include "itkProgressReporter.h"
+#include "vnl/vnl_math.h"
+
+#include "ScanConversionGeometry.h"
+#include "ScanConversionProfiler.h"
+#include "ScanConversionSliceSeriesLocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+#include <xmmintrin.h>
+#define ScanConversionPrefetch( address ) _mm_prefetch( reinterpret_cast< const char * >( address ), _MM_HINT_T0 )
+#elif defined( __GNUC__ )
+#define ScanConversionPrefetch( address ) __builtin_prefetch( address )
+#else
+#define ScanConversionPrefetch( address ) static_cast< void >( address )
+#endif
+
+#if !defined( _WIN32 )
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+/** Bytes of input samples that a tile prefetches at most: half of the data
+ * cache of a core, the level 2 cache when the system reports it, and
+ * otherwise 256 KiB, so the window of a tile does not evict itself or the
+ * samples of the previous tile. */
+inline itk::SizeValueType
+ScanConversionPrefetchWindowBytes()
+{
+  long cacheSize = 0;
+#if defined( _SC_LEVEL2_CACHE_SIZE )
+  cacheSize = sysconf( _SC_LEVEL2_CACHE_SIZE );
+#endif
+  if( cacheSize <= 0 )
+    {
+    cacheSize = 256 * 1024;
+    }
+  return static_cast< itk::SizeValueType >( cacheSize ) / 2;
+}
+
+
+/** \class ScanConversionResampleImageFilter
+ *
+ * \brief Resample a probe image, only interpolating within the sector.
+ *
+ * When SectorMask is on, a sector is set, and the output direction is the
+ * identity, the span of every output scanline inside the sector is computed
+ * analytically. Only the voxels within the spans, padded by one voxel, are
+ * transformed and interpolated, and the other voxels are set to the default
+ * pixel value. The output is the same as the itk::ResampleImageFilter
+ * output, which also sets the voxels outside of the input buffer to the
+ * default pixel value.
+ *
+ * When LimitInputRequestedRegion is on, only the input region needed for the
+ * output requested region is requested instead of the largest possible
+ * region, so a streamed output only reads the input it samples. With slice
+ * bounds, this is the range of slices whose bounds, joined with the bounds of
+ * the next slice, intersect the output region. Otherwise, it is the bounding
+ * box of the input indices of the faces of the output region, extended to
+ * the start of the radius axis when the apex of the sector is inside the
+ * output region. The region is padded by InputRequestedRegionPadding samples
+ * for the support of the interpolator.
+ *
+ * When SliceSeriesLocator is on, the input is a slice series, and its
+ * slices are ordered along the sweep, the input indices of the output voxels
+ * are found with a ScanConversionSliceSeriesLocator built once before the
+ * threads start, instead of the mapping of the input image, so the time per
+ * voxel grows with the logarithm of the number of slices.
+ *
+ * When TileSize is not zero, the output region of each thread is traversed
+ * in cubic tiles of TileSize voxels, in the Morton order of the tiles,
+ * instead of in scanlines. The input samples around the input indices of
+ * the corners of each tile, i.e. the radial and angular window of the input
+ * that the tile maps to, are prefetched before the tile is interpolated.
+ * Output scanlines of a probe geometry cross many radial lines of the input,
+ * so the neighboring voxels of a tile reuse the input samples in the cache
+ * that the voxels of a scanline would evict. The output does not depend on
+ * the traversal.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ScanConversionResampleImageFilter:
+  public itk::ResampleImageFilter< TInputImage, TOutputImage >
+{
+public:
+  typedef ScanConversionResampleImageFilter                   Self;
+  typedef itk::ResampleImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef itk::SmartPointer< Self >                           Pointer;
+  typedef itk::SmartPointer< const Self >                     ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionResampleImageFilter, ResampleImageFilter );
+
+  typedef TInputImage                                  InputImageType;
+  typedef TOutputImage                                 OutputImageType;
+  typedef typename Superclass::OutputImageRegionType   OutputImageRegionType;
+  typedef typename Superclass::TransformType           TransformType;
+  typedef typename Superclass::InterpolatorType        InterpolatorType;
+  typedef typename Superclass::InterpolatorOutputType  InterpolatorOutputType;
+  typedef typename OutputImageType::PixelType          PixelType;
+  typedef typename OutputImageType::IndexType          IndexType;
+  typedef typename OutputImageType::PointType          PointType;
+  typedef typename InterpolatorType::ContinuousIndexType ContinuousIndexType;
+
+  typedef typename InputImageType::RegionType            InputImageRegionType;
+  typedef std::vector< ScanConversionSliceBounds >        SliceBoundsContainerType;
+  typedef ScanConversionSliceSeriesLocator< InputImageType > LocatorType;
+
+  void SetSector( const ScanConversionSector & sector )
+    {
+    m_Sector = sector;
+    this->Modified();
+    }
+
+  /** Only interpolate the output voxels inside the sector. */
+  itkSetMacro( SectorMask, bool );
+  itkGetConstMacro( SectorMask, bool );
+  itkBooleanMacro( SectorMask );
+
+  /** Only request the input region needed for the output requested region. */
+  itkSetMacro( LimitInputRequestedRegion, bool );
+  itkGetConstMacro( LimitInputRequestedRegion, bool );
+  itkBooleanMacro( LimitInputRequestedRegion );
+
+  /** Number of input samples added around the limited input requested region
+   * for the support of the interpolator. */
+  itkSetMacro( InputRequestedRegionPadding, unsigned int );
+  itkGetConstMacro( InputRequestedRegionPadding, unsigned int );
+
+  /** Map the output voxels to the slices of a slice series input with a
+   * ScanConversionSliceSeriesLocator. */
+  itkSetMacro( SliceSeriesLocator, bool );
+  itkGetConstMacro( SliceSeriesLocator, bool );
+  itkBooleanMacro( SliceSeriesLocator );
+
+  /** Edge in output voxels of the tiles of the traversal of the output, 0
+   * for scanlines. */
+  itkSetMacro( TileSize, unsigned int );
+  itkGetConstMacro( TileSize, unsigned int );
+
+  /** Physical bounds of each slice along the last axis of a slice series
+   * input. */
+  void SetSliceBounds( const SliceBoundsContainerType & sliceBounds )
+    {
+    m_SliceBounds = sliceBounds;
+    this->Modified();
+    }
+
+protected:
+  ScanConversionResampleImageFilter():
+    m_SectorMask( false ),
+    m_LimitInputRequestedRegion( false ),
+    m_InputRequestedRegionPadding( 1 ),
+    m_SliceSeriesLocator( false ),
+    m_TileSize( 0 ),
+    m_PrefetchWindowBytes( ScanConversionPrefetchWindowBytes() )
+  {}
+  ~ScanConversionResampleImageFilter() {}
+
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE
+    {
+    Superclass::BeforeThreadedGenerateData();
+    m_Locator = LocatorType();
+    if( m_SliceSeriesLocator && this->GetExtrapolator() == ITK_NULLPTR )
+      {
+      ScanConversionProfileScope profileLocator( "Build Slice Locator" );
+      m_Locator.Initialize( this->GetInput() );
+      }
+    }
+
+  virtual void NonlinearThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+    itk::ThreadIdType threadId ) ITK_OVERRIDE
+    {
+    if( m_TileSize > 0 && this->GetExtrapolator() == ITK_NULLPTR )
+      {
+      this->TiledThreadedGenerateData( outputRegionForThread, threadId );
+      return;
+      }
+
+    if( !this->UseSectorSpans() )
+      {
+      if( this->GetExtrapolator() == ITK_NULLPTR && m_Locator.GetValid() )
+        {
+        this->ScanlineThreadedGenerateData( outputRegionForThread, threadId );
+        }
+      else
+        {
+        Superclass::NonlinearThreadedGenerateData( outputRegionForThread, threadId );
+        }
+      return;
+      }
+
+    OutputImageType * outputPtr = this->GetOutput();
+    const InputImageType * inputPtr = this->GetInput();
+    const TransformType * transformPtr = this->GetTransform();
+    const InterpolatorType * interpolatorPtr = this->GetInterpolator();
+    const PixelType defaultValue = this->GetDefaultPixelValue();
+
+    itk::ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+    typedef itk::ImageScanlineIterator< OutputImageType > OutputIteratorType;
+    OutputIteratorType outIt( outputPtr, outputRegionForThread );
+    IndexType outputIndex;
+    PointType outputPoint;
+    ContinuousIndexType inputIndex;
+    itk::IndexValueType indexSpans[2][2];
+    while( !outIt.IsAtEnd() )
+      {
+      const unsigned int numberOfSpans = this->ComputeLineIndexSpans( outIt.GetIndex(), indexSpans );
+
+      while( !outIt.IsAtEndOfLine() )
+        {
+        outputIndex = outIt.GetIndex();
+        PixelType value = defaultValue;
+        if( InIndexSpans( outputIndex, numberOfSpans, indexSpans ) )
+          {
+          outputPtr->TransformIndexToPhysicalPoint( outputIndex, outputPoint );
+          const PointType inputPoint = transformPtr->TransformPoint( outputPoint );
+          this->TransformInputPointToContinuousIndex( inputPtr, inputPoint, inputIndex );
+          if( interpolatorPtr->IsInsideBuffer( inputIndex ) )
+            {
+            value = ClampPixel( interpolatorPtr->EvaluateAtContinuousIndex( inputIndex ) );
+            }
+          }
+        outIt.Set( value );
+        progress.CompletedPixel();
+        ++outIt;
+        }
+      outIt.NextLine();
+      }
+    }
+
+  /** Whether the spans of the output scanlines inside the sector are
+   * computed analytically. */
+  bool UseSectorSpans() const
+    {
+    typename OutputImageType::DirectionType identity;
+    identity.SetIdentity();
+    return m_SectorMask
+      && m_Sector.Geometry != ScanConversionSector::UNSPECIFIED_GEOMETRY
+      && this->GetOutputDirection() == identity;
+    }
+
+  /** Output index spans inside the sector, padded by one voxel, of the
+   * scanline of an output voxel. */
+  unsigned int ComputeLineIndexSpans( const IndexType & lineIndex, itk::IndexValueType indexSpans[2][2] ) const
+    {
+    const OutputImageType * outputPtr = this->GetOutput();
+    const PointType & outputOrigin = outputPtr->GetOrigin();
+    const double outputSpacing = outputPtr->GetSpacing()[0];
+    PointType linePoint;
+    outputPtr->TransformIndexToPhysicalPoint( lineIndex, linePoint );
+    double spans[2][2];
+    const unsigned int numberOfSpans = ScanConversionSectorLineSpans( m_Sector, linePoint[1], linePoint[2], spans );
+    for( unsigned int span = 0; span < numberOfSpans; ++span )
+      {
+      indexSpans[span][0] = static_cast< itk::IndexValueType >( std::floor( ( spans[span][0] - outputOrigin[0] ) / outputSpacing ) ) - 1;
+      indexSpans[span][1] = static_cast< itk::IndexValueType >( std::ceil( ( spans[span][1] - outputOrigin[0] ) / outputSpacing ) ) + 1;
+      }
+    return numberOfSpans;
+    }
+
+  static bool InIndexSpans( const IndexType & outputIndex,
+    unsigned int numberOfSpans,
+    const itk::IndexValueType indexSpans[2][2] )
+    {
+    for( unsigned int span = 0; span < numberOfSpans; ++span )
+      {
+      if( outputIndex[0] >= indexSpans[span][0] && outputIndex[0] <= indexSpans[span][1] )
+        {
+        return true;
+        }
+      }
+    return false;
+    }
+
+  /** Morton code of the index of a tile: the bits of the tile index along
+   * each axis, interleaved from the least significant. */
+  static itk::uint64_t TileMortonCode( const itk::SizeValueType * tileIndex )
+    {
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    const unsigned int bitsPerAxis = 64 / Dimension;
+    itk::uint64_t code = 0;
+    for( unsigned int bit = 0; bit < bitsPerAxis; ++bit )
+      {
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        code |= ( static_cast< itk::uint64_t >( tileIndex[dim] >> bit ) & 1u ) << ( bit * Dimension + dim );
+        }
+      }
+    return code;
+    }
+
+  /** Interpolate the output region of a thread in tiles of TileSize voxels,
+   * in Morton order, as the sector and the scanline loops do. */
+  void TiledThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+    itk::ThreadIdType threadId )
+    {
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    OutputImageType * outputPtr = this->GetOutput();
+    const InputImageType * inputPtr = this->GetInput();
+    const TransformType * transformPtr = this->GetTransform();
+    const InterpolatorType * interpolatorPtr = this->GetInterpolator();
+    const PixelType defaultValue = this->GetDefaultPixelValue();
+    const bool sectorSpans = this->UseSectorSpans();
+
+    itk::ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+    itk::SizeValueType numberOfTiles[Dimension];
+    itk::SizeValueType totalNumberOfTiles = 1;
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      numberOfTiles[dim] = ( outputRegionForThread.GetSize( dim ) + m_TileSize - 1 ) / m_TileSize;
+      totalNumberOfTiles *= numberOfTiles[dim];
+      }
+    typedef std::pair< itk::uint64_t, itk::SizeValueType > TileOrderType;
+    std::vector< TileOrderType > tileOrder;
+    tileOrder.reserve( totalNumberOfTiles );
+    itk::SizeValueType tileIndex[Dimension];
+    for( itk::SizeValueType tile = 0; tile < totalNumberOfTiles; ++tile )
+      {
+      itk::SizeValueType remainder = tile;
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        tileIndex[dim] = remainder % numberOfTiles[dim];
+        remainder /= numberOfTiles[dim];
+        }
+      tileOrder.push_back( TileOrderType( TileMortonCode( tileIndex ), tile ) );
+      }
+    std::sort( tileOrder.begin(), tileOrder.end() );
+
+    typedef itk::ImageScanlineIterator< OutputImageType > OutputIteratorType;
+    IndexType outputIndex;
+    PointType outputPoint;
+    ContinuousIndexType inputIndex;
+    itk::IndexValueType indexSpans[2][2];
+    for( typename std::vector< TileOrderType >::const_iterator tile = tileOrder.begin();
+      tile != tileOrder.end();
+      ++tile )
+      {
+      OutputImageRegionType tileRegion;
+      itk::SizeValueType remainder = tile->second;
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        const itk::SizeValueType start = ( remainder % numberOfTiles[dim] ) * m_TileSize;
+        remainder /= numberOfTiles[dim];
+        tileRegion.SetIndex( dim, outputRegionForThread.GetIndex( dim ) + static_cast< itk::IndexValueType >( start ) );
+        tileRegion.SetSize( dim, std::min< itk::SizeValueType >( m_TileSize, outputRegionForThread.GetSize( dim ) - start ) );
+        }
+      this->PrefetchInputWindow( tileRegion );
+
+      OutputIteratorType outIt( outputPtr, tileRegion );
+      while( !outIt.IsAtEnd() )
+        {
+        unsigned int numberOfSpans = 0;
+        if( sectorSpans )
+          {
+          numberOfSpans = this->ComputeLineIndexSpans( outIt.GetIndex(), indexSpans );
+          }
+        while( !outIt.IsAtEndOfLine() )
+          {
+          outputIndex = outIt.GetIndex();
+          PixelType value = defaultValue;
+          if( !sectorSpans || InIndexSpans( outputIndex, numberOfSpans, indexSpans ) )
+            {
+            outputPtr->TransformIndexToPhysicalPoint( outputIndex, outputPoint );
+            const PointType inputPoint = transformPtr->TransformPoint( outputPoint );
+            this->TransformInputPointToContinuousIndex( inputPtr, inputPoint, inputIndex );
+            if( interpolatorPtr->IsInsideBuffer( inputIndex ) )
+              {
+              value = ClampPixel( interpolatorPtr->EvaluateAtContinuousIndex( inputIndex ) );
+              }
+            }
+          outIt.Set( value );
+          progress.CompletedPixel();
+          ++outIt;
+          }
+        outIt.NextLine();
+        }
+      }
+    }
+
+  /** Prefetch the input samples within the bounding box of the input
+   * indices of the corners of an output tile, padded by
+   * InputRequestedRegionPadding samples, one cache line at a time along the
+   * first axis. The window is skipped when it is not finite or larger than
+   * the ScanConversionPrefetchWindowBytes, e.g. for a tile around the apex of
+   * the sector, where prefetching would only evict the samples in the
+   * cache. */
+  void PrefetchInputWindow( const OutputImageRegionType & tileRegion ) const
+    {
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    const InputImageType * inputPtr = this->GetInput();
+    const OutputImageType * outputPtr = this->GetOutput();
+    const TransformType * transformPtr = this->GetTransform();
+    const InputImageRegionType & bufferedRegion = inputPtr->GetBufferedRegion();
+
+    double lower[Dimension];
+    double upper[Dimension];
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      lower[dim] = itk::NumericTraits< double >::max();
+      upper[dim] = itk::NumericTraits< double >::NonpositiveMin();
+      }
+    IndexType cornerIndex;
+    PointType cornerPoint;
+    ContinuousIndexType inputIndex;
+    for( unsigned int corner = 0; corner < ( 1u << Dimension ); ++corner )
+      {
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        cornerIndex[dim] = tileRegion.GetIndex( dim );
+        if( corner & ( 1u << dim ) )
+          {
+          cornerIndex[dim] += tileRegion.GetSize( dim ) - 1;
+          }
+        }
+      outputPtr->TransformIndexToPhysicalPoint( cornerIndex, cornerPoint );
+      this->TransformInputPointToContinuousIndex( inputPtr, transformPtr->TransformPoint( cornerPoint ), inputIndex );
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        if( !vnl_math_isfinite( inputIndex[dim] ) )
+          {
+          return;
+          }
+        lower[dim] = std::min( lower[dim], static_cast< double >( inputIndex[dim] ) );
+        upper[dim] = std::max( upper[dim], static_cast< double >( inputIndex[dim] ) );
+        }
+      }
+
+    const double padding = static_cast< double >( m_InputRequestedRegionPadding );
+    InputImageRegionType window;
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      const itk::IndexValueType bufferedStart = bufferedRegion.GetIndex( dim );
+      const itk::IndexValueType bufferedEnd = bufferedStart + static_cast< itk::IndexValueType >( bufferedRegion.GetSize( dim ) ) - 1;
+      const itk::IndexValueType start = std::max( bufferedStart,
+        static_cast< itk::IndexValueType >( std::floor( lower[dim] - padding ) ) );
+      const itk::IndexValueType end = std::min( bufferedEnd,
+        static_cast< itk::IndexValueType >( std::ceil( upper[dim] + padding ) ) );
+      if( start > end )
+        {
+        return;
+        }
+      window.SetIndex( dim, start );
+      window.SetSize( dim, end - start + 1 );
+      }
+    typedef typename InputImageType::PixelType InputPixelType;
+    if( window.GetNumberOfPixels() * sizeof( InputPixelType ) > m_PrefetchWindowBytes )
+      {
+      return;
+      }
+
+    const InputPixelType * buffer = inputPtr->GetBufferPointer();
+    const itk::SizeValueType samplesPerLine = std::max< itk::SizeValueType >( 64 / sizeof( InputPixelType ), 1 );
+    const itk::SizeValueType lineLength = window.GetSize( 0 );
+    typename InputImageType::IndexType lineIndex = window.GetIndex();
+    while( true )
+      {
+      const InputPixelType * line = buffer + inputPtr->ComputeOffset( lineIndex );
+      for( itk::SizeValueType sample = 0; sample < lineLength; sample += samplesPerLine )
+        {
+        ScanConversionPrefetch( line + sample );
+        }
+      ScanConversionPrefetch( line + lineLength - 1 );
+
+      unsigned int dim = 1;
+      for( ; dim < Dimension; ++dim )
+        {
+        if( ++lineIndex[dim] < window.GetIndex( dim ) + static_cast< itk::IndexValueType >( window.GetSize( dim ) ) )
+          {
+          break;
+          }
+        lineIndex[dim] = window.GetIndex( dim );
+        }
+      if( dim == Dimension )
+        {
+        break;
+        }
+      }
+    }
+
+  /** The loop of itk::ResampleImageFilter without an extrapolator, with the
+   * input indices from the slice series locator. */
+  void ScanlineThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+    itk::ThreadIdType threadId )
+    {
+    OutputImageType * outputPtr = this->GetOutput();
+    const InputImageType * inputPtr = this->GetInput();
+    const TransformType * transformPtr = this->GetTransform();
+    const InterpolatorType * interpolatorPtr = this->GetInterpolator();
+    const PixelType defaultValue = this->GetDefaultPixelValue();
+
+    itk::ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+    typedef itk::ImageScanlineIterator< OutputImageType > OutputIteratorType;
+    OutputIteratorType outIt( outputPtr, outputRegionForThread );
+    IndexType outputIndex;
+    PointType outputPoint;
+    ContinuousIndexType inputIndex;
+    while( !outIt.IsAtEnd() )
+      {
+      while( !outIt.IsAtEndOfLine() )
+        {
+        outputIndex = outIt.GetIndex();
+        PixelType value = defaultValue;
+        outputPtr->TransformIndexToPhysicalPoint( outputIndex, outputPoint );
+        const PointType inputPoint = transformPtr->TransformPoint( outputPoint );
+        this->TransformInputPointToContinuousIndex( inputPtr, inputPoint, inputIndex );
+        if( interpolatorPtr->IsInsideBuffer( inputIndex ) )
+          {
+          value = ClampPixel( interpolatorPtr->EvaluateAtContinuousIndex( inputIndex ) );
+          }
+        outIt.Set( value );
+        progress.CompletedPixel();
+        ++outIt;
+        }
+      outIt.NextLine();
+      }
+    }
+
+  template< typename TPoint >
+  void TransformInputPointToContinuousIndex( const InputImageType * inputPtr,
+    const TPoint & inputPoint,
+    ContinuousIndexType & inputIndex ) const
+    {
+    if( m_Locator.GetValid() )
+      {
+      m_Locator.TransformPhysicalPointToContinuousIndex( inputPoint, inputIndex );
+      }
+    else
+      {
+      inputPtr->TransformPhysicalPointToContinuousIndex( inputPoint, inputIndex );
+      }
+    }
+
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE
+    {
+    Superclass::GenerateInputRequestedRegion();
+    if( !m_LimitInputRequestedRegion || this->GetInput() == ITK_NULLPTR )
+      {
+      return;
+      }
+
+    InputImageType * inputPtr = const_cast< InputImageType * >( this->GetInput() );
+    const OutputImageType * outputPtr = this->GetOutput();
+    const OutputImageRegionType & outputRegion = outputPtr->GetRequestedRegion();
+    const InputImageRegionType & largestRegion = inputPtr->GetLargestPossibleRegion();
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    const double padding = static_cast< double >( m_InputRequestedRegionPadding );
+
+    double lower[Dimension];
+    double upper[Dimension];
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      lower[dim] = itk::NumericTraits< double >::max();
+      upper[dim] = itk::NumericTraits< double >::NonpositiveMin();
+      }
+
+    if( !m_SliceBounds.empty() )
+      {
+      this->ComputeSliceRange( outputRegion, lower, upper );
+      }
+    else
+      {
+      this->ComputeFaceIndexBounds( outputRegion, lower, upper );
+      }
+
+    InputImageRegionType requestedRegion = largestRegion;
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      if( lower[dim] > upper[dim] )
+        {
+        // No sample of the output region maps into the input
+        requestedRegion.SetSize( dim, 0 );
+        continue;
+        }
+      const itk::IndexValueType start = static_cast< itk::IndexValueType >( std::floor( lower[dim] - padding ) );
+      const itk::IndexValueType end = static_cast< itk::IndexValueType >( std::ceil( upper[dim] + padding ) );
+      const itk::IndexValueType largestStart = largestRegion.GetIndex( dim );
+      const itk::IndexValueType largestEnd = largestStart + static_cast< itk::IndexValueType >( largestRegion.GetSize( dim ) ) - 1;
+      const itk::IndexValueType croppedStart = std::max( start, largestStart );
+      const itk::IndexValueType croppedEnd = std::min( end, largestEnd );
+      if( croppedStart > croppedEnd )
+        {
+        requestedRegion.SetSize( dim, 0 );
+        continue;
+        }
+      requestedRegion.SetIndex( dim, croppedStart );
+      requestedRegion.SetSize( dim, croppedEnd - croppedStart + 1 );
+      }
+    if( requestedRegion.GetNumberOfPixels() == 0 )
+      {
+      // Keep a valid region; the output samples are all outside of it
+      requestedRegion.SetIndex( largestRegion.GetIndex() );
+      requestedRegion.SetSize( InputImageRegionType::SizeType::Filled( 1 ) );
+      }
+    inputPtr->SetRequestedRegion( requestedRegion );
+    }
+
+  /** Bounding box of the continuous input indices of the voxels on the faces
+   * of the output region. */
+  void ComputeFaceIndexBounds( const OutputImageRegionType & outputRegion, double * lower, double * upper ) const
+    {
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    const InputImageType * inputPtr = this->GetInput();
+    const OutputImageType * outputPtr = this->GetOutput();
+    const TransformType * transformPtr = this->GetTransform();
+
+    IndexType outputIndex;
+    PointType outputPoint;
+    ContinuousIndexType inputIndex;
+    for( unsigned int faceDim = 0; faceDim < Dimension; ++faceDim )
+      {
+      for( unsigned int side = 0; side < 2; ++side )
+        {
+        OutputImageRegionType face = outputRegion;
+        if( side == 1 )
+          {
+          face.SetIndex( faceDim, outputRegion.GetIndex( faceDim ) + outputRegion.GetSize( faceDim ) - 1 );
+          }
+        face.SetSize( faceDim, 1 );
+        const itk::SizeValueType numberOfFaceVoxels = face.GetNumberOfPixels();
+        outputIndex = face.GetIndex();
+        for( itk::SizeValueType voxel = 0; voxel < numberOfFaceVoxels; ++voxel )
+          {
+          outputPtr->TransformIndexToPhysicalPoint( outputIndex, outputPoint );
+          inputPtr->TransformPhysicalPointToContinuousIndex( transformPtr->TransformPoint( outputPoint ), inputIndex );
+          for( unsigned int dim = 0; dim < Dimension; ++dim )
+            {
+            if( vnl_math_isfinite( inputIndex[dim] ) )
+              {
+              lower[dim] = std::min( lower[dim], static_cast< double >( inputIndex[dim] ) );
+              upper[dim] = std::max( upper[dim], static_cast< double >( inputIndex[dim] ) );
+              }
+            }
+          for( unsigned int dim = 0; dim < Dimension; ++dim )
+            {
+            if( ++outputIndex[dim] < face.GetIndex( dim ) + static_cast< itk::IndexValueType >( face.GetSize( dim ) ) )
+              {
+              break;
+              }
+            outputIndex[dim] = face.GetIndex( dim );
+            }
+          }
+        }
+      }
+
+    // The radius is smallest inside the region when it contains the apex
+    const int radiusAxis = ScanConversionSectorRadiusAxis( m_Sector );
+    if( radiusAxis >= 0 )
+      {
+      PointType apex;
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        apex[dim] = m_Sector.Apex[dim];
+        }
+      ContinuousIndexType apexIndex;
+      outputPtr->TransformPhysicalPointToContinuousIndex( apex, apexIndex );
+      bool apexInside = true;
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        if( apexIndex[dim] < outputRegion.GetIndex( dim ) - 1.0
+          || apexIndex[dim] > outputRegion.GetIndex( dim ) + static_cast< double >( outputRegion.GetSize( dim ) ) )
+          {
+          apexInside = false;
+          }
+        }
+      if( apexInside )
+        {
+        lower[radiusAxis] = std::min( lower[radiusAxis],
+          static_cast< double >( inputPtr->GetLargestPossibleRegion().GetIndex( radiusAxis ) ) );
+        }
+      }
+    }
+
+  /** Range of slices along the last input axis that the output region
+   * samples. The other axes span the whole slices. */
+  void ComputeSliceRange( const OutputImageRegionType & outputRegion, double * lower, double * upper ) const
+    {
+    const unsigned int Dimension = OutputImageType::ImageDimension;
+    const unsigned int SliceAxis = Dimension - 1;
+    const OutputImageType * outputPtr = this->GetOutput();
+    const InputImageRegionType & largestRegion = this->GetInput()->GetLargestPossibleRegion();
+
+    // Physical bounds of the output region, padded by a voxel
+    double regionLower[Dimension];
+    double regionUpper[Dimension];
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      regionLower[dim] = itk::NumericTraits< double >::max();
+      regionUpper[dim] = itk::NumericTraits< double >::NonpositiveMin();
+      }
+    IndexType cornerIndex;
+    PointType cornerPoint;
+    for( unsigned int corner = 0; corner < ( 1u << Dimension ); ++corner )
+      {
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        cornerIndex[dim] = outputRegion.GetIndex( dim );
+        if( corner & ( 1u << dim ) )
+          {
+          cornerIndex[dim] += outputRegion.GetSize( dim ) - 1;
+          }
+        }
+      outputPtr->TransformIndexToPhysicalPoint( cornerIndex, cornerPoint );
+      const PointType inputPoint = this->GetTransform()->TransformPoint( cornerPoint );
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        regionLower[dim] = std::min( regionLower[dim], static_cast< double >( inputPoint[dim] ) );
+        regionUpper[dim] = std::max( regionUpper[dim], static_cast< double >( inputPoint[dim] ) );
+        }
+      }
+    double maxSpacing = 0.0;
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      maxSpacing = std::max( maxSpacing, static_cast< double >( outputPtr->GetSpacing()[dim] ) );
+      }
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      regionLower[dim] -= maxSpacing;
+      regionUpper[dim] += maxSpacing;
+      }
+
+    const itk::SizeValueType numberOfSlices = m_SliceBounds.size();
+    for( itk::SizeValueType slice = 0; slice < numberOfSlices; ++slice )
+      {
+      const ScanConversionSliceBounds & bounds = m_SliceBounds[slice];
+      const ScanConversionSliceBounds & nextBounds = m_SliceBounds[std::min( slice + 1, numberOfSlices - 1 )];
+      bool intersects = true;
+      for( unsigned int dim = 0; dim < Dimension; ++dim )
+        {
+        const double sliceLower = std::min( bounds.Lower[dim], nextBounds.Lower[dim] );
+        const double sliceUpper = std::max( bounds.Upper[dim], nextBounds.Upper[dim] );
+        if( sliceUpper < regionLower[dim] || sliceLower > regionUpper[dim] )
+          {
+          intersects = false;
+          }
+        }
+      if( intersects )
+        {
+        const double sliceIndex = static_cast< double >( largestRegion.GetIndex( SliceAxis ) + slice );
+        lower[SliceAxis] = std::min( lower[SliceAxis], sliceIndex );
+        upper[SliceAxis] = std::max( upper[SliceAxis], sliceIndex + 1.0 );
+        }
+      }
+    if( lower[SliceAxis] > upper[SliceAxis] )
+      {
+      return;
+      }
+    for( unsigned int dim = 0; dim < SliceAxis; ++dim )
+      {
+      lower[dim] = largestRegion.GetIndex( dim );
+      upper[dim] = largestRegion.GetIndex( dim ) + static_cast< double >( largestRegion.GetSize( dim ) ) - 1.0;
+      }
+    }
+
+  static PixelType ClampPixel( const InterpolatorOutputType & value )
+    {
+    const InterpolatorOutputType minimum = itk::NumericTraits< PixelType >::NonpositiveMin();
+    const InterpolatorOutputType maximum = itk::NumericTraits< PixelType >::max();
+    if( value < minimum )
+      {
+      return itk::NumericTraits< PixelType >::NonpositiveMin();
+      }
+    if( value > maximum )
+      {
+      return itk::NumericTraits< PixelType >::max();
+      }
+    return static_cast< PixelType >( value );
+    }
+
+private:
+  ScanConversionResampleImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  ScanConversionSector     m_Sector;
+  bool                     m_SectorMask;
+  bool                     m_LimitInputRequestedRegion;
+  unsigned int             m_InputRequestedRegionPadding;
+  SliceBoundsContainerType m_SliceBounds;
+  bool                     m_SliceSeriesLocator;
+  LocatorType              m_Locator;
+  unsigned int             m_TileSize;
+  itk::SizeValueType       m_PrefetchWindowBytes;
+};
+
+}
+
+#endif
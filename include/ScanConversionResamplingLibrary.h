@@ -0,0 +1,281 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionResamplingLibrary_h
+#define ScanConversionResamplingLibrary_h
+
+#include "ScanConversionResamplingOptions.h"
+#include "ScanConversionProfiler.h"
+
+#include <string>
+#include <vector>
+
+/** Totals of a stage profiled by the resampling library. */
+struct ScanConversionResamplingLibraryStage
+{
+  std::string  Name;
+  unsigned int Count;
+  double       WallTime;
+  double       CPUTime;
+  double       StartResidentSetSize;
+  double       PeakResidentSetSize;
+};
+typedef std::vector< ScanConversionResamplingLibraryStage > ScanConversionResamplingLibraryProfile;
+
+
+/** \class ScanConversionResamplingLibrary
+ *
+ * \brief Entry points of the prebuilt ScanConversionResampling library.
+ *
+ * The library explicitly instantiates the resampling methods of
+ * ScanConversionResamplingMethods.h, the lookup tables of
+ * ScanConversionLookupTable.h, the FastLinear method of
+ * ScanConversionCurvilinearFastLinear.h, and the GPULinear method of
+ * ScanConversionOpenCL.h once for the input image types of the
+ * CurvilinearArray, PhasedArray3D, and SliceSeries modules and the pixel
+ * types they support. The modules only include this header and
+ * ScanConversionResamplingOptions.h, so they do not instantiate any
+ * resampling method. The method is selected at run time from the kernel
+ * table of the library, so a kernel is added to the library without
+ * rebuilding the modules.
+ *
+ * Resample is, in order of precedence, GPULinear, FastLinear,
+ * LookupTableScanConversionResampling when options.LookupTableFileName is
+ * set, or ScanConversionResampling, and StreamingResample is
+ * StreamingScanConversionResampling. The lookup tables do not resample the
+ * progressive levels, so Resample fails when both
+ * options.LookupTableFileName and options.ProgressiveLevels are set. When
+ * profile is not null, the library profiles its stages and appends them to
+ * profile. Use the LibraryScanConversionResampling and
+ * LibraryStreamingScanConversionResampling wrappers, which add the stages to
+ * the profiler of the module.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ScanConversionResamplingLibrary
+{
+public:
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+
+  static int Resample( const typename InputImageType::Pointer & inputImage,
+    typename OutputImageType::Pointer & outputImage,
+    const typename OutputImageType::SizeType & size,
+    const typename OutputImageType::SpacingType & spacing,
+    const typename OutputImageType::PointType & origin,
+    const typename OutputImageType::DirectionType & direction,
+    const std::string & methodString,
+    const ScanConversionResamplingOptions & options,
+    ModuleProcessInformation * CLPProcessInformation,
+    ScanConversionResamplingLibraryProfile * profile );
+
+  static int StreamingResample( const typename InputImageType::Pointer & inputImage,
+    const std::string & outputFileName,
+    const typename OutputImageType::SizeType & size,
+    const typename OutputImageType::SpacingType & spacing,
+    const typename OutputImageType::PointType & origin,
+    const typename OutputImageType::DirectionType & direction,
+    const std::string & methodString,
+    const ScanConversionResamplingOptions & options,
+    ModuleProcessInformation * CLPProcessInformation,
+    ScanConversionResamplingLibraryProfile * profile );
+};
+
+
+/** \class ScanConversionResamplingLibraryFrameResampler
+ *
+ * \brief Resampler of the prebuilt library for frames that share a geometry.
+ *
+ * Initialize computes the state that only depends on the geometry of the
+ * first frame: the lookup table of ITKNearestNeighbor and ITKLinear, read
+ * from or written to options.LookupTableFileName when it is set, the
+ * locator of the VTK kernels, or the OpenCL context of GPULinear. Resample
+ * then resamples each frame with that state. The other methods are resampled
+ * as by ScanConversionResamplingLibrary::Resample. Use the
+ * LibraryScanConversionFrameResampler wrapper, which adds the stages to the
+ * profiler of the module.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ScanConversionResamplingLibraryFrameResampler
+{
+public:
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+
+  ScanConversionResamplingLibraryFrameResampler();
+  ~ScanConversionResamplingLibraryFrameResampler();
+
+  int Initialize( const typename InputImageType::Pointer & inputImage,
+    const typename OutputImageType::SizeType & size,
+    const typename OutputImageType::SpacingType & spacing,
+    const typename OutputImageType::PointType & origin,
+    const typename OutputImageType::DirectionType & direction,
+    const std::string & methodString,
+    const ScanConversionResamplingOptions & options,
+    ModuleProcessInformation * CLPProcessInformation,
+    ScanConversionResamplingLibraryProfile * profile );
+
+  int Resample( const typename InputImageType::Pointer & inputImage,
+    typename OutputImageType::Pointer & outputImage,
+    ScanConversionResamplingLibraryProfile * profile );
+
+private:
+  ScanConversionResamplingLibraryFrameResampler( const ScanConversionResamplingLibraryFrameResampler & );
+  void operator=( const ScanConversionResamplingLibraryFrameResampler & );
+
+  struct Implementation;
+  Implementation * m_Implementation;
+};
+
+
+namespace
+{
+
+inline void
+AddScanConversionResamplingLibraryProfile( const ScanConversionResamplingLibraryProfile & profile )
+{
+  ScanConversionProfiler * profiler = ScanConversionProfiler::GetInstance();
+  for( ScanConversionResamplingLibraryProfile::const_iterator libraryStage = profile.begin();
+    libraryStage != profile.end();
+    ++libraryStage )
+    {
+    ScanConversionProfiler::Stage stage;
+    stage.Name = libraryStage->Name;
+    stage.Count = libraryStage->Count;
+    stage.WallTime = libraryStage->WallTime;
+    stage.CPUTime = libraryStage->CPUTime;
+    stage.StartResidentSetSize = libraryStage->StartResidentSetSize;
+    stage.PeakResidentSetSize = libraryStage->PeakResidentSetSize;
+    profiler->AddStage( stage );
+    }
+}
+
+
+/** ScanConversionResampling with the prebuilt library. */
+template< typename TInputImage, typename TOutputImage >
+int
+LibraryScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  ScanConversionResamplingLibraryProfile profile;
+  const int status = ScanConversionResamplingLibrary< TInputImage, TOutputImage >::Resample( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    options,
+    CLPProcessInformation,
+    ScanConversionProfiler::GetInstance()->GetEnabled() ? &profile : ITK_NULLPTR
+  );
+  AddScanConversionResamplingLibraryProfile( profile );
+  return status;
+}
+
+
+/** StreamingScanConversionResampling with the prebuilt library. */
+template< typename TInputImage, typename TOutputImage >
+int
+LibraryStreamingScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  const std::string & outputFileName,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  ScanConversionResamplingLibraryProfile profile;
+  const int status = ScanConversionResamplingLibrary< TInputImage, TOutputImage >::StreamingResample( inputImage,
+    outputFileName,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    options,
+    CLPProcessInformation,
+    ScanConversionProfiler::GetInstance()->GetEnabled() ? &profile : ITK_NULLPTR
+  );
+  AddScanConversionResamplingLibraryProfile( profile );
+  return status;
+}
+
+
+/** ScanConversionResamplingLibraryFrameResampler that adds the stages of
+ * the library to the profiler of the module. */
+template< typename TInputImage, typename TOutputImage >
+class LibraryScanConversionFrameResampler
+{
+public:
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+
+  int Initialize( const typename InputImageType::Pointer & inputImage,
+    const typename OutputImageType::SizeType & size,
+    const typename OutputImageType::SpacingType & spacing,
+    const typename OutputImageType::PointType & origin,
+    const typename OutputImageType::DirectionType & direction,
+    const std::string & methodString,
+    const ScanConversionResamplingOptions & options,
+    ModuleProcessInformation * CLPProcessInformation )
+  {
+    ScanConversionResamplingLibraryProfile profile;
+    const int status = m_Resampler.Initialize( inputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      methodString,
+      options,
+      CLPProcessInformation,
+      ScanConversionProfiler::GetInstance()->GetEnabled() ? &profile : ITK_NULLPTR
+    );
+    AddScanConversionResamplingLibraryProfile( profile );
+    return status;
+  }
+
+  int Resample( const typename InputImageType::Pointer & inputImage,
+    typename OutputImageType::Pointer & outputImage )
+  {
+    ScanConversionResamplingLibraryProfile profile;
+    const int status = m_Resampler.Resample( inputImage,
+      outputImage,
+      ScanConversionProfiler::GetInstance()->GetEnabled() ? &profile : ITK_NULLPTR
+    );
+    AddScanConversionResamplingLibraryProfile( profile );
+    return status;
+  }
+
+private:
+  ScanConversionResamplingLibraryFrameResampler< InputImageType, OutputImageType > m_Resampler;
+};
+
+}
+
+#endif
@@ -20,62 +20,214 @@
 #define ScanConversionResamplingMethods_h
 
 #include "itkResampleImageFilter.h"
+#include "itkImageFileWriter.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 #include "itkLinearInterpolateImageFunction.h"
-#include "itkWindowedSincInterpolateImageFunction.h"
-#include "itkGaussianInterpolateImageFunction.h"
 #include "itkSpecialCoordinatesImageToVTKStructuredGridFilter.h"
-#include "itkVTKImageToImageFilter.h"
-#include "itkImageAlgorithm.h"
+#include "itkImportImageContainer.h"
+#include "itkMultiThreader.h"
+#include "itksys/SystemInformation.hxx"
 
 #include "vtkProbeFilter.h"
 #include "vtkImageData.h"
 #include "vtkNew.h"
+#include "vtkSmartPointer.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkDataArray.h"
+#include "vtkTypeTraits.h"
 #include "vtkStructuredGrid.h"
-#include "vtkPointInterpolator.h"
+#include "vtkStaticPointLocator.h"
+#include "vtkIdList.h"
+#include "vtkGenericCell.h"
+#include "vtkDoubleArray.h"
 #include "vtkGaussianKernel.h"
 #include "vtkLinearKernel.h"
 #include "vtkShepardKernel.h"
 #include "vtkInterpolationKernel.h"
 #include "vtkVoronoiKernel.h"
+#include "vtkMath.h"
+
+#include "ScanConversionProfiler.h"
+#include "ScanConversionImageWriter.h"
+#include "ScanConversionResamplingOptions.h"
+
+#include "ScanConversionResampleImageFilter.h"
+#include "ScanConversionGaussianInterpolateImageFunction.h"
+#include "ScanConversionWindowedSincInterpolateImageFunction.h"
+#include "ScanConversionFiniteNearestNeighborInterpolateImageFunction.h"
+#include "ScanConversionFiniteLinearInterpolateImageFunction.h"
+#include "ScanConversionFiniteSample.h"
 
-#include "itkPluginFilterWatcher.h"
 
 namespace
 {
 
-enum ScanConversionResamplingMethod {
-  ITK_NEAREST_NEIGHBOR = 0,
-  ITK_LINEAR,
-  ITK_GAUSSIAN,
-  ITK_WINDOWED_SINC,
-  VTK_PROBE_FILTER,
-  VTK_GAUSSIAN_KERNEL,
-  VTK_LINEAR_KERNEL,
-  VTK_SHEPARD_KERNEL,
-  VTK_VORONOI_KERNEL
+/** Image container that references the scalars of a vtkDataArray. The
+ * container keeps a reference to the array, so the pixel buffer stays valid
+ * for the life of the ITK image without a copy. */
+template< typename TElement >
+class VTKDataArrayImageContainer:
+  public itk::ImportImageContainer< itk::SizeValueType, TElement >
+{
+public:
+  typedef VTKDataArrayImageContainer                                Self;
+  typedef itk::ImportImageContainer< itk::SizeValueType, TElement > Superclass;
+  typedef itk::SmartPointer< Self >                                 Pointer;
+  typedef itk::SmartPointer< const Self >                           ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( VTKDataArrayImageContainer, ImportImageContainer );
+
+  void SetDataArray( vtkDataArray * dataArray )
+    {
+    m_DataArray = dataArray;
+    this->SetImportPointer( static_cast< TElement * >( dataArray->GetVoidPointer( 0 ) ),
+      static_cast< itk::SizeValueType >( dataArray->GetNumberOfTuples() ),
+      false );
+    }
+
+protected:
+  VTKDataArrayImageContainer() {}
+  ~VTKDataArrayImageContainer() {}
+
+private:
+  VTKDataArrayImageContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  vtkSmartPointer< vtkDataArray > m_DataArray;
 };
 
 
-template< typename TInputImage, typename TOutputImage >
+template< typename TVTKScalar, typename TPixel >
+void
+CastVTKScalars( const TVTKScalar * vtkBuffer, TPixel * itkBuffer, vtkIdType numberOfValues )
+{
+  for( vtkIdType ii = 0; ii < numberOfValues; ++ii )
+    {
+    itkBuffer[ii] = static_cast< TPixel >( vtkBuffer[ii] );
+    }
+}
+
+
+/** Cast single component VTK scalars into an ITK pixel buffer. */
+template< typename TPixel >
+void
+CastVTKScalars( vtkDataArray * scalars, TPixel * itkBuffer )
+{
+  const vtkIdType numberOfValues = scalars->GetNumberOfTuples();
+  switch( scalars->GetDataType() )
+    {
+    vtkTemplateMacro( CastVTKScalars( static_cast< const VTK_TT * >( scalars->GetVoidPointer( 0 ) ),
+        itkBuffer,
+        numberOfValues ) );
+  default:
+    for( vtkIdType ii = 0; ii < numberOfValues; ++ii )
+      {
+      itkBuffer[ii] = static_cast< TPixel >( scalars->GetComponent( ii, 0 ) );
+      }
+    }
+}
+
+
+/** Store the scalars of a VTK image in an ITK image. When the VTK scalar type
+ * matches the ITK pixel type the scalars are adopted without a copy.
+ * Otherwise they are cast into a newly allocated buffer. */
+template< typename TOutputImage >
 int
-ITKScanConversionResampling(const typename TInputImage::Pointer & inputImage,
-  typename TOutputImage::Pointer & outputImage,
+VTKImageDataToImage( vtkImageData * imageData,
+  const typename TOutputImage::DirectionType & direction,
+  typename TOutputImage::Pointer & outputImage )
+{
+  typedef TOutputImage                        OutputImageType;
+  typedef typename OutputImageType::PixelType PixelType;
+
+  vtkDataArray * scalars = imageData->GetPointData()->GetScalars();
+  if( scalars == ITK_NULLPTR || scalars->GetNumberOfComponents() != 1 )
+    {
+    std::cerr << "Expected single component scalars in the VTK resampling output" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  int dimensions[3];
+  imageData->GetDimensions( dimensions );
+  double vtkSpacing[3];
+  imageData->GetSpacing( vtkSpacing );
+  double vtkOrigin[3];
+  imageData->GetOrigin( vtkOrigin );
+
+  typename OutputImageType::SizeType size;
+  typename OutputImageType::SpacingType spacing;
+  typename OutputImageType::PointType origin;
+  for( unsigned int ii = 0; ii < OutputImageType::ImageDimension; ++ii )
+    {
+    size[ii] = dimensions[ii];
+    spacing[ii] = vtkSpacing[ii];
+    origin[ii] = vtkOrigin[ii];
+    }
+
+  typename OutputImageType::Pointer output = OutputImageType::New();
+  output->SetRegions( size );
+  output->SetSpacing( spacing );
+  output->SetOrigin( origin );
+  output->SetDirection( direction );
+  if( scalars->GetDataType() == vtkTypeTraits< PixelType >::VTKTypeID() )
+    {
+    typedef VTKDataArrayImageContainer< PixelType > ContainerType;
+    typename ContainerType::Pointer container = ContainerType::New();
+    container->SetDataArray( scalars );
+    output->SetPixelContainer( container );
+    }
+  else
+    {
+    output->Allocate();
+    CastVTKScalars( scalars, output->GetBufferPointer() );
+    }
+  outputImage = output;
+
+  return EXIT_SUCCESS;
+}
+
+
+/** Set a windowed-sinc interpolator with a Lanczos window of radius VRadius. */
+template< typename TInputImage, typename TOutputImage, unsigned int VRadius >
+void
+SetWindowedSincInterpolator( ScanConversionResampleImageFilter< TInputImage, TOutputImage > * resampler,
+  bool replaceNonFinite )
+{
+  typedef ScanConversionWindowedSincInterpolateImageFunction< TInputImage, VRadius, double > InterpolatorType;
+  typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetReplaceNonFinite( replaceNonFinite );
+  resampler->SetInterpolator( interpolator );
+  resampler->SetInputRequestedRegionPadding( VRadius );
+}
+
+
+/** Create and configure the resampler for an ITK resampling method. Returns
+ * ITK_NULLPTR for the other methods. */
+template< typename TInputImage, typename TOutputImage >
+typename ScanConversionResampleImageFilter< TInputImage, TOutputImage >::Pointer
+CreateITKScanConversionResampler(const typename TInputImage::Pointer & inputImage,
   const typename TOutputImage::SizeType & size,
   const typename TOutputImage::SpacingType & spacing,
   const typename TOutputImage::PointType & origin,
   const typename TOutputImage::DirectionType & direction,
   ScanConversionResamplingMethod method,
-  ModuleProcessInformation * CLPProcessInformation
+  const ScanConversionResamplingOptions & options
   )
 {
   typedef TInputImage  InputImageType;
   typedef TOutputImage OutputImageType;
   typedef double       CoordRepType;
 
-  typedef itk::ResampleImageFilter< InputImageType, OutputImageType > ResamplerType;
+  typedef ScanConversionResampleImageFilter< InputImageType, OutputImageType > ResamplerType;
   typename ResamplerType::Pointer resampler = ResamplerType::New();
   resampler->SetInput( inputImage );
+  resampler->SetSector( options.Sector );
+  resampler->SetSectorMask( options.SectorMask );
+  resampler->SetSliceBounds( options.SliceBounds );
+  resampler->SetSliceSeriesLocator( options.SliceSeriesLocator );
+  resampler->SetTileSize( options.TileSize );
 
   resampler->SetSize( size );
   resampler->SetOutputSpacing( spacing );
@@ -85,16 +237,36 @@ ITKScanConversionResampling(const typename TInputImage::Pointer & inputImage,
     {
   case ITK_NEAREST_NEIGHBOR:
       {
-      typedef itk::NearestNeighborInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
-      typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
-      resampler->SetInterpolator( interpolator );
+      if( options.ReplaceNonFinite )
+        {
+        typedef ScanConversionFiniteNearestNeighborInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
+        typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+        resampler->SetInterpolator( interpolator );
+        }
+      else
+        {
+        typedef itk::NearestNeighborInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
+        typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+        resampler->SetInterpolator( interpolator );
+        }
+      resampler->SetInputRequestedRegionPadding( 1 );
       break;
       }
   case ITK_LINEAR:
       {
-      typedef itk::LinearInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
-      typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
-      resampler->SetInterpolator( interpolator );
+      if( options.ReplaceNonFinite )
+        {
+        typedef ScanConversionFiniteLinearInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
+        typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+        resampler->SetInterpolator( interpolator );
+        }
+      else
+        {
+        typedef itk::LinearInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
+        typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+        resampler->SetInterpolator( interpolator );
+        }
+      resampler->SetInputRequestedRegionPadding( 1 );
       break;
       }
   case ITK_GAUSSIAN:
@@ -104,7 +276,7 @@ ITKScanConversionResampling(const typename TInputImage::Pointer & inputImage,
         {
         maxSpacing = std::max( maxSpacing, spacing[ii] );
         }
-      typedef itk::GaussianInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
+      typedef ScanConversionGaussianInterpolateImageFunction< InputImageType, CoordRepType > InterpolatorType;
       typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
       typename InterpolatorType::ArrayType sigma;
       for( unsigned int ii = 0; ii < OutputImageType::ImageDimension; ++ii )
@@ -113,132 +285,124 @@ ITKScanConversionResampling(const typename TInputImage::Pointer & inputImage,
         }
       interpolator->SetSigma( sigma );
       interpolator->SetAlpha( 3.0 * maxSpacing );
+      interpolator->SetReplaceNonFinite( options.ReplaceNonFinite );
       resampler->SetInterpolator( interpolator );
-      break;
+      // The support of the Gaussian is defined in the physical units of the
+      // input spacing, which does not map to input samples for the probe
+      // geometries, so the whole input is requested
+      resampler->SetLimitInputRequestedRegion( false );
+      return resampler;
       }
   case ITK_WINDOWED_SINC:
       {
-      static const unsigned int Radius = 3;
-      typedef itk::Function::LanczosWindowFunction< Radius, CoordRepType, CoordRepType > WindowFunctionType;
-      typedef itk::WindowedSincInterpolateImageFunction< InputImageType, Radius, WindowFunctionType > InterpolatorType;
-      typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
-      resampler->SetInterpolator( interpolator );
+      switch( options.WindowedSincRadius )
+        {
+      case 2:
+        SetWindowedSincInterpolator< InputImageType, OutputImageType, 2 >( resampler, options.ReplaceNonFinite );
+        break;
+      case 3:
+        SetWindowedSincInterpolator< InputImageType, OutputImageType, 3 >( resampler, options.ReplaceNonFinite );
+        break;
+      case 4:
+        SetWindowedSincInterpolator< InputImageType, OutputImageType, 4 >( resampler, options.ReplaceNonFinite );
+        break;
+      default:
+        std::cerr << "Unsupported windowed-sinc radius: " << options.WindowedSincRadius << std::endl;
+        return ITK_NULLPTR;
+        }
       break;
       }
   default:
     std::cerr << "Unsupported resampling method in ITKScanConversionResampling" << std::endl;
-    return EXIT_FAILURE;
+    return ITK_NULLPTR;
     }
+  resampler->SetLimitInputRequestedRegion( options.StreamDivisions > 1 );
 
-  itk::PluginFilterWatcher watchResampler(resampler, "Resample Image", CLPProcessInformation);
-  resampler->Update();
-  outputImage = resampler->GetOutput();
-
-  return EXIT_SUCCESS;
+  return resampler;
 }
 
 
 template< typename TInputImage, typename TOutputImage >
 int
-VTKProbeFilterResampling(const typename TInputImage::Pointer & inputImage,
+ITKScanConversionResampling(const typename TInputImage::Pointer & inputImage,
   typename TOutputImage::Pointer & outputImage,
   const typename TOutputImage::SizeType & size,
   const typename TOutputImage::SpacingType & spacing,
   const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  ScanConversionResamplingMethod method,
+  const ScanConversionResamplingOptions & options,
   ModuleProcessInformation * CLPProcessInformation
   )
 {
-  typedef TInputImage  InputImageType;
-  typedef TOutputImage OutputImageType;
-
-  typedef itk::SpecialCoordinatesImageToVTKStructuredGridFilter< InputImageType > ConversionFilterType;
-  typename ConversionFilterType::Pointer conversionFilter = ConversionFilterType::New();
-  conversionFilter->SetInput( inputImage );
-  itk::PluginFilterWatcher watchConversion(conversionFilter, "Convert to vtkStructuredGrid", CLPProcessInformation);
-  conversionFilter->Update();
-  vtkStructuredGrid * inputStructuredGrid = conversionFilter->GetOutput();
-
-  vtkNew< vtkImageData > grid;
-  grid->SetDimensions( size[0], size[1], size[2] );
-  grid->SetSpacing( spacing[0], spacing[1], spacing[2] );
-  grid->SetOrigin( origin[0], origin[1], origin[2] );
-  grid->ComputeBounds();
-
-  vtkNew< vtkProbeFilter > probeFilter;
-  probeFilter->SetSourceData( inputStructuredGrid );
-  probeFilter->SetInputData( grid.GetPointer() );
-  probeFilter->Update();
-
-  typedef itk::VTKImageToImageFilter< OutputImageType > VTKToITKFilterType;
-  typename VTKToITKFilterType::Pointer vtkToITKFilter = VTKToITKFilterType::New();
-  vtkToITKFilter->SetInput( probeFilter->GetImageDataOutput() );
-  vtkToITKFilter->Update();
-
-  typename OutputImageType::Pointer output = OutputImageType::New();
-  output->SetRegions( vtkToITKFilter->GetOutput()->GetLargestPossibleRegion() );
-  output->Allocate();
-  itk::ImageAlgorithm::Copy< OutputImageType, OutputImageType >(
-    vtkToITKFilter->GetOutput(),
-    output.GetPointer(),
-    output->GetLargestPossibleRegion(),
-    output->GetLargestPossibleRegion()
-    );
-  outputImage = output;
+  typedef ScanConversionResampleImageFilter< TInputImage, TOutputImage > ResamplerType;
+  typename ResamplerType::Pointer resampler = CreateITKScanConversionResampler< TInputImage, TOutputImage >( inputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    method,
+    options );
+  if( resampler.IsNull() )
+    {
+    return EXIT_FAILURE;
+    }
 
+  ScanConversionFilterWatcher watchResampler(resampler, "Resample Image", CLPProcessInformation);
+  resampler->Update();
+  outputImage = resampler->GetOutput();
 
   return EXIT_SUCCESS;
 }
 
 
-template< typename TInputImage, typename TOutputImage >
-int
-VTKPointInterpolatorResampling(const typename TInputImage::Pointer & inputImage,
-  typename TOutputImage::Pointer & outputImage,
-  const typename TOutputImage::SizeType & size,
-  const typename TOutputImage::SpacingType & spacing,
+/** The VTK resampling filters sample on a vtkImageData, which has no
+ * direction. When the output grid is oblique, express the structured grid
+ * points in the frame of the output grid axes about the output origin, so the
+ * axis aligned vtkImageData with the same origin samples the oblique grid. */
+template< typename TOutputImage >
+void
+AlignStructuredGridToOutputGrid( vtkStructuredGrid * structuredGrid,
   const typename TOutputImage::PointType & origin,
-  ScanConversionResamplingMethod method,
-  ModuleProcessInformation * CLPProcessInformation
-  )
+  const typename TOutputImage::DirectionType & direction )
 {
-  typedef TInputImage  InputImageType;
-  typedef TOutputImage OutputImageType;
+  typedef typename TOutputImage::DirectionType DirectionType;
+  DirectionType identity;
+  identity.SetIdentity();
+  if( direction == identity )
+    {
+    return;
+    }
 
-  typedef itk::SpecialCoordinatesImageToVTKStructuredGridFilter< InputImageType > ConversionFilterType;
-  typename ConversionFilterType::Pointer conversionFilter = ConversionFilterType::New();
-  conversionFilter->SetInput( inputImage );
-  itk::PluginFilterWatcher watchConversion(conversionFilter, "Convert to vtkStructuredGrid", CLPProcessInformation);
-  conversionFilter->Update();
-  vtkStructuredGrid * inputStructuredGrid = conversionFilter->GetOutput();
-  inputStructuredGrid->ComputeBounds();
-
-  vtkNew< vtkImageData > grid;
-  grid->SetDimensions( size[0], size[1], size[2] );
-  grid->SetSpacing( spacing[0], spacing[1], spacing[2] );
-  grid->SetOrigin( origin[0], origin[1], origin[2] );
-  grid->ComputeBounds();
-  vtkNew< vtkFloatArray > scalars;
-  scalars->SetName( "Scalars" );
-  scalars->Allocate( size[0] * size[1] * size[2] );
-  grid->GetPointData()->SetScalars(scalars.GetPointer());
-
-
-  vtkNew< vtkPointInterpolator > pointInterpolator;
-  pointInterpolator->SetSourceData( inputStructuredGrid );
-  pointInterpolator->SetInputData( grid.GetPointer() );
-  pointInterpolator->SetPassPointArrays( false );
-  pointInterpolator->SetNullPointsStrategyToNullValue();
-  pointInterpolator->SetNullValue( 0.0 );
-
-  vtkInterpolationKernel * interpolationKernel = ITK_NULLPTR;
-
-  double maxSpacing = 0.0;
-  for( unsigned int ii = 0; ii < InputImageType::ImageDimension; ++ii )
+  vtkPoints * inputPoints = structuredGrid->GetPoints();
+  const vtkIdType numberOfPoints = inputPoints->GetNumberOfPoints();
+  vtkNew< vtkPoints > alignedPoints;
+  alignedPoints->SetDataTypeToDouble();
+  alignedPoints->SetNumberOfPoints( numberOfPoints );
+  double point[3];
+  double alignedPoint[3];
+  for( vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId )
     {
-    maxSpacing = std::max( maxSpacing, spacing[ii] );
+    inputPoints->GetPoint( pointId, point );
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      alignedPoint[ii] = origin[ii];
+      for( unsigned int jj = 0; jj < 3; ++jj )
+        {
+        alignedPoint[ii] += direction[jj][ii] * ( point[jj] - origin[jj] );
+        }
+      }
+    alignedPoints->SetPoint( pointId, alignedPoint );
     }
-  const double radius = 2.1 * maxSpacing;
+  structuredGrid->SetPoints( alignedPoints.GetPointer() );
+}
+
 
+/** Create the interpolation kernel for a resampling method. The caller is
+ * responsible for deleting the kernel. */
+inline vtkInterpolationKernel *
+CreateVTKInterpolationKernel( ScanConversionResamplingMethod method, double radius )
+{
   switch( method )
     {
   case VTK_GAUSSIAN_KERNEL:
@@ -246,81 +410,782 @@ VTKPointInterpolatorResampling(const typename TInputImage::Pointer & inputImage,
       vtkGaussianKernel * gaussianKernel = vtkGaussianKernel::New();
       gaussianKernel->SetKernelFootprintToRadius();
       gaussianKernel->SetRadius( radius );
-      interpolationKernel = gaussianKernel;
-      break;
+      return gaussianKernel;
       }
   case VTK_LINEAR_KERNEL:
       {
       vtkLinearKernel * linearKernel = vtkLinearKernel::New();
       linearKernel->SetKernelFootprintToRadius();
       linearKernel->SetRadius( radius );
-      interpolationKernel = linearKernel;
-      break;
+      return linearKernel;
       }
   case VTK_SHEPARD_KERNEL:
       {
       vtkShepardKernel * shepardKernel = vtkShepardKernel::New();
       shepardKernel->SetKernelFootprintToRadius();
       shepardKernel->SetRadius( radius );
-      interpolationKernel = shepardKernel;
-      break;
+      return shepardKernel;
       }
   case VTK_VORONOI_KERNEL:
       {
       vtkVoronoiKernel * voronoiKernel = vtkVoronoiKernel::New();
-      interpolationKernel = voronoiKernel;
-      break;
+      return voronoiKernel;
       }
   default:
-    std::cerr << "Unexpected interpolation kernel: " << method << std::endl;
-    return EXIT_FAILURE;
+    return ITK_NULLPTR;
+    }
+}
+
+
+/** The weighted sum of a VTK kernel, saturated to the range of the output
+ * pixel type. The weights sum to one, but a sum that rounds past the range
+ * of an integer pixel type must saturate instead of wrapping around. */
+template< typename TOutputPixel >
+TOutputPixel
+SaturateVTKKernelValue( double value )
+{
+  const double minOutputValue = itk::NumericTraits< TOutputPixel >::NonpositiveMin();
+  const double maxOutputValue = itk::NumericTraits< TOutputPixel >::max();
+  if( value < minOutputValue )
+    {
+    return static_cast< TOutputPixel >( minOutputValue );
+    }
+  else if( value > maxOutputValue )
+    {
+    return static_cast< TOutputPixel >( maxOutputValue );
+    }
+  return static_cast< TOutputPixel >( value );
+}
+
+
+template< typename TInputPixel, typename TOutputPixel >
+struct VTKScanConversionKernelData
+{
+  vtkInterpolationKernel * Kernel;
+  const TInputPixel *      InputBuffer;
+  int                      Dimensions[3];
+  double                   Spacing[3];
+  double                   Origin[3];
+  TOutputPixel *           OutputBuffer;
+  bool                     ReplaceNonFinite;
+
+  /** Neighbor lists of the output voxels, when they were built, with
+   * NeighborListSize entries per voxel. */
+  const unsigned int *     NeighborCounts;
+  const vtkIdType *        NeighborIds;
+  const float *            NeighborWeights;
+  unsigned int             NeighborListSize;
+};
+
+
+/** Interpolate a range of output rows with the kernel of a
+ * VTKScanConversionResampler. The kernel searches the shared static point
+ * locator, which is thread safe. */
+template< typename TInputPixel, typename TOutputPixel >
+ITK_THREAD_RETURN_TYPE
+VTKScanConversionKernelThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct                      ThreadInfoType;
+  typedef VTKScanConversionKernelData< TInputPixel, TOutputPixel > DataType;
+  ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+  const DataType * data = static_cast< DataType * >( threadInfo->UserData );
+
+  const vtkIdType numberOfRows = static_cast< vtkIdType >( data->Dimensions[1] ) * data->Dimensions[2];
+  const vtkIdType rowBegin = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  const vtkIdType rowEnd = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+
+  vtkNew< vtkIdList > pointIds;
+  vtkNew< vtkDoubleArray > weights;
+  double point[3];
+  TOutputPixel * outputPixel = data->OutputBuffer + rowBegin * data->Dimensions[0];
+  for( vtkIdType row = rowBegin; row < rowEnd; ++row )
+    {
+    point[1] = data->Origin[1] + ( row % data->Dimensions[1] ) * data->Spacing[1];
+    point[2] = data->Origin[2] + ( row / data->Dimensions[1] ) * data->Spacing[2];
+    for( int column = 0; column < data->Dimensions[0]; ++column )
+      {
+      point[0] = data->Origin[0] + column * data->Spacing[0];
+      double value = 0.0;
+      if( data->Kernel->ComputeBasis( point, pointIds.GetPointer() ) > 0 )
+        {
+        const vtkIdType numberOfWeights = data->Kernel->ComputeWeights( point, pointIds.GetPointer(), weights.GetPointer() );
+        const double * weightBuffer = weights->GetPointer( 0 );
+        if( data->ReplaceNonFinite )
+          {
+          for( vtkIdType weightIndex = 0; weightIndex < numberOfWeights; ++weightIndex )
+            {
+            value += weightBuffer[weightIndex] * ScanConversionFiniteSample( data->InputBuffer[pointIds->GetId( weightIndex )] );
+            }
+          }
+        else
+          {
+          for( vtkIdType weightIndex = 0; weightIndex < numberOfWeights; ++weightIndex )
+            {
+            value += weightBuffer[weightIndex] * data->InputBuffer[pointIds->GetId( weightIndex )];
+            }
+          }
+        }
+      *outputPixel = SaturateVTKKernelValue< TOutputPixel >( value );
+      ++outputPixel;
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Interpolate a range of output rows from the neighbor lists of a
+ * VTKScanConversionResampler, without searching the locator. */
+template< typename TInputPixel, typename TOutputPixel >
+ITK_THREAD_RETURN_TYPE
+VTKScanConversionNeighborListThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct                      ThreadInfoType;
+  typedef VTKScanConversionKernelData< TInputPixel, TOutputPixel > DataType;
+  ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+  const DataType * data = static_cast< DataType * >( threadInfo->UserData );
+
+  const vtkIdType numberOfRows = static_cast< vtkIdType >( data->Dimensions[1] ) * data->Dimensions[2];
+  const vtkIdType rowBegin = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  const vtkIdType rowEnd = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+
+  const vtkIdType voxelEnd = rowEnd * data->Dimensions[0];
+  for( vtkIdType voxel = rowBegin * data->Dimensions[0]; voxel < voxelEnd; ++voxel )
+    {
+    const unsigned int count = data->NeighborCounts[voxel];
+    const vtkIdType * ids = data->NeighborIds + voxel * data->NeighborListSize;
+    const float * neighborWeights = data->NeighborWeights + voxel * data->NeighborListSize;
+    double value = 0.0;
+    if( data->ReplaceNonFinite )
+      {
+      for( unsigned int neighbor = 0; neighbor < count; ++neighbor )
+        {
+        value += neighborWeights[neighbor] * ScanConversionFiniteSample( data->InputBuffer[ids[neighbor]] );
+        }
+      }
+    else
+      {
+      for( unsigned int neighbor = 0; neighbor < count; ++neighbor )
+        {
+        value += neighborWeights[neighbor] * data->InputBuffer[ids[neighbor]];
+        }
+      }
+    data->OutputBuffer[voxel] = SaturateVTKKernelValue< TOutputPixel >( value );
     }
 
-  typedef itk::Image< float, 3 > VTKInterpolatorOutputImageType;
-  typedef itk::VTKImageToImageFilter< VTKInterpolatorOutputImageType > VTKToITKFilterType;
-  typename VTKToITKFilterType::Pointer vtkToITKFilter = VTKToITKFilterType::New();
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Output grid, kernel, and locator of the neighbor lists of a
+ * VTKScanConversionResampler, and the lists that are built. */
+struct VTKScanConversionNeighborListBuildData
+{
+  vtkInterpolationKernel * Kernel;
+  vtkStaticPointLocator *  Locator;
+  vtkDataSet *             DataSet;
+  int                      Dimensions[3];
+  double                   Spacing[3];
+  double                   Origin[3];
+  unsigned int             NeighborListSize;
+  /** Largest distance of a neighbor, negative for no limit. */
+  double                   MaximumDistance;
+  /** When not null, the local sample spacing of each input point, and the
+   * largest distance of a neighbor is the larger of MaximumDistance and the
+   * local spacing of the closest input point. */
+  const float *            LocalSpacings;
+  unsigned int *           NeighborCounts;
+  vtkIdType *              NeighborIds;
+  float *                  NeighborWeights;
+};
+
+
+/** Bytes that the neighbor lists of a VTKScanConversionResampler may take:
+ * a quarter of the physical memory, or 1 GiB when it is not known. */
+inline double
+ScanConversionNeighborListMaximumBytes()
+{
+  itksys::SystemInformation systemInformation;
+  systemInformation.RunMemoryCheck();
+  const double physicalMemoryMiB = static_cast< double >( systemInformation.GetTotalPhysicalMemory() );
+  if( physicalMemoryMiB <= 0.0 )
+    {
+    return 1024.0 * 1048576.0;
+    }
+  return 0.25 * physicalMemoryMiB * 1048576.0;
+}
+
+
+/** Find the closest input points and their kernel weights for a range of
+ * output rows. */
+inline ITK_THREAD_RETURN_TYPE
+VTKScanConversionBuildNeighborListThread( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  typedef VTKScanConversionNeighborListBuildData DataType;
+  ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+  const DataType * data = static_cast< DataType * >( threadInfo->UserData );
+
+  const vtkIdType numberOfRows = static_cast< vtkIdType >( data->Dimensions[1] ) * data->Dimensions[2];
+  const vtkIdType rowBegin = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  const vtkIdType rowEnd = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+  const double maximumDistance2 = data->MaximumDistance * data->MaximumDistance;
+
+  vtkNew< vtkIdList > pointIds;
+  vtkNew< vtkDoubleArray > weights;
+  double point[3];
+  double neighborPoint[3];
+  vtkIdType voxel = rowBegin * data->Dimensions[0];
+  for( vtkIdType row = rowBegin; row < rowEnd; ++row )
+    {
+    point[1] = data->Origin[1] + ( row % data->Dimensions[1] ) * data->Spacing[1];
+    point[2] = data->Origin[2] + ( row / data->Dimensions[1] ) * data->Spacing[2];
+    for( int column = 0; column < data->Dimensions[0]; ++column, ++voxel )
+      {
+      point[0] = data->Origin[0] + column * data->Spacing[0];
+      data->Locator->FindClosestNPoints( static_cast< int >( data->NeighborListSize ), point, pointIds.GetPointer() );
+      if( data->MaximumDistance >= 0.0 )
+        {
+        double voxelMaximumDistance2 = maximumDistance2;
+        if( data->LocalSpacings != ITK_NULLPTR && pointIds->GetNumberOfIds() > 0 )
+          {
+          const double localSpacing = data->LocalSpacings[pointIds->GetId( 0 )];
+          voxelMaximumDistance2 = std::max( voxelMaximumDistance2, localSpacing * localSpacing );
+          }
+        // The points are sorted by distance
+        vtkIdType numberOfIds = 0;
+        while( numberOfIds < pointIds->GetNumberOfIds() )
+          {
+          data->DataSet->GetPoint( pointIds->GetId( numberOfIds ), neighborPoint );
+          if( vtkMath::Distance2BetweenPoints( point, neighborPoint ) > voxelMaximumDistance2 )
+            {
+            break;
+            }
+          ++numberOfIds;
+          }
+        pointIds->SetNumberOfIds( numberOfIds );
+        }
+
+      unsigned int count = 0;
+      if( pointIds->GetNumberOfIds() > 0 )
+        {
+        count = static_cast< unsigned int >( data->Kernel->ComputeWeights( point, pointIds.GetPointer(), weights.GetPointer() ) );
+        }
+      vtkIdType * ids = data->NeighborIds + voxel * data->NeighborListSize;
+      float * neighborWeights = data->NeighborWeights + voxel * data->NeighborListSize;
+      const double * weightBuffer = count > 0 ? weights->GetPointer( 0 ) : ITK_NULLPTR;
+      for( unsigned int neighbor = 0; neighbor < count; ++neighbor )
+        {
+        ids[neighbor] = pointIds->GetId( neighbor );
+        neighborWeights[neighbor] = static_cast< float >( weightBuffer[neighbor] );
+        }
+      data->NeighborCounts[voxel] = count;
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** \class VTKScanConversionResampler
+ *
+ * \brief Resample frames that share a geometry with the VTK methods.
+ *
+ * Initialize converts the input geometry to a vtkStructuredGrid once. For the
+ * kernel methods, it also builds a vtkStaticPointLocator over the grid
+ * points, which the kernel searches for every output voxel. For the
+ * vtkProbeFilter, the grid keeps the cell locator that the probe builds on
+ * the first frame, since the grid points do not change.
+ *
+ * Resample only swaps the scalars for the pixels of the next frame. The probe
+ * filter reads the frame buffer without a copy, and the kernels read the
+ * buffer directly. The frames must have the size of the image given to
+ * Initialize, and the point ids of the grid follow the input buffer order.
+ *
+ * The kernel methods interpolate the output rows in parallel with the same
+ * weights as the vtkPointInterpolator, with null points set to zero.
+ *
+ * With the N_CLOSEST_FOOTPRINT and the ADAPTIVE_FOOTPRINT, the Gaussian,
+ * Linear, and Shepard kernels interpolate at most KernelNumberOfPoints input
+ * samples for each output voxel, and Initialize finds them and computes
+ * their weights once. Resample then only sums the weighted samples of each
+ * frame, at the cost of KernelNumberOfPoints ids and weights per output voxel.
+ * The ADAPTIVE_FOOTPRINT only keeps the samples within the local sample
+ * spacing of the closest sample, the largest distance from that sample to
+ * its neighbors on the input grid, or within the radius if it is larger.
+ * When the lists would take more than ScanConversionNeighborListMaximumBytes,
+ * the radius footprint is used instead. The radius footprint searches the
+ * locator for every voxel of every frame, since the number of samples within
+ * the radius is not bounded.
+ *
+ * With ReplaceNonFinite, the kernels replace the non-finite samples with
+ * zero as they read them. The vtkProbeFilter interpolates the scalars inside
+ * VTK, so it still probes the frame buffer without a copy, and only the
+ * output voxels that the non-finite samples made non-finite are
+ * interpolated again, with the non-finite samples of their cell replaced. */
+template< typename TInputImage, typename TOutputImage >
+class VTKScanConversionResampler
+{
+public:
+  typedef TInputImage                             InputImageType;
+  typedef TOutputImage                            OutputImageType;
+  typedef typename InputImageType::PixelType      InputPixelType;
+  typedef typename OutputImageType::PixelType     OutputPixelType;
+  typedef typename OutputImageType::SizeType      SizeType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  VTKScanConversionResampler():
+    m_Method( VTK_PROBE_FILTER ),
+    m_NumberOfInputPixels( 0 ),
+    m_ReplaceNonFinite( false ),
+    m_KernelFootprint( ScanConversionResamplingOptions::RADIUS_FOOTPRINT ),
+    m_KernelNumberOfPoints( 8 )
+  {
+  }
+
+  void SetReplaceNonFinite( bool replaceNonFinite )
+  {
+    m_ReplaceNonFinite = replaceNonFinite;
+  }
+
+  /** Footprint of the Gaussian, Linear, and Shepard kernels, set before
+   * Initialize. */
+  void SetKernelFootprint( ScanConversionResamplingOptions::KernelFootprintType footprint,
+    unsigned int numberOfPoints )
+  {
+    m_KernelFootprint = footprint;
+    m_KernelNumberOfPoints = std::max( numberOfPoints, 1u );
+  }
+
+  /** Methods that are resampled with VTK. */
+  static bool SupportsMethod( ScanConversionResamplingMethod method )
+  {
+    switch( method )
+      {
+    case VTK_PROBE_FILTER:
+    case VTK_GAUSSIAN_KERNEL:
+    case VTK_LINEAR_KERNEL:
+    case VTK_SHEPARD_KERNEL:
+    case VTK_VORONOI_KERNEL:
+      return true;
+    default:
+      return false;
+      }
+  }
+
+  /** Build the structured grid and the locator for the geometry of the
+   * inputImage sampled on the given output grid. */
+  int Initialize( const InputImageType * inputImage,
+    const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction,
+    ScanConversionResamplingMethod method,
+    ModuleProcessInformation * CLPProcessInformation )
+  {
+    if( !SupportsMethod( method ) )
+      {
+      std::cerr << "Unexpected VTK resampling method: " << method << std::endl;
+      return EXIT_FAILURE;
+      }
+    m_Method = method;
+    m_Size = size;
+    m_Spacing = spacing;
+    m_Origin = origin;
+    m_Direction = direction;
+    m_NumberOfInputPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+
+    typedef itk::SpecialCoordinatesImageToVTKStructuredGridFilter< InputImageType > ConversionFilterType;
+    typename ConversionFilterType::Pointer conversionFilter = ConversionFilterType::New();
+    conversionFilter->SetInput( inputImage );
+    ScanConversionFilterWatcher watchConversion(conversionFilter, "Convert to vtkStructuredGrid", CLPProcessInformation);
+    conversionFilter->Update();
+
+    ScanConversionProfileScope profileLocator( "Build VTK Locator" );
+    m_StructuredGrid = vtkSmartPointer< vtkStructuredGrid >::New();
+    m_StructuredGrid->ShallowCopy( conversionFilter->GetOutput() );
+    m_StructuredGrid->GetPointData()->Initialize();
+    AlignStructuredGridToOutputGrid< OutputImageType >( m_StructuredGrid, origin, direction );
+    m_StructuredGrid->ComputeBounds();
+
+    if( m_Method == VTK_PROBE_FILTER )
+      {
+      m_Locator = ITK_NULLPTR;
+      m_Kernel = ITK_NULLPTR;
+      m_OutputGrid = vtkSmartPointer< vtkImageData >::New();
+      m_OutputGrid->SetDimensions( size[0], size[1], size[2] );
+      m_OutputGrid->SetSpacing( spacing[0], spacing[1], spacing[2] );
+      m_OutputGrid->SetOrigin( origin[0], origin[1], origin[2] );
+      m_OutputGrid->ComputeBounds();
+
+      m_ProbeFilter = vtkSmartPointer< vtkProbeFilter >::New();
+      m_ProbeFilter->SetSourceData( m_StructuredGrid );
+      m_ProbeFilter->SetInputData( m_OutputGrid );
+      return EXIT_SUCCESS;
+      }
+
+    m_ProbeFilter = ITK_NULLPTR;
+    m_OutputGrid = ITK_NULLPTR;
+    double maxSpacing = 0.0;
+    for( unsigned int ii = 0; ii < OutputImageType::ImageDimension; ++ii )
+      {
+      maxSpacing = std::max( maxSpacing, spacing[ii] );
+      }
+    const double radius = 2.1 * maxSpacing;
+
+    m_Locator = vtkSmartPointer< vtkStaticPointLocator >::New();
+    m_Locator->SetDataSet( m_StructuredGrid );
+    m_Locator->BuildLocator();
+    m_Kernel.TakeReference( CreateVTKInterpolationKernel( m_Method, radius ) );
+    m_Kernel->Initialize( m_Locator, m_StructuredGrid, m_StructuredGrid->GetPointData() );
+
+    m_NeighborCounts.clear();
+    m_NeighborIds.clear();
+    m_NeighborWeights.clear();
+    if( m_KernelFootprint != ScanConversionResamplingOptions::RADIUS_FOOTPRINT && m_Method != VTK_VORONOI_KERNEL )
+      {
+      const double numberOfVoxels = static_cast< double >( size[0] ) * size[1] * size[2];
+      const double neighborListBytes = numberOfVoxels
+        * ( sizeof( unsigned int ) + m_KernelNumberOfPoints * ( sizeof( vtkIdType ) + sizeof( float ) ) );
+      if( neighborListBytes > static_cast< double >( ScanConversionNeighborListMaximumBytes() ) )
+        {
+        std::cerr << "The neighbor lists of the kernel footprint would take "
+          << neighborListBytes / 1048576.0 << " MiB, so the samples within the radius are interpolated instead" << std::endl;
+        }
+      else
+        {
+        // The adaptive footprint shrinks to the closest samples where the
+        // input is dense, and grows up to the local sample spacing where it
+        // is sparse, so the voxels beyond the input are null
+        double maximumDistance = -1.0;
+        std::vector< float > localSpacings;
+        if( m_KernelFootprint == ScanConversionResamplingOptions::ADAPTIVE_FOOTPRINT )
+          {
+          maximumDistance = radius;
+          LocalSampleSpacings( m_StructuredGrid, localSpacings );
+          }
+        this->BuildNeighborLists( maximumDistance, localSpacings );
+        }
+      }
+
+    return EXIT_SUCCESS;
+  }
+
+  /** Resample the inputImage, which must have the geometry given to
+   * Initialize. */
+  int Resample( const InputImageType * inputImage,
+    typename OutputImageType::Pointer & outputImage )
+  {
+    if( m_StructuredGrid.GetPointer() == ITK_NULLPTR )
+      {
+      std::cerr << "The VTK scan conversion resampler has not been initialized" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( inputImage->GetBufferedRegion().GetNumberOfPixels() != m_NumberOfInputPixels )
+      {
+      std::cerr << "The input size differs from the size of the input used to initialize the VTK resampler" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ScanConversionProfileScope profileResampling( "Resample Image" );
+    if( m_Method == VTK_PROBE_FILTER )
+      {
+      vtkSmartPointer< vtkDataArray > scalars;
+      scalars.TakeReference( vtkDataArray::CreateDataArray( vtkTypeTraits< InputPixelType >::VTKTypeID() ) );
+      scalars->SetNumberOfComponents( 1 );
+      scalars->SetVoidArray( const_cast< InputPixelType * >( inputImage->GetBufferPointer() ),
+        static_cast< vtkIdType >( m_NumberOfInputPixels ),
+        1 );
+      m_StructuredGrid->GetPointData()->SetScalars( scalars );
+      m_ProbeFilter->Update();
+      if( m_ReplaceNonFinite && !itk::NumericTraits< InputPixelType >::is_integer )
+        {
+        this->ReplaceNonFiniteProbes( m_ProbeFilter->GetImageDataOutput(), inputImage->GetBufferPointer() );
+        }
+      const int status = VTKImageDataToImage< OutputImageType >( m_ProbeFilter->GetImageDataOutput(), m_Direction, outputImage );
+      m_StructuredGrid->GetPointData()->Initialize();
+      return status;
+      }
+
+    typename OutputImageType::Pointer output = OutputImageType::New();
+    output->SetRegions( m_Size );
+    output->SetSpacing( m_Spacing );
+    output->SetOrigin( m_Origin );
+    output->SetDirection( m_Direction );
+    output->Allocate();
+
+    typedef VTKScanConversionKernelData< InputPixelType, OutputPixelType > DataType;
+    DataType data;
+    data.Kernel = m_Kernel;
+    data.InputBuffer = inputImage->GetBufferPointer();
+    data.OutputBuffer = output->GetBufferPointer();
+    data.ReplaceNonFinite = m_ReplaceNonFinite;
+    data.NeighborCounts = m_NeighborCounts.empty() ? ITK_NULLPTR : &m_NeighborCounts[0];
+    data.NeighborIds = m_NeighborIds.empty() ? ITK_NULLPTR : &m_NeighborIds[0];
+    data.NeighborWeights = m_NeighborWeights.empty() ? ITK_NULLPTR : &m_NeighborWeights[0];
+    data.NeighborListSize = m_KernelNumberOfPoints;
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      data.Dimensions[ii] = m_Size[ii];
+      data.Spacing[ii] = m_Spacing[ii];
+      data.Origin[ii] = m_Origin[ii];
+      }
+
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    const vtkIdType numberOfRows = static_cast< vtkIdType >( data.Dimensions[1] ) * data.Dimensions[2];
+    if( numberOfRows < static_cast< vtkIdType >( threader->GetNumberOfThreads() ) )
+      {
+      threader->SetNumberOfThreads( static_cast< itk::ThreadIdType >( std::max( vtkIdType( 1 ), numberOfRows ) ) );
+      }
+    if( m_NeighborCounts.empty() )
+      {
+      threader->SetSingleMethod( VTKScanConversionKernelThread< InputPixelType, OutputPixelType >, &data );
+      }
+    else
+      {
+      threader->SetSingleMethod( VTKScanConversionNeighborListThread< InputPixelType, OutputPixelType >, &data );
+      }
+    threader->SingleMethodExecute();
+
+    outputImage = output;
+    return EXIT_SUCCESS;
+  }
 
+private:
+  /** Interpolate again the probed voxels that are not finite, with the
+   * non-finite samples of their cell replaced with zero. A probed voxel is
+   * only non-finite when a sample of its cell is, so the other voxels
+   * already have the value of the interpolation of the replaced samples. */
+  void ReplaceNonFiniteProbes( vtkImageData * probedImage, const InputPixelType * inputBuffer )
+  {
+    vtkDataArray * probedScalars = probedImage->GetPointData()->GetScalars();
+    if( probedScalars == ITK_NULLPTR )
+      {
+      return;
+      }
+    vtkSmartPointer< vtkGenericCell > cell = vtkSmartPointer< vtkGenericCell >::New();
+    const double tolerance = 0.001 * m_StructuredGrid->GetLength();
+    double point[3];
+    double pcoords[3];
+    double weights[8];
+    int subId = 0;
+    const vtkIdType numberOfPoints = probedImage->GetNumberOfPoints();
+    for( vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId )
+      {
+      if( vnl_math::isfinite( probedScalars->GetComponent( pointId, 0 ) ) )
+        {
+        continue;
+        }
+      probedImage->GetPoint( pointId, point );
+      const vtkIdType cellId = m_StructuredGrid->FindCell( point,
+        ITK_NULLPTR,
+        cell,
+        -1,
+        tolerance * tolerance,
+        subId,
+        pcoords,
+        weights );
+      double value = 0.0;
+      if( cellId >= 0 )
+        {
+        for( vtkIdType ii = 0; ii < cell->GetNumberOfPoints(); ++ii )
+          {
+          value += weights[ii] * ScanConversionFiniteSample( inputBuffer[cell->GetPointId( ii )] );
+          }
+        }
+      probedScalars->SetComponent( pointId, 0, value );
+      }
+  }
+
+  /** Local sample spacing of each point of the structured grid, the largest
+   * distance from the point to its neighbors along the grid axes. */
+  static void LocalSampleSpacings( vtkStructuredGrid * structuredGrid, std::vector< float > & localSpacings )
+  {
+    int dimensions[3];
+    structuredGrid->GetDimensions( dimensions );
+    const vtkIdType strides[3] = { 1, dimensions[0], static_cast< vtkIdType >( dimensions[0] ) * dimensions[1] };
+    localSpacings.assign( static_cast< std::size_t >( strides[2] * dimensions[2] ), 0.0f );
+    double point[3];
+    double neighborPoint[3];
+    for( int kk = 0; kk < dimensions[2]; ++kk )
+      {
+      for( int jj = 0; jj < dimensions[1]; ++jj )
+        {
+        for( int ii = 0; ii < dimensions[0]; ++ii )
+          {
+          const vtkIdType pointId = ii + strides[1] * jj + strides[2] * kk;
+          structuredGrid->GetPoint( pointId, point );
+          const int indices[3] = { ii, jj, kk };
+          for( unsigned int dim = 0; dim < 3; ++dim )
+            {
+            if( indices[dim] + 1 < dimensions[dim] )
+              {
+              // The distance counts for the point and its neighbor
+              structuredGrid->GetPoint( pointId + strides[dim], neighborPoint );
+              const float distance = static_cast< float >( std::sqrt( vtkMath::Distance2BetweenPoints( point, neighborPoint ) ) );
+              localSpacings[pointId] = std::max( localSpacings[pointId], distance );
+              localSpacings[pointId + strides[dim]] = std::max( localSpacings[pointId + strides[dim]], distance );
+              }
+            }
+          }
+        }
+      }
+  }
+
+  /** Find the neighbors of every output voxel and their kernel weights. */
+  void BuildNeighborLists( double maximumDistance, const std::vector< float > & localSpacings )
+  {
+    ScanConversionProfileScope profileNeighborLists( "Build VTK Neighbor Lists" );
+    const itk::SizeValueType numberOfVoxels = m_Size[0] * m_Size[1] * m_Size[2];
+    m_NeighborCounts.resize( numberOfVoxels );
+    m_NeighborIds.resize( numberOfVoxels * m_KernelNumberOfPoints );
+    m_NeighborWeights.resize( numberOfVoxels * m_KernelNumberOfPoints );
 
+    VTKScanConversionNeighborListBuildData data;
+    data.Kernel = m_Kernel;
+    data.Locator = m_Locator;
+    data.DataSet = m_StructuredGrid;
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      data.Dimensions[ii] = m_Size[ii];
+      data.Spacing[ii] = m_Spacing[ii];
+      data.Origin[ii] = m_Origin[ii];
+      }
+    data.NeighborListSize = m_KernelNumberOfPoints;
+    data.MaximumDistance = maximumDistance;
+    data.LocalSpacings = localSpacings.empty() ? ITK_NULLPTR : &localSpacings[0];
+    data.NeighborCounts = &m_NeighborCounts[0];
+    data.NeighborIds = &m_NeighborIds[0];
+    data.NeighborWeights = &m_NeighborWeights[0];
+
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    const vtkIdType numberOfRows = static_cast< vtkIdType >( data.Dimensions[1] ) * data.Dimensions[2];
+    if( numberOfRows < static_cast< vtkIdType >( threader->GetNumberOfThreads() ) )
+      {
+      threader->SetNumberOfThreads( static_cast< itk::ThreadIdType >( std::max( vtkIdType( 1 ), numberOfRows ) ) );
+      }
+    threader->SetSingleMethod( VTKScanConversionBuildNeighborListThread, &data );
+    threader->SingleMethodExecute();
+  }
+
+  ScanConversionResamplingMethod              m_Method;
+  itk::SizeValueType                          m_NumberOfInputPixels;
+  bool                                        m_ReplaceNonFinite;
+  ScanConversionResamplingOptions::KernelFootprintType m_KernelFootprint;
+  unsigned int                                m_KernelNumberOfPoints;
+  std::vector< unsigned int >                 m_NeighborCounts;
+  std::vector< vtkIdType >                    m_NeighborIds;
+  std::vector< float >                        m_NeighborWeights;
+  SizeType                                    m_Size;
+  SpacingType                                 m_Spacing;
+  PointType                                   m_Origin;
+  DirectionType                               m_Direction;
+  vtkSmartPointer< vtkStructuredGrid >        m_StructuredGrid;
+  vtkSmartPointer< vtkImageData >             m_OutputGrid;
+  vtkSmartPointer< vtkProbeFilter >           m_ProbeFilter;
+  vtkSmartPointer< vtkStaticPointLocator >    m_Locator;
+  vtkSmartPointer< vtkInterpolationKernel >   m_Kernel;
+};
+
+
+template< typename TInputImage, typename TOutputImage >
+int
+VTKProbeFilterResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  VTKScanConversionResampler< TInputImage, TOutputImage > resampler;
+  resampler.SetReplaceNonFinite( options.ReplaceNonFinite );
+  if( resampler.Initialize( inputImage.GetPointer(), size, spacing, origin, direction, VTK_PROBE_FILTER, CLPProcessInformation ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return resampler.Resample( inputImage.GetPointer(), outputImage );
+}
+
+
+/** Resample with a vtkPointInterpolator kernel. The kernel searches the
+ * input points of options.KernelFootprint, by default within a radius of 2.1
+ * times the largest output spacing, except for the Voronoi kernel, which
+ * uses the closest point at any distance. */
+template< typename TInputImage, typename TOutputImage >
+int
+VTKPointInterpolatorResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  ScanConversionResamplingMethod method,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
   switch( method )
     {
   case VTK_GAUSSIAN_KERNEL:
   case VTK_LINEAR_KERNEL:
   case VTK_SHEPARD_KERNEL:
   case VTK_VORONOI_KERNEL:
-      {
-      pointInterpolator->SetKernel( interpolationKernel );
-      pointInterpolator->Update();
-      vtkToITKFilter->SetInput( pointInterpolator->GetImageDataOutput() );
-      break;
-      }
+    break;
   default:
     std::cerr << "Unexpected interpolation kernel: " << method << std::endl;
     return EXIT_FAILURE;
     }
 
-  vtkToITKFilter->Update();
-  interpolationKernel->Delete();
+  VTKScanConversionResampler< TInputImage, TOutputImage > resampler;
+  resampler.SetReplaceNonFinite( options.ReplaceNonFinite );
+  resampler.SetKernelFootprint( options.KernelFootprint, options.KernelNumberOfPoints );
+  if( resampler.Initialize( inputImage.GetPointer(), size, spacing, origin, direction, method, CLPProcessInformation ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  return resampler.Resample( inputImage.GetPointer(), outputImage );
+}
 
-  typedef itk::CastImageFilter< VTKInterpolatorOutputImageType, OutputImageType > CasterType;
-  typename CasterType::Pointer caster = CasterType::New();
-  caster->SetInput( vtkToITKFilter->GetOutput() );
-  caster->Update();
 
-  typename OutputImageType::Pointer output = OutputImageType::New();
-  output->SetRegions( caster->GetOutput()->GetLargestPossibleRegion() );
-  output->CopyInformation( caster->GetOutput() );
-  output->Allocate();
-  itk::ImageAlgorithm::Copy< OutputImageType, OutputImageType >(
-    caster->GetOutput(),
-    output.GetPointer(),
-    output->GetLargestPossibleRegion(),
-    output->GetLargestPossibleRegion()
-    );
-  outputImage = output;
-  return EXIT_SUCCESS;
+/** File name of a progressive preview level, e.g. Output_level2.mha for
+ * Output.mha, in directory, or next to fileName when directory is empty. */
+inline std::string
+ScanConversionProgressiveLevelFileName( const std::string & fileName,
+  unsigned int level,
+  const std::string & directory )
+{
+  std::ostringstream levelFileName;
+  const std::string path = directory.empty() ? itksys::SystemTools::GetFilenamePath( fileName ) : directory;
+  if( !path.empty() )
+    {
+    levelFileName << path << "/";
+    }
+  levelFileName << itksys::SystemTools::GetFilenameWithoutLastExtension( fileName )
+    << "_level" << level
+    << itksys::SystemTools::GetFilenameLastExtension( fileName );
+  return levelFileName.str();
 }
 
 
+template< typename TInputImage, typename TOutputImage >
+int
+ProgressiveScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  );
+
+
 template< typename TInputImage, typename TOutputImage >
 int
 ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
@@ -330,50 +1195,29 @@ ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
   const typename TOutputImage::PointType & origin,
   const typename TOutputImage::DirectionType & direction,
   const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
   ModuleProcessInformation * CLPProcessInformation
   )
 {
   typedef TInputImage  InputImageType;
   typedef TOutputImage OutputImageType;
 
-  ScanConversionResamplingMethod method = ITK_LINEAR;
-  if( methodString == "ITKNearestNeighbor" )
-    {
-    method = ITK_NEAREST_NEIGHBOR;
-    }
-  else if( methodString == "ITKLinear" )
-    {
-    method = ITK_LINEAR;
-    }
-  else if( methodString == "ITKGaussian" )
-    {
-    method = ITK_GAUSSIAN;
-    }
-  else if( methodString == "ITKWindowedSinc" )
-    {
-    method = ITK_WINDOWED_SINC;
-    }
-  else if( methodString == "VTKProbeFilter" )
-    {
-    method = VTK_PROBE_FILTER;
-    }
-  else if( methodString == "VTKGaussianKernel" )
-    {
-    method = VTK_GAUSSIAN_KERNEL;
-    }
-  else if( methodString == "VTKLinearKernel" )
+  if( options.ProgressiveLevels > 0 )
     {
-    method = VTK_LINEAR_KERNEL;
-    }
-  else if( methodString == "VTKShepardKernel" )
-    {
-    method = VTK_SHEPARD_KERNEL;
-    }
-  else if( methodString == "VTKVoronoiKernel" )
-    {
-    method = VTK_VORONOI_KERNEL;
+    return ProgressiveScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+      outputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      methodString,
+      options,
+      CLPProcessInformation
+    );
     }
 
+  const ScanConversionResamplingMethod method = ScanConversionResamplingMethodFromString( methodString );
+
   switch( method )
     {
   case ITK_NEAREST_NEIGHBOR:
@@ -387,6 +1231,7 @@ ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
       origin,
       direction,
       method,
+      options,
       CLPProcessInformation
     );
     break;
@@ -396,6 +1241,8 @@ ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
       size,
       spacing,
       origin,
+      direction,
+      options,
       CLPProcessInformation
     );
     break;
@@ -408,16 +1255,224 @@ ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
       size,
       spacing,
       origin,
+      direction,
       method,
+      options,
       CLPProcessInformation
     );
     break;
+  case FORWARD_SPLAT:
+    std::cerr << "ForwardSplat accumulates the slices of a slice series, "
+      "and is only available in ScanConvertSliceSeries" << std::endl;
+    break;
+  case GPU_LINEAR:
+    std::cerr << "GPULinear is only available in the prebuilt resampling library "
+      "of ScanConvertCurvilinearArray and ScanConvertPhasedArray3D" << std::endl;
+    break;
   default:
     std::cerr << "Unknown scan conversion resampling method" << std::endl;
     }
   return EXIT_FAILURE;
 }
 
+
+template< typename TInputImage, typename TOutputImage >
+int
+ScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  return ScanConversionResampling< TInputImage, TOutputImage >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    ScanConversionResamplingOptions(),
+    CLPProcessInformation
+  );
+}
+
+
+/** Resample the output progressively, from a coarse preview to the output
+ * grid. Preview level l, from options.ProgressiveLevels down to 1, has 2^l
+ * times fewer voxels along each axis over the same extent, is resampled with
+ * ITK_NEAREST_NEIGHBOR, and is written to the
+ * ScanConversionProgressiveLevelFileName of options.ProgressiveFileName as
+ * soon as it completes. The output grid is resampled last with the requested
+ * method and the other options, as without previews, so the output does not
+ * depend on the previews. The previews together cost less than a seventh of
+ * a nearest neighbor resampling of the output grid. */
+template< typename TInputImage, typename TOutputImage >
+int
+ProgressiveScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  typename TOutputImage::Pointer & outputImage,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+  typedef ScanConversionResampleImageFilter< InputImageType, OutputImageType > ResamplerType;
+  const unsigned int Dimension = OutputImageType::ImageDimension;
+
+  ScanConversionResamplingOptions levelOptions = options;
+  levelOptions.ProgressiveLevels = 0;
+
+  for( unsigned int level = options.ProgressiveLevels; level > 0; --level )
+    {
+    ScanConversionProfileScope profileLevel( "Resample Level" );
+    const itk::SizeValueType factor = static_cast< itk::SizeValueType >( 1 ) << level;
+
+    // The voxels of a level are the centers of 2 x 2 x 2 voxels of the next
+    // level
+    typename OutputImageType::SizeType levelSize;
+    typename OutputImageType::SpacingType levelSpacing;
+    typename OutputImageType::PointType levelOrigin = origin;
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+      {
+      levelSize[dim] = ( size[dim] + factor - 1 ) / factor;
+      levelSpacing[dim] = spacing[dim] * factor;
+      const double shift = ( factor - 1 ) / 2.0 * spacing[dim];
+      for( unsigned int row = 0; row < Dimension; ++row )
+        {
+        levelOrigin[row] += direction[row][dim] * shift;
+        }
+      }
+
+    typename ResamplerType::Pointer resampler = CreateITKScanConversionResampler< InputImageType, OutputImageType >( inputImage,
+      levelSize,
+      levelSpacing,
+      levelOrigin,
+      direction,
+      ITK_NEAREST_NEIGHBOR,
+      levelOptions );
+    if( resampler.IsNull() )
+      {
+      return EXIT_FAILURE;
+      }
+    ScanConversionFilterWatcher watchResampler(resampler, "Resample Level", CLPProcessInformation);
+    resampler->Update();
+
+    typename OutputImageType::Pointer levelImage = resampler->GetOutput();
+    if( WriteScanConversionImage< OutputImageType >( levelImage,
+        ScanConversionProgressiveLevelFileName( options.ProgressiveFileName, level, options.ProgressiveDirectory ),
+        options.CompressionLevel,
+        "Write Level",
+        CLPProcessInformation ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  return ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+    outputImage,
+    size,
+    spacing,
+    origin,
+    direction,
+    methodString,
+    levelOptions,
+    CLPProcessInformation
+  );
+}
+
+
+/** Resample with an ITK method and write the output in
+ * options.StreamDivisions pieces along the last axis. The input should be
+ * the output of a pipeline that has not been updated, so that the resampler
+ * only requests the input region that each piece samples. The output is
+ * written without compression, which the ImageFileWriter requires to stream.
+ * Other methods resample the whole volume before writing it. */
+template< typename TInputImage, typename TOutputImage >
+int
+StreamingScanConversionResampling(const typename TInputImage::Pointer & inputImage,
+  const std::string & outputFileName,
+  const typename TOutputImage::SizeType & size,
+  const typename TOutputImage::SpacingType & spacing,
+  const typename TOutputImage::PointType & origin,
+  const typename TOutputImage::DirectionType & direction,
+  const std::string & methodString,
+  const ScanConversionResamplingOptions & options,
+  ModuleProcessInformation * CLPProcessInformation
+  )
+{
+  typedef TInputImage  InputImageType;
+  typedef TOutputImage OutputImageType;
+
+  typedef itk::ImageFileWriter< OutputImageType > WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( outputFileName );
+
+  const ScanConversionResamplingMethod method = ScanConversionResamplingMethodFromString( methodString );
+  typedef ScanConversionResampleImageFilter< InputImageType, OutputImageType > ResamplerType;
+  typename ResamplerType::Pointer resampler;
+  switch( method )
+    {
+  case ITK_NEAREST_NEIGHBOR:
+  case ITK_LINEAR:
+  case ITK_GAUSSIAN:
+  case ITK_WINDOWED_SINC:
+    resampler = CreateITKScanConversionResampler< InputImageType, OutputImageType >( inputImage,
+      size,
+      spacing,
+      origin,
+      direction,
+      method,
+      options );
+    if( resampler.IsNull() )
+      {
+      return EXIT_FAILURE;
+      }
+    writer->SetInput( resampler->GetOutput() );
+    writer->SetNumberOfStreamDivisions( std::max( options.StreamDivisions, 1u ) );
+    writer->SetUseCompression( false );
+    break;
+  default:
+      {
+      std::cerr << "Streaming is only available for the ITK resampling methods, "
+        "resampling the whole volume" << std::endl;
+      inputImage->SetRequestedRegionToLargestPossibleRegion();
+      inputImage->Update();
+      typename OutputImageType::Pointer outputImage;
+      if( ScanConversionResampling< InputImageType, OutputImageType >( inputImage,
+          outputImage,
+          size,
+          spacing,
+          origin,
+          direction,
+          methodString,
+          options,
+          CLPProcessInformation ) != EXIT_SUCCESS )
+        {
+        return EXIT_FAILURE;
+        }
+      return WriteScanConversionImage< OutputImageType >( outputImage,
+        outputFileName,
+        options.CompressionLevel,
+        "Write Output",
+        CLPProcessInformation );
+      }
+    }
+
+  ScanConversionFilterWatcher watchWriter(writer, "Resample and Write Output", CLPProcessInformation);
+  writer->Update();
+
+  return EXIT_SUCCESS;
+}
+
 }
 
 #endif
@@ -0,0 +1,207 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionResamplingOptions_h
+#define ScanConversionResamplingOptions_h
+
+#include "ScanConversionGeometry.h"
+
+#include <string>
+#include <vector>
+
+// The options are passed to the prebuilt resampling library, see
+// ScanConversionResamplingLibrary.h, so they are not in the anonymous
+// namespace. This header, with the method names, does not include the
+// resampling methods, so the modules that resample with the library do not
+// instantiate them.
+
+/** Optional settings of ScanConversionResampling. */
+struct ScanConversionResamplingOptions
+{
+  /** Input samples that the VTK Gaussian, Linear, and Shepard kernels
+   * interpolate for each output voxel: the samples within a radius of 2.1
+   * times the largest output spacing, the KernelNumberOfPoints closest
+   * samples, or the KernelNumberOfPoints closest samples within the local
+   * sample spacing of the closest sample, or the radius if it is larger. */
+  enum KernelFootprintType
+    {
+    RADIUS_FOOTPRINT,
+    N_CLOSEST_FOOTPRINT,
+    ADAPTIVE_FOOTPRINT
+    };
+
+  ScanConversionResamplingOptions():
+    SectorMask( false ),
+    StreamDivisions( 1 ),
+    WindowedSincRadius( 3 ),
+    KernelFootprint( RADIUS_FOOTPRINT ),
+    KernelNumberOfPoints( 8 ),
+    CompressionLevel( 1 ),
+    SliceSeriesLocator( false ),
+    ProgressiveLevels( 0 ),
+    ReplaceNonFinite( false ),
+    TileSize( 0 )
+  {}
+
+  /** Only interpolate the output voxels inside Sector with the ITK methods. */
+  bool                 SectorMask;
+  ScanConversionSector Sector;
+
+  /** Number of pieces written by StreamingScanConversionResampling. */
+  unsigned int         StreamDivisions;
+
+  /** Radius of the Lanczos window of ITK_WINDOWED_SINC: 2, 3, or 4. */
+  unsigned int         WindowedSincRadius;
+
+  /** Footprint of the VTK kernels. */
+  KernelFootprintType  KernelFootprint;
+  unsigned int         KernelNumberOfPoints;
+
+  /** Compression level of the outputs written by
+   * StreamingScanConversionResampling when it does not stream. */
+  int                  CompressionLevel;
+
+  /** Map the output voxels to the slices of a slice series input with a
+   * ScanConversionSliceSeriesLocator with the ITK methods. */
+  bool                 SliceSeriesLocator;
+
+  /** Number of coarser preview levels resampled and written by
+   * ScanConversionResampling before the output, 0 for none. The previews are
+   * named after ProgressiveFileName, and written to ProgressiveDirectory, or
+   * next to ProgressiveFileName when it is empty. */
+  unsigned int         ProgressiveLevels;
+  std::string          ProgressiveFileName;
+  std::string          ProgressiveDirectory;
+
+  /** Replace the non-finite input samples with zero as they are
+   * interpolated, instead of in an itk::ReplaceNonFiniteImageFilter pass
+   * over the input. */
+  bool                 ReplaceNonFinite;
+
+  /** Edge in output voxels of the tiles in which the ITK methods traverse
+   * the output, 0 for scanlines. */
+  unsigned int         TileSize;
+
+  /** Physical bounds of each slice of a slice series input, used to limit
+   * the input requested region of a streamed output. */
+  std::vector< ScanConversionSliceBounds > SliceBounds;
+
+  /** Lookup table file read or written by the prebuilt resampling library
+   * for the methods that can be tabulated, empty for none, and the special
+   * coordinates parameters of the input that its geometry key records. */
+  std::string          LookupTableFileName;
+  std::vector< double > LookupTableGeometryParameters;
+};
+
+
+namespace
+{
+
+enum ScanConversionResamplingMethod {
+  ITK_NEAREST_NEIGHBOR = 0,
+  ITK_LINEAR,
+  ITK_GAUSSIAN,
+  ITK_WINDOWED_SINC,
+  VTK_PROBE_FILTER,
+  VTK_GAUSSIAN_KERNEL,
+  VTK_LINEAR_KERNEL,
+  VTK_SHEPARD_KERNEL,
+  VTK_VORONOI_KERNEL,
+  /** Accumulates the slices of a slice series instead of interpolating the
+   * output voxels, see ScanConversionSliceSplatAccumulator. */
+  FORWARD_SPLAT,
+  /** Interpolates linearly on an OpenCL device, see ScanConversionOpenCL.h.
+   * Only available with SlicerITKUltrasound_ENABLE_GPU, in the prebuilt
+   * resampling library. */
+  GPU_LINEAR
+};
+
+
+/** Convert the CLI method name to the resampling method. Unknown names
+ * default to ITK_LINEAR. */
+inline ScanConversionResamplingMethod
+ScanConversionResamplingMethodFromString( const std::string & methodString )
+{
+  ScanConversionResamplingMethod method = ITK_LINEAR;
+  if( methodString == "ITKNearestNeighbor" )
+    {
+    method = ITK_NEAREST_NEIGHBOR;
+    }
+  else if( methodString == "ITKLinear" )
+    {
+    method = ITK_LINEAR;
+    }
+  else if( methodString == "ITKGaussian" )
+    {
+    method = ITK_GAUSSIAN;
+    }
+  else if( methodString == "ITKWindowedSinc" )
+    {
+    method = ITK_WINDOWED_SINC;
+    }
+  else if( methodString == "VTKProbeFilter" )
+    {
+    method = VTK_PROBE_FILTER;
+    }
+  else if( methodString == "VTKGaussianKernel" )
+    {
+    method = VTK_GAUSSIAN_KERNEL;
+    }
+  else if( methodString == "VTKLinearKernel" )
+    {
+    method = VTK_LINEAR_KERNEL;
+    }
+  else if( methodString == "VTKShepardKernel" )
+    {
+    method = VTK_SHEPARD_KERNEL;
+    }
+  else if( methodString == "VTKVoronoiKernel" )
+    {
+    method = VTK_VORONOI_KERNEL;
+    }
+  else if( methodString == "ForwardSplat" )
+    {
+    method = FORWARD_SPLAT;
+    }
+  else if( methodString == "GPULinear" )
+    {
+    method = GPU_LINEAR;
+    }
+  return method;
+}
+
+
+/** Convert the CLI kernel footprint name to the footprint. Unknown names
+ * default to RADIUS_FOOTPRINT. */
+inline ScanConversionResamplingOptions::KernelFootprintType
+ScanConversionKernelFootprintFromString( const std::string & footprintString )
+{
+  if( footprintString == "NClosest" )
+    {
+    return ScanConversionResamplingOptions::N_CLOSEST_FOOTPRINT;
+    }
+  else if( footprintString == "Adaptive" )
+    {
+    return ScanConversionResamplingOptions::ADAPTIVE_FOOTPRINT;
+    }
+  return ScanConversionResamplingOptions::RADIUS_FOOTPRINT;
+}
+
+}
+
+#endif
@@ -0,0 +1,359 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionServer_h
+#define ScanConversionServer_h
+
+#include "itkMacro.h"
+#include "itksys/SystemTools.hxx"
+
+#include "vtkClientSocket.h"
+#include "vtkObjectFactory.h"
+#include "vtkServerSocket.h"
+#include "vtkSmartPointer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#if defined( _WIN32 )
+#include <winsock2.h>
+#include <windows.h>
+#include <ntsecapi.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+/** Longest request line, twice the longest path of most file systems. */
+const std::string::size_type ScanConversionMaximumRequestLength = 8192;
+
+/** Number of random bytes of the token of a server session. */
+const unsigned int ScanConversionTokenBytes = 16;
+
+
+/** A token of ScanConversionTokenBytes random bytes from the random source
+ * of the operating system, in hexadecimal. Returns false when the source
+ * cannot be read. */
+inline bool
+MakeScanConversionServerToken( std::string & token )
+{
+  unsigned char bytes[ScanConversionTokenBytes];
+#if defined( _WIN32 )
+  if( !RtlGenRandom( bytes, sizeof( bytes ) ) )
+    {
+    return false;
+    }
+#else
+  std::ifstream randomStream( "/dev/urandom", std::ios::in | std::ios::binary );
+  if( !randomStream.read( reinterpret_cast< char * >( bytes ), sizeof( bytes ) ) )
+    {
+    return false;
+    }
+#endif
+  static const char hexDigits[] = "0123456789abcdef";
+  token.clear();
+  for( unsigned int byte = 0; byte < sizeof( bytes ); ++byte )
+    {
+    token += hexDigits[bytes[byte] >> 4];
+    token += hexDigits[bytes[byte] & 0xf];
+    }
+  return true;
+}
+
+
+/** Write the token to fileName, readable and writable by the user only, so
+ * that only the processes of the user can authenticate with the server. On
+ * POSIX systems an existing file must belong to the user and no symbolic
+ * link is followed. On Windows, the file has the permissions of its
+ * directory. */
+inline bool
+WriteScanConversionServerToken( const std::string & fileName, const std::string & token )
+{
+  const std::string line = token + "\n";
+#if defined( _WIN32 )
+  std::ofstream tokenStream( fileName.c_str(), std::ios::out | std::ios::trunc );
+  tokenStream << line;
+  return !tokenStream.fail();
+#else
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_NOFOLLOW
+  flags |= O_NOFOLLOW;
+#endif
+  const int descriptor = open( fileName.c_str(), flags, S_IRUSR | S_IWUSR );
+  if( descriptor < 0 )
+    {
+    return false;
+    }
+  // The mode of open only applies to a new file
+  bool written = fchmod( descriptor, S_IRUSR | S_IWUSR ) == 0;
+  written = written && write( descriptor, line.c_str(), line.size() ) == static_cast< ssize_t >( line.size() );
+  written = close( descriptor ) == 0 && written;
+  return written;
+#endif
+}
+
+
+/** Compare the received token with the token of the session in a time
+ * that does not depend on the position of the first difference. */
+inline bool
+ScanConversionServerTokensMatch( const std::string & received, const std::string & token )
+{
+  if( received.size() != token.size() )
+    {
+    return false;
+    }
+  unsigned char difference = 0;
+  for( std::string::size_type character = 0; character < token.size(); ++character )
+    {
+    difference |= static_cast< unsigned char >( received[character] ^ token[character] );
+    }
+  return difference == 0;
+}
+
+
+/** Server socket that only listens on the loopback interface, so only the
+ * processes of the same machine can connect. vtkServerSocket::CreateServer
+ * listens on every interface. */
+class ScanConversionLoopbackServerSocket: public vtkServerSocket
+{
+public:
+  static ScanConversionLoopbackServerSocket * New();
+  vtkTypeMacro( ScanConversionLoopbackServerSocket, vtkServerSocket );
+
+  /** Listen on port of the loopback interface. Returns 0 on success. */
+  int CreateLoopbackServer( int port )
+  {
+    if( this->SocketDescriptor != -1 )
+      {
+      this->CloseSocket();
+      }
+    this->SocketDescriptor = this->CreateSocket();
+    if( this->SocketDescriptor < 0 )
+      {
+      return -1;
+      }
+
+    int reuseAddress = 1;
+    setsockopt( this->SocketDescriptor, SOL_SOCKET, SO_REUSEADDR,
+      reinterpret_cast< const char * >( &reuseAddress ), sizeof( reuseAddress ) );
+
+    struct sockaddr_in address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( static_cast< unsigned short >( port ) );
+    if( bind( this->SocketDescriptor, reinterpret_cast< struct sockaddr * >( &address ), sizeof( address ) ) != 0
+      || this->Listen( this->SocketDescriptor ) != 0 )
+      {
+      this->CloseSocket();
+      return -1;
+      }
+    return 0;
+  }
+
+protected:
+  ScanConversionLoopbackServerSocket() {}
+  ~ScanConversionLoopbackServerSocket() {}
+
+private:
+  ScanConversionLoopbackServerSocket( const ScanConversionLoopbackServerSocket & );
+  void operator=( const ScanConversionLoopbackServerSocket & );
+};
+
+vtkStandardNewMacro( ScanConversionLoopbackServerSocket );
+
+
+/** Read a line terminated by a newline from the socket. Returns false when
+ * the client disconnects before the end of the line, or when the line is
+ * longer than ScanConversionMaximumRequestLength. */
+inline bool
+ReceiveScanConversionRequestLine( vtkClientSocket * socket, std::string & line )
+{
+  line.clear();
+  char character;
+  while( socket->Receive( &character, 1 ) == 1 )
+    {
+    if( character == '\n' )
+      {
+      if( !line.empty() && line[line.size() - 1] == '\r' )
+        {
+        line.erase( line.size() - 1 );
+        }
+      return true;
+      }
+    if( line.size() == ScanConversionMaximumRequestLength )
+      {
+      std::cerr << "The scan conversion request is longer than "
+        << ScanConversionMaximumRequestLength << " characters" << std::endl;
+      return false;
+      }
+    line += character;
+    }
+  return false;
+}
+
+
+inline bool
+SendScanConversionReply( vtkClientSocket * socket, const std::string & reply )
+{
+  const std::string line = reply + "\n";
+  return socket->Send( line.c_str(), static_cast< int >( line.size() ) ) == 1;
+}
+
+
+/** Serve scan conversion requests on a TCP port until a client sends QUIT.
+ *
+ * The process then pays the startup cost, e.g. the registration of the IO
+ * factories, and the cost of the geometry that the handler keeps, once for
+ * all the frames. The server only listens on the loopback interface, and
+ * authenticates its clients with a random token of the session, which it
+ * writes to tokenFileName, readable by the user only, once it listens. The
+ * first line of each connection is the token: a client that sends another
+ * line is replied ERROR and disconnected, so only the processes of the user
+ * can have the server read and write the files of the user. The token file
+ * is removed when the server stops. Requests whose line is longer than
+ * ScanConversionMaximumRequestLength close the connection. Clients are
+ * served one at a time, and a client can send any number of requests before
+ * it disconnects. Each request is a line
+ *
+ *   <input file name><TAB><output file name>
+ *
+ * and the reply, sent once the output is written, is the line OK or ERROR.
+ * The handler provides
+ *
+ *   int operator()( const std::string & inputFileName, const std::string & outputFileName );
+ *
+ * which returns EXIT_SUCCESS or EXIT_FAILURE. */
+template< typename TRequestHandler >
+int
+ScanConversionServe( int port, const std::string & tokenFileName, TRequestHandler & handler )
+{
+  if( tokenFileName.empty() )
+    {
+    std::cerr << "The server requires a token file to authenticate its clients" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string token;
+  if( !MakeScanConversionServerToken( token ) )
+    {
+    std::cerr << "Could not generate the token of the server" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer< ScanConversionLoopbackServerSocket > server =
+    vtkSmartPointer< ScanConversionLoopbackServerSocket >::New();
+  if( server->CreateLoopbackServer( port ) != 0 )
+    {
+    std::cerr << "Could not listen on port " << port << " of the loopback interface" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !WriteScanConversionServerToken( tokenFileName, token ) )
+    {
+    std::cerr << "Could not write the token of the server to " << tokenFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::cout << "Serving scan conversion requests on port " << server->GetServerPort()
+    << " of the loopback interface, with the token in " << tokenFileName << std::endl;
+
+  bool quit = false;
+  while( !quit )
+    {
+    vtkSmartPointer< vtkClientSocket > client;
+    client.TakeReference( server->WaitForConnection() );
+    if( client.GetPointer() == ITK_NULLPTR )
+      {
+      continue;
+      }
+
+    std::string request;
+    if( !ReceiveScanConversionRequestLine( client, request ) )
+      {
+      client->CloseSocket();
+      continue;
+      }
+    if( !ScanConversionServerTokensMatch( request, token ) )
+      {
+      std::cerr << "A client of the scan conversion server sent an invalid token" << std::endl;
+      SendScanConversionReply( client, "ERROR" );
+      client->CloseSocket();
+      continue;
+      }
+    SendScanConversionReply( client, "OK" );
+
+    while( !quit && ReceiveScanConversionRequestLine( client, request ) )
+      {
+      if( request == "QUIT" )
+        {
+        quit = true;
+        SendScanConversionReply( client, "OK" );
+        break;
+        }
+      const std::string::size_type tab = request.find( '\t' );
+      if( tab == std::string::npos || tab == 0 || tab + 1 == request.size() )
+        {
+        std::cerr << "Invalid scan conversion request: " << request << std::endl;
+        SendScanConversionReply( client, "ERROR" );
+        continue;
+        }
+      const std::string inputFileName = request.substr( 0, tab );
+      const std::string outputFileName = request.substr( tab + 1 );
+
+      int status = EXIT_FAILURE;
+      try
+        {
+        status = handler( inputFileName, outputFileName );
+        }
+      catch( itk::ExceptionObject & excep )
+        {
+        std::cerr << "Error scan converting " << inputFileName << ": " << excep << std::endl;
+        }
+      catch( std::exception & excep )
+        {
+        std::cerr << "Error scan converting " << inputFileName << ": " << excep.what() << std::endl;
+        }
+      catch( ... )
+        {
+        std::cerr << "Unknown error scan converting " << inputFileName << std::endl;
+        }
+      if( !SendScanConversionReply( client, status == EXIT_SUCCESS ? "OK" : "ERROR" ) )
+        {
+        break;
+        }
+      }
+    client->CloseSocket();
+    }
+
+  itksys::SystemTools::RemoveFile( tokenFileName.c_str() );
+  return EXIT_SUCCESS;
+}
+
+}
+
+#endif
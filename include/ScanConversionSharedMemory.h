@@ -0,0 +1,465 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionSharedMemory_h
+#define ScanConversionSharedMemory_h
+
+#include "itkImageIOBase.h"
+#include "itkImportImageContainer.h"
+#include "itkIntTypes.h"
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkPluginUtilities.h"
+
+#include "ScanConversionImageWriter.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define ScanConversion_HAS_SHARED_MEMORY
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+/** Prefix of the input names that are shared memory frames, e.g.
+ * shm:/probe0, instead of files. */
+const char * const ScanConversionSharedMemoryPrefix = "shm:";
+
+/** Layout of the start of a shared memory frame, written by the acquisition
+ * system. The samples follow at DataOffset, in the order of an ITK buffer,
+ * with the first index fastest. GeometryParameters are the geometry of the
+ * probe, in the order of the command line parameters of the module, e.g.
+ * lateralAngularSeparation, radiusSampleSize, and firstSampleDistance for a
+ * curvilinear array, or azimuthAngularSeparation,
+ * elevationAngularSeparation, radiusSampleSize, and firstSampleDistance for
+ * a phased array. ElementType is a MetaImage element type, e.g. MET_FLOAT.
+ * The Size beyond the dimension of the input image, e.g. Size[2] of a 2D
+ * frame, is 1, and DataOffset is a multiple of the size of an element.
+ *
+ * FrameCounter is a sequence lock: the acquisition system makes it odd
+ * before it starts to write a frame to the segment, e.g. a ring slot, and
+ * even once the frame is written. A frame is only converted when the
+ * counter is even when it is mapped and still has the same value once it
+ * is converted, so a frame the acquisition system rewrites meanwhile is
+ * reported instead of being converted torn. */
+struct ScanConversionSharedMemoryHeader
+{
+  char          Magic[8];
+  char          ElementType[16];
+  itk::uint32_t Size[3];
+  itk::uint32_t NumberOfGeometryParameters;
+  double        Origin[3];
+  double        GeometryParameters[4];
+  itk::uint64_t DataOffset;
+  itk::uint64_t FrameCounter;
+};
+
+const char ScanConversionSharedMemoryMagic[8] = { 'S', 'C', 'S', 'H', 'M', '0', '0', '2' };
+
+
+inline bool
+IsScanConversionSharedMemoryName( const std::string & name )
+{
+  return name.compare( 0, std::strlen( ScanConversionSharedMemoryPrefix ), ScanConversionSharedMemoryPrefix ) == 0;
+}
+
+
+/** \class ScanConversionSharedMemoryMapping
+ *
+ * \brief A read only view of a shared memory frame.
+ *
+ * The segment is mapped copy on write, so the samples are used in place, and
+ * a filter that writes its input cannot change the frame of the acquisition
+ * system. The segment stays open, so the FrameCounter of the acquisition
+ * system is read from the segment itself rather than from a page of the
+ * mapping that may have been copied. The mapping is released with the last
+ * reference to it.
+ */
+class ScanConversionSharedMemoryMapping: public itk::LightObject
+{
+public:
+  typedef ScanConversionSharedMemoryMapping Self;
+  typedef itk::LightObject                  Superclass;
+  typedef itk::SmartPointer< Self >         Pointer;
+  typedef itk::SmartPointer< const Self >   ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionSharedMemoryMapping, LightObject );
+
+  /** Map the frame with the given name, with or without the shm: prefix,
+   * of an image of the given dimension. */
+  int Open( const std::string & name, unsigned int imageDimension = 3 )
+    {
+    this->Close();
+    m_ImageDimension = imageDimension;
+    std::string segmentName = name;
+    if( IsScanConversionSharedMemoryName( segmentName ) )
+      {
+      segmentName = segmentName.substr( std::strlen( ScanConversionSharedMemoryPrefix ) );
+      }
+#if defined( ScanConversion_HAS_SHARED_MEMORY )
+    const int descriptor = shm_open( segmentName.c_str(), O_RDONLY, 0 );
+    if( descriptor < 0 )
+      {
+      std::cerr << "Could not open the shared memory frame " << segmentName << std::endl;
+      return EXIT_FAILURE;
+      }
+    struct stat status;
+    if( fstat( descriptor, &status ) != 0 || status.st_size < static_cast< off_t >( sizeof( ScanConversionSharedMemoryHeader ) ) )
+      {
+      std::cerr << "The shared memory frame " << segmentName << " is smaller than its header" << std::endl;
+      close( descriptor );
+      return EXIT_FAILURE;
+      }
+    void * address = mmap( ITK_NULLPTR, static_cast< size_t >( status.st_size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0 );
+    if( address == MAP_FAILED )
+      {
+      std::cerr << "Could not map the shared memory frame " << segmentName << std::endl;
+      close( descriptor );
+      return EXIT_FAILURE;
+      }
+    m_Address = address;
+    m_Length = static_cast< itk::SizeValueType >( status.st_size );
+    m_Descriptor = descriptor;
+    if( this->CheckHeader( segmentName ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( !this->ReadFrameCounter( m_FrameCounter ) || m_FrameCounter % 2 != 0 )
+      {
+      std::cerr << "The shared memory frame " << segmentName << " is being written" << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+#else
+    std::cerr << "Shared memory frames are not supported on this platform: " << segmentName << std::endl;
+    return EXIT_FAILURE;
+#endif
+    }
+
+  const ScanConversionSharedMemoryHeader & GetHeader() const
+    {
+    return *static_cast< const ScanConversionSharedMemoryHeader * >( m_Address );
+    }
+
+  void * GetData() const
+    {
+    return static_cast< char * >( m_Address ) + this->GetHeader().DataOffset;
+    }
+
+  /** The number of samples of the image, over its dimension. */
+  itk::SizeValueType GetNumberOfSamples() const
+    {
+    const ScanConversionSharedMemoryHeader & header = this->GetHeader();
+    itk::SizeValueType numberOfSamples = 1;
+    for( unsigned int dim = 0; dim < m_ImageDimension; ++dim )
+      {
+      numberOfSamples *= header.Size[dim];
+      }
+    return numberOfSamples;
+    }
+
+  /** Whether the acquisition system has not started to write another frame
+   * to the segment since it was mapped, so the samples read meanwhile are
+   * those of one frame. */
+  bool IsFrameUnchanged() const
+    {
+    itk::uint64_t frameCounter;
+    return this->ReadFrameCounter( frameCounter ) && frameCounter == m_FrameCounter;
+    }
+
+  /** The component type of the samples, or false if it is not supported. */
+  bool GetComponentType( itk::ImageIOBase::IOComponentType & componentType ) const
+    {
+    const ScanConversionSharedMemoryHeader & header = this->GetHeader();
+    const std::string elementType( header.ElementType, strnlen( header.ElementType, sizeof( header.ElementType ) ) );
+    if( elementType == ScanConversionMetaImageElementType< unsigned char >::Get() )
+      {
+      componentType = itk::ImageIOBase::UCHAR;
+      }
+    else if( elementType == ScanConversionMetaImageElementType< unsigned short >::Get() )
+      {
+      componentType = itk::ImageIOBase::USHORT;
+      }
+    else if( elementType == ScanConversionMetaImageElementType< short >::Get() )
+      {
+      componentType = itk::ImageIOBase::SHORT;
+      }
+    else if( elementType == ScanConversionMetaImageElementType< float >::Get() )
+      {
+      componentType = itk::ImageIOBase::FLOAT;
+      }
+    else if( elementType == ScanConversionMetaImageElementType< double >::Get() )
+      {
+      componentType = itk::ImageIOBase::DOUBLE;
+      }
+    else
+      {
+      return false;
+      }
+    return true;
+    }
+
+protected:
+  ScanConversionSharedMemoryMapping():
+    m_Address( ITK_NULLPTR ),
+    m_Length( 0 ),
+    m_Descriptor( -1 ),
+    m_ImageDimension( 3 ),
+    m_FrameCounter( 0 )
+  {}
+  ~ScanConversionSharedMemoryMapping()
+  {
+    this->Close();
+  }
+
+private:
+  ScanConversionSharedMemoryMapping( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  void Close()
+    {
+#if defined( ScanConversion_HAS_SHARED_MEMORY )
+    if( m_Address != ITK_NULLPTR )
+      {
+      munmap( m_Address, static_cast< size_t >( m_Length ) );
+      }
+    if( m_Descriptor >= 0 )
+      {
+      close( m_Descriptor );
+      }
+#endif
+    m_Address = ITK_NULLPTR;
+    m_Length = 0;
+    m_Descriptor = -1;
+    }
+
+  /** Read the FrameCounter from the segment rather than from the mapping. */
+  bool ReadFrameCounter( itk::uint64_t & frameCounter ) const
+    {
+#if defined( ScanConversion_HAS_SHARED_MEMORY )
+    const off_t offset = static_cast< off_t >( offsetof( ScanConversionSharedMemoryHeader, FrameCounter ) );
+    return m_Descriptor >= 0
+      && pread( m_Descriptor, &frameCounter, sizeof( frameCounter ), offset ) == static_cast< ssize_t >( sizeof( frameCounter ) );
+#else
+    (void)frameCounter;
+    return false;
+#endif
+    }
+
+  int CheckHeader( const std::string & segmentName )
+    {
+    const ScanConversionSharedMemoryHeader & header = this->GetHeader();
+    if( std::memcmp( header.Magic, ScanConversionSharedMemoryMagic, sizeof( header.Magic ) ) != 0 )
+      {
+      std::cerr << "The shared memory segment " << segmentName << " is not a scan conversion frame" << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    if( header.NumberOfGeometryParameters > 4 || header.DataOffset < sizeof( ScanConversionSharedMemoryHeader ) )
+      {
+      std::cerr << "The header of the shared memory frame " << segmentName << " is invalid" << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      if( header.Size[dim] < 1 || ( dim >= m_ImageDimension && header.Size[dim] != 1 ) )
+        {
+        std::cerr << "The size of the shared memory frame " << segmentName
+          << " is invalid for a " << m_ImageDimension << "D image" << std::endl;
+        this->Close();
+        return EXIT_FAILURE;
+        }
+      }
+    itk::ImageIOBase::IOComponentType componentType;
+    if( !this->GetComponentType( componentType ) )
+      {
+      std::cerr << "Unsupported element type of the shared memory frame " << segmentName << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    const itk::SizeValueType componentSize = itk::ImageIOBase::GetComponentTypeSize( componentType );
+    if( header.DataOffset % componentSize != 0 )
+      {
+      std::cerr << "The samples of the shared memory frame " << segmentName << " are not aligned" << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    // Each factor is checked against the length, so the products do not overflow
+    itk::SizeValueType dataLength = componentSize;
+    bool fits = header.DataOffset <= m_Length;
+    for( unsigned int dim = 0; dim < m_ImageDimension && fits; ++dim )
+      {
+      fits = header.Size[dim] <= m_Length / dataLength;
+      dataLength *= header.Size[dim];
+      }
+    if( !fits || dataLength > m_Length - header.DataOffset )
+      {
+      std::cerr << "The shared memory frame " << segmentName << " is smaller than its samples" << std::endl;
+      this->Close();
+      return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+    }
+
+  void *             m_Address;
+  itk::SizeValueType m_Length;
+  int                m_Descriptor;
+  unsigned int       m_ImageDimension;
+  itk::uint64_t      m_FrameCounter;
+};
+
+
+/** Image container that references the samples of a shared memory frame.
+ * The container keeps a reference to the mapping, so the pixel buffer stays
+ * valid for the life of the ITK image without a copy. */
+template< typename TElement >
+class ScanConversionSharedMemoryImageContainer:
+  public itk::ImportImageContainer< itk::SizeValueType, TElement >
+{
+public:
+  typedef ScanConversionSharedMemoryImageContainer                  Self;
+  typedef itk::ImportImageContainer< itk::SizeValueType, TElement > Superclass;
+  typedef itk::SmartPointer< Self >                                 Pointer;
+  typedef itk::SmartPointer< const Self >                           ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionSharedMemoryImageContainer, ImportImageContainer );
+
+  void SetMapping( ScanConversionSharedMemoryMapping * mapping )
+    {
+    m_Mapping = mapping;
+    this->SetImportPointer( static_cast< TElement * >( mapping->GetData() ), mapping->GetNumberOfSamples(), false );
+    }
+
+  const ScanConversionSharedMemoryMapping * GetMapping() const
+    {
+    return m_Mapping.GetPointer();
+    }
+
+protected:
+  ScanConversionSharedMemoryImageContainer() {}
+  ~ScanConversionSharedMemoryImageContainer() {}
+
+private:
+  ScanConversionSharedMemoryImageContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  ScanConversionSharedMemoryMapping::Pointer m_Mapping;
+};
+
+
+/** Component type of the samples of the input, a shared memory frame or a
+ * file. */
+inline void
+GetScanConversionInputComponentType( const std::string & inputName, itk::ImageIOBase::IOComponentType & componentType )
+{
+  if( !IsScanConversionSharedMemoryName( inputName ) )
+    {
+    itk::ImageIOBase::IOPixelType pixelType;
+    itk::GetImageType( inputName, pixelType, componentType );
+    return;
+    }
+  ScanConversionSharedMemoryMapping::Pointer mapping = ScanConversionSharedMemoryMapping::New();
+  if( mapping->Open( inputName ) != EXIT_SUCCESS || !mapping->GetComponentType( componentType ) )
+    {
+    componentType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+    }
+}
+
+
+/** Wrap the shared memory frame inputName as a special coordinates image
+ * without a copy. The size and the origin of the image, and the geometry
+ * parameters of the probe, are read from the header of the frame. The
+ * element type of the frame must be the pixel type of the image. */
+template< typename TImage >
+int
+ReadScanConversionSharedMemoryFrame( const std::string & inputName,
+  typename TImage::Pointer & image,
+  std::vector< double > & geometryParameters )
+{
+  typedef typename TImage::PixelType PixelType;
+
+  ScanConversionSharedMemoryMapping::Pointer mapping = ScanConversionSharedMemoryMapping::New();
+  if( mapping->Open( inputName, TImage::ImageDimension ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  const ScanConversionSharedMemoryHeader & header = mapping->GetHeader();
+  itk::ImageIOBase::IOComponentType componentType;
+  mapping->GetComponentType( componentType );
+  if( componentType != itk::ImageIOBase::MapPixelType< PixelType >::CType )
+    {
+    std::cerr << "The element type of the shared memory frame " << inputName
+      << " differs from the pixel type of the first input" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  typedef ScanConversionSharedMemoryImageContainer< PixelType > ContainerType;
+  typename ContainerType::Pointer container = ContainerType::New();
+  container->SetMapping( mapping );
+
+  typename TImage::RegionType region;
+  typename TImage::PointType origin;
+  for( unsigned int dim = 0; dim < TImage::ImageDimension; ++dim )
+    {
+    region.SetSize( dim, header.Size[dim] );
+    origin[dim] = header.Origin[dim];
+    }
+  image = TImage::New();
+  image->SetRegions( region );
+  image->SetOrigin( origin );
+  image->SetPixelContainer( container );
+
+  geometryParameters.assign( header.GeometryParameters, header.GeometryParameters + header.NumberOfGeometryParameters );
+  return EXIT_SUCCESS;
+}
+
+
+/** Check that the acquisition system did not rewrite the shared memory
+ * frame of image while it was converted. Images that are not shared memory
+ * frames are unchanged. Call once the samples of the image have been read. */
+template< typename TImage >
+int
+CheckScanConversionSharedMemoryFrame( const TImage * image, const std::string & inputName )
+{
+  typedef ScanConversionSharedMemoryImageContainer< typename TImage::PixelType > ContainerType;
+  const ContainerType * container = dynamic_cast< const ContainerType * >( image->GetPixelContainer() );
+  if( container != ITK_NULLPTR && !container->GetMapping()->IsFrameUnchanged() )
+    {
+    std::cerr << "The shared memory frame " << inputName << " was rewritten while it was converted" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionSliceSeriesLocator_h
+#define ScanConversionSliceSeriesLocator_h
+
+#include "itkIntTypes.h"
+#include "itkMacro.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+/** \class ScanConversionSliceSeriesLocator
+ *
+ * \brief Physical point to continuous index mapping of a slice series image
+ * in logarithmic time in the number of slices.
+ *
+ * Initialize caches, for every slice along the last axis of the image, the
+ * inverse of the affine map from the in-plane indices and the distance along
+ * the normal of the slice plane to the physical space. The planes of a sweep
+ * are ordered, so the signed distance of a point to the planes changes sign
+ * once, and the pair of slices that brackets the point is found by a binary
+ * search. The slice index is the zero crossing of the distance between the
+ * two planes, and the in-plane indices are interpolated between the planes
+ * with the same weight. A point beyond the first or the last slice is
+ * extrapolated from the first or the last pair.
+ *
+ * Initialize returns false, and the locator is not valid, when the image has
+ * fewer than two slices, a slice plane is degenerate, or the planes are not
+ * consistently ordered along the sweep. The image mapping must then be used.
+ */
+template< typename TImage >
+class ScanConversionSliceSeriesLocator
+{
+public:
+  typedef TImage                        ImageType;
+  typedef typename ImageType::IndexType IndexType;
+  typedef typename ImageType::PointType PointType;
+
+  static const unsigned int ImageDimension = ImageType::ImageDimension;
+
+  ScanConversionSliceSeriesLocator():
+    m_FirstSlice( 0 ),
+    m_Orientation( 1.0 )
+  {
+    m_InPlaneStart[0] = 0;
+    m_InPlaneStart[1] = 0;
+  }
+
+  bool GetValid() const
+    {
+    return !m_Planes.empty();
+    }
+
+  bool Initialize( const ImageType * image )
+    {
+    m_Planes.clear();
+    if( ImageDimension != 3 || image == ITK_NULLPTR )
+      {
+      return false;
+      }
+    const unsigned int SliceAxis = ImageDimension - 1;
+    const typename ImageType::RegionType & largestRegion = image->GetLargestPossibleRegion();
+    const itk::SizeValueType numberOfSlices = largestRegion.GetSize( SliceAxis );
+    if( numberOfSlices < 2 )
+      {
+      return false;
+      }
+
+    std::vector< SlicePlane > planes( numberOfSlices );
+    std::vector< double > centers( 3 * numberOfSlices );
+    const double columnsCenter = 0.5 * ( largestRegion.GetSize( 0 ) - 1.0 );
+    const double rowsCenter = 0.5 * ( largestRegion.GetSize( 1 ) - 1.0 );
+    IndexType index = largestRegion.GetIndex();
+    PointType point;
+    for( itk::SizeValueType slice = 0; slice < numberOfSlices; ++slice )
+      {
+      SlicePlane & plane = planes[slice];
+      index[0] = largestRegion.GetIndex( 0 );
+      index[1] = largestRegion.GetIndex( 1 );
+      index[SliceAxis] = largestRegion.GetIndex( SliceAxis ) + static_cast< itk::IndexValueType >( slice );
+      image->TransformIndexToPhysicalPoint( index, point );
+      double column[3];
+      double row[3];
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        plane.Origin[dim] = point[dim];
+        }
+      ++index[0];
+      image->TransformIndexToPhysicalPoint( index, point );
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        column[dim] = point[dim] - plane.Origin[dim];
+        }
+      --index[0];
+      ++index[1];
+      image->TransformIndexToPhysicalPoint( index, point );
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        row[dim] = point[dim] - plane.Origin[dim];
+        }
+      if( !InvertPlane( column, row, plane ) )
+        {
+        return false;
+        }
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        centers[3 * slice + dim] = plane.Origin[dim] + columnsCenter * column[dim] + rowsCenter * row[dim];
+        }
+      }
+
+    // The planes must advance along the sweep on the same side of each other.
+    // The centers of the slices are used, since the slices of a fan sweep can
+    // share an edge
+    double firstDirection = 0.0;
+    for( itk::SizeValueType slice = 0; slice + 1 < numberOfSlices; ++slice )
+      {
+      const double distance = Distance( planes[slice], &centers[3 * ( slice + 1 )] );
+      if( distance == 0.0 || ( firstDirection != 0.0 && ( distance > 0.0 ) != ( firstDirection > 0.0 ) ) )
+        {
+        return false;
+        }
+      if( firstDirection == 0.0 )
+        {
+        firstDirection = distance;
+        }
+      }
+
+    m_Planes.swap( planes );
+    m_FirstSlice = largestRegion.GetIndex( SliceAxis );
+    m_InPlaneStart[0] = largestRegion.GetIndex( 0 );
+    m_InPlaneStart[1] = largestRegion.GetIndex( 1 );
+    m_Orientation = firstDirection > 0.0 ? 1.0 : -1.0;
+    return true;
+    }
+
+  template< typename TPoint, typename TContinuousIndex >
+  void TransformPhysicalPointToContinuousIndex( const TPoint & point, TContinuousIndex & index ) const
+    {
+    double position[3];
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      position[dim] = point[dim];
+      }
+
+    // The oriented distance decreases along the slices, find the last slice
+    // of the bracketing pair with a nonnegative distance
+    const itk::SizeValueType numberOfSlices = m_Planes.size();
+    itk::SizeValueType lower = 0;
+    itk::SizeValueType upper = numberOfSlices - 1;
+    if( m_Orientation * Distance( m_Planes[lower], position ) < 0.0 )
+      {
+      upper = 1;
+      }
+    else if( m_Orientation * Distance( m_Planes[upper], position ) >= 0.0 )
+      {
+      lower = numberOfSlices - 2;
+      }
+    else
+      {
+      while( upper - lower > 1 )
+        {
+        const itk::SizeValueType middle = lower + ( upper - lower ) / 2;
+        if( m_Orientation * Distance( m_Planes[middle], position ) >= 0.0 )
+          {
+          lower = middle;
+          }
+        else
+          {
+          upper = middle;
+          }
+        }
+      }
+
+    double lowerIndex[3];
+    double upperIndex[3];
+    PlaneIndex( m_Planes[lower], position, lowerIndex );
+    PlaneIndex( m_Planes[upper], position, upperIndex );
+    const double denominator = lowerIndex[2] - upperIndex[2];
+    const double weight = denominator != 0.0 ? lowerIndex[2] / denominator : 0.0;
+    for( unsigned int dim = 0; dim < 2; ++dim )
+      {
+      index[dim] = lowerIndex[dim] + weight * ( upperIndex[dim] - lowerIndex[dim] );
+      }
+    index[2] = static_cast< double >( m_FirstSlice ) + static_cast< double >( lower ) + weight;
+    }
+
+private:
+  /** Rows of the inverse of the map from the continuous in-plane indices and
+   * the distance along the unit normal to the physical space. */
+  struct SlicePlane
+  {
+    double Origin[3];
+    double Inverse[3][3];
+  };
+
+  static bool InvertPlane( const double column[3], const double row[3], SlicePlane & plane )
+    {
+    double normal[3];
+    normal[0] = column[1] * row[2] - column[2] * row[1];
+    normal[1] = column[2] * row[0] - column[0] * row[2];
+    normal[2] = column[0] * row[1] - column[1] * row[0];
+    const double normalLength = std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+    if( normalLength == 0.0 )
+      {
+      return false;
+      }
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      normal[dim] /= normalLength;
+      }
+
+    // The columns of the map are column, row, and normal
+    const double * axes[3] = { column, row, normal };
+    double matrix[3][3];
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      for( unsigned int jj = 0; jj < 3; ++jj )
+        {
+        matrix[ii][jj] = axes[jj][ii];
+        }
+      }
+    const double determinant = matrix[0][0] * ( matrix[1][1] * matrix[2][2] - matrix[1][2] * matrix[2][1] )
+      - matrix[0][1] * ( matrix[1][0] * matrix[2][2] - matrix[1][2] * matrix[2][0] )
+      + matrix[0][2] * ( matrix[1][0] * matrix[2][1] - matrix[1][1] * matrix[2][0] );
+    if( determinant == 0.0 )
+      {
+      return false;
+      }
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      for( unsigned int jj = 0; jj < 3; ++jj )
+        {
+        // Cofactor of the transposed element
+        const unsigned int r0 = ( jj + 1 ) % 3;
+        const unsigned int r1 = ( jj + 2 ) % 3;
+        const unsigned int c0 = ( ii + 1 ) % 3;
+        const unsigned int c1 = ( ii + 2 ) % 3;
+        plane.Inverse[ii][jj] = ( matrix[r0][c0] * matrix[r1][c1] - matrix[r0][c1] * matrix[r1][c0] ) / determinant;
+        }
+      }
+    return true;
+    }
+
+  /** Distance along the normal of the plane. */
+  static double Distance( const SlicePlane & plane, const double position[3] )
+    {
+    double distance = 0.0;
+    for( unsigned int dim = 0; dim < 3; ++dim )
+      {
+      distance += plane.Inverse[2][dim] * ( position[dim] - plane.Origin[dim] );
+      }
+    return distance;
+    }
+
+  /** Continuous in-plane indices, relative to the first index of the slice,
+   * and the distance along the normal of the plane. */
+  void PlaneIndex( const SlicePlane & plane, const double position[3], double index[3] ) const
+    {
+    for( unsigned int ii = 0; ii < 3; ++ii )
+      {
+      index[ii] = 0.0;
+      for( unsigned int dim = 0; dim < 3; ++dim )
+        {
+        index[ii] += plane.Inverse[ii][dim] * ( position[dim] - plane.Origin[dim] );
+        }
+      }
+    index[0] += static_cast< double >( m_InPlaneStart[0] );
+    index[1] += static_cast< double >( m_InPlaneStart[1] );
+    }
+
+  std::vector< SlicePlane > m_Planes;
+  itk::IndexValueType       m_FirstSlice;
+  itk::IndexValueType       m_InPlaneStart[2];
+  double                    m_Orientation;
+};
+
+}
+
+#endif
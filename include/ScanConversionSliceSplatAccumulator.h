@@ -0,0 +1,861 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionSliceSplatAccumulator_h
+#define ScanConversionSliceSplatAccumulator_h
+
+#include "itkIntTypes.h"
+#include "itkMath.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkNumericTraits.h"
+
+#include "ScanConversionProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+/** \class ScanConversionSliceSplatAccumulator
+ *
+ * \brief Weighted sums of the samples of a slice series splatted onto a
+ * rectilinear output grid.
+ *
+ * Every input sample is added to the eight output voxels around its physical
+ * point with trilinear weights. Each voxel keeps the sum of the weighted
+ * values and the sum of the weights, so slices can be added as they are
+ * acquired, and the output, the ratio of the sums, can be computed at any
+ * time. Voxels that no sample reached are filled with the ratio of the sums
+ * over the cube of HoleFillingRadius voxels around them, or are zero when no
+ * sample reached the cube either.
+ *
+ * Each slice of a slice series is a planar grid, so the continuous output
+ * index of the samples of a slice is an affine function of the in-plane
+ * index, computed from three samples of the slice.
+ *
+ * The slices are split into contiguous ranges over the threads of an
+ * itk::MultiThreader. Each thread splats the consecutive slices of its range
+ * into its own sums over their bounding box in the output grid, and adds the
+ * box to the sums of the grid, one plane along the last axis at a time under
+ * the lock of the plane, before the box of the next slices would exceed
+ * MaximumBoxVoxels. The bounding box of a range of a fan sweep is most of the
+ * grid, so the boxes of the threads together are bounded by the cap instead
+ * of by the number of threads times the grid.
+ *
+ * The grid can be extended by whole voxels on the same lattice to include
+ * new slices, which keeps the sums already accumulated. The accumulator,
+ * with the number of slices added so far, can be written to and read from a
+ * file in the native byte order.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ScanConversionSliceSplatAccumulator
+{
+public:
+  typedef TInputImage                             InputImageType;
+  typedef TOutputImage                            OutputImageType;
+  typedef typename InputImageType::PixelType      InputPixelType;
+  typedef typename OutputImageType::PixelType     OutputPixelType;
+  typedef typename OutputImageType::SizeType      SizeType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+  typedef typename InputImageType::PointType      InputPointType;
+
+  itkStaticConstMacro( ImageDimension, unsigned int, OutputImageType::ImageDimension );
+
+  typedef float AccumulatorValueType;
+
+  ScanConversionSliceSplatAccumulator():
+    m_NumberOfSlices( 0 ),
+    m_HasGrid( false ),
+    m_HoleFillingRadius( 0 )
+  {
+    m_Size.Fill( 0 );
+  }
+
+  /** Radius in voxels of the neighborhood that fills the voxels no sample
+   * reached. Zero leaves them empty. */
+  void SetHoleFillingRadius( unsigned int radius )
+  {
+    m_HoleFillingRadius = radius;
+  }
+  unsigned int GetHoleFillingRadius() const
+  {
+    return m_HoleFillingRadius;
+  }
+
+  /** Allocate empty sums on the given grid. */
+  void SetGrid( const SizeType & size,
+    const SpacingType & spacing,
+    const PointType & origin,
+    const DirectionType & direction )
+  {
+    m_Size = size;
+    m_Spacing = spacing;
+    m_Origin = origin;
+    m_Direction = direction;
+    m_HasGrid = true;
+    m_NumberOfSlices = 0;
+    const itk::SizeValueType numberOfVoxels = this->GetNumberOfVoxels();
+    m_ValueSums.assign( numberOfVoxels, 0.0f );
+    m_WeightSums.assign( numberOfVoxels, 0.0f );
+  }
+
+  bool GetHasGrid() const
+  {
+    return m_HasGrid;
+  }
+
+  /** Number of slices added to the sums. */
+  itk::SizeValueType GetNumberOfSlices() const
+  {
+    return m_NumberOfSlices;
+  }
+
+  void GetGrid( SizeType & size, SpacingType & spacing, PointType & origin, DirectionType & direction ) const
+  {
+    size = m_Size;
+    spacing = m_Spacing;
+    origin = m_Origin;
+    direction = m_Direction;
+  }
+
+  /** Extend the grid by whole voxels so that it contains every point. */
+  void ExpandToInclude( const std::vector< InputPointType > & points )
+  {
+    itk::IndexValueType lower[ImageDimension];
+    itk::IndexValueType upper[ImageDimension];
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      lower[dim] = 0;
+      upper[dim] = static_cast< itk::IndexValueType >( m_Size[dim] ) - 1;
+      }
+    double index[ImageDimension];
+    for( std::size_t pointIndex = 0; pointIndex < points.size(); ++pointIndex )
+      {
+      this->TransformPhysicalPointToContinuousIndex( points[pointIndex], index );
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        lower[dim] = std::min( lower[dim], itk::Math::Floor< itk::IndexValueType >( index[dim] ) );
+        upper[dim] = std::max( upper[dim], itk::Math::Ceil< itk::IndexValueType >( index[dim] ) );
+        }
+      }
+    bool expanded = false;
+    SizeType size;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      size[dim] = static_cast< itk::SizeValueType >( upper[dim] - lower[dim] + 1 );
+      expanded = expanded || size[dim] != m_Size[dim];
+      }
+    if( !expanded )
+      {
+      return;
+      }
+
+    PointType origin = m_Origin;
+    for( unsigned int row = 0; row < ImageDimension; ++row )
+      {
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        origin[row] += m_Direction[row][dim] * m_Spacing[dim] * lower[dim];
+        }
+      }
+
+    itk::SizeValueType numberOfVoxels = 1;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      numberOfVoxels *= size[dim];
+      }
+    std::vector< AccumulatorValueType > valueSums( numberOfVoxels, 0.0f );
+    std::vector< AccumulatorValueType > weightSums( numberOfVoxels, 0.0f );
+
+    // Copy the old sums one row at a time at their offset in the new grid
+    const itk::SizeValueType oldRowLength = m_Size[0];
+    const itk::SizeValueType numberOfOldRows = this->GetNumberOfVoxels() / std::max< itk::SizeValueType >( oldRowLength, 1 );
+    for( itk::SizeValueType oldRow = 0; oldRow < numberOfOldRows; ++oldRow )
+      {
+      itk::SizeValueType remainder = oldRow;
+      itk::OffsetValueType newOffset = -lower[0];
+      itk::OffsetValueType newStride = size[0];
+      for( unsigned int dim = 1; dim < ImageDimension; ++dim )
+        {
+        const itk::OffsetValueType oldIndex = static_cast< itk::OffsetValueType >( remainder % m_Size[dim] );
+        remainder /= m_Size[dim];
+        newOffset += ( oldIndex - lower[dim] ) * newStride;
+        newStride *= size[dim];
+        }
+      std::copy( m_ValueSums.begin() + oldRow * oldRowLength,
+        m_ValueSums.begin() + ( oldRow + 1 ) * oldRowLength,
+        valueSums.begin() + newOffset );
+      std::copy( m_WeightSums.begin() + oldRow * oldRowLength,
+        m_WeightSums.begin() + ( oldRow + 1 ) * oldRowLength,
+        weightSums.begin() + newOffset );
+      }
+
+    m_Size = size;
+    m_Origin = origin;
+    m_ValueSums.swap( valueSums );
+    m_WeightSums.swap( weightSums );
+  }
+
+  /** Splat the slices in [firstSlice, endSlice) of the inputImage, which must
+   * be in its buffered region. */
+  int AddSlices( const InputImageType * inputImage,
+    itk::IndexValueType firstSlice,
+    itk::IndexValueType endSlice )
+  {
+    if( !m_HasGrid )
+      {
+      std::cerr << "The splat accumulator grid has not been set" << std::endl;
+      return EXIT_FAILURE;
+      }
+    const typename InputImageType::RegionType & bufferedRegion = inputImage->GetBufferedRegion();
+    const unsigned int SliceAxis = ImageDimension - 1;
+    if( firstSlice < bufferedRegion.GetIndex( SliceAxis )
+      || endSlice > bufferedRegion.GetIndex( SliceAxis ) + static_cast< itk::IndexValueType >( bufferedRegion.GetSize( SliceAxis ) ) )
+      {
+      std::cerr << "The slices to splat are not in the buffered region of the input" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    ScanConversionProfileScope profileSplat( "Splat Slices" );
+    if( endSlice <= firstSlice )
+      {
+      return EXIT_SUCCESS;
+      }
+
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    const itk::SizeValueType numberOfSlices = static_cast< itk::SizeValueType >( endSlice - firstSlice );
+    if( numberOfSlices < static_cast< itk::SizeValueType >( threader->GetNumberOfThreads() ) )
+      {
+      threader->SetNumberOfThreads( numberOfSlices );
+      }
+
+    ThreadData data;
+    data.Accumulator = this;
+    data.InputImage = inputImage;
+    data.FirstSlice = firstSlice;
+    data.EndSlice = endSlice;
+    // The boxes of the threads together are at most the size of the grid,
+    // or a few megabytes for small grids
+    data.MaximumBoxVoxels = std::max< itk::SizeValueType >( this->GetNumberOfVoxels() / threader->GetNumberOfThreads(),
+      MinimumMaximumBoxVoxels );
+    data.PlaneLocks.resize( m_Size[ImageDimension - 1] );
+    for( std::size_t plane = 0; plane < data.PlaneLocks.size(); ++plane )
+      {
+      data.PlaneLocks[plane] = itk::MutexLock::New();
+      }
+    threader->SetSingleMethod( Self::SplatThread, &data );
+    threader->SingleMethodExecute();
+
+    m_NumberOfSlices += numberOfSlices;
+    return EXIT_SUCCESS;
+  }
+
+  /** The ratio of the value and weight sums of every voxel. */
+  int GetOutput( typename OutputImageType::Pointer & outputImage ) const
+  {
+    if( !m_HasGrid )
+      {
+      std::cerr << "The splat accumulator grid has not been set" << std::endl;
+      return EXIT_FAILURE;
+      }
+    typename OutputImageType::Pointer output = OutputImageType::New();
+    output->SetRegions( m_Size );
+    output->SetSpacing( m_Spacing );
+    output->SetOrigin( m_Origin );
+    output->SetDirection( m_Direction );
+    output->Allocate();
+
+    ScanConversionProfileScope profileOutput( "Splat Output" );
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    const itk::SizeValueType numberOfRows = this->GetNumberOfVoxels() / std::max< itk::SizeValueType >( m_Size[0], 1 );
+    if( numberOfRows < static_cast< itk::SizeValueType >( threader->GetNumberOfThreads() ) )
+      {
+      threader->SetNumberOfThreads( std::max< itk::SizeValueType >( numberOfRows, 1 ) );
+      }
+    OutputThreadData data;
+    data.Accumulator = this;
+    data.OutputImage = output.GetPointer();
+    threader->SetSingleMethod( Self::OutputThread, &data );
+    threader->SingleMethodExecute();
+
+    outputImage = output;
+    return EXIT_SUCCESS;
+  }
+
+  /** Read an accumulator. Returns false if the file cannot be read, if its
+   * grid is not a valid grid, or if its length is not the length of the sums
+   * of the grid, e.g. a truncated file. The accumulator is unchanged when the
+   * file is not read. */
+  bool Read( const std::string & fileName )
+  {
+    std::ifstream stream( fileName.c_str(), std::ios::in | std::ios::binary );
+    if( !stream )
+      {
+      return false;
+      }
+    stream.seekg( 0, std::ios::end );
+    const std::streamoff fileLength = stream.tellg();
+    stream.seekg( 0, std::ios::beg );
+
+    char magic[sizeof( MagicString )];
+    stream.read( magic, sizeof( magic ) );
+    itk::uint32_t dimension = 0;
+    stream.read( reinterpret_cast< char * >( &dimension ), sizeof( dimension ) );
+    if( !stream || std::memcmp( magic, MagicString, sizeof( magic ) ) != 0 || dimension != ImageDimension )
+      {
+      return false;
+      }
+
+    itk::uint64_t numberOfSlices = 0;
+    stream.read( reinterpret_cast< char * >( &numberOfSlices ), sizeof( numberOfSlices ) );
+    double grid[ImageDimension * ( 3 + ImageDimension )];
+    stream.read( reinterpret_cast< char * >( grid ), sizeof( grid ) );
+    if( !stream || numberOfSlices > static_cast< itk::uint64_t >( itk::NumericTraits< itk::IndexValueType >::max() ) )
+      {
+      return false;
+      }
+
+    // The number of voxels is bounded by the length of the file before the
+    // sums are allocated
+    const std::streamoff sumsLength = fileLength - static_cast< std::streamoff >( stream.tellg() );
+    const double maximumNumberOfVoxels = static_cast< double >( sumsLength ) / ( 2 * sizeof( AccumulatorValueType ) );
+    SizeType size;
+    SpacingType spacing;
+    PointType origin;
+    DirectionType direction;
+    double numberOfVoxels = 1.0;
+    unsigned int position = 0;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      const double sizeAlongDim = grid[position++];
+      if( !( sizeAlongDim >= 1.0 && sizeAlongDim <= maximumNumberOfVoxels )
+        || sizeAlongDim != std::floor( sizeAlongDim ) )
+        {
+        return false;
+        }
+      size[dim] = static_cast< itk::SizeValueType >( sizeAlongDim );
+      numberOfVoxels *= sizeAlongDim;
+      spacing[dim] = grid[position++];
+      origin[dim] = grid[position++];
+      if( !( spacing[dim] > 0.0 ) || !vnl_math_isfinite( spacing[dim] ) || !vnl_math_isfinite( origin[dim] ) )
+        {
+        return false;
+        }
+      for( unsigned int column = 0; column < ImageDimension; ++column )
+        {
+        direction[dim][column] = grid[position++];
+        if( !vnl_math_isfinite( direction[dim][column] ) )
+          {
+          return false;
+          }
+        }
+      }
+    if( numberOfVoxels != maximumNumberOfVoxels )
+      {
+      return false;
+      }
+
+    const itk::SizeValueType voxels = static_cast< itk::SizeValueType >( numberOfVoxels );
+    std::vector< AccumulatorValueType > valueSums( voxels );
+    std::vector< AccumulatorValueType > weightSums( voxels );
+    stream.read( reinterpret_cast< char * >( &(valueSums[0]) ), voxels * sizeof( AccumulatorValueType ) );
+    stream.read( reinterpret_cast< char * >( &(weightSums[0]) ), voxels * sizeof( AccumulatorValueType ) );
+    if( !stream )
+      {
+      return false;
+      }
+    m_Size = size;
+    m_Spacing = spacing;
+    m_Origin = origin;
+    m_Direction = direction;
+    m_ValueSums.swap( valueSums );
+    m_WeightSums.swap( weightSums );
+    m_NumberOfSlices = static_cast< itk::SizeValueType >( numberOfSlices );
+    m_HasGrid = true;
+    return true;
+  }
+
+  bool Write( const std::string & fileName ) const
+  {
+    std::ofstream stream( fileName.c_str(), std::ios::out | std::ios::binary );
+    if( !stream )
+      {
+      return false;
+      }
+
+    stream.write( MagicString, sizeof( MagicString ) );
+    const itk::uint32_t dimension = ImageDimension;
+    stream.write( reinterpret_cast< const char * >( &dimension ), sizeof( dimension ) );
+    const itk::uint64_t numberOfSlices = m_NumberOfSlices;
+    stream.write( reinterpret_cast< const char * >( &numberOfSlices ), sizeof( numberOfSlices ) );
+    double grid[ImageDimension * ( 3 + ImageDimension )];
+    unsigned int position = 0;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      grid[position++] = static_cast< double >( m_Size[dim] );
+      grid[position++] = m_Spacing[dim];
+      grid[position++] = m_Origin[dim];
+      for( unsigned int column = 0; column < ImageDimension; ++column )
+        {
+        grid[position++] = m_Direction[dim][column];
+        }
+      }
+    stream.write( reinterpret_cast< const char * >( grid ), sizeof( grid ) );
+    const itk::SizeValueType numberOfVoxels = this->GetNumberOfVoxels();
+    stream.write( reinterpret_cast< const char * >( &(m_ValueSums[0]) ), numberOfVoxels * sizeof( AccumulatorValueType ) );
+    stream.write( reinterpret_cast< const char * >( &(m_WeightSums[0]) ), numberOfVoxels * sizeof( AccumulatorValueType ) );
+    return !stream.fail();
+  }
+
+private:
+  itk::SizeValueType GetNumberOfVoxels() const
+  {
+    itk::SizeValueType numberOfVoxels = 1;
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      numberOfVoxels *= m_Size[dim];
+      }
+    return numberOfVoxels;
+  }
+
+  template< typename TPoint >
+  void TransformPhysicalPointToContinuousIndex( const TPoint & point, double index[ImageDimension] ) const
+  {
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      double coordinate = 0.0;
+      for( unsigned int row = 0; row < ImageDimension; ++row )
+        {
+        coordinate += m_Direction[row][dim] * ( point[row] - m_Origin[row] );
+        }
+      index[dim] = coordinate / m_Spacing[dim];
+      }
+  }
+
+  typedef ScanConversionSliceSplatAccumulator Self;
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+
+  /** Sums over a box of the output grid. */
+  struct SplatBox
+  {
+    itk::IndexValueType                 Lower[ImageDimension];
+    itk::SizeValueType                  Size[ImageDimension];
+    std::vector< AccumulatorValueType > ValueSums;
+    std::vector< AccumulatorValueType > WeightSums;
+  };
+
+  /** Shared state of the threads of AddSlices. */
+  struct ThreadData
+  {
+    Self *                                  Accumulator;
+    const InputImageType *                  InputImage;
+    itk::IndexValueType                     FirstSlice;
+    itk::IndexValueType                     EndSlice;
+    itk::SizeValueType                      MaximumBoxVoxels;
+    std::vector< itk::MutexLock::Pointer >  PlaneLocks;
+  };
+
+  /** Shared state of the threads of GetOutput. */
+  struct OutputThreadData
+  {
+    const Self *       Accumulator;
+    OutputImageType *  OutputImage;
+  };
+
+  /** Continuous output index of the first sample of a slice and its
+   * increments along the columns and the rows. */
+  void ComputeSliceMapping( const InputImageType * inputImage,
+    itk::IndexValueType slice,
+    double origin[ImageDimension],
+    double columnStep[ImageDimension],
+    double rowStep[ImageDimension] ) const
+  {
+    const unsigned int SliceAxis = ImageDimension - 1;
+    typename InputImageType::IndexType inputIndex = inputImage->GetBufferedRegion().GetIndex();
+    inputIndex[SliceAxis] = slice;
+    InputPointType point;
+    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+    this->TransformPhysicalPointToContinuousIndex( point, origin );
+    ++inputIndex[0];
+    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+    this->TransformPhysicalPointToContinuousIndex( point, columnStep );
+    --inputIndex[0];
+    ++inputIndex[1];
+    inputImage->TransformIndexToPhysicalPoint( inputIndex, point );
+    this->TransformPhysicalPointToContinuousIndex( point, rowStep );
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      columnStep[dim] -= origin[dim];
+      rowStep[dim] -= origin[dim];
+      }
+  }
+
+  /** Splat a contiguous range of the slices, in batches of consecutive
+   * slices whose bounding box in the grid is at most MaximumBoxVoxels, or one
+   * slice, and add the box of each batch to the grid. */
+  static ITK_THREAD_RETURN_TYPE SplatThread( void * arg )
+  {
+    ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+    ThreadData * data = static_cast< ThreadData * >( threadInfo->UserData );
+    Self * accumulator = data->Accumulator;
+    const InputImageType * inputImage = data->InputImage;
+
+    const itk::IndexValueType numberOfSlices = data->EndSlice - data->FirstSlice;
+    const itk::IndexValueType firstSlice = data->FirstSlice + numberOfSlices * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+    const itk::IndexValueType endSlice = data->FirstSlice + numberOfSlices * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+
+    const unsigned int SliceAxis = ImageDimension - 1;
+    const typename InputImageType::RegionType & bufferedRegion = inputImage->GetBufferedRegion();
+    const itk::SizeValueType columns = bufferedRegion.GetSize( 0 );
+    const itk::SizeValueType rows = bufferedRegion.GetSize( 1 );
+
+    // The samples of a slice are inside the parallelogram of its corners,
+    // and reach the voxels of its bounding box in the grid, [lower, end)
+    std::vector< double > mappings( ( endSlice - firstSlice ) * 3 * ImageDimension );
+    std::vector< itk::IndexValueType > sliceBoxes( ( endSlice - firstSlice ) * 2 * ImageDimension );
+    for( itk::IndexValueType slice = firstSlice; slice < endSlice; ++slice )
+      {
+      double * origin = &mappings[( slice - firstSlice ) * 3 * ImageDimension];
+      double * columnStep = origin + ImageDimension;
+      double * rowStep = columnStep + ImageDimension;
+      accumulator->ComputeSliceMapping( inputImage, slice, origin, columnStep, rowStep );
+      double lower[ImageDimension];
+      double upper[ImageDimension];
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        lower[dim] = itk::NumericTraits< double >::max();
+        upper[dim] = itk::NumericTraits< double >::NonpositiveMin();
+        }
+      for( unsigned int corner = 0; corner < 4; ++corner )
+        {
+        const double column = ( corner & 1 ) ? columns - 1.0 : 0.0;
+        const double row = ( corner & 2 ) ? rows - 1.0 : 0.0;
+        for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+          {
+          const double index = origin[dim] + column * columnStep[dim] + row * rowStep[dim];
+          lower[dim] = std::min( lower[dim], index );
+          upper[dim] = std::max( upper[dim], index );
+          }
+        }
+      itk::IndexValueType * sliceBox = &sliceBoxes[( slice - firstSlice ) * 2 * ImageDimension];
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        const itk::IndexValueType gridEnd = static_cast< itk::IndexValueType >( accumulator->m_Size[dim] );
+        sliceBox[dim] = std::max< itk::IndexValueType >( itk::Math::Floor< itk::IndexValueType >( lower[dim] ), 0 );
+        sliceBox[ImageDimension + dim] = std::min< itk::IndexValueType >( itk::Math::Floor< itk::IndexValueType >( upper[dim] ) + 2, gridEnd );
+        }
+      }
+
+    SplatBox box;
+    const InputPixelType * inputBuffer = inputImage->GetBufferPointer();
+    double index[ImageDimension];
+    itk::IndexValueType batchFirst = firstSlice;
+    while( batchFirst < endSlice )
+      {
+      // Grow the batch while its box is within the cap. The slices outside
+      // the grid have an empty box and do not grow it.
+      itk::IndexValueType lower[ImageDimension];
+      itk::IndexValueType end[ImageDimension];
+      bool empty = true;
+      itk::IndexValueType batchEnd = batchFirst;
+      for( ; batchEnd < endSlice; ++batchEnd )
+        {
+        const itk::IndexValueType * sliceBox = &sliceBoxes[( batchEnd - firstSlice ) * 2 * ImageDimension];
+        bool sliceEmpty = false;
+        for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+          {
+          sliceEmpty = sliceEmpty || sliceBox[ImageDimension + dim] <= sliceBox[dim];
+          }
+        if( sliceEmpty )
+          {
+          continue;
+          }
+        itk::IndexValueType unionLower[ImageDimension];
+        itk::IndexValueType unionEnd[ImageDimension];
+        itk::SizeValueType unionVoxels = 1;
+        for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+          {
+          unionLower[dim] = empty ? sliceBox[dim] : std::min( lower[dim], sliceBox[dim] );
+          unionEnd[dim] = empty ? sliceBox[ImageDimension + dim] : std::max( end[dim], sliceBox[ImageDimension + dim] );
+          unionVoxels *= static_cast< itk::SizeValueType >( unionEnd[dim] - unionLower[dim] );
+          }
+        if( !empty && unionVoxels > data->MaximumBoxVoxels )
+          {
+          break;
+          }
+        std::copy( unionLower, unionLower + ImageDimension, lower );
+        std::copy( unionEnd, unionEnd + ImageDimension, end );
+        empty = false;
+        }
+      if( empty )
+        {
+        break;
+        }
+
+      itk::SizeValueType numberOfVoxels = 1;
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        box.Lower[dim] = lower[dim];
+        box.Size[dim] = static_cast< itk::SizeValueType >( end[dim] - lower[dim] );
+        numberOfVoxels *= box.Size[dim];
+        }
+      box.ValueSums.assign( numberOfVoxels, 0.0f );
+      box.WeightSums.assign( numberOfVoxels, 0.0f );
+
+      for( itk::IndexValueType slice = batchFirst; slice < batchEnd; ++slice )
+        {
+        const double * origin = &mappings[( slice - firstSlice ) * 3 * ImageDimension];
+        const double * columnStep = origin + ImageDimension;
+        const double * rowStep = columnStep + ImageDimension;
+        const InputPixelType * sliceBuffer = inputBuffer + ( slice - bufferedRegion.GetIndex( SliceAxis ) ) * columns * rows;
+        for( itk::SizeValueType row = 0; row < rows; ++row )
+          {
+          for( itk::SizeValueType column = 0; column < columns; ++column )
+            {
+            for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+              {
+              index[dim] = origin[dim] + column * columnStep[dim] + row * rowStep[dim] - box.Lower[dim];
+              }
+            Splat( index, static_cast< AccumulatorValueType >( sliceBuffer[row * columns + column] ), box );
+            }
+          }
+        }
+
+      accumulator->AddBox( box, data->PlaneLocks );
+      batchFirst = batchEnd;
+      }
+
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  /** Add the sums of a box to the sums of the grid, one plane along the last
+   * axis at a time under the lock of the plane. */
+  void AddBox( const SplatBox & box, const std::vector< itk::MutexLock::Pointer > & planeLocks )
+  {
+    const unsigned int PlaneAxis = ImageDimension - 1;
+    itk::SizeValueType rowsPerPlane = 1;
+    for( unsigned int dim = 1; dim < PlaneAxis; ++dim )
+      {
+      rowsPerPlane *= box.Size[dim];
+      }
+    for( itk::SizeValueType plane = 0; plane < box.Size[PlaneAxis]; ++plane )
+      {
+      const itk::IndexValueType gridPlane = box.Lower[PlaneAxis] + static_cast< itk::IndexValueType >( plane );
+      planeLocks[gridPlane]->Lock();
+      for( itk::SizeValueType planeRow = 0; planeRow < rowsPerPlane; ++planeRow )
+        {
+        // Offset of the first voxel of the row in the grid
+        itk::SizeValueType remainder = planeRow;
+        itk::SizeValueType gridOffset = static_cast< itk::SizeValueType >( box.Lower[0] );
+        itk::SizeValueType gridStride = m_Size[0];
+        for( unsigned int dim = 1; dim < PlaneAxis; ++dim )
+          {
+          gridOffset += ( static_cast< itk::SizeValueType >( box.Lower[dim] ) + remainder % box.Size[dim] ) * gridStride;
+          remainder /= box.Size[dim];
+          gridStride *= m_Size[dim];
+          }
+        gridOffset += static_cast< itk::SizeValueType >( gridPlane ) * gridStride;
+
+        const itk::SizeValueType boxOffset = ( plane * rowsPerPlane + planeRow ) * box.Size[0];
+        AccumulatorValueType * valueRow = &m_ValueSums[gridOffset];
+        AccumulatorValueType * weightRow = &m_WeightSums[gridOffset];
+        const AccumulatorValueType * boxValues = &box.ValueSums[boxOffset];
+        const AccumulatorValueType * boxWeights = &box.WeightSums[boxOffset];
+        for( itk::SizeValueType ii = 0; ii < box.Size[0]; ++ii )
+          {
+          valueRow[ii] += boxValues[ii];
+          weightRow[ii] += boxWeights[ii];
+          }
+        }
+      planeLocks[gridPlane]->Unlock();
+      }
+  }
+
+  /** Ratio of the sums for a contiguous range of the output rows. */
+  static ITK_THREAD_RETURN_TYPE OutputThread( void * arg )
+  {
+    ThreadInfoType * threadInfo = static_cast< ThreadInfoType * >( arg );
+    OutputThreadData * data = static_cast< OutputThreadData * >( threadInfo->UserData );
+    const Self * accumulator = data->Accumulator;
+    const SizeType & size = accumulator->m_Size;
+    const AccumulatorValueType * valueSums = &(accumulator->m_ValueSums[0]);
+    const AccumulatorValueType * weightSums = &(accumulator->m_WeightSums[0]);
+    OutputPixelType * outputBuffer = data->OutputImage->GetBufferPointer();
+    const itk::IndexValueType radius = static_cast< itk::IndexValueType >( accumulator->m_HoleFillingRadius );
+
+    itk::OffsetValueType strides[ImageDimension];
+    strides[0] = 1;
+    for( unsigned int dim = 1; dim < ImageDimension; ++dim )
+      {
+      strides[dim] = strides[dim - 1] * size[dim - 1];
+      }
+
+    const double minOutputValue = itk::NumericTraits< OutputPixelType >::NonpositiveMin();
+    const double maxOutputValue = itk::NumericTraits< OutputPixelType >::max();
+
+    const itk::SizeValueType numberOfRows = accumulator->GetNumberOfVoxels() / std::max< itk::SizeValueType >( size[0], 1 );
+    const itk::SizeValueType firstRow = numberOfRows * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+    const itk::SizeValueType endRow = numberOfRows * ( threadInfo->ThreadID + 1 ) / threadInfo->NumberOfThreads;
+    itk::IndexValueType voxelIndex[ImageDimension];
+    for( itk::SizeValueType row = firstRow; row < endRow; ++row )
+      {
+      itk::SizeValueType remainder = row;
+      for( unsigned int dim = 1; dim < ImageDimension; ++dim )
+        {
+        voxelIndex[dim] = static_cast< itk::IndexValueType >( remainder % size[dim] );
+        remainder /= size[dim];
+        }
+      for( itk::SizeValueType ii = 0; ii < size[0]; ++ii )
+        {
+        const itk::SizeValueType voxel = row * size[0] + ii;
+        double valueSum = valueSums[voxel];
+        double weightSum = weightSums[voxel];
+        if( weightSum <= 0.0 && radius > 0 )
+          {
+          voxelIndex[0] = static_cast< itk::IndexValueType >( ii );
+          SumNeighborhood( valueSums, weightSums, size, strides, voxelIndex, radius, ImageDimension - 1, 0, valueSum, weightSum );
+          }
+        if( weightSum <= 0.0 )
+          {
+          outputBuffer[voxel] = itk::NumericTraits< OutputPixelType >::ZeroValue();
+          continue;
+          }
+        const double value = valueSum / weightSum;
+        if( value < minOutputValue )
+          {
+          outputBuffer[voxel] = static_cast< OutputPixelType >( minOutputValue );
+          }
+        else if( value > maxOutputValue )
+          {
+          outputBuffer[voxel] = static_cast< OutputPixelType >( maxOutputValue );
+          }
+        else
+          {
+          outputBuffer[voxel] = static_cast< OutputPixelType >( value );
+          }
+        }
+      }
+
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  /** Add the sums of the cube of the given radius around a voxel, clipped to
+   * the grid, along the axes up to axis. */
+  static void SumNeighborhood( const AccumulatorValueType * valueSums,
+    const AccumulatorValueType * weightSums,
+    const SizeType & size,
+    const itk::OffsetValueType strides[ImageDimension],
+    const itk::IndexValueType voxelIndex[ImageDimension],
+    itk::IndexValueType radius,
+    unsigned int axis,
+    itk::OffsetValueType offset,
+    double & valueSum,
+    double & weightSum )
+  {
+    const itk::IndexValueType begin = std::max< itk::IndexValueType >( voxelIndex[axis] - radius, 0 );
+    const itk::IndexValueType end = std::min< itk::IndexValueType >( voxelIndex[axis] + radius + 1,
+      static_cast< itk::IndexValueType >( size[axis] ) );
+    for( itk::IndexValueType index = begin; index < end; ++index )
+      {
+      const itk::OffsetValueType neighborOffset = offset + index * strides[axis];
+      if( axis == 0 )
+        {
+        valueSum += valueSums[neighborOffset];
+        weightSum += weightSums[neighborOffset];
+        }
+      else
+        {
+        SumNeighborhood( valueSums, weightSums, size, strides, voxelIndex, radius, axis - 1, neighborOffset, valueSum, weightSum );
+        }
+      }
+  }
+
+  /** Add a sample at a continuous index of a box to the voxels around it. */
+  static void Splat( const double index[ImageDimension], AccumulatorValueType value, SplatBox & box )
+  {
+    static const unsigned int NumberOfNeighbors = 1 << ImageDimension;
+    itk::IndexValueType base[ImageDimension];
+    double fractions[ImageDimension];
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      base[dim] = itk::Math::Floor< itk::IndexValueType >( index[dim] );
+      fractions[dim] = index[dim] - base[dim];
+      if( base[dim] < -1 || base[dim] >= static_cast< itk::IndexValueType >( box.Size[dim] ) )
+        {
+        return;
+        }
+      }
+    for( unsigned int neighbor = 0; neighbor < NumberOfNeighbors; ++neighbor )
+      {
+      itk::SizeValueType offset = 0;
+      itk::SizeValueType stride = 1;
+      double weight = 1.0;
+      bool inside = true;
+      for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+        {
+        const bool upper = ( neighbor & ( 1 << dim ) ) != 0;
+        const itk::IndexValueType voxelIndex = base[dim] + ( upper ? 1 : 0 );
+        if( voxelIndex < 0 || voxelIndex >= static_cast< itk::IndexValueType >( box.Size[dim] ) )
+          {
+          inside = false;
+          break;
+          }
+        weight *= upper ? fractions[dim] : 1.0 - fractions[dim];
+        offset += voxelIndex * stride;
+        stride *= box.Size[dim];
+        }
+      if( inside && weight > 0.0 )
+        {
+        box.ValueSums[offset] += static_cast< AccumulatorValueType >( weight ) * value;
+        box.WeightSums[offset] += static_cast< AccumulatorValueType >( weight );
+        }
+      }
+  }
+
+  static const char MagicString[8];
+
+  /** Cap of the box of a batch on small grids, 4 MB of sums. */
+  static const itk::SizeValueType MinimumMaximumBoxVoxels = 1 << 19;
+
+  itk::SizeValueType                  m_NumberOfSlices;
+  bool                                m_HasGrid;
+  unsigned int                        m_HoleFillingRadius;
+  SizeType                            m_Size;
+  SpacingType                         m_Spacing;
+  PointType                           m_Origin;
+  DirectionType                       m_Direction;
+  std::vector< AccumulatorValueType > m_ValueSums;
+  std::vector< AccumulatorValueType > m_WeightSums;
+};
+
+template< typename TInputImage, typename TOutputImage >
+const char ScanConversionSliceSplatAccumulator< TInputImage, TOutputImage >::MagicString[8] = { 'S', 'C', 'S', 'P', 'L', '0', '0', '1' };
+
+template< typename TInputImage, typename TOutputImage >
+const itk::SizeValueType ScanConversionSliceSplatAccumulator< TInputImage, TOutputImage >::MinimumMaximumBoxVoxels;
+
+}
+
+#endif
@@ -0,0 +1,660 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionTesting_h
+#define ScanConversionTesting_h
+
+// Test functions of the module test drivers. Include after itkTestMain.h,
+// and register them with RegisterScanConversionTests().
+
+#include "itkImageAlgorithm.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkMultiThreader.h"
+#include "itksys/SystemTools.hxx"
+
+#include "vtkClientSocket.h"
+#include "vtkSmartPointer.h"
+
+#include "ScanConversionServer.h"
+#include "ScanConversionSharedMemory.h"
+#include "ScanConversionThreading.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** Run registered test functions one after the other, e.g. a conversion
+ * that writes a file and one that reads it back. The arguments are the
+ * commands, each a test function name and its arguments, separated by
+ * --then. Stops at the first command that fails. */
+inline int
+ScanConversionTestSequence( int argc, char * argv[] )
+{
+  std::vector< std::vector< char * > > commands( 1 );
+  for( int arg = 1; arg < argc; ++arg )
+    {
+    if( std::strcmp( argv[arg], "--then" ) == 0 )
+      {
+      commands.push_back( std::vector< char * >() );
+      }
+    else
+      {
+      commands.back().push_back( argv[arg] );
+      }
+    }
+
+  for( std::size_t command = 0; command < commands.size(); ++command )
+    {
+    if( commands[command].empty() )
+      {
+      std::cerr << "Command " << command << " of the test sequence is empty" << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::map< std::string, MainFuncPointer >::const_iterator function =
+      StringToTestFunctionMap.find( commands[command][0] );
+    if( function == StringToTestFunctionMap.end() )
+      {
+      std::cerr << "Unknown test function " << commands[command][0] << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::vector< char * > & arguments = commands[command];
+    arguments.push_back( ITK_NULLPTR );
+    if( ( *function->second )( static_cast< int >( arguments.size() - 1 ), &arguments[0] ) != EXIT_SUCCESS )
+      {
+      std::cerr << "Command " << command << " of the test sequence, " << arguments[0] << ", failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  return EXIT_SUCCESS;
+}
+
+
+struct ScanConversionServerTestArguments
+{
+  std::vector< char * > Arguments;
+  int                   Status;
+};
+
+
+inline ITK_THREAD_RETURN_TYPE
+ScanConversionServerTestThread( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * threadInfo = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  ScanConversionServerTestArguments * serverArguments =
+    static_cast< ScanConversionServerTestArguments * >( threadInfo->UserData );
+  serverArguments->Status = ( *StringToTestFunctionMap["ModuleEntryPoint"] )(
+    static_cast< int >( serverArguments->Arguments.size() - 1 ),
+    &serverArguments->Arguments[0] );
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+
+/** Read the token that a server writes once it listens. Returns false when
+ * the file has no whole token yet. */
+inline bool
+ReadScanConversionServerTestToken( const char * tokenFileName, std::string & token )
+{
+  std::ifstream tokenStream( tokenFileName );
+  if( !tokenStream || !std::getline( tokenStream, token ) )
+    {
+    return false;
+    }
+  return token.size() == 2 * ScanConversionTokenBytes;
+}
+
+
+/** Send a line to the server and check its reply. */
+inline bool
+ScanConversionServerTestExchange( vtkClientSocket * client, const std::string & line, const char * expectedReply )
+{
+  const std::string request = line + "\n";
+  const int replyLength = static_cast< int >( std::strlen( expectedReply ) );
+  std::vector< char > reply( replyLength );
+  return client->Send( request.c_str(), static_cast< int >( request.size() ) ) == 1
+    && client->Receive( &reply[0], replyLength ) == replyLength
+    && std::strncmp( &reply[0], expectedReply, replyLength ) == 0;
+}
+
+
+/** Start a module with --serverPort in a thread, check that a client with
+ * an invalid token is refused, then authenticate with the token of the
+ * server, send it one request, then QUIT, e.g.
+ *
+ *   ScanConversionServerTest <port> <token file> <request input> <request output>
+ *     <ModuleEntryPoint arguments, including --serverPort port
+ *      and --serverTokenFile token file>
+ */
+inline int
+ScanConversionServerTest( int argc, char * argv[] )
+{
+  if( argc < 6 )
+    {
+    std::cerr << "Usage: " << argv[0] << " port tokenFile requestInput requestOutput moduleArguments..." << std::endl;
+    return EXIT_FAILURE;
+    }
+  const int port = std::atoi( argv[1] );
+  const char * tokenFileName = argv[2];
+  const std::string request = std::string( argv[3] ) + "\t" + argv[4];
+
+  // Do not read the token of a previous run
+  itksys::SystemTools::RemoveFile( tokenFileName );
+
+  ScanConversionServerTestArguments serverArguments;
+  serverArguments.Status = EXIT_FAILURE;
+  serverArguments.Arguments.push_back( const_cast< char * >( "ModuleEntryPoint" ) );
+  for( int arg = 5; arg < argc; ++arg )
+    {
+    serverArguments.Arguments.push_back( argv[arg] );
+    }
+  serverArguments.Arguments.push_back( ITK_NULLPTR );
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  const int serverThread = threader->SpawnThread( ScanConversionServerTestThread, &serverArguments );
+
+  // The server writes its token once it listens
+  std::string token;
+  bool listening = false;
+  for( unsigned int attempt = 0; attempt < 300 && !listening; ++attempt )
+    {
+    listening = ReadScanConversionServerTestToken( tokenFileName, token );
+    if( !listening )
+      {
+      itksys::SystemTools::Delay( 100 );
+      }
+    }
+  if( !listening )
+    {
+    std::cerr << "The server did not write its token to " << tokenFileName << std::endl;
+    threader->TerminateThread( serverThread );
+    return EXIT_FAILURE;
+    }
+
+  int status = EXIT_SUCCESS;
+  vtkSmartPointer< vtkClientSocket > intruder = vtkSmartPointer< vtkClientSocket >::New();
+  if( intruder->ConnectToServer( "127.0.0.1", port ) != 0
+    || !ScanConversionServerTestExchange( intruder, std::string( token.size(), '0' ), "ERROR\n" ) )
+    {
+    std::cerr << "The server did not refuse an invalid token" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  intruder->CloseSocket();
+
+  vtkSmartPointer< vtkClientSocket > client = vtkSmartPointer< vtkClientSocket >::New();
+  if( client->ConnectToServer( "127.0.0.1", port ) != 0 )
+    {
+    std::cerr << "Could not connect to the server on port " << port << std::endl;
+    threader->TerminateThread( serverThread );
+    return EXIT_FAILURE;
+    }
+  if( !ScanConversionServerTestExchange( client, token, "OK\n" ) )
+    {
+    std::cerr << "The server did not accept its token" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  else if( !ScanConversionServerTestExchange( client, request, "OK\n" ) )
+    {
+    std::cerr << "The server did not convert " << argv[3] << std::endl;
+    status = EXIT_FAILURE;
+    }
+  if( !ScanConversionServerTestExchange( client, "QUIT", "OK\n" ) )
+    {
+    std::cerr << "The server did not acknowledge QUIT" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  client->CloseSocket();
+
+  threader->TerminateThread( serverThread );
+  if( serverArguments.Status != EXIT_SUCCESS )
+    {
+    std::cerr << "The server failed" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
+
+
+template< typename TPixel >
+int
+WriteScanConversionSharedMemoryTestFrame( const char * inputFileName, const char * segmentName )
+{
+  typedef itk::Image< TPixel, 3 >            ImageType;
+  typedef itk::ImageFileReader< ImageType > ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( inputFileName );
+  reader->Update();
+  const ImageType * image = reader->GetOutput();
+
+  ScanConversionSharedMemoryHeader header;
+  std::memset( &header, 0, sizeof( header ) );
+  std::memcpy( header.Magic, ScanConversionSharedMemoryMagic, sizeof( header.Magic ) );
+  std::strncpy( header.ElementType, ScanConversionMetaImageElementType< TPixel >::Get(), sizeof( header.ElementType ) );
+  for( unsigned int dim = 0; dim < 3; ++dim )
+    {
+    header.Size[dim] = static_cast< itk::uint32_t >( image->GetLargestPossibleRegion().GetSize()[dim] );
+    header.Origin[dim] = image->GetOrigin()[dim];
+    }
+  header.NumberOfGeometryParameters = 0;
+  header.DataOffset = 256;
+  header.FrameCounter = 2;
+  const std::size_t dataLength = image->GetPixelContainer()->Size() * sizeof( TPixel );
+  const std::size_t length = static_cast< std::size_t >( header.DataOffset ) + dataLength;
+
+#if defined( ScanConversion_HAS_SHARED_MEMORY )
+  shm_unlink( segmentName );
+  const int descriptor = shm_open( segmentName, O_CREAT | O_RDWR, 0600 );
+  if( descriptor < 0 || ftruncate( descriptor, static_cast< off_t >( length ) ) != 0 )
+    {
+    std::cerr << "Could not create the shared memory frame " << segmentName << std::endl;
+    return EXIT_FAILURE;
+    }
+  void * address = mmap( ITK_NULLPTR, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0 );
+  close( descriptor );
+  if( address == MAP_FAILED )
+    {
+    std::cerr << "Could not map the shared memory frame " << segmentName << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::memcpy( address, &header, sizeof( header ) );
+  std::memcpy( static_cast< char * >( address ) + header.DataOffset, image->GetBufferPointer(), dataLength );
+  munmap( address, length );
+  return EXIT_SUCCESS;
+#else
+  std::cerr << "Shared memory frames are not supported on this platform: " << segmentName << std::endl;
+  return EXIT_FAILURE;
+#endif
+}
+
+
+/** Write a volume to a new shared memory frame, in its pixel type, with
+ * the geometry of the command line, e.g.
+ *
+ *   ScanConversionWriteSharedMemoryFrame <input volume> </segment name>
+ */
+inline int
+ScanConversionWriteSharedMemoryFrame( int argc, char * argv[] )
+{
+  if( argc < 3 )
+    {
+    std::cerr << "Usage: " << argv[0] << " inputVolume segmentName" << std::endl;
+    return EXIT_FAILURE;
+    }
+  itk::ImageIOBase::IOPixelType pixelType;
+  itk::ImageIOBase::IOComponentType componentType;
+  itk::GetImageType( argv[1], pixelType, componentType );
+  switch( componentType )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return WriteScanConversionSharedMemoryTestFrame< unsigned char >( argv[1], argv[2] );
+    case itk::ImageIOBase::USHORT:
+      return WriteScanConversionSharedMemoryTestFrame< unsigned short >( argv[1], argv[2] );
+    case itk::ImageIOBase::SHORT:
+      return WriteScanConversionSharedMemoryTestFrame< short >( argv[1], argv[2] );
+    case itk::ImageIOBase::FLOAT:
+      return WriteScanConversionSharedMemoryTestFrame< float >( argv[1], argv[2] );
+    case itk::ImageIOBase::DOUBLE:
+      return WriteScanConversionSharedMemoryTestFrame< double >( argv[1], argv[2] );
+    default:
+      std::cerr << "Unsupported pixel type of " << argv[1] << std::endl;
+      return EXIT_FAILURE;
+    }
+}
+
+
+inline int
+ScanConversionRemoveSharedMemoryFrame( int argc, char * argv[] )
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " segmentName" << std::endl;
+    return EXIT_FAILURE;
+    }
+#if defined( ScanConversion_HAS_SHARED_MEMORY )
+  return shm_unlink( argv[1] ) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+  return EXIT_FAILURE;
+#endif
+}
+
+
+template< typename TPixel >
+int
+StitchScanConversionTestSlabs( const char * outputFileName, const std::vector< const char * > & slabFileNames )
+{
+  typedef itk::Image< TPixel, 3 >            ImageType;
+  typedef itk::ImageFileReader< ImageType > ReaderType;
+  std::vector< typename ImageType::Pointer > slabs;
+  for( std::size_t slab = 0; slab < slabFileNames.size(); ++slab )
+    {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( slabFileNames[slab] );
+    reader->Update();
+    slabs.push_back( reader->GetOutput() );
+    }
+
+  typename ImageType::Pointer stitched = ImageType::New();
+  typename ImageType::SizeType size = slabs[0]->GetLargestPossibleRegion().GetSize();
+  size[2] = 0;
+  for( std::size_t slab = 0; slab < slabs.size(); ++slab )
+    {
+    const typename ImageType::SizeType & slabSize = slabs[slab]->GetLargestPossibleRegion().GetSize();
+    if( slabSize[0] != size[0] || slabSize[1] != size[1] )
+      {
+      std::cerr << "The slab " << slabFileNames[slab] << " does not have the size of the first slab" << std::endl;
+      return EXIT_FAILURE;
+      }
+    size[2] += slabSize[2];
+    }
+  stitched->CopyInformation( slabs[0] );
+  stitched->SetRegions( size );
+  stitched->Allocate();
+
+  // Each slab is placed at its origin in the stitched output
+  for( std::size_t slab = 0; slab < slabs.size(); ++slab )
+    {
+    typename ImageType::IndexType start;
+    if( !stitched->TransformPhysicalPointToIndex( slabs[slab]->GetOrigin(), start ) )
+      {
+      std::cerr << "The slab " << slabFileNames[slab] << " is outside of the stitched output" << std::endl;
+      return EXIT_FAILURE;
+      }
+    typename ImageType::RegionType region( start, slabs[slab]->GetLargestPossibleRegion().GetSize() );
+    if( !stitched->GetLargestPossibleRegion().IsInside( region ) )
+      {
+      std::cerr << "The slab " << slabFileNames[slab] << " is outside of the stitched output" << std::endl;
+      return EXIT_FAILURE;
+      }
+    itk::ImageAlgorithm::Copy( slabs[slab].GetPointer(), stitched.GetPointer(),
+      slabs[slab]->GetLargestPossibleRegion(), region );
+    }
+
+  typedef itk::ImageFileWriter< ImageType > WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( outputFileName );
+  writer->SetInput( stitched );
+  writer->Update();
+  return EXIT_SUCCESS;
+}
+
+
+/** Stitch the slabs of an output written with --outputSlab, in order along
+ * the last axis, e.g.
+ *
+ *   ScanConversionStitchSlabs <output> <slab 0> <slab 1>...
+ */
+inline int
+ScanConversionStitchSlabs( int argc, char * argv[] )
+{
+  if( argc < 3 )
+    {
+    std::cerr << "Usage: " << argv[0] << " output slab..." << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::vector< const char * > slabFileNames( argv + 2, argv + argc );
+  itk::ImageIOBase::IOPixelType pixelType;
+  itk::ImageIOBase::IOComponentType componentType;
+  itk::GetImageType( argv[2], pixelType, componentType );
+  switch( componentType )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return StitchScanConversionTestSlabs< unsigned char >( argv[1], slabFileNames );
+    case itk::ImageIOBase::USHORT:
+      return StitchScanConversionTestSlabs< unsigned short >( argv[1], slabFileNames );
+    case itk::ImageIOBase::SHORT:
+      return StitchScanConversionTestSlabs< short >( argv[1], slabFileNames );
+    case itk::ImageIOBase::FLOAT:
+      return StitchScanConversionTestSlabs< float >( argv[1], slabFileNames );
+    case itk::ImageIOBase::DOUBLE:
+      return StitchScanConversionTestSlabs< double >( argv[1], slabFileNames );
+    default:
+      std::cerr << "Unsupported pixel type of " << argv[2] << std::endl;
+      return EXIT_FAILURE;
+    }
+}
+
+
+/** Whether the ITK and VTK thread defaults and the processor affinity of the
+ * calling thread are those of the process before the test. */
+struct ScanConversionThreadingState
+{
+  ScanConversionThreadingState():
+    ITKNumberOfThreads( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    VTKMaximumNumberOfThreads( vtkMultiThreader::GetGlobalMaximumNumberOfThreads() )
+  {
+#if defined( __linux__ )
+    CPU_ZERO( &CPUSet );
+    sched_getaffinity( 0, sizeof( CPUSet ), &CPUSet );
+#endif
+  }
+
+  bool operator==( const ScanConversionThreadingState & other ) const
+  {
+    return ITKNumberOfThreads == other.ITKNumberOfThreads
+      && VTKMaximumNumberOfThreads == other.VTKMaximumNumberOfThreads
+#if defined( __linux__ )
+      && CPU_EQUAL( &CPUSet, &other.CPUSet )
+#endif
+      ;
+  }
+
+  itk::ThreadIdType ITKNumberOfThreads;
+  int               VTKMaximumNumberOfThreads;
+#if defined( __linux__ )
+  cpu_set_t         CPUSet;
+#endif
+};
+
+
+/** Check ParseScanConversionCPUList, and that a ScanConversionThreadingScope
+ * sets the threads and the affinity and restores them, e.g.
+ *
+ *   ScanConversionThreadingTest [ModuleEntryPoint <arguments>...]
+ *
+ * With a module command, the module is also run with --cpuAffinity set to
+ * the first processor of the process, and the threading is checked to be
+ * restored after it returns. */
+inline int
+ScanConversionThreadingTest( int argc, char * argv[] )
+{
+  struct CPUListCase
+  {
+    const char * List;
+    bool         Valid;
+    unsigned int NumberOfCPUs;
+    int          First;
+    int          Last;
+  };
+  const CPUListCase cases[] = {
+    { "0", true, 1, 0, 0 },
+    { "2-5", true, 4, 2, 5 },
+    { "0-1,4,6-7", true, 5, 0, 7 },
+    { "3,1,3", true, 2, 1, 3 },
+    { "", false, 0, 0, 0 },
+    { "3-1", false, 0, 0, 0 },
+    { "1-", false, 0, 0, 0 },
+    { "-1", false, 0, 0, 0 },
+    { "1,,2", false, 0, 0, 0 },
+    { " 1", false, 0, 0, 0 },
+    { "a", false, 0, 0, 0 },
+    { "node:", false, 0, 0, 0 },
+    { "node:a", false, 0, 0, 0 }
+  };
+  for( unsigned int caseIndex = 0; caseIndex < sizeof( cases ) / sizeof( cases[0] ); ++caseIndex )
+    {
+    const CPUListCase & cpuListCase = cases[caseIndex];
+    std::set< int > cpus;
+    const bool valid = ParseScanConversionCPUList( cpuListCase.List, cpus );
+    if( valid != cpuListCase.Valid
+      || ( valid && ( cpus.size() != cpuListCase.NumberOfCPUs
+          || *cpus.begin() != cpuListCase.First
+          || *cpus.rbegin() != cpuListCase.Last ) ) )
+      {
+      std::cerr << "ParseScanConversionCPUList of \"" << cpuListCase.List << "\" is wrong" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  const ScanConversionThreadingState before;
+  std::string firstCPU;
+#if defined( __linux__ )
+  for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+    {
+    if( CPU_ISSET( cpu, &before.CPUSet ) )
+      {
+      std::ostringstream cpuStream;
+      cpuStream << cpu;
+      firstCPU = cpuStream.str();
+      break;
+      }
+    }
+#endif
+
+    {
+    ScanConversionThreadingScope scope;
+    if( scope.Configure( -1, "" ) == EXIT_SUCCESS || scope.Configure( 1, "3-1" ) == EXIT_SUCCESS )
+      {
+      std::cerr << "Configure accepted an invalid number of threads or processor list" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( scope.Configure( 1, firstCPU ) != EXIT_SUCCESS )
+      {
+      return EXIT_FAILURE;
+      }
+    if( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() != 1
+      || vtkMultiThreader::GetGlobalMaximumNumberOfThreads() != 1 )
+      {
+      std::cerr << "Configure did not set the number of threads" << std::endl;
+      return EXIT_FAILURE;
+      }
+#if defined( __linux__ )
+    cpu_set_t cpuSet;
+    if( sched_getaffinity( 0, sizeof( cpuSet ), &cpuSet ) != 0 || CPU_COUNT( &cpuSet ) != 1 )
+      {
+      std::cerr << "Configure did not bind the thread to processor " << firstCPU << std::endl;
+      return EXIT_FAILURE;
+      }
+#endif
+    }
+  if( !( ScanConversionThreadingState() == before ) )
+    {
+    std::cerr << "ScanConversionThreadingScope did not restore the threading" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if( argc < 2 )
+    {
+    return EXIT_SUCCESS;
+    }
+  std::vector< char * > moduleArguments;
+  moduleArguments.push_back( argv[1] );
+  std::string affinityFlag = "--cpuAffinity";
+  if( !firstCPU.empty() )
+    {
+    moduleArguments.push_back( &affinityFlag[0] );
+    moduleArguments.push_back( &firstCPU[0] );
+    }
+  moduleArguments.insert( moduleArguments.end(), argv + 2, argv + argc );
+  moduleArguments.push_back( ITK_NULLPTR );
+  std::map< std::string, MainFuncPointer >::const_iterator function = StringToTestFunctionMap.find( argv[1] );
+  if( function == StringToTestFunctionMap.end() )
+    {
+    std::cerr << "Unknown test function " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( ( *function->second )( static_cast< int >( moduleArguments.size() - 1 ), &moduleArguments[0] ) != EXIT_SUCCESS )
+    {
+    return EXIT_FAILURE;
+    }
+  if( !( ScanConversionThreadingState() == before ) )
+    {
+    std::cerr << argv[1] << " did not restore the threading" << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+
+/** Check that a profile written by the --profile option of a module has each
+ * of the given stages, e.g.
+ *
+ *   ScanConversionCheckProfile <profile.json> "Read Input" "Resample Image" Total
+ *
+ * The profile is removed once it is checked, so a later run of the test
+ * does not check a stale profile.
+ */
+inline int
+ScanConversionCheckProfile( int argc, char * argv[] )
+{
+  if( argc < 3 )
+    {
+    std::cerr << "Usage: " << argv[0] << " profile stage [stage ...]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::ifstream profileStream( argv[1] );
+  if( !profileStream )
+    {
+    std::cerr << "The profile " << argv[1] << " was not written" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::ostringstream profileText;
+  profileText << profileStream.rdbuf();
+  profileStream.close();
+  const std::string profile = profileText.str();
+
+  int status = EXIT_SUCCESS;
+  if( profile.find( "\"stages\": [" ) == std::string::npos )
+    {
+    std::cerr << "The profile " << argv[1] << " has no stages" << std::endl;
+    status = EXIT_FAILURE;
+    }
+  for( int stage = 2; stage < argc; ++stage )
+    {
+    const std::string stageEntry = std::string( "{ \"name\": \"" ) + argv[stage] + "\", \"count\": ";
+    if( profile.find( stageEntry ) == std::string::npos )
+      {
+      std::cerr << "The profile " << argv[1] << " has no " << argv[stage] << " stage" << std::endl;
+      status = EXIT_FAILURE;
+      }
+    }
+  itksys::SystemTools::RemoveFile( argv[1] );
+  return status;
+}
+
+
+inline void
+RegisterScanConversionTests()
+{
+  StringToTestFunctionMap["ScanConversionTestSequence"] = ScanConversionTestSequence;
+  StringToTestFunctionMap["ScanConversionServerTest"] = ScanConversionServerTest;
+  StringToTestFunctionMap["ScanConversionWriteSharedMemoryFrame"] = ScanConversionWriteSharedMemoryFrame;
+  StringToTestFunctionMap["ScanConversionRemoveSharedMemoryFrame"] = ScanConversionRemoveSharedMemoryFrame;
+  StringToTestFunctionMap["ScanConversionStitchSlabs"] = ScanConversionStitchSlabs;
+  StringToTestFunctionMap["ScanConversionThreadingTest"] = ScanConversionThreadingTest;
+  StringToTestFunctionMap["ScanConversionCheckProfile"] = ScanConversionCheckProfile;
+}
+
+}
+
+#endif
@@ -0,0 +1,265 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionThreading_h
+#define ScanConversionThreading_h
+
+#include "itkMultiThreader.h"
+#include "itksys/Directory.hxx"
+
+#include "vtkMultiThreader.h"
+#include "vtkSMPTools.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined( __linux__ )
+#include <cerrno>
+#include <sched.h>
+#endif
+
+namespace
+{
+
+/** Parse a list of processors, e.g. "0-7,16-23", into cpus. A list of the
+ * form "node:N" is the list of the processors of NUMA node N. Returns false
+ * if the list is not valid. */
+inline bool
+ParseScanConversionCPUList( const std::string & cpuList, std::set< int > & cpus )
+{
+  const std::string nodePrefix = "node:";
+  if( cpuList.compare( 0, nodePrefix.size(), nodePrefix ) == 0 )
+    {
+    const std::string node = cpuList.substr( nodePrefix.size() );
+    if( node.empty() || node.find_first_not_of( "0123456789" ) != std::string::npos )
+      {
+      return false;
+      }
+    const std::string nodeFileName = "/sys/devices/system/node/node" + node + "/cpulist";
+    std::ifstream nodeFile( nodeFileName.c_str() );
+    std::string nodeCPUList;
+    if( !std::getline( nodeFile, nodeCPUList ) )
+      {
+      std::cerr << "Could not read the processors of NUMA node " << node << " from " << nodeFileName << std::endl;
+      return false;
+      }
+    return ParseScanConversionCPUList( nodeCPUList, cpus );
+    }
+
+  std::istringstream ranges( cpuList );
+  std::string range;
+  while( std::getline( ranges, range, ',' ) )
+    {
+    const std::string::size_type dash = range.find( '-' );
+    const std::string firstString = range.substr( 0, dash );
+    const std::string lastString = dash == std::string::npos ? firstString : range.substr( dash + 1 );
+    if( firstString.empty() || lastString.empty()
+      || firstString.find_first_not_of( "0123456789" ) != std::string::npos
+      || lastString.find_first_not_of( "0123456789" ) != std::string::npos )
+      {
+      return false;
+      }
+    const int first = std::atoi( firstString.c_str() );
+    const int last = std::atoi( lastString.c_str() );
+    if( last < first )
+      {
+      return false;
+      }
+    for( int cpu = first; cpu <= last; ++cpu )
+      {
+      cpus.insert( cpu );
+      }
+    }
+  return !cpus.empty();
+}
+
+
+#if defined( __linux__ )
+/** Processor affinity of each thread of the process. */
+typedef std::vector< std::pair< pid_t, cpu_set_t > > ScanConversionThreadAffinityContainer;
+
+
+/** Bind every thread of the process to the processors of cpuSet, and append
+ * the previous affinity of each thread to previous. sched_setaffinity only
+ * binds the thread it is given, so the threads are listed in
+ * /proc/self/task. Returns false if a thread could not be bound. */
+inline bool
+SetScanConversionProcessAffinity( const cpu_set_t & cpuSet, ScanConversionThreadAffinityContainer & previous )
+{
+  itksys::Directory tasks;
+  std::vector< pid_t > threads;
+  if( tasks.Load( "/proc/self/task" ) )
+    {
+    for( unsigned long file = 0; file < tasks.GetNumberOfFiles(); ++file )
+      {
+      const std::string name = tasks.GetFile( file );
+      if( !name.empty() && name.find_first_not_of( "0123456789" ) == std::string::npos )
+        {
+        threads.push_back( static_cast< pid_t >( std::atoi( name.c_str() ) ) );
+        }
+      }
+    }
+  if( threads.empty() )
+    {
+    // Without /proc, bind the calling thread
+    threads.push_back( 0 );
+    }
+  for( std::vector< pid_t >::const_iterator thread = threads.begin(); thread != threads.end(); ++thread )
+    {
+    cpu_set_t threadCPUSet;
+    if( sched_getaffinity( *thread, sizeof( threadCPUSet ), &threadCPUSet ) != 0 )
+      {
+      // The thread exited since the tasks were listed
+      continue;
+      }
+    if( sched_setaffinity( *thread, sizeof( cpuSet ), &cpuSet ) != 0 )
+      {
+      if( errno == ESRCH )
+        {
+        continue;
+        }
+      return false;
+      }
+    previous.push_back( std::make_pair( *thread, threadCPUSet ) );
+    }
+  return true;
+}
+#endif
+
+
+/** \class ScanConversionThreadingScope
+ *
+ * \brief Threads and processor affinity of a scan conversion for the
+ * lifetime of the scope.
+ *
+ * Configure limits the threads of every stage of a scan conversion, the ITK
+ * filters and threaders, the VTK SMP backend and threaders, and the writers,
+ * to numberOfThreads, and binds every thread of the process to the
+ * processors of cpuAffinity. Zero threads keeps the ITK default, or uses one
+ * thread per processor of cpuAffinity. An empty cpuAffinity keeps the
+ * processors of the process. Threads created later inherit the affinity of
+ * the thread that creates them.
+ *
+ * The destructor restores the global default numbers of threads of the ITK
+ * and VTK threaders and the affinity of the threads that were bound, so a
+ * module that runs in the process of the application does not change its
+ * threading. The SMP backend of VTK does not report its number of threads,
+ * so it is returned to its default instead.
+ */
+class ScanConversionThreadingScope
+{
+public:
+  ScanConversionThreadingScope():
+    m_ITKNumberOfThreads( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_VTKMaximumNumberOfThreads( vtkMultiThreader::GetGlobalMaximumNumberOfThreads() ),
+    m_SMPInitialized( false )
+  {
+  }
+
+  ~ScanConversionThreadingScope()
+  {
+    itk::MultiThreader::SetGlobalDefaultNumberOfThreads( m_ITKNumberOfThreads );
+    vtkMultiThreader::SetGlobalMaximumNumberOfThreads( m_VTKMaximumNumberOfThreads );
+    if( m_SMPInitialized )
+      {
+      vtkSMPTools::Initialize( 0 );
+      }
+#if defined( __linux__ )
+    for( ScanConversionThreadAffinityContainer::const_iterator thread = m_ThreadAffinities.begin();
+      thread != m_ThreadAffinities.end();
+      ++thread )
+      {
+      // Threads that exited are skipped
+      sched_setaffinity( thread->first, sizeof( thread->second ), &thread->second );
+      }
+#endif
+  }
+
+  int Configure( int numberOfThreads, const std::string & cpuAffinity )
+  {
+    if( numberOfThreads < 0 )
+      {
+      std::cerr << "The number of threads must be positive, or zero for the default" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    if( !cpuAffinity.empty() )
+      {
+      std::set< int > cpus;
+      if( !ParseScanConversionCPUList( cpuAffinity, cpus ) )
+        {
+        std::cerr << "Invalid processor list: " << cpuAffinity << std::endl;
+        return EXIT_FAILURE;
+        }
+#if defined( __linux__ )
+      cpu_set_t cpuSet;
+      CPU_ZERO( &cpuSet );
+      for( std::set< int >::const_iterator cpu = cpus.begin(); cpu != cpus.end(); ++cpu )
+        {
+        if( *cpu >= CPU_SETSIZE )
+          {
+          std::cerr << "Processor " << *cpu << " is beyond the largest supported processor" << std::endl;
+          return EXIT_FAILURE;
+          }
+        CPU_SET( *cpu, &cpuSet );
+        }
+      if( !SetScanConversionProcessAffinity( cpuSet, m_ThreadAffinities ) )
+        {
+        std::cerr << "Could not bind the process to the processors " << cpuAffinity << std::endl;
+        return EXIT_FAILURE;
+        }
+#else
+      std::cerr << "Processor affinity is not supported on this platform, ignoring " << cpuAffinity << std::endl;
+#endif
+      if( numberOfThreads == 0 )
+        {
+        numberOfThreads = static_cast< int >( cpus.size() );
+        }
+      }
+
+    if( numberOfThreads > 0 )
+      {
+      itk::MultiThreader::SetGlobalDefaultNumberOfThreads( numberOfThreads );
+      vtkMultiThreader::SetGlobalMaximumNumberOfThreads( numberOfThreads );
+      vtkSMPTools::Initialize( numberOfThreads );
+      m_SMPInitialized = true;
+      }
+    return EXIT_SUCCESS;
+  }
+
+private:
+  ScanConversionThreadingScope( const ScanConversionThreadingScope & );
+  void operator=( const ScanConversionThreadingScope & );
+
+  const itk::ThreadIdType m_ITKNumberOfThreads;
+  const int               m_VTKMaximumNumberOfThreads;
+  bool                    m_SMPInitialized;
+#if defined( __linux__ )
+  ScanConversionThreadAffinityContainer m_ThreadAffinities;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ScanConversionWindowedSincInterpolateImageFunction_h
+#define ScanConversionWindowedSincInterpolateImageFunction_h
+
+#include "itkInterpolateImageFunction.h"
+#include "itkMath.h"
+#include "vnl/vnl_math.h"
+
+#include "ScanConversionFiniteSample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+/** \class ScanConversionWindowedSincInterpolateImageFunction
+ *
+ * \brief Lanczos windowed-sinc interpolation with a tabulated kernel.
+ *
+ * The weights are those of the itk::WindowedSincInterpolateImageFunction
+ * with an itk::Function::LanczosWindowFunction of the same radius, and the
+ * samples beyond the buffer are the nearest samples in the buffer, as with
+ * its zero flux Neumann boundary condition. The radius is a template
+ * parameter, so the support of 2 * VRadius samples along each axis has a
+ * fixed size. The kernel is linearly interpolated from a table with
+ * KernelTableSamplesPerUnit entries per sample instead of evaluating sines,
+ * and the weighted sum is evaluated as one pass along each axis.
+ *
+ * With ReplaceNonFinite, the non-finite samples of the support are replaced
+ * with zero as they are read, as after an itk::ReplaceNonFiniteImageFilter.
+ */
+template< typename TInputImage, unsigned int VRadius, typename TCoordRep = double >
+class ScanConversionWindowedSincInterpolateImageFunction:
+  public itk::InterpolateImageFunction< TInputImage, TCoordRep >
+{
+public:
+  typedef ScanConversionWindowedSincInterpolateImageFunction        Self;
+  typedef itk::InterpolateImageFunction< TInputImage, TCoordRep >   Superclass;
+  typedef itk::SmartPointer< Self >                                 Pointer;
+  typedef itk::SmartPointer< const Self >                           ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( ScanConversionWindowedSincInterpolateImageFunction, InterpolateImageFunction );
+
+  itkStaticConstMacro( ImageDimension, unsigned int, TInputImage::ImageDimension );
+  itkStaticConstMacro( Radius, unsigned int, VRadius );
+  itkStaticConstMacro( WindowSize, unsigned int, 2 * VRadius );
+  itkStaticConstMacro( KernelTableSamplesPerUnit, unsigned int, 1024 );
+
+  typedef typename Superclass::InputImageType      InputImageType;
+  typedef typename Superclass::OutputType          OutputType;
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+  typedef typename Superclass::RealType            RealType;
+  typedef typename InputImageType::PixelType       InputPixelType;
+
+  virtual void SetInputImage( const InputImageType * image ) ITK_OVERRIDE
+    {
+    Superclass::SetInputImage( image );
+    if( image == ITK_NULLPTR )
+      {
+      return;
+      }
+    const typename InputImageType::RegionType & bufferedRegion = image->GetBufferedRegion();
+    const typename InputImageType::OffsetValueType * offsetTable = image->GetOffsetTable();
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_BufferStart[dim] = bufferedRegion.GetIndex( dim );
+      m_BufferSize[dim] = static_cast< itk::OffsetValueType >( bufferedRegion.GetSize( dim ) );
+      m_Strides[dim] = offsetTable[dim];
+      }
+    }
+
+  /** Replace the non-finite samples with zero. */
+  itkSetMacro( ReplaceNonFinite, bool );
+  itkGetConstMacro( ReplaceNonFinite, bool );
+  itkBooleanMacro( ReplaceNonFinite );
+
+  virtual OutputType EvaluateAtContinuousIndex( const ContinuousIndexType & cindex ) const ITK_OVERRIDE
+    {
+    // The support along each axis is [baseIndex - VRadius + 1, baseIndex + VRadius]
+    RealType weights[ImageDimension][WindowSize];
+    itk::OffsetValueType offsets[ImageDimension][WindowSize];
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      const itk::IndexValueType baseIndex = itk::Math::Floor< itk::IndexValueType >( cindex[dim] );
+      const RealType distance = cindex[dim] - static_cast< RealType >( baseIndex );
+      const itk::OffsetValueType first = baseIndex - m_BufferStart[dim] - static_cast< itk::OffsetValueType >( VRadius ) + 1;
+      for( unsigned int ii = 0; ii < WindowSize; ++ii )
+        {
+        const itk::OffsetValueType offset = std::min( std::max( first + static_cast< itk::OffsetValueType >( ii ),
+            static_cast< itk::OffsetValueType >( 0 ) ),
+          m_BufferSize[dim] - 1 );
+        offsets[dim][ii] = offset * m_Strides[dim];
+        weights[dim][ii] = this->Kernel( distance + VRadius - 1 - ii );
+        }
+      }
+
+    const InputPixelType * buffer = this->GetInputImage()->GetBufferPointer();
+    return static_cast< OutputType >( this->SumAlongAxis( ImageDimension - 1, buffer, weights, offsets ) );
+    }
+
+protected:
+  ScanConversionWindowedSincInterpolateImageFunction():
+    m_ReplaceNonFinite( false )
+  {
+    for( unsigned int dim = 0; dim < ImageDimension; ++dim )
+      {
+      m_BufferStart[dim] = 0;
+      m_BufferSize[dim] = 0;
+      m_Strides[dim] = 0;
+      }
+
+    // sinc( x ) * sinc( x / VRadius ) for | x | in [0, VRadius], plus an
+    // entry past the end for the interpolation
+    const unsigned int numberOfEntries = VRadius * KernelTableSamplesPerUnit + 2;
+    m_KernelTable.resize( numberOfEntries, 0.0 );
+    m_KernelTable[0] = 1.0;
+    for( unsigned int entry = 1; entry <= VRadius * KernelTableSamplesPerUnit; ++entry )
+      {
+      const double x = static_cast< double >( entry ) / KernelTableSamplesPerUnit;
+      const double piX = vnl_math::pi * x;
+      const double windowZ = piX / VRadius;
+      m_KernelTable[entry] = std::sin( piX ) / piX * std::sin( windowZ ) / windowZ;
+      }
+  }
+  ~ScanConversionWindowedSincInterpolateImageFunction() {}
+
+  virtual void PrintSelf( std::ostream & os, itk::Indent indent ) const ITK_OVERRIDE
+    {
+    Superclass::PrintSelf( os, indent );
+    os << indent << "Radius: " << VRadius << std::endl;
+    os << indent << "ReplaceNonFinite: " << m_ReplaceNonFinite << std::endl;
+    }
+
+private:
+  ScanConversionWindowedSincInterpolateImageFunction( const Self & ); // purposely not implemented
+  void operator=( const Self & ); // purposely not implemented
+
+  RealType Kernel( RealType x ) const
+    {
+    const RealType position = std::abs( x ) * KernelTableSamplesPerUnit;
+    if( position >= VRadius * KernelTableSamplesPerUnit )
+      {
+      return 0.0;
+      }
+    const unsigned int entry = static_cast< unsigned int >( position );
+    const RealType fraction = position - entry;
+    return m_KernelTable[entry] + fraction * ( m_KernelTable[entry + 1] - m_KernelTable[entry] );
+    }
+
+  /** Weighted sum of the support along the axes up to axis, starting at
+   * sample. */
+  RealType SumAlongAxis( unsigned int axis,
+    const InputPixelType * sample,
+    const RealType weights[ImageDimension][WindowSize],
+    const itk::OffsetValueType offsets[ImageDimension][WindowSize] ) const
+    {
+    RealType sum = 0.0;
+    if( axis == 0 )
+      {
+      if( m_ReplaceNonFinite )
+        {
+        for( unsigned int ii = 0; ii < WindowSize; ++ii )
+          {
+          sum += weights[0][ii] * static_cast< RealType >( ScanConversionFiniteSample( sample[offsets[0][ii]] ) );
+          }
+        return sum;
+        }
+      for( unsigned int ii = 0; ii < WindowSize; ++ii )
+        {
+        sum += weights[0][ii] * static_cast< RealType >( sample[offsets[0][ii]] );
+        }
+      return sum;
+      }
+    for( unsigned int ii = 0; ii < WindowSize; ++ii )
+      {
+      sum += weights[axis][ii] * this->SumAlongAxis( axis - 1, sample + offsets[axis][ii], weights, offsets );
+      }
+    return sum;
+    }
+
+  itk::IndexValueType   m_BufferStart[ImageDimension];
+  itk::OffsetValueType  m_BufferSize[ImageDimension];
+  itk::OffsetValueType  m_Strides[ImageDimension];
+  std::vector< double > m_KernelTable;
+  bool                  m_ReplaceNonFinite;
+};
+
+}
+
+#endif